@@ -0,0 +1,464 @@
+#include "BenchmarkRunner.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+
+using namespace cv;
+
+//----------
+// every allocation in the process is counted, including OpenCV's worker threads
+static std::atomic<uint64_t> heapAllocationCount{ 0 };
+static std::atomic<uint64_t> heapAllocationBytes{ 0 };
+static std::atomic<uint64_t> matAllocationCount{ 0 };
+static std::atomic<uint64_t> matAllocationBytes{ 0 };
+
+void * operator new(std::size_t size) {
+	heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	heapAllocationBytes.fetch_add(size, std::memory_order_relaxed);
+	if (auto pointer = std::malloc(size ? size : 1)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void * pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void * pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void * pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void * pointer, std::size_t) noexcept {
+	std::free(pointer);
+}
+
+//----------
+// counts Mat data allocations, and leaves the work to OpenCV's own allocator
+class CountingMatAllocator : public MatAllocator {
+public:
+	UMatData * allocate(int dims, const int * sizes, int type, void * data, size_t * step, AccessFlag flags, UMatUsageFlags usageFlags) const override {
+		if (!data) {
+			uint64_t bytes = CV_ELEM_SIZE(type);
+			for (int i = 0; i < dims; i++) {
+				bytes *= sizes[i];
+			}
+			matAllocationCount.fetch_add(1, std::memory_order_relaxed);
+			matAllocationBytes.fetch_add(bytes, std::memory_order_relaxed);
+		}
+		return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+	}
+
+	bool allocate(UMatData * data, AccessFlag flags, UMatUsageFlags usageFlags) const override {
+		return Mat::getStdAllocator()->allocate(data, flags, usageFlags);
+	}
+
+	void deallocate(UMatData * data) const override {
+		Mat::getStdAllocator()->deallocate(data);
+	}
+};
+
+static CountingMatAllocator countingMatAllocator;
+
+//----------
+string BenchmarkResult::getKey() const {
+	return this->name + "|" + this->input + "|" + this->size + "|" + BenchmarkRunner::getDepthName(this->depth) + "|" + ofToString(this->channels);
+}
+
+//----------
+ofJson BenchmarkResult::toJson() const {
+	ofJson json;
+	json["name"] = this->name;
+	json["input"] = this->input;
+	json["size"] = this->size;
+	json["width"] = this->width;
+	json["height"] = this->height;
+	json["depth"] = BenchmarkRunner::getDepthName(this->depth);
+	json["channels"] = this->channels;
+	json["iterations"] = this->iterations;
+	json["secondsPerCall"] = this->secondsPerCall;
+	json["throughput"] = this->throughput;
+	json["unit"] = this->unit;
+	json["matAllocationsPerCall"] = this->matAllocationsPerCall;
+	json["matBytesPerCall"] = this->matBytesPerCall;
+	json["heapAllocationsPerCall"] = this->heapAllocationsPerCall;
+	json["heapBytesPerCall"] = this->heapBytesPerCall;
+	if (!this->error.empty()) {
+		json["error"] = this->error;
+	}
+	return json;
+}
+
+//----------
+BenchmarkResult BenchmarkResult::fromJson(const ofJson & json) {
+	BenchmarkResult result;
+	result.name = json.value("name", "");
+	result.input = json.value("input", "");
+	result.size = json.value("size", "");
+	result.width = json.value("width", 0);
+	result.height = json.value("height", 0);
+	result.depth = BenchmarkRunner::getDepthFromName(json.value("depth", ""));
+	result.channels = json.value("channels", 0);
+	result.iterations = json.value("iterations", (size_t) 0);
+	result.secondsPerCall = json.value("secondsPerCall", 0.0);
+	result.throughput = json.value("throughput", 0.0);
+	result.unit = json.value("unit", "");
+	result.matAllocationsPerCall = json.value("matAllocationsPerCall", 0.0);
+	result.matBytesPerCall = json.value("matBytesPerCall", 0.0);
+	result.heapAllocationsPerCall = json.value("heapAllocationsPerCall", 0.0);
+	result.heapBytesPerCall = json.value("heapBytesPerCall", 0.0);
+	result.error = json.value("error", "");
+	return result;
+}
+
+//----------
+vector<BenchmarkSize> BenchmarkRunner::getDefaultSizes() {
+	return {
+		{ "VGA", 640, 480 },
+		{ "HD", 1280, 720 },
+		{ "FHD", 1920, 1080 },
+		{ "4K", 3840, 2160 },
+		{ "8K", 7680, 4320 }
+	};
+}
+
+//----------
+string BenchmarkRunner::getDepthName(int depth) {
+	switch (depth) {
+	case CV_8U: return "8U";
+	case CV_8S: return "8S";
+	case CV_16U: return "16U";
+	case CV_16S: return "16S";
+	case CV_32S: return "32S";
+	case CV_32F: return "32F";
+	case CV_64F: return "64F";
+	default: return "";
+	}
+}
+
+//----------
+int BenchmarkRunner::getDepthFromName(const string & name) {
+	for (int depth = CV_8U; depth <= CV_64F; depth++) {
+		if (getDepthName(depth) == name) {
+			return depth;
+		}
+	}
+	return -1;
+}
+
+//----------
+void BenchmarkRunner::addItems(const string & name, size_t itemCount, std::function<void()> function) {
+	Benchmark benchmark;
+	benchmark.name = name;
+	benchmark.itemCount = std::max(itemCount, (size_t) 1);
+	benchmark.runItems = function;
+	this->benchmarks.push_back(benchmark);
+}
+
+//----------
+void BenchmarkRunner::addCheck(const string & name, std::function<bool()> function) {
+	this->checks.push_back({ name, function });
+}
+
+//----------
+size_t BenchmarkRunner::runChecks(const Settings & settings) {
+	size_t failures = 0;
+	for (const auto & check : this->checks) {
+		if (!settings.filter.empty() && check.name.find(settings.filter) == string::npos) {
+			continue;
+		}
+
+		bool passed = false;
+		string error;
+		try {
+			passed = check.function();
+		}
+		catch (const std::exception & e) {
+			error = e.what();
+		}
+		cout << std::left << std::setw(36) << check.name << (passed ? "ok" : "FAILED " + error) << endl;
+		if (!passed) {
+			failures++;
+		}
+	}
+	return failures;
+}
+
+//----------
+vector<BenchmarkResult> BenchmarkRunner::run(const Settings & settings) {
+	this->settings = settings;
+
+	auto previousAllocator = Mat::getDefaultAllocator();
+	Mat::setDefaultAllocator(&countingMatAllocator);
+
+	cout << std::left << std::setw(36) << "name" << std::setw(10) << "input" << std::setw(6) << "size" << std::right
+		<< std::setw(5) << "depth"
+		<< std::setw(4) << "ch"
+		<< std::setw(12) << "ms/call"
+		<< std::setw(12) << "throughput"
+		<< std::setw(10) << ""
+		<< std::setw(10) << "mat allocs"
+		<< std::setw(11) << "heap allocs" << endl;
+
+	vector<BenchmarkResult> results;
+	auto runCase = [&results](BenchmarkResult & result, const std::function<void()> & call) {
+		try {
+			call();
+		}
+		catch (const cv::Exception & e) {
+			result.error = e.what();
+		}
+		catch (const std::exception & e) {
+			result.error = e.what();
+		}
+		print(result);
+		results.push_back(result);
+	};
+
+	for (const auto & benchmark : this->benchmarks) {
+		if (!this->settings.filter.empty() && benchmark.name.find(this->settings.filter) == string::npos) {
+			continue;
+		}
+
+		if (benchmark.runItems) {
+			BenchmarkResult result;
+			result.name = benchmark.name;
+			runCase(result, [&]() {
+				this->measure(benchmark.runItems, result);
+				result.throughput = result.secondsPerCall > 0.0 ? (double) benchmark.itemCount / result.secondsPerCall / 1e6 : 0.0;
+				result.unit = "Mitems/s";
+			});
+			continue;
+		}
+
+		for (const auto & size : this->settings.sizes) {
+			for (auto depth : benchmark.options.depths) {
+				if (find(this->settings.depths.begin(), this->settings.depths.end(), depth) == this->settings.depths.end()) {
+					continue;
+				}
+				for (auto channels : benchmark.options.channels) {
+					vector<string> inputs = { "Mat" };
+					if (benchmark.options.pixels) {
+						inputs.push_back("ofPixels");
+					}
+					for (const auto & input : inputs) {
+						Case imageCase{ size, depth, channels, input, benchmark.options.fill };
+
+						BenchmarkResult result;
+						result.name = benchmark.name;
+						result.input = input;
+						result.size = size.name;
+						result.width = size.width;
+						result.height = size.height;
+						result.depth = depth;
+						result.channels = channels;
+						runCase(result, [&]() {
+							benchmark.runImage(imageCase, result);
+							result.throughput = result.secondsPerCall > 0.0 ? (double) size.width * size.height / result.secondsPerCall / 1e6 : 0.0;
+							result.unit = "MP/s";
+						});
+					}
+				}
+			}
+		}
+	}
+
+	Mat::setDefaultAllocator(previousAllocator);
+	return results;
+}
+
+//----------
+vector<BenchmarkResult> BenchmarkRunner::run() {
+	return this->run(Settings());
+}
+
+//----------
+bool BenchmarkRunner::save(const string & filename, const vector<BenchmarkResult> & results) {
+	ofJson json;
+	json["opencv"] = CV_VERSION;
+	json["results"] = ofJson::array();
+	for (const auto & result : results) {
+		json["results"].push_back(result.toJson());
+	}
+
+	std::ofstream file(filename);
+	file << json.dump(1, '\t') << endl;
+	if (!file) {
+		ofLogError("Benchmark") << "Couldn't write " << filename;
+		return false;
+	}
+	return true;
+}
+
+//----------
+bool BenchmarkRunner::load(const string & filename, vector<BenchmarkResult> & results) {
+	std::ifstream file(filename);
+	if (!file) {
+		ofLogError("Benchmark") << "Couldn't open " << filename;
+		return false;
+	}
+
+	try {
+		ofJson json;
+		file >> json;
+		results.clear();
+		for (const auto & result : json.at("results")) {
+			results.push_back(BenchmarkResult::fromJson(result));
+		}
+	}
+	catch (const std::exception & e) {
+		ofLogError("Benchmark") << "Couldn't read " << filename << " : " << e.what();
+		return false;
+	}
+	return true;
+}
+
+//----------
+size_t BenchmarkRunner::compare(const vector<BenchmarkResult> & results, const vector<BenchmarkResult> & baseline, double regressionThreshold) {
+	map<string, const BenchmarkResult *> baselineByKey;
+	for (const auto & result : baseline) {
+		baselineByKey[result.getKey()] = &result;
+	}
+
+	size_t regressions = 0, improvements = 0, unmatched = 0;
+	cout << endl << "compared with the baseline (threshold " << regressionThreshold * 100.0 << "%)" << endl;
+	cout << std::fixed << std::setprecision(3);
+	for (const auto & result : results) {
+		auto found = baselineByKey.find(result.getKey());
+		if (found == baselineByKey.end() || !found->second->error.empty() || !result.error.empty()) {
+			unmatched++;
+			continue;
+		}
+		const auto & before = *found->second;
+		const double ratio = before.secondsPerCall > 0.0 ? result.secondsPerCall / before.secondsPerCall : 1.0;
+
+		// allocations are averaged over the calls, so allow for the odd one which isn't made every time
+		const bool slower = ratio > 1.0 + regressionThreshold;
+		const bool moreAllocations = result.matAllocationsPerCall > before.matAllocationsPerCall + 0.5
+			|| result.heapAllocationsPerCall > before.heapAllocationsPerCall + 0.5;
+
+		if (slower || moreAllocations) {
+			regressions++;
+			cout << "REGRESSION " << result.getKey()
+				<< " : " << before.secondsPerCall * 1e3 << "ms -> " << result.secondsPerCall * 1e3 << "ms (x" << ratio << ")"
+				<< ", mat allocations " << before.matAllocationsPerCall << " -> " << result.matAllocationsPerCall
+				<< ", heap allocations " << before.heapAllocationsPerCall << " -> " << result.heapAllocationsPerCall << endl;
+		}
+		else if (ratio < 1.0 - regressionThreshold) {
+			improvements++;
+		}
+	}
+	cout << regressions << " regressions, " << improvements << " improvements, " << unmatched << " not in the baseline (or failed)" << endl;
+	return regressions;
+}
+
+//----------
+void BenchmarkRunner::fill(Mat & mat, Fill fill) {
+	// the same images every run
+	RNG rng(0x0fc7);
+	const double maxVal = ofxCv::getMaxVal(mat.depth());
+
+	switch (fill) {
+	case Fill::Noise:
+		rng.fill(mat, RNG::UNIFORM, Scalar::all(0), Scalar::all(maxVal));
+		break;
+	case Fill::Smooth:
+	{
+		Mat coarse(std::max(mat.rows / 32, 2), std::max(mat.cols / 32, 2), mat.type());
+		rng.fill(coarse, RNG::UNIFORM, Scalar::all(0), Scalar::all(maxVal));
+		cv::resize(coarse, mat, mat.size(), 0, 0, INTER_CUBIC);
+		break;
+	}
+	case Fill::Mask:
+	{
+		mat = Scalar::all(0);
+		const int radius = std::max(std::min(mat.rows, mat.cols) / 20, 1);
+		for (int i = 0; i < 20; i++) {
+			cv::Point center(rng.uniform(0, mat.cols), rng.uniform(0, mat.rows));
+			cv::circle(mat, center, radius, Scalar::all(maxVal), FILLED);
+		}
+		break;
+	}
+	case Fill::Checkerboard:
+	{
+		mat = Scalar::all(maxVal);
+		const int columns = 10, rows = 7;
+		const int square = std::min(mat.cols / (columns + 2), mat.rows / (rows + 2));
+		const cv::Point origin((mat.cols - square * columns) / 2, (mat.rows - square * rows) / 2);
+		for (int y = 0; y < rows; y++) {
+			for (int x = 0; x < columns; x++) {
+				if ((x + y) % 2 == 0) {
+					cv::rectangle(mat, cv::Rect(origin.x + x * square, origin.y + y * square, square, square), Scalar::all(0), FILLED);
+				}
+			}
+		}
+		break;
+	}
+	}
+}
+
+//----------
+void BenchmarkRunner::measure(const std::function<void()> & call, BenchmarkResult & result) {
+	// the first call allocates outputs, fills caches etc
+	call();
+
+	vector<double> times;
+	times.reserve(this->settings.maxIterations);
+
+	const auto matCountBefore = matAllocationCount.load();
+	const auto matBytesBefore = matAllocationBytes.load();
+	const auto heapCountBefore = heapAllocationCount.load();
+	const auto heapBytesBefore = heapAllocationBytes.load();
+
+	double elapsed = 0.0;
+	while ((elapsed < this->settings.minTime || times.size() < this->settings.minIterations) && times.size() < this->settings.maxIterations) {
+		const auto start = std::chrono::steady_clock::now();
+		call();
+		const auto end = std::chrono::steady_clock::now();
+		const double seconds = std::chrono::duration<double>(end - start).count();
+		times.push_back(seconds);
+		elapsed += seconds;
+	}
+
+	const double calls = (double) std::max(times.size(), (size_t) 1);
+	result.matAllocationsPerCall = (double) (matAllocationCount.load() - matCountBefore) / calls;
+	result.matBytesPerCall = (double) (matAllocationBytes.load() - matBytesBefore) / calls;
+	result.heapAllocationsPerCall = (double) (heapAllocationCount.load() - heapCountBefore) / calls;
+	result.heapBytesPerCall = (double) (heapAllocationBytes.load() - heapBytesBefore) / calls;
+
+	result.iterations = times.size();
+	if (!times.empty()) {
+		std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+		result.secondsPerCall = times[times.size() / 2];
+	}
+}
+
+//----------
+void BenchmarkRunner::print(const BenchmarkResult & result) {
+	cout << std::left << std::setw(36) << result.name << std::setw(10) << result.input << std::setw(6) << result.size << std::right
+		<< std::setw(5) << BenchmarkRunner::getDepthName(result.depth)
+		<< std::setw(4) << (result.channels ? ofToString(result.channels) : "");
+	if (!result.error.empty()) {
+		cout << "  failed : " << result.error << endl;
+		return;
+	}
+	cout << std::fixed << std::setprecision(3)
+		<< std::setw(12) << result.secondsPerCall * 1e3
+		<< std::setw(12) << result.throughput
+		<< std::setw(10) << result.unit
+		<< std::setprecision(1)
+		<< std::setw(10) << result.matAllocationsPerCall
+		<< std::setw(11) << result.heapAllocationsPerCall << endl;
+}
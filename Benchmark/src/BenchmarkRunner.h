@@ -0,0 +1,182 @@
+/*
+ a small harness for timing ofxCvMin's functions.
+
+ each benchmark is called once to warm up (so outputs are allocated), then
+ called repeatedly for at least minTime seconds. the median time of one call is
+ reported, along with the throughput (megapixels or millions of items per
+ second) and the allocations made during one call, both through cv::Mat's
+ allocator and on the heap (operator new).
+
+ image benchmarks run at every size and depth in the settings, with both Mat and
+ ofPixels inputs. results are saved as JSON, and can be compared with the JSON
+ from an earlier run (the baseline) to find regressions.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "ofxCvMin.h"
+
+#include <functional>
+
+struct BenchmarkSize {
+	string name;
+	int width;
+	int height;
+};
+
+struct BenchmarkResult {
+	string name;
+	string input; // Mat, ofPixels, or empty for benchmarks which don't take an image
+	string size;
+	int width = 0;
+	int height = 0;
+	int depth = -1;
+	int channels = 0;
+
+	size_t iterations = 0;
+	double secondsPerCall = 0.0; // median
+	double throughput = 0.0;
+	string unit;
+
+	double matAllocationsPerCall = 0.0;
+	double matBytesPerCall = 0.0;
+	double heapAllocationsPerCall = 0.0;
+	double heapBytesPerCall = 0.0;
+
+	string error; // what the function threw, if it did
+
+	// identifies the same benchmark in another run
+	string getKey() const;
+
+	ofJson toJson() const;
+	static BenchmarkResult fromJson(const ofJson &);
+};
+
+class BenchmarkRunner {
+public:
+	enum class Fill {
+		Noise, // uniform random values
+		Smooth, // blurry blobs, more like a photo
+		Mask, // sparse blobs at the maximum value on zero
+		Checkerboard // a 10x7 checkerboard (9x6 inner corners) filling most of the image
+	};
+
+	struct ImageOptions {
+		vector<int> depths = { CV_8U, CV_16U, CV_32F };
+		vector<int> channels = { 1, 3 };
+		Fill fill = Fill::Noise;
+		bool pixels = true; // also run with ofPixels inputs
+	};
+
+	struct Settings {
+		vector<BenchmarkSize> sizes = getDefaultSizes();
+		vector<int> depths = { CV_8U, CV_16U, CV_32F };
+		string filter; // only run benchmarks whose names contain this
+		double minTime = 0.2; // seconds spent calling each benchmark
+		size_t minIterations = 3;
+		size_t maxIterations = 10000;
+		double regressionThreshold = 0.1; // how much slower than the baseline counts as a regression (0.1 = 10%)
+	};
+
+	// VGA, HD, FHD, 4K and 8K
+	static vector<BenchmarkSize> getDefaultSizes();
+
+	static string getDepthName(int depth);
+	static int getDepthFromName(const string &);
+
+	// the function is called as function(src, dst), where src and dst are both Mat
+	// or both ofPixels of the depth being tested. dst starts off imitating src.
+	template<class F>
+	void addImage(const string & name, const ImageOptions & options, F function) {
+		Benchmark benchmark;
+		benchmark.name = name;
+		benchmark.options = options;
+		benchmark.runImage = [this, function](const Case & imageCase, BenchmarkResult & result) {
+			auto call = function;
+			if (imageCase.input == "Mat") {
+				this->runImage<cv::Mat>(imageCase, call, result);
+				return;
+			}
+			switch (imageCase.depth) {
+			case CV_8U:
+				this->runImage<ofPixels_<unsigned char>>(imageCase, call, result);
+				break;
+			case CV_16U:
+				this->runImage<ofPixels_<unsigned short>>(imageCase, call, result);
+				break;
+			case CV_32F:
+				this->runImage<ofPixels_<float>>(imageCase, call, result);
+				break;
+			default:
+				result.error = "ofPixels can't have depth " + getDepthName(imageCase.depth);
+			}
+		};
+		this->benchmarks.push_back(benchmark);
+	}
+
+	// for functions which don't take an image. the function should process itemCount
+	// things (e.g. points) in each call, and throughput is reported in millions of items per second
+	void addItems(const string & name, size_t itemCount, std::function<void()> function);
+
+	// a correctness check which runs before the benchmarks, e.g. that a fast path
+	// gives the same results as the one it replaces. returns false on failure
+	void addCheck(const string & name, std::function<bool()> function);
+
+	// runs the checks whose names contain the filter. returns how many failed
+	size_t runChecks(const Settings &);
+
+	vector<BenchmarkResult> run(const Settings &);
+	vector<BenchmarkResult> run();
+
+	static bool save(const string & filename, const vector<BenchmarkResult> &);
+	static bool load(const string & filename, vector<BenchmarkResult> &);
+
+	// prints the benchmarks which are slower than the baseline by more than the threshold,
+	// or make more allocations. returns how many there were
+	static size_t compare(const vector<BenchmarkResult> & results, const vector<BenchmarkResult> & baseline, double regressionThreshold);
+protected:
+	struct Case {
+		BenchmarkSize size;
+		int depth;
+		int channels;
+		string input;
+		Fill fill;
+	};
+
+	struct Benchmark {
+		string name;
+		ImageOptions options;
+		size_t itemCount = 0;
+		std::function<void(const Case &, BenchmarkResult &)> runImage;
+		std::function<void()> runItems;
+	};
+
+	template<class T, class F>
+	void runImage(const Case & imageCase, F & function, BenchmarkResult & result) {
+		T src, dst;
+		ofxCv::allocate(src, imageCase.size.width, imageCase.size.height, CV_MAKETYPE(imageCase.depth, imageCase.channels));
+		cv::Mat srcMat = ofxCv::toCv(src);
+		fill(srcMat, imageCase.fill);
+		ofxCv::imitate(dst, src);
+		this->measure([&]() {
+			function(src, dst);
+		}, result);
+	}
+
+	static void fill(cv::Mat &, Fill);
+	void measure(const std::function<void()> &, BenchmarkResult &);
+	static void print(const BenchmarkResult &);
+
+	struct Check {
+		string name;
+		std::function<bool()> function;
+	};
+
+	vector<Benchmark> benchmarks;
+	vector<Check> checks;
+	Settings settings;
+};
+
+// every benchmark and check of ofxCvMin's functions (Benchmarks.cpp)
+void addBenchmarks(BenchmarkRunner &);
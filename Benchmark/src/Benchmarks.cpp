@@ -0,0 +1,566 @@
+#include "BenchmarkRunner.h"
+
+using namespace cv;
+
+// drawing functions (drawMat, drawCorners, drawHighlightString) need a GL context, and
+// loadMat / saveMat / saveImage are mostly disk time, so they're left out
+
+typedef BenchmarkRunner::ImageOptions Options;
+typedef BenchmarkRunner::Fill Fill;
+
+//----------
+static Options makeOptions(const vector<int> & depths, const vector<int> & channels, Fill fill = Fill::Noise, bool pixels = true) {
+	Options options;
+	options.depths = depths;
+	options.channels = channels;
+	options.fill = fill;
+	options.pixels = pixels;
+	return options;
+}
+
+static const vector<int> allDepths = { CV_8U, CV_16U, CV_32F };
+
+//----------
+// corners of the image pulled in by a tenth, for the perspective warps
+template<class T>
+static vector<Point2f> getInsetCorners(T & img) {
+	const float w = ofxCv::getWidth(img), h = ofxCv::getHeight(img);
+	return {
+		Point2f(w * 0.1f, h * 0.1f),
+		Point2f(w * 0.9f, h * 0.05f),
+		Point2f(w * 0.95f, h * 0.95f),
+		Point2f(w * 0.05f, h * 0.9f)
+	};
+}
+
+//----------
+static void addUtilities(BenchmarkRunner & runner) {
+	const auto any = makeOptions(allDepths, { 1, 3 });
+
+	runner.addImage("imitate", any, [](auto & src, auto & dst) {
+		ofxCv::imitate(dst, src);
+	});
+	runner.addImage("copy", any, [](auto & src, auto & dst) {
+		ofxCv::copy(src, dst);
+	});
+
+	// converting copies write to a Mat, an ofPixels of the source's type can't hold the result
+	runner.addImage("copy to 32F", makeOptions({ CV_8U, CV_16U }, { 1, 3 }, Fill::Noise, false), [](auto & src, auto & dst) {
+		ofxCv::copy(src, dst, CV_32F);
+	});
+	runner.addImage("copy to 8U", makeOptions({ CV_16U, CV_32F }, { 1, 3 }, Fill::Noise, false), [](auto & src, auto & dst) {
+		ofxCv::copy(src, dst, CV_8U);
+	});
+
+	runner.addImage("toCv", any, [](auto & src, auto & dst) {
+		Mat mat = ofxCv::toCv(src);
+	});
+
+	// the result wraps the Mat's data, so a pixels type is needed for each depth
+	runner.addImage("toOf", makeOptions({ CV_8U }, { 1, 3 }), [](auto & src, auto & dst) {
+		ofPixels pixels;
+		ofxCv::toOf(ofxCv::toCv(src), pixels);
+	});
+	runner.addImage("toOf", makeOptions({ CV_16U }, { 1, 3 }), [](auto & src, auto & dst) {
+		ofShortPixels pixels;
+		ofxCv::toOf(ofxCv::toCv(src), pixels);
+	});
+	runner.addImage("toOf", makeOptions({ CV_32F }, { 1, 3 }), [](auto & src, auto & dst) {
+		ofFloatPixels pixels;
+		ofxCv::toOf(ofxCv::toCv(src), pixels);
+	});
+
+	ofPolyline polyline;
+	for (int i = 0; i < 1000; i++) {
+		polyline.addVertex(ofRandom(1000), ofRandom(1000));
+	}
+	runner.addItems("toCv(ofPolyline)", polyline.size(), [polyline]() {
+		auto points = ofxCv::toCv(polyline);
+	});
+
+	vector<cv::Point2f> contour;
+	for (int i = 0; i < 1000; i++) {
+		contour.emplace_back(ofRandom(1000), ofRandom(1000));
+	}
+	runner.addItems("toOfPolyline", contour.size(), [contour]() {
+		auto result = ofxCv::toOfPolyline(contour);
+	});
+}
+
+//----------
+static void addWrappers(BenchmarkRunner & runner) {
+	const auto any = makeOptions(allDepths, { 1, 3 });
+	const auto blobs = makeOptions({ CV_8U }, { 1 }, Fill::Mask);
+
+	// the source is used for both inputs
+	runner.addImage("max", any, [](auto & src, auto & dst) { ofxCv::max(src, src, dst); });
+	runner.addImage("min", any, [](auto & src, auto & dst) { ofxCv::min(src, src, dst); });
+	runner.addImage("multiply", any, [](auto & src, auto & dst) { ofxCv::multiply(src, src, dst); });
+	runner.addImage("divide", any, [](auto & src, auto & dst) { ofxCv::divide(src, src, dst); });
+	runner.addImage("add", any, [](auto & src, auto & dst) { ofxCv::add(src, src, dst); });
+	runner.addImage("subtract", any, [](auto & src, auto & dst) { ofxCv::subtract(src, src, dst); });
+	runner.addImage("absdiff", any, [](auto & src, auto & dst) { ofxCv::absdiff(src, src, dst); });
+	runner.addImage("bitwise_and", any, [](auto & src, auto & dst) { ofxCv::bitwise_and(src, src, dst); });
+	runner.addImage("bitwise_or", any, [](auto & src, auto & dst) { ofxCv::bitwise_or(src, src, dst); });
+	runner.addImage("bitwise_xor", any, [](auto & src, auto & dst) { ofxCv::bitwise_xor(src, src, dst); });
+
+	runner.addImage("invert", any, [](auto & src, auto & dst) {
+		ofxCv::invert(src, dst);
+	});
+	runner.addImage("lerp", any, [](auto & src, auto & dst) {
+		ofxCv::lerp(src, src, dst, 0.25f);
+	});
+	runner.addImage("normalize", any, [](auto & src, auto & dst) {
+		ofxCv::normalize(src, dst);
+	});
+	runner.addImage("threshold", any, [](auto & src, auto & dst) {
+		ofxCv::threshold(src, dst, ofxCv::getMaxVal(ofxCv::getDepth(src)) / 2);
+	});
+	runner.addImage("erode", any, [](auto & src, auto & dst) {
+		ofxCv::erode(src, dst);
+	});
+	runner.addImage("dilate", any, [](auto & src, auto & dst) {
+		ofxCv::dilate(src, dst);
+	});
+	runner.addImage("autothreshold", makeOptions({ CV_8U }, { 1 }, Fill::Smooth), [](auto & src, auto & dst) {
+		ofxCv::autothreshold(src, dst);
+	});
+	runner.addImage("convertColor", makeOptions(allDepths, { 3 }), [](auto & src, auto & dst) {
+		ofxCv::convertColor(src, dst, COLOR_RGB2GRAY);
+	});
+	runner.addImage("copyGray", any, [](auto & src, auto & dst) {
+		ofxCv::copyGray(src, dst);
+	});
+	runner.addImage("blur", any, [](auto & src, auto & dst) {
+		ofxCv::blur(src, dst, 5);
+	});
+	runner.addImage("medianBlur", any, [](auto & src, auto & dst) {
+		ofxCv::medianBlur(src, dst, 5);
+	});
+	runner.addImage("equalizeHist", makeOptions({ CV_8U }, { 1, 3 }, Fill::Smooth), [](auto & src, auto & dst) {
+		ofxCv::equalizeHist(src, dst);
+	});
+	runner.addImage("Canny", makeOptions({ CV_8U }, { 1 }, Fill::Smooth), [](auto & src, auto & dst) {
+		ofxCv::Canny(src, dst, 50, 150);
+	});
+	runner.addImage("warpPerspective", any, [](auto & src, auto & dst) {
+		auto points = getInsetCorners(src);
+		ofxCv::warpPerspective(src, dst, points);
+	});
+	runner.addImage("unwarpPerspective", any, [](auto & src, auto & dst) {
+		auto points = getInsetCorners(src);
+		ofxCv::unwarpPerspective(src, dst, points);
+	});
+	runner.addImage("warpPerspective(transform)", any, [](auto & src, auto & dst) {
+		Mat transform = (Mat_<double>(3, 3) << 0.9, 0.05, 10, -0.05, 0.9, 20, 0.0001, 0.0001, 1);
+		ofxCv::warpPerspective(src, dst, transform);
+	});
+	runner.addImage("resize", any, [](auto & src, auto & dst) {
+		ofxCv::resize(src, dst, 0.5f, 0.5f);
+	});
+	runner.addImage("fillPoly", makeOptions(allDepths, { 1 }), [](auto & src, auto & dst) {
+		const int w = ofxCv::getWidth(src), h = ofxCv::getHeight(src);
+		vector<cv::Point> points;
+		for (int i = 0; i < 32; i++) {
+			const float angle = TWO_PI * i / 32;
+			const float radius = (i % 2 ? 0.45f : 0.25f) * std::min(w, h);
+			points.emplace_back(w / 2 + radius * cos(angle), h / 2 + radius * sin(angle));
+		}
+		ofxCv::fillPoly(points, dst);
+	});
+	runner.addImage("flip", any, [](auto & src, auto & dst) {
+		ofxCv::flip(src, dst, 1);
+	});
+	runner.addImage("rotate", any, [](auto & src, auto & dst) {
+		ofxCv::rotate(src, dst, 10);
+	});
+	runner.addImage("rotate90", any, [](auto & src, auto & dst) {
+		ofxCv::rotate90(src, dst, 180);
+	});
+
+	runner.addImage("findChessboardCornersPreTest", makeOptions({ CV_8U }, { 1 }, Fill::Checkerboard), [](auto & src, auto & dst) {
+		vector<Point2f> corners;
+		ofxCv::findChessboardCornersPreTest(ofxCv::toCv(src), cv::Size(9, 6), corners);
+	});
+	runner.addImage("findBoard", makeOptions({ CV_8U }, { 1 }, Fill::Checkerboard), [](auto & src, auto & dst) {
+		vector<Point2f> corners;
+		ofxCv::findBoard(ofxCv::toCv(src), ofxCv::Checkerboard, cv::Size(9, 6), corners, true);
+	});
+	runner.addImage("findAsymmetricCircles", blobs, [](auto & src, auto & dst) {
+		vector<Point2f> centers;
+		ofxCv::findAsymmetricCircles(ofxCv::toCv(src), cv::Size(4, 11), centers);
+	});
+	runner.addImage("refineCheckerboardCorners", makeOptions({ CV_8U }, { 1 }, Fill::Checkerboard), [](auto & src, auto & dst) {
+		// where the corners were drawn, a pixel out
+		const int w = ofxCv::getWidth(src), h = ofxCv::getHeight(src);
+		const int square = std::min(w / 12, h / 9);
+		const int originX = (w - square * 10) / 2, originY = (h - square * 7) / 2;
+		vector<Point2f> corners;
+		for (int y = 1; y < 7; y++) {
+			for (int x = 1; x < 10; x++) {
+				corners.emplace_back(originX + x * square + 1, originY + y * square + 1);
+			}
+		}
+		ofxCv::refineCheckerboardCorners(ofxCv::toCv(src), cv::Size(9, 6), corners);
+	});
+
+	ofPolyline polyline;
+	for (int i = 0; i < 1000; i++) {
+		polyline.addVertex(ofRandom(1000), ofRandom(1000));
+	}
+	runner.addItems("convexHull", polyline.size(), [polyline]() {
+		ofxCv::convexHull(polyline);
+	});
+	runner.addItems("minAreaRect", polyline.size(), [polyline]() {
+		ofxCv::minAreaRect(polyline);
+	});
+	runner.addItems("fitEllipse", polyline.size(), [polyline]() {
+		ofxCv::fitEllipse(polyline);
+	});
+	runner.addItems("fitLine", polyline.size(), [polyline]() {
+		ofVec2f point, direction;
+		ofxCv::fitLine(polyline, point, direction);
+	});
+
+	vector<ofVec3f> from, to;
+	for (int i = 0; i < 100; i++) {
+		from.emplace_back(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1));
+		to.push_back(from.back() * 2 + ofVec3f(0.5, 0.1, 0) + ofVec3f(ofRandom(-0.01, 0.01), ofRandom(-0.01, 0.01), ofRandom(-0.01, 0.01)));
+	}
+	runner.addItems("estimateAffine3D", from.size(), [from, to]() {
+		ofxCv::estimateAffine3D(from, to);
+	});
+
+	Mat cameraMatrix = (Mat_<double>(3, 3) << 1000, 0, 960, 0, 1000, 540, 0, 0, 1);
+	Mat distortion = (Mat_<double>(1, 5) << 0.1, -0.05, 0, 0, 0);
+	runner.addItems("convertColor(ofColor)", 1, []() {
+		ofxCv::convertColor(ofColor(200, 100, 50), COLOR_RGB2HSV);
+	});
+	runner.addItems("undistortPoint", 1, [cameraMatrix, distortion]() {
+		ofxCv::undistortPoint({ 100, 200 }, cameraMatrix, distortion);
+	});
+
+	// a projector looking at points on two planes, so the calibration is well constrained
+	vector<glm::vec3> world;
+	vector<glm::vec2> projected;
+	vector<Point3f> worldPoints;
+	vector<Point2f> imagePoints;
+	{
+		for (int y = 0; y < 8; y++) {
+			for (int x = 0; x < 8; x++) {
+				world.emplace_back(x * 0.1f - 0.35f, y * 0.1f - 0.35f, 0.0f);
+				world.emplace_back(x * 0.1f - 0.35f, 0.4f, y * 0.1f);
+			}
+		}
+		Mat rotation = (Mat_<double>(3, 1) << 0.1, 0.2, 0.0);
+		Mat translation = (Mat_<double>(3, 1) << 0.0, 0.0, 2.0);
+		for (const auto & point : world) {
+			worldPoints.emplace_back(point.x, point.y, point.z);
+		}
+		projectPoints(worldPoints, rotation, translation, cameraMatrix, Mat(), imagePoints);
+		for (const auto & point : imagePoints) {
+			projected.emplace_back(point.x, point.y);
+		}
+	}
+	runner.addItems("calibrateProjector", world.size(), [world, projected]() {
+		Mat cameraMatrix, rotation, translation;
+		ofxCv::calibrateProjector(cameraMatrix, rotation, translation, world, projected, 1920, 1080, false, 0.0f);
+	});
+	runner.addItems("calibrateCameraWorldRemoveOutliers", worldPoints.size(), [worldPoints, imagePoints, cameraMatrix]() {
+		Mat cameraMatrixGuess = cameraMatrix.clone(), distortion, rotation, translation;
+		ofxCv::calibrateCameraWorldRemoveOutliers(worldPoints, imagePoints, cv::Size(1920, 1080), cameraMatrixGuess, distortion, rotation, translation, CALIB_USE_INTRINSIC_GUESS);
+	});
+}
+
+//----------
+static bool isNear(const glm::mat4 & a, const glm::mat4 & b, float tolerance) {
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 4; j++) {
+			if (std::abs(a[i][j] - b[i][j]) > tolerance) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//----------
+static bool isNear(const Mat & a, const Matx31d & b, double tolerance) {
+	Matx31d converted;
+	a.reshape(1, 3).convertTo(converted, CV_64F);
+	return cv::norm(converted, b, NORM_INF) <= tolerance;
+}
+
+//----------
+// the Matx and batch makeMatrix/decomposeMatrix against the Mat versions they replace
+static void addMatrixChecks(BenchmarkRunner & runner, const vector<Vec3d> & rotationVectors, const vector<Vec3d> & translations) {
+	runner.addCheck("makeMatrix(Matx) == makeMatrix(Mat)", [rotationVectors, translations]() {
+		for (size_t i = 0; i < rotationVectors.size(); i++) {
+			const auto expected = ofxCv::makeMatrix(Mat(rotationVectors[i]), Mat(translations[i]));
+			if (!isNear(ofxCv::makeMatrix(Matx31d(rotationVectors[i]), Matx31d(translations[i])), expected, 1e-6f)
+				|| !isNear(ofxCv::makeMatrix(Matx31f(Vec3f(rotationVectors[i])), Matx31f(Vec3f(translations[i]))), expected, 1e-5f)) {
+				return false;
+			}
+		}
+		return true;
+	});
+	runner.addCheck("decomposeMatrix(Matx) == decomposeMatrix(Mat)", [rotationVectors, translations]() {
+		for (size_t i = 0; i < rotationVectors.size(); i++) {
+			const auto transform = ofxCv::makeMatrix(Mat(rotationVectors[i]), Mat(translations[i]));
+			Mat rotation, translation;
+			ofxCv::decomposeMatrix(transform, rotation, translation);
+			Matx31d rotationx, translationx;
+			ofxCv::decomposeMatrix(transform, rotationx, translationx);
+
+			// and both should give back what went in, to float precision
+			if (!isNear(rotation, rotationx, 1e-5) || !isNear(translation, translationx, 1e-6)
+				|| cv::norm(rotationx, Matx31d(rotationVectors[i]), NORM_INF) > 1e-4) {
+				return false;
+			}
+		}
+		return true;
+	});
+	runner.addCheck("makeMatrices/decomposeMatrices == single", [rotationVectors, translations]() {
+		vector<glm::mat4> transforms;
+		ofxCv::makeMatrices(rotationVectors, translations, transforms);
+		vector<Vec3d> rotationVectorsOut, translationsOut;
+		ofxCv::decomposeMatrices(transforms, rotationVectorsOut, translationsOut);
+		if (transforms.size() != rotationVectors.size() || rotationVectorsOut.size() != transforms.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < transforms.size(); i++) {
+			Matx31d rotation, translation;
+			ofxCv::decomposeMatrix(transforms[i], rotation, translation);
+			if (!isNear(transforms[i], ofxCv::makeMatrix(Matx31d(rotationVectors[i]), Matx31d(translations[i])), 0.0f)
+				|| Matx31d(rotationVectorsOut[i]) != rotation || Matx31d(translationsOut[i]) != translation) {
+				return false;
+			}
+		}
+		return true;
+	});
+}
+
+//----------
+static void addHelpers(BenchmarkRunner & runner) {
+	const auto gray = makeOptions(allDepths, { 1 });
+	const auto any = makeOptions(allDepths, { 1, 3 });
+	const auto mask = makeOptions({ CV_8U }, { 1 }, Fill::Mask);
+
+	// transforms
+	const size_t count = 1000;
+	vector<Vec3d> rotationVectors, translations;
+	for (size_t i = 0; i < count; i++) {
+		rotationVectors.emplace_back(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1));
+		translations.emplace_back(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1));
+	}
+	vector<glm::mat4> transforms;
+	ofxCv::makeMatrices(rotationVectors, translations, transforms);
+	addMatrixChecks(runner, rotationVectors, translations);
+
+	runner.addItems("makeMatrix(Mat)", count, [rotationVectors, translations]() {
+		for (size_t i = 0; i < rotationVectors.size(); i++) {
+			ofxCv::makeMatrix(Mat(rotationVectors[i]), Mat(translations[i]));
+		}
+	});
+	runner.addItems("makeMatrix(Matx)", count, [rotationVectors, translations]() {
+		for (size_t i = 0; i < rotationVectors.size(); i++) {
+			ofxCv::makeMatrix(Matx31d(rotationVectors[i]), Matx31d(translations[i]));
+		}
+	});
+	runner.addItems("decomposeMatrix(Mat)", count, [transforms]() {
+		Mat rotation, translation;
+		for (const auto & transform : transforms) {
+			ofxCv::decomposeMatrix(transform, rotation, translation);
+		}
+	});
+	runner.addItems("decomposeMatrix(Matx)", count, [transforms]() {
+		Matx31d rotation, translation;
+		for (const auto & transform : transforms) {
+			ofxCv::decomposeMatrix(transform, rotation, translation);
+		}
+	});
+	runner.addItems("rotationVectorToMatrix", count, [rotationVectors]() {
+		for (const auto & rotationVector : rotationVectors) {
+			ofxCv::rotationVectorToMatrix(Matx31d(rotationVector));
+		}
+	});
+	runner.addItems("rotationMatrixToVector", count, [rotationVectors]() {
+		for (const auto & rotationVector : rotationVectors) {
+			ofxCv::rotationMatrixToVector(ofxCv::rotationVectorToMatrix(Matx31d(rotationVector)));
+		}
+	});
+	runner.addItems("makeMatrices", count, [rotationVectors, translations]() {
+		vector<glm::mat4> transforms;
+		ofxCv::makeMatrices(rotationVectors, translations, transforms);
+	});
+	runner.addItems("decomposeMatrices", count, [transforms]() {
+		vector<Vec3d> rotationVectors, translations;
+		ofxCv::decomposeMatrices(transforms, rotationVectors, translations);
+	});
+
+	Mat cameraMatrix = (Mat_<double>(3, 3) << 1000, 0, 960, 0, 1000, 540, 0, 0, 1);
+	Mat distortion = (Mat_<double>(1, 5) << 0.1, -0.05, 0, 0, 0);
+	runner.addItems("makeProjectionMatrix", 1, [cameraMatrix]() {
+		ofxCv::makeProjectionMatrix(cameraMatrix, cv::Size(1920, 1080));
+	});
+
+	// boards
+	const cv::Size boardSize(64, 64);
+	const size_t boardCount = boardSize.area();
+	runner.addItems("makeCheckerboardPoints", boardCount, [boardSize]() {
+		ofxCv::makeCheckerboardPoints(boardSize, 0.01f);
+	});
+	runner.addItems("makeCheckerboardMesh", boardCount, [boardSize]() {
+		ofxCv::makeCheckerboardMesh(boardSize, 0.01f);
+	});
+	runner.addItems("makeAsymmetricCirclePoints", boardCount, [boardSize]() {
+		ofxCv::makeAsymmetricCirclePoints(boardSize, 0.01f);
+	});
+	runner.addItems("makeAsymmetricCircleMesh", boardCount, [boardSize]() {
+		ofxCv::makeAsymmetricCircleMesh(boardSize, 0.01f);
+	});
+	runner.addItems("makeBoardPoints", boardCount, [boardSize]() {
+		ofxCv::makeBoardPoints(ofxCv::Checkerboard, boardSize, 0.01f);
+	});
+	runner.addItems("makeBoardMesh", boardCount, [boardSize]() {
+		ofxCv::makeBoardMesh(ofxCv::Checkerboard, boardSize, 0.01f);
+	});
+	runner.addItems("getBoardMesh", boardCount, [boardSize]() {
+		ofxCv::getBoardMesh(ofxCv::Checkerboard, boardSize, 0.01f);
+	});
+
+	// points
+	vector<Point2f> imagePoints;
+	vector<Point3f> worldPoints = ofxCv::makeCheckerboardPoints(boardSize, 0.01f);
+	Mat rotation = (Mat_<double>(3, 1) << 0.1, 0.2, 0.0);
+	Mat translation = (Mat_<double>(3, 1) << 0.0, 0.0, 1.0);
+	projectPoints(worldPoints, rotation, translation, cameraMatrix, distortion, imagePoints);
+	runner.addItems("undistortImagePoints", imagePoints.size(), [imagePoints, cameraMatrix, distortion]() {
+		ofxCv::undistortImagePoints(imagePoints, cameraMatrix, distortion);
+	});
+	runner.addItems("reprojectionError", imagePoints.size(), [imagePoints, worldPoints, rotation, translation, cameraMatrix, distortion]() {
+		ofxCv::reprojectionError(imagePoints, worldPoints, rotation, translation, cameraMatrix, distortion);
+	});
+
+	// the warm-up call acquires the board, so the timed calls (and allocation counts) are the tracked path
+	{
+		const cv::Size trackedSize(9, 6);
+		auto tracker = std::make_shared<ofxCv::PoseTracker>();
+		tracker->setup(cameraMatrix, distortion, ofxCv::Checkerboard, trackedSize, 0.025f);
+		vector<Point2f> trackedPoints;
+		projectPoints(ofxCv::makeBoardPoints(ofxCv::Checkerboard, trackedSize, 0.025f), rotation, translation, cameraMatrix, distortion, trackedPoints);
+		runner.addItems("PoseTracker::update", trackedPoints.size(), [tracker, trackedPoints]() {
+			tracker->update(trackedPoints);
+		});
+	}
+
+	// images
+	runner.addImage("findMaxLocation", gray, [](auto & src, auto & dst) {
+		ofxCv::findMaxLocation(src);
+	});
+	runner.addImage("findPeaks", makeOptions(allDepths, { 1 }, Fill::Smooth), [](auto & src, auto & dst) {
+		ofxCv::findPeaks(src, ofxCv::getMaxVal(ofxCv::getDepth(src)) * 0.8f);
+	});
+	runner.addImage("getProfiles", any, [](auto & src, auto & dst) {
+		ofxCv::getProfiles(src);
+	});
+	runner.addImage("meanCols", gray, [](auto & src, auto & dst) { ofxCv::meanCols(src); });
+	runner.addImage("meanRows", gray, [](auto & src, auto & dst) { ofxCv::meanRows(src); });
+	runner.addImage("sumCols", gray, [](auto & src, auto & dst) { ofxCv::sumCols(src); });
+	runner.addImage("sumRows", gray, [](auto & src, auto & dst) { ofxCv::sumRows(src); });
+	runner.addImage("minCols", gray, [](auto & src, auto & dst) { ofxCv::minCols(src); });
+	runner.addImage("minRows", gray, [](auto & src, auto & dst) { ofxCv::minRows(src); });
+	runner.addImage("maxCols", gray, [](auto & src, auto & dst) { ofxCv::maxCols(src); });
+	runner.addImage("maxRows", gray, [](auto & src, auto & dst) { ofxCv::maxRows(src); });
+
+	// scanning the whole image, since nothing matches
+	runner.addImage("findFirst", gray, [](auto & src, auto & dst) {
+		ofxCv::findFirst(ofxCv::toCv(src), ofxCv::SCAN_GREATER, ofxCv::getMaxVal(ofxCv::getDepth(src)));
+	});
+	runner.addImage("findLast", gray, [](auto & src, auto & dst) {
+		ofxCv::findLast(ofxCv::toCv(src), ofxCv::SCAN_GREATER, ofxCv::getMaxVal(ofxCv::getDepth(src)));
+	});
+	runner.addImage("findFirst(target)", mask, [](auto & src, auto & dst) {
+		ofxCv::findFirst(ofxCv::toCv(src), (unsigned char) 1);
+	});
+	runner.addImage("getNonZeroExtents", mask, [](auto & src, auto & dst) {
+		cv::Rect extents;
+		ofxCv::getNonZeroExtents(ofxCv::toCv(src), extents);
+	});
+	runner.addImage("getRowExtents", mask, [](auto & src, auto & dst) {
+		vector<Vec2i> extents;
+		ofxCv::getRowExtents(ofxCv::toCv(src), extents);
+	});
+	runner.addImage("getBoundingBox", mask, [](auto & src, auto & dst) {
+		ofRectangle box;
+		ofxCv::getBoundingBox(src, box);
+	});
+	runner.addImage("getBoundingBox(threshold)", mask, [](auto & src, auto & dst) {
+		ofRectangle box;
+		ofxCv::getBoundingBox(src, box, 128, false);
+	});
+	runner.addImage("thin", mask, [](auto & src, auto & dst) {
+		// thins in place, so work on a copy of the mask each time
+		ofxCv::copy(src, dst);
+		ofxCv::thin(dst);
+	});
+	// autorotate's call to rotate() only resolves for Mats
+	runner.addImage("autorotate", makeOptions({ CV_8U }, { 1 }, Fill::Checkerboard, false), [](auto & src, auto & dst) {
+		if constexpr (std::is_same<std::decay_t<decltype(src)>, Mat>::value) {
+			Mat thresh;
+			ofxCv::Canny(src, thresh, 50, 200);
+			ofxCv::autorotate(src, thresh, dst);
+		}
+	});
+
+	// geometry
+	runner.addItems("intersectLineLine", count, []() {
+		for (size_t i = 0; i < 1000; i++) {
+			ofxCv::intersectLineLine(Point3f(0, 0, 0), Point3f(1, (float) i, 0), Point3f(0, 1, 1), Point3f(1, 0, (float) i));
+		}
+	});
+	runner.addItems("intersectPointLine", count, []() {
+		for (size_t i = 0; i < 1000; i++) {
+			ofxCv::intersectPointLine(Point3f((float) i, 1, 0), Point3f(0, 0, 0), Point3f(1, 1, 1));
+		}
+	});
+	runner.addItems("intersectPointRay", count, []() {
+		for (size_t i = 0; i < 1000; i++) {
+			ofxCv::intersectPointRay(Point3f((float) i, 1, 0), Point3f(1, 1, 1));
+		}
+	});
+
+	vector<Vec4i> lines;
+	for (size_t i = 0; i < count; i++) {
+		lines.emplace_back((int) ofRandom(1000), (int) ofRandom(1000), (int) ofRandom(1000), (int) ofRandom(1000));
+	}
+	runner.addItems("weightedAverageAngle", lines.size(), [lines]() {
+		ofxCv::weightedAverageAngle(lines);
+	});
+
+	vector<vector<Point2f>> hulls;
+	for (int i = 0; i < 100; i++) {
+		vector<Point2f> points, hull;
+		for (int j = 0; j < 100; j++) {
+			points.emplace_back(ofRandom(1000), ofRandom(1000));
+		}
+		convexHull(points, hull);
+		hulls.push_back(hull);
+	}
+	runner.addItems("getConvexPolygon", 1, [hulls]() {
+		ofxCv::getConvexPolygon(hulls.front(), 4);
+	});
+	runner.addItems("getConvexPolygons", hulls.size(), [hulls]() {
+		ofxCv::getConvexPolygons(hulls, 4);
+	});
+}
+
+//----------
+void addBenchmarks(BenchmarkRunner & runner) {
+	// the same inputs every run
+	ofSeedRandom(0);
+
+	addUtilities(runner);
+	addWrappers(runner);
+	addHelpers(runner);
+}
@@ -0,0 +1,85 @@
+#include "ofMain.h"
+#include "BenchmarkRunner.h"
+
+//========================================================================
+// Benchmark [--out results.json] [--baseline baseline.json] [--threshold 0.1]
+//	[--sizes VGA,HD,FHD,4K,8K] [--depths 8U,16U,32F] [--filter name] [--min-time seconds]
+//
+// returns 1 if a check failed or anything regressed against the baseline, so it can run in CI
+int main(int argc, char * argv[]) {
+	BenchmarkRunner::Settings settings;
+	string outputPath = "benchmark.json";
+	string baselinePath;
+
+	for (int i = 1; i < argc; i++) {
+		const string argument = argv[i];
+		if (i + 1 >= argc) {
+			ofLogError("Benchmark") << "Missing a value for " << argument;
+			return 2;
+		}
+		const string value = argv[++i];
+
+		if (argument == "--out") {
+			outputPath = value;
+		}
+		else if (argument == "--baseline") {
+			baselinePath = value;
+		}
+		else if (argument == "--threshold") {
+			settings.regressionThreshold = ofToDouble(value);
+		}
+		else if (argument == "--filter") {
+			settings.filter = value;
+		}
+		else if (argument == "--min-time") {
+			settings.minTime = ofToDouble(value);
+		}
+		else if (argument == "--sizes") {
+			const auto names = ofSplitString(value, ",", true, true);
+			settings.sizes.clear();
+			for (const auto & size : BenchmarkRunner::getDefaultSizes()) {
+				if (find(names.begin(), names.end(), size.name) != names.end()) {
+					settings.sizes.push_back(size);
+				}
+			}
+		}
+		else if (argument == "--depths") {
+			settings.depths.clear();
+			for (const auto & name : ofSplitString(value, ",", true, true)) {
+				const int depth = BenchmarkRunner::getDepthFromName(name);
+				if (depth < 0) {
+					ofLogError("Benchmark") << "Unknown depth " << name;
+					return 2;
+				}
+				settings.depths.push_back(depth);
+			}
+		}
+		else {
+			ofLogError("Benchmark") << "Unknown argument " << argument;
+			return 2;
+		}
+	}
+
+	BenchmarkRunner runner;
+	addBenchmarks(runner);
+	const auto failedChecks = runner.runChecks(settings);
+	const auto results = runner.run(settings);
+	if (!BenchmarkRunner::save(outputPath, results)) {
+		return 2;
+	}
+	if (failedChecks > 0) {
+		ofLogError("Benchmark") << failedChecks << " checks failed";
+		return 1;
+	}
+
+	if (!baselinePath.empty()) {
+		vector<BenchmarkResult> baseline;
+		if (!BenchmarkRunner::load(baselinePath, baseline)) {
+			return 2;
+		}
+		if (BenchmarkRunner::compare(results, baseline, settings.regressionThreshold) > 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -8,19 +8,28 @@ using namespace cv;
 //--------------------------------------------------------------
 void ofApp::setup(){
 	camera.initGrabber(640, 480);
+
+	// processing runs on its own thread, overlapping with capture and drawing
+	this->pipeline.addStage("erode", [](const Mat & input, Mat & output) {
+		cv::erode(input, output, Mat(), cv::Point(-1, -1), 3);
+		return true;
+	});
+	this->pipeline.start();
 }
 
 //--------------------------------------------------------------
 void ofApp::update(){
 	camera.update();
-	
-	Mat matImage = toCv(camera.getPixelsRef()).clone();
-	cv::erode(matImage, matImage, Mat());
-	cv::erode(matImage, matImage, Mat());
-	cv::erode(matImage, matImage, Mat());
-	ofxCv::imitate(this->preview, matImage);
-	ofxCv::copy(matImage, this->preview, 3);
-	this->preview.update();
+	if (camera.isFrameNew()) {
+		this->pipeline.send(toCv(camera.getPixelsRef()));
+	}
+
+	Mat matImage;
+	if (this->pipeline.receive(matImage)) {
+		ofxCv::imitate(this->preview, matImage);
+		ofxCv::copy(matImage, this->preview, 3);
+		this->preview.update();
+	}
 
 	auto dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_6X6_250);
 }
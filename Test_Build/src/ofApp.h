@@ -22,4 +22,5 @@ class ofApp : public ofBaseApp{
 	
 	ofVideoGrabber camera;
 	ofImage preview;
+	ofxCv::Pipeline pipeline;
 };
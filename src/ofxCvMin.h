@@ -13,3 +13,22 @@
 #include "ofxCvMin/Helpers.h"
 #include "ofxCvMin/Modals.h"
 #include "ofxCvMin/CheckerboardUserAssist.h"
+
+// subsystems
+#include "ofxCvMin/Core/BundleAdjustment.h"
+#include "ofxCvMin/PoseTracker.h"
+#include "ofxCvMin/CrossValidation.h"
+#include "ofxCvMin/Registration.h"
+#include "ofxCvMin/StructuredLight.h"
+#include "ofxCvMin/Core/Skeleton.h"
+#include "ofxCvMin/Deskew.h"
+#include "ofxCvMin/Triangulation.h"
+#include "ofxCvMin/Core/LaserLine.h"
+#include "ofxCvMin/Core/MatFile.h"
+#include "ofxCvMin/AsyncImageWriter.h"
+#include "ofxCvMin/FrameRecording.h"
+#include "ofxCvMin/CalibrationArchive.h"
+#include "ofxCvMin/Pipeline.h"
+#include "ofxCvMin/Core/Instrumentation.h"
+#include "ofxCvMin/Core/FrameAllocator.h"
+#include "ofxCvMin/Core/ThreadingConfig.h"
@@ -0,0 +1,184 @@
+#include "AsyncImageWriter.h"
+#include "Wrappers.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	//----------
+	AsyncImageWriter::AsyncImageWriter() {
+		this->setup(Settings());
+	}
+
+	//----------
+	AsyncImageWriter::~AsyncImageWriter() {
+		this->close();
+	}
+
+	//----------
+	void AsyncImageWriter::setup(const Settings & settings) {
+		this->close();
+
+		this->settings = settings;
+		this->settings.threadCount = std::max(this->settings.threadCount, 1);
+		this->settings.queueSize = std::max(this->settings.queueSize, (size_t) 1);
+
+		this->closing = false;
+		for (int i = 0; i < this->settings.threadCount; i++) {
+			this->threads.emplace_back([this]() {
+				this->threadedFunction();
+			});
+		}
+	}
+
+	//----------
+	const AsyncImageWriter::Settings & AsyncImageWriter::getSettings() const {
+		return this->settings;
+	}
+
+	//----------
+	bool AsyncImageWriter::submit(const Mat & image, const string & filename, bool copy) {
+		if (image.empty()) {
+			ofLogWarning("ofxCv::AsyncImageWriter") << "Ignoring empty image for " << filename;
+			return false;
+		}
+		const auto depth = image.depth();
+		if (depth != CV_8U && depth != CV_16U && depth != CV_32F) {
+			ofLogError("ofxCv::AsyncImageWriter") << "saveImage only supports CV_8U, CV_16U and CV_32F images (" << filename << ")";
+			return false;
+		}
+
+		// copy outside the lock so other threads aren't held up
+		Job job{ copy ? image.clone() : image, filename };
+
+		std::unique_lock<std::mutex> lock(this->lock);
+		if (this->threads.empty()) {
+			ofLogError("ofxCv::AsyncImageWriter") << "Not running, call setup() first";
+			return false;
+		}
+		this->counters.submitted++;
+
+		if (this->queue.size() >= this->settings.queueSize) {
+			switch (this->settings.overflowPolicy) {
+			case OverflowPolicy::Block:
+				this->spaceAvailable.wait(lock, [this]() {
+					return this->queue.size() < this->settings.queueSize;
+				});
+				break;
+			case OverflowPolicy::DropOldest:
+				this->queue.pop_front();
+				this->counters.dropped++;
+				break;
+			case OverflowPolicy::DropNewest:
+			default:
+				this->counters.dropped++;
+				return false;
+			}
+		}
+
+		this->queue.push_back(std::move(job));
+		this->counters.queueDepth = this->queue.size();
+		this->counters.maxQueueDepth = std::max(this->counters.maxQueueDepth, this->queue.size());
+		lock.unlock();
+
+		this->jobAvailable.notify_one();
+		return true;
+	}
+
+	//----------
+	void AsyncImageWriter::flush() {
+		std::unique_lock<std::mutex> lock(this->lock);
+		this->idle.wait(lock, [this]() {
+			return this->queue.empty() && this->activeJobs == 0;
+		});
+	}
+
+	//----------
+	void AsyncImageWriter::close() {
+		if (this->threads.empty()) {
+			return;
+		}
+		this->flush();
+		{
+			std::lock_guard<std::mutex> lock(this->lock);
+			this->closing = true;
+		}
+		this->jobAvailable.notify_all();
+		for (auto & thread : this->threads) {
+			thread.join();
+		}
+		this->threads.clear();
+	}
+
+	//----------
+	size_t AsyncImageWriter::getQueueDepth() const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->queue.size();
+	}
+
+	//----------
+	AsyncImageWriter::Counters AsyncImageWriter::getCounters() const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->counters;
+	}
+
+	//----------
+	void AsyncImageWriter::resetCounters() {
+		std::lock_guard<std::mutex> lock(this->lock);
+		this->counters = Counters();
+		this->counters.queueDepth = this->queue.size();
+	}
+
+	//----------
+	void AsyncImageWriter::threadedFunction() {
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(this->lock);
+				this->jobAvailable.wait(lock, [this]() {
+					return this->closing || !this->queue.empty();
+				});
+				if (this->queue.empty()) {
+					// closing, and there's nothing left to do
+					return;
+				}
+				job = std::move(this->queue.front());
+				this->queue.pop_front();
+				this->counters.queueDepth = this->queue.size();
+				this->activeJobs++;
+			}
+			this->spaceAvailable.notify_one();
+
+			const auto startTime = ofGetElapsedTimeMicros();
+			bool success = false;
+			try {
+				success = saveImage(job.image, job.filename);
+				if (!success) {
+					ofLogError("ofxCv::AsyncImageWriter") << "Couldn't save " << job.filename;
+				}
+			}
+			catch (const std::exception & e) {
+				ofLogError("ofxCv::AsyncImageWriter") << "Couldn't save " << job.filename << " : " << e.what();
+				success = false;
+			}
+			const auto encodeTime = (double) (ofGetElapsedTimeMicros() - startTime) / 1e6;
+
+			// release the image before saying we're done, so shared data is free to reuse after flush()
+			job.image.release();
+
+			{
+				std::lock_guard<std::mutex> lock(this->lock);
+				if (success) {
+					this->counters.written++;
+					this->counters.encodeTimeTotal += encodeTime;
+					this->counters.encodeTimeMax = std::max(this->counters.encodeTimeMax, encodeTime);
+				}
+				else {
+					this->counters.failed++;
+				}
+				this->activeJobs--;
+			}
+			this->idle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,98 @@
+/*
+ AsyncImageWriter saves images on background threads, so that dumping captures
+ or debug frames doesn't stall the thread that makes them.
+
+ images wait in a bounded queue and are encoded by saveImage (so 8, 16 and 32
+ bit depths are handled the same way) on a pool of threads. when the queue is
+ full the overflow policy decides whether submit() waits, drops the oldest
+ queued image or drops the new one.
+
+ images which are submitted without copying share their data with the caller's
+ Mat (through its reference count), so don't write into that Mat until it has
+ been saved (e.g. allocate a new one for each frame, or call flush()).
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "opencv2/opencv.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	class AsyncImageWriter {
+	public:
+		enum class OverflowPolicy {
+			Block,
+			DropOldest,
+			DropNewest
+		};
+
+		struct Settings {
+			int threadCount = 2;
+			size_t queueSize = 16;
+			OverflowPolicy overflowPolicy = OverflowPolicy::Block;
+		};
+
+		struct Counters {
+			size_t submitted = 0;
+			size_t written = 0;
+			size_t dropped = 0;
+			size_t failed = 0;
+			size_t queueDepth = 0;
+			size_t maxQueueDepth = 0;
+			double encodeTimeTotal = 0.0; // seconds, summed over all threads
+			double encodeTimeMax = 0.0;
+
+			double getEncodeTimeMean() const {
+				return this->written ? this->encodeTimeTotal / this->written : 0.0;
+			}
+		};
+
+		AsyncImageWriter();
+		~AsyncImageWriter();
+
+		// stops any running threads (after they finish what's queued) and starts new ones
+		void setup(const Settings &);
+		const Settings & getSettings() const;
+
+		// returns false if the image was dropped. copy = false shares the Mat's data
+		bool submit(const Mat & image, const string & filename, bool copy = true);
+
+		// waits until everything submitted so far has been written
+		void flush();
+
+		// flushes and stops the threads. called by the destructor
+		void close();
+
+		size_t getQueueDepth() const;
+		Counters getCounters() const;
+		void resetCounters();
+	protected:
+		struct Job {
+			Mat image;
+			string filename;
+		};
+
+		void threadedFunction();
+
+		Settings settings;
+		vector<std::thread> threads;
+
+		mutable std::mutex lock;
+		std::condition_variable jobAvailable;
+		std::condition_variable spaceAvailable;
+		std::condition_variable idle;
+		std::deque<Job> queue;
+		int activeJobs = 0;
+		bool closing = false;
+
+		Counters counters;
+	};
+}
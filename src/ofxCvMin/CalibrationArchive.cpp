@@ -0,0 +1,683 @@
+#include "CalibrationArchive.h"
+
+#include <filesystem>
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	static const char archiveMagic[8] = { 'O', 'F', 'X', 'C', 'V', 'C', 'A', 'L' };
+	static const char archiveIndexMagic[8] = { 'O', 'F', 'X', 'C', 'V', 'C', 'I', 'X' };
+	static const uint32_t archiveVersion = 1;
+	static const uint32_t chunkMagic = 0x4b4e4843; // CHNK
+	static const int archiveMaxDims = 32; // CV_MAX_DIM, which isn't reachable from opencv.hpp
+
+	struct ArchiveHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+	};
+
+	struct ChunkHeader {
+		uint32_t magic;
+		uint32_t type;
+		int32_t view;
+		uint32_t nameLength;
+		uint64_t payloadSize;
+		uint64_t checksum;
+	};
+
+	struct IndexEntry {
+		uint32_t type;
+		int32_t view;
+		uint32_t nameLength;
+		uint32_t reserved;
+		uint64_t offset;
+		uint64_t size;
+		uint64_t checksum;
+	};
+
+	// the last bytes of the index chunk, and so of the file
+	struct IndexFooter {
+		uint64_t indexOffset;
+		uint64_t entryCount;
+		uint64_t unusedBytes;
+		char magic[8];
+	};
+
+	//----------
+	// FNV-1a
+	static uint64_t chunkChecksum(const unsigned char * data, size_t size) {
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ data[i]) * 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+	//----------
+	// builds up a chunk's payload
+	class PayloadWriter {
+	public:
+		PayloadWriter(vector<unsigned char> & data) : data(data) { }
+
+		void write(const void * source, size_t size) {
+			auto bytes = (const unsigned char *) source;
+			this->data.insert(this->data.end(), bytes, bytes + size);
+		}
+
+		template<class T>
+		void write(const T & value) {
+			this->write(&value, sizeof(T));
+		}
+
+		template<class T>
+		void writeVector(const vector<T> & values) {
+			this->write((uint64_t) values.size());
+			this->write(values.data(), values.size() * sizeof(T));
+		}
+
+		void writeMat(const Mat & mat) {
+			const Mat continuous = mat.isContinuous() ? mat : mat.clone();
+			this->write((int32_t) continuous.type());
+			this->write((int32_t) continuous.dims);
+			for (int i = 0; i < continuous.dims; i++) {
+				this->write((int32_t) continuous.size[i]);
+			}
+			this->write(continuous.data, continuous.total() * continuous.elemSize());
+		}
+	protected:
+		vector<unsigned char> & data;
+	};
+
+	//----------
+	// reads a chunk's payload, and fails rather than reading past its end
+	class PayloadReader {
+	public:
+		PayloadReader(const vector<unsigned char> & data) : data(data) { }
+
+		bool read(void * destination, size_t size) {
+			if (size > this->data.size() - this->position) {
+				return false;
+			}
+			memcpy(destination, this->data.data() + this->position, size);
+			this->position += size;
+			return true;
+		}
+
+		template<class T>
+		bool read(T & value) {
+			return this->read(&value, sizeof(T));
+		}
+
+		template<class T>
+		bool readVector(vector<T> & values) {
+			uint64_t count;
+			if (!this->read(count) || count > (this->data.size() - this->position) / sizeof(T)) {
+				return false;
+			}
+			values.resize((size_t) count);
+			return this->read(values.data(), values.size() * sizeof(T));
+		}
+
+		bool readMat(Mat & mat) {
+			int32_t type, dims;
+			if (!this->read(type) || !this->read(dims) || dims < 0 || dims > archiveMaxDims
+				|| (type & ~CV_MAT_TYPE_MASK) != 0 || CV_MAT_DEPTH(type) > CV_16F) {
+				return false;
+			}
+			if (dims == 0) {
+				mat.release();
+				return true;
+			}
+			int sizes[archiveMaxDims];
+			size_t count = 1;
+			for (int i = 0; i < dims; i++) {
+				int32_t size;
+				if (!this->read(size) || size < 0 || (size > 0 && count > (this->data.size() - this->position) / size)) {
+					return false;
+				}
+				sizes[i] = size;
+				count *= size;
+			}
+			if (count * CV_ELEM_SIZE(type) != this->data.size() - this->position) {
+				return false;
+			}
+			mat.create(dims, sizes, type);
+			return this->read(mat.data, count * mat.elemSize());
+		}
+	protected:
+		const vector<unsigned char> & data;
+		size_t position = 0;
+	};
+
+	//----------
+	vector<Point3f> CalibrationArchive::Board::makePoints() const {
+		return makeBoardPoints(this->type, this->size, this->spacing, this->centered);
+	}
+
+	//----------
+	CalibrationArchive::~CalibrationArchive() {
+		this->close();
+	}
+
+	//----------
+	bool CalibrationArchive::open(const string & filename) {
+		this->close();
+
+		const auto path = ofToDataPath(filename, true);
+		this->file.open(path, ios::in | ios::out | ios::binary);
+		if (!this->file.is_open()) {
+			// new session
+			this->file.clear();
+			this->file.open(path, ios::in | ios::out | ios::binary | ios::trunc);
+			if (!this->file.is_open()) {
+				ofLogError("ofxCv::CalibrationArchive") << "Couldn't open " << filename;
+				return false;
+			}
+			ArchiveHeader header;
+			memset(&header, 0, sizeof(header));
+			memcpy(header.magic, archiveMagic, sizeof(archiveMagic));
+			header.version = archiveVersion;
+			this->file.write((const char *) &header, sizeof(header));
+			this->file.flush();
+		}
+
+		this->file.seekg(0, ios::end);
+		const uint64_t fileSize = (uint64_t) this->file.tellg();
+		ArchiveHeader header;
+		this->file.seekg(0);
+		if (fileSize < sizeof(header) || !this->file.read((char *) &header, sizeof(header)) || memcmp(header.magic, archiveMagic, sizeof(archiveMagic)) != 0) {
+			ofLogError("ofxCv::CalibrationArchive") << filename << " isn't a calibration archive";
+			this->file.close();
+			return false;
+		}
+		if (header.version != archiveVersion) {
+			ofLogError("ofxCv::CalibrationArchive") << filename << " has unsupported version " << header.version;
+			this->file.close();
+			return false;
+		}
+
+		this->filename = filename;
+		this->index.clear();
+		this->viewCount = 0;
+		this->unusedBytes = 0;
+		this->indexChunkSize = 0;
+		this->indexDirty = false;
+
+		if (!this->readIndex(fileSize)) {
+			if (fileSize > sizeof(ArchiveHeader)) {
+				ofLogWarning("ofxCv::CalibrationArchive") << filename << " has no index (wasn't closed properly?), scanning chunks";
+			}
+			this->rebuildIndex(fileSize);
+
+			// cut off any partly written chunk, so the next index ends the file
+			if (this->fileSize < fileSize) {
+				this->file.close();
+				std::error_code error;
+				std::filesystem::resize_file(path, this->fileSize, error);
+				this->file.open(path, ios::in | ios::out | ios::binary);
+				if (error || !this->file.is_open()) {
+					ofLogError("ofxCv::CalibrationArchive") << "Couldn't repair " << filename;
+					this->file.close();
+					return false;
+				}
+			}
+		}
+
+		for (const auto & entry : this->index) {
+			if (entry.first.type == CHUNK_VIEW) {
+				this->viewCount = std::max(this->viewCount, entry.first.view + 1);
+			}
+		}
+		return true;
+	}
+
+	//----------
+	bool CalibrationArchive::isOpen() const {
+		return this->file.is_open();
+	}
+
+	//----------
+	void CalibrationArchive::flush() {
+		std::lock_guard<std::mutex> lock(this->lock);
+		if (!this->isOpen() || !this->indexDirty) {
+			return;
+		}
+
+		vector<unsigned char> payload;
+		PayloadWriter writer(payload);
+		for (const auto & entry : this->index) {
+			IndexEntry indexEntry;
+			indexEntry.type = entry.first.type;
+			indexEntry.view = entry.first.view;
+			indexEntry.nameLength = (uint32_t) entry.first.name.size();
+			indexEntry.reserved = 0;
+			indexEntry.offset = entry.second.offset;
+			indexEntry.size = entry.second.size;
+			indexEntry.checksum = entry.second.checksum;
+			writer.write(indexEntry);
+			writer.write(entry.first.name.data(), entry.first.name.size());
+		}
+
+		IndexFooter footer;
+		footer.indexOffset = this->fileSize;
+		footer.entryCount = this->index.size();
+		footer.unusedBytes = this->unusedBytes;
+		memcpy(footer.magic, archiveIndexMagic, sizeof(archiveIndexMagic));
+		writer.write(footer);
+
+		ChunkHeader header;
+		header.magic = chunkMagic;
+		header.type = CHUNK_INDEX;
+		header.view = -1;
+		header.nameLength = 0;
+		header.payloadSize = payload.size();
+		header.checksum = chunkChecksum(payload.data(), payload.size());
+
+		this->file.seekp(this->fileSize);
+		this->file.write((const char *) &header, sizeof(header));
+		this->file.write((const char *) payload.data(), payload.size());
+		this->file.flush();
+		if (!this->file) {
+			ofLogError("ofxCv::CalibrationArchive") << "Couldn't write the index of " << this->filename;
+			this->file.clear();
+			return;
+		}
+
+		this->indexChunkSize = sizeof(header) + payload.size();
+		this->fileSize += this->indexChunkSize;
+		this->indexDirty = false;
+	}
+
+	//----------
+	void CalibrationArchive::close() {
+		if (!this->isOpen()) {
+			return;
+		}
+		this->flush();
+		this->file.close();
+		this->index.clear();
+		this->viewCount = 0;
+	}
+
+	//----------
+	void CalibrationArchive::setBoard(const Board & board) {
+		vector<unsigned char> payload;
+		PayloadWriter writer(payload);
+		writer.write((int32_t) board.type);
+		writer.write((int32_t) board.size.width);
+		writer.write((int32_t) board.size.height);
+		writer.write(board.spacing);
+		writer.write((uint8_t) board.centered);
+		this->writeChunk({ CHUNK_BOARD, -1, "" }, payload);
+	}
+
+	//----------
+	bool CalibrationArchive::getBoard(Board & board) const {
+		vector<unsigned char> payload;
+		if (!this->readChunk({ CHUNK_BOARD, -1, "" }, payload)) {
+			return false;
+		}
+		PayloadReader reader(payload);
+		int32_t type, width, height;
+		uint8_t centered;
+		if (!reader.read(type) || !reader.read(width) || !reader.read(height) || !reader.read(board.spacing) || !reader.read(centered)) {
+			return false;
+		}
+		board.type = (BoardType) type;
+		board.size = cv::Size(width, height);
+		board.centered = centered != 0;
+		return true;
+	}
+
+	//----------
+	int CalibrationArchive::addView(const string & name, cv::Size imageSize, int64_t timestamp) {
+		int view;
+		{
+			std::lock_guard<std::mutex> lock(this->lock);
+			view = this->viewCount++;
+		}
+
+		vector<unsigned char> payload;
+		PayloadWriter writer(payload);
+		writer.write((int32_t) imageSize.width);
+		writer.write((int32_t) imageSize.height);
+		writer.write(timestamp < 0 ? (int64_t) ofGetSystemTimeMicros() : timestamp);
+		this->writeChunk({ CHUNK_VIEW, view, name }, payload);
+		return view;
+	}
+
+	//----------
+	int CalibrationArchive::getViewCount() const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->viewCount;
+	}
+
+	//----------
+	bool CalibrationArchive::getView(int view, View & result) const {
+		// the view's name is in its key
+		Key key{ CHUNK_VIEW, view, "" };
+		{
+			std::lock_guard<std::mutex> lock(this->lock);
+			auto findView = this->index.lower_bound(key);
+			if (findView == this->index.end() || findView->first.type != CHUNK_VIEW || findView->first.view != view) {
+				return false;
+			}
+			key = findView->first;
+		}
+
+		vector<unsigned char> payload;
+		if (!this->readChunk(key, payload)) {
+			return false;
+		}
+		PayloadReader reader(payload);
+		int32_t width, height;
+		if (!reader.read(width) || !reader.read(height) || !reader.read(result.timestamp)) {
+			return false;
+		}
+		result.name = key.name;
+		result.imageSize = cv::Size(width, height);
+		return true;
+	}
+
+	//----------
+	void CalibrationArchive::setDetection(int view, const vector<Point2f> & imagePoints, const vector<Point3f> & objectPoints) {
+		vector<unsigned char> payload;
+		PayloadWriter writer(payload);
+		writer.writeVector(imagePoints);
+		writer.writeVector(objectPoints);
+		this->writeChunk({ CHUNK_DETECTION, view, "" }, payload);
+	}
+
+	//----------
+	bool CalibrationArchive::getDetection(int view, vector<Point2f> & imagePoints, vector<Point3f> & objectPoints) const {
+		vector<unsigned char> payload;
+		if (!this->readChunk({ CHUNK_DETECTION, view, "" }, payload)) {
+			return false;
+		}
+		PayloadReader reader(payload);
+		return reader.readVector(imagePoints) && reader.readVector(objectPoints);
+	}
+
+	//----------
+	bool CalibrationArchive::hasDetection(int view) const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->index.count({ CHUNK_DETECTION, view, "" }) > 0;
+	}
+
+	//----------
+	void CalibrationArchive::setThumbnail(int view, const Mat & image, int maxWidth) {
+		if (image.empty()) {
+			return;
+		}
+
+		Mat thumbnail;
+		if (image.cols > maxWidth) {
+			const double scale = (double) maxWidth / image.cols;
+			resize(image, thumbnail, cv::Size(), scale, scale, INTER_AREA);
+		}
+		else {
+			thumbnail = image;
+		}
+		if (thumbnail.depth() != CV_8U) {
+			normalize(thumbnail, thumbnail, 0, 255, NORM_MINMAX, CV_8U);
+		}
+
+		vector<unsigned char> payload;
+		if (!imencode(".jpg", thumbnail, payload)) {
+			ofLogError("ofxCv::CalibrationArchive") << "Couldn't encode the thumbnail of view " << view;
+			return;
+		}
+		this->writeChunk({ CHUNK_THUMBNAIL, view, "" }, payload);
+	}
+
+	//----------
+	bool CalibrationArchive::getThumbnail(int view, Mat & thumbnail) const {
+		vector<unsigned char> payload;
+		if (!this->readChunk({ CHUNK_THUMBNAIL, view, "" }, payload)) {
+			return false;
+		}
+		thumbnail = imdecode(payload, IMREAD_UNCHANGED);
+		return !thumbnail.empty();
+	}
+
+	//----------
+	void CalibrationArchive::setMat(const string & name, const Mat & mat, int view) {
+		vector<unsigned char> payload;
+		PayloadWriter writer(payload);
+		writer.writeMat(mat);
+		this->writeChunk({ CHUNK_MAT, view, name }, payload);
+	}
+
+	//----------
+	bool CalibrationArchive::getMat(const string & name, Mat & mat, int view) const {
+		vector<unsigned char> payload;
+		if (!this->readChunk({ CHUNK_MAT, view, name }, payload)) {
+			return false;
+		}
+		PayloadReader reader(payload);
+		return reader.readMat(mat);
+	}
+
+	//----------
+	bool CalibrationArchive::hasMat(const string & name, int view) const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->index.count({ CHUNK_MAT, view, name }) > 0;
+	}
+
+	//----------
+	vector<string> CalibrationArchive::getMatNames(int view) const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		vector<string> names;
+		for (auto it = this->index.lower_bound({ CHUNK_MAT, view, "" }); it != this->index.end(); ++it) {
+			if (it->first.type != CHUNK_MAT || it->first.view != view) {
+				break;
+			}
+			names.push_back(it->first.name);
+		}
+		return names;
+	}
+
+	//----------
+	void CalibrationArchive::getCalibrationPoints(vector<vector<Point3f>> & objectPoints, vector<vector<Point2f>> & imagePoints, vector<int> * viewIndices) const {
+		objectPoints.clear();
+		imagePoints.clear();
+		if (viewIndices) {
+			viewIndices->clear();
+		}
+
+		Board board;
+		vector<Point3f> boardPoints;
+		if (this->getBoard(board)) {
+			boardPoints = board.makePoints();
+		}
+
+		const int viewCount = this->getViewCount();
+		for (int view = 0; view < viewCount; view++) {
+			vector<Point2f> viewImagePoints;
+			vector<Point3f> viewObjectPoints;
+			if (!this->getDetection(view, viewImagePoints, viewObjectPoints)) {
+				continue;
+			}
+			if (viewObjectPoints.empty()) {
+				viewObjectPoints = boardPoints;
+			}
+			if (viewObjectPoints.size() != viewImagePoints.size() || viewImagePoints.empty()) {
+				ofLogWarning("ofxCv::CalibrationArchive") << "Skipping view " << view << " : " << viewImagePoints.size() << " image points but " << viewObjectPoints.size() << " object points";
+				continue;
+			}
+			objectPoints.push_back(std::move(viewObjectPoints));
+			imagePoints.push_back(std::move(viewImagePoints));
+			if (viewIndices) {
+				viewIndices->push_back(view);
+			}
+		}
+	}
+
+	//----------
+	uint64_t CalibrationArchive::getUnusedBytes() const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->unusedBytes;
+	}
+
+	//----------
+	bool CalibrationArchive::readIndex(uint64_t fileSize) {
+		if (fileSize < sizeof(ArchiveHeader) + sizeof(ChunkHeader) + sizeof(IndexFooter)) {
+			return false;
+		}
+
+		IndexFooter footer;
+		this->file.seekg(fileSize - sizeof(IndexFooter));
+		if (!this->file.read((char *) &footer, sizeof(footer)) || memcmp(footer.magic, archiveIndexMagic, sizeof(archiveIndexMagic)) != 0) {
+			this->file.clear();
+			return false;
+		}
+
+		ChunkHeader header;
+		this->file.seekg(footer.indexOffset);
+		if (!this->file.read((char *) &header, sizeof(header))
+			|| header.magic != chunkMagic
+			|| header.type != CHUNK_INDEX
+			|| footer.indexOffset + sizeof(header) + header.payloadSize != fileSize) {
+			this->file.clear();
+			return false;
+		}
+
+		vector<unsigned char> payload((size_t) header.payloadSize);
+		if (!this->file.read((char *) payload.data(), payload.size()) || chunkChecksum(payload.data(), payload.size()) != header.checksum) {
+			this->file.clear();
+			return false;
+		}
+
+		PayloadReader reader(payload);
+		for (uint64_t i = 0; i < footer.entryCount; i++) {
+			IndexEntry entry;
+			if (!reader.read(entry)) {
+				this->index.clear();
+				return false;
+			}
+			string name(entry.nameLength, '\0');
+			if (!reader.read(&name[0], name.size())) {
+				this->index.clear();
+				return false;
+			}
+			this->index[{ entry.type, entry.view, name }] = { entry.offset, entry.size, entry.checksum };
+		}
+
+		this->fileSize = fileSize;
+		this->unusedBytes = footer.unusedBytes;
+		this->indexChunkSize = sizeof(header) + header.payloadSize;
+		return true;
+	}
+
+	//----------
+	void CalibrationArchive::rebuildIndex(uint64_t fileSize) {
+		this->index.clear();
+		this->unusedBytes = 0;
+
+		// chunks run up to the first one which is incomplete. later chunks replace earlier ones
+		uint64_t offset = sizeof(ArchiveHeader);
+		while (offset + sizeof(ChunkHeader) <= fileSize) {
+			ChunkHeader header;
+			this->file.seekg(offset);
+			if (!this->file.read((char *) &header, sizeof(header)) || header.magic != chunkMagic) {
+				break;
+			}
+			const uint64_t payloadOffset = offset + sizeof(header) + header.nameLength;
+			const uint64_t next = payloadOffset + header.payloadSize;
+			if (next > fileSize) {
+				break;
+			}
+
+			if (header.type == CHUNK_INDEX) {
+				this->unusedBytes += next - offset;
+			}
+			else {
+				Key key{ header.type, header.view, string(header.nameLength, '\0') };
+				if (!this->file.read(&key.name[0], key.name.size())) {
+					break;
+				}
+				auto findExisting = this->index.find(key);
+				if (findExisting != this->index.end()) {
+					this->unusedBytes += sizeof(ChunkHeader) + key.name.size() + findExisting->second.size;
+				}
+				this->index[key] = { payloadOffset, header.payloadSize, header.checksum };
+			}
+			offset = next;
+		}
+		this->file.clear();
+
+		// anything after the last complete chunk will be written over
+		this->fileSize = offset;
+		this->indexChunkSize = 0;
+		this->indexDirty = true;
+	}
+
+	//----------
+	void CalibrationArchive::writeChunk(const Key & key, const vector<unsigned char> & payload) {
+		std::lock_guard<std::mutex> lock(this->lock);
+		if (!this->isOpen()) {
+			ofLogError("ofxCv::CalibrationArchive") << "Not open";
+			return;
+		}
+
+		ChunkHeader header;
+		header.magic = chunkMagic;
+		header.type = key.type;
+		header.view = key.view;
+		header.nameLength = (uint32_t) key.name.size();
+		header.payloadSize = payload.size();
+		header.checksum = chunkChecksum(payload.data(), payload.size());
+
+		this->file.seekp(this->fileSize);
+		this->file.write((const char *) &header, sizeof(header));
+		this->file.write(key.name.data(), key.name.size());
+		this->file.write((const char *) payload.data(), payload.size());
+		if (!this->file) {
+			ofLogError("ofxCv::CalibrationArchive") << "Couldn't write to " << this->filename;
+			this->file.clear();
+			return;
+		}
+
+		auto findExisting = this->index.find(key);
+		if (findExisting != this->index.end()) {
+			this->unusedBytes += sizeof(ChunkHeader) + key.name.size() + findExisting->second.size;
+		}
+		const uint64_t payloadOffset = this->fileSize + sizeof(header) + key.name.size();
+		this->index[key] = { payloadOffset, payload.size(), header.checksum };
+		this->fileSize = payloadOffset + payload.size();
+
+		// the index at the end of the file (if any) no longer describes the file
+		this->unusedBytes += this->indexChunkSize;
+		this->indexChunkSize = 0;
+		this->indexDirty = true;
+	}
+
+	//----------
+	bool CalibrationArchive::readChunk(const Key & key, vector<unsigned char> & payload) const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		if (!this->isOpen()) {
+			return false;
+		}
+		auto findEntry = this->index.find(key);
+		if (findEntry == this->index.end()) {
+			return false;
+		}
+
+		const auto & entry = findEntry->second;
+		payload.resize((size_t) entry.size);
+		this->file.flush(); // so reads see what's been written
+		this->file.seekg(entry.offset);
+		if (!this->file.read((char *) payload.data(), payload.size())) {
+			this->file.clear();
+			ofLogError("ofxCv::CalibrationArchive") << "Couldn't read from " << this->filename;
+			return false;
+		}
+		if (chunkChecksum(payload.data(), payload.size()) != entry.checksum) {
+			ofLogError("ofxCv::CalibrationArchive") << "A chunk of " << this->filename << " failed its checksum";
+			return false;
+		}
+		return true;
+	}
+}
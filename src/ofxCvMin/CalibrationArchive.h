@@ -0,0 +1,125 @@
+/*
+ a calibration session (board definition, views, detected points, thumbnails,
+ solver inputs and results) kept in one binary file.
+
+ the file is a sequence of chunks, each with a small header (type, view, name,
+ size, checksum). changes are appended as new chunks, so adding a view never
+ rewrites what's already there, and a later chunk with the same type, view and
+ name replaces an earlier one. close() (or flush()) appends an index chunk which
+ ends the file, so opening only reads the index. chunk contents are read when
+ they're asked for. if the session wasn't closed properly, the index is rebuilt
+ by walking the chunk headers.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "opencv2/opencv.hpp"
+#include "Helpers.h"
+
+#include <fstream>
+#include <mutex>
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	class CalibrationArchive {
+	public:
+		struct Board {
+			BoardType type = BoardType::Checkerboard;
+			cv::Size size;
+			float spacing = 1.0f;
+			bool centered = true;
+
+			vector<Point3f> makePoints() const;
+		};
+
+		struct View {
+			string name;
+			cv::Size imageSize;
+			int64_t timestamp = 0; // microseconds
+		};
+
+		~CalibrationArchive();
+
+		// opens an existing session for reading and appending, or creates a new one
+		bool open(const string & filename);
+		bool isOpen() const;
+
+		// appends the index, so the next open() is fast. close() calls this
+		void flush();
+		void close();
+
+		void setBoard(const Board &);
+		bool getBoard(Board &) const;
+
+		// returns the index of the new view. timestamp -1 means now
+		int addView(const string & name, cv::Size imageSize, int64_t timestamp = -1);
+		int getViewCount() const;
+		bool getView(int view, View &) const;
+
+		// objectPoints can be left empty if they're the board's points
+		void setDetection(int view, const vector<Point2f> & imagePoints, const vector<Point3f> & objectPoints = vector<Point3f>());
+		bool getDetection(int view, vector<Point2f> & imagePoints, vector<Point3f> & objectPoints) const;
+		bool hasDetection(int view) const;
+
+		// the image is shrunk to maxWidth and stored as a jpeg
+		void setThumbnail(int view, const Mat & image, int maxWidth = 320);
+		bool getThumbnail(int view, Mat & thumbnail) const;
+
+		// any other data, e.g. solver inputs and results. view = -1 is for the whole session
+		void setMat(const string & name, const Mat &, int view = -1);
+		bool getMat(const string & name, Mat &, int view = -1) const;
+		bool hasMat(const string & name, int view = -1) const;
+		vector<string> getMatNames(int view = -1) const;
+
+		// the detections of all views which have one, ready for calibrateCamera. views with no
+		// object points use the board's points. viewIndices (if given) says which view each set came from
+		void getCalibrationPoints(vector<vector<Point3f>> & objectPoints, vector<vector<Point2f>> & imagePoints, vector<int> * viewIndices = nullptr) const;
+
+		// bytes in chunks which have since been replaced
+		uint64_t getUnusedBytes() const;
+	protected:
+		enum ChunkType : uint32_t {
+			CHUNK_BOARD = 0x44524142, // BARD
+			CHUNK_VIEW = 0x57454956, // VIEW
+			CHUNK_DETECTION = 0x54434544, // DECT
+			CHUNK_THUMBNAIL = 0x424d4854, // THMB
+			CHUNK_MAT = 0x5441414d, // MAAT
+			CHUNK_INDEX = 0x58444e49 // INDX
+		};
+
+		struct Key {
+			uint32_t type;
+			int32_t view;
+			string name;
+
+			bool operator<(const Key & other) const {
+				return tie(this->type, this->view, this->name) < tie(other.type, other.view, other.name);
+			}
+		};
+
+		struct Entry {
+			uint64_t offset; // of the payload
+			uint64_t size;
+			uint64_t checksum;
+		};
+
+		bool readIndex(uint64_t fileSize);
+		void rebuildIndex(uint64_t fileSize);
+		void writeChunk(const Key &, const vector<unsigned char> & payload);
+		bool readChunk(const Key &, vector<unsigned char> & payload) const;
+
+		mutable std::fstream file; // reading moves the position
+		string filename;
+		mutable std::mutex lock;
+
+		map<Key, Entry> index;
+		int viewCount = 0;
+		uint64_t fileSize = 0;
+		uint64_t unusedBytes = 0;
+		uint64_t indexChunkSize = 0; // of the index at the end of the file, if there is one
+		bool indexDirty = false;
+	};
+}
@@ -0,0 +1,750 @@
+#include "Analysis.h"
+#include "Instrumentation.h"
+#include "ThreadingConfig.h"
+
+#include "opencv2/core/hal/intrin.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+using namespace std;
+
+namespace ofxCv {
+	
+	using namespace cv;
+	
+	template <typename T>
+	static void findPeaks(const Mat& mat, vector<Peak>& peaks, float threshold, int radius, PeakRefinement refinement) {
+		const int rows = mat.rows, cols = mat.cols;
+		
+		// block non-maximum suppression: any two pixels in a (radius + 1) square tile are
+		// within radius of each other, so only the tile's maximum (the first, for ties) can
+		// be a peak, and only it needs the full neighbourhood check
+		const int tileSize = radius + 1;
+		const int tileRows = (rows + tileSize - 1) / tileSize;
+		
+		// rows of tiles in parallel, each with its own list. neighbourhoods are only read,
+		// so they can reach across tile edges
+		struct Found {
+			int x, y;
+			Peak peak;
+		};
+		vector<vector<Found>> tileRowPeaks(tileRows);
+		parallelFor(Range(0, tileRows), [&](const Range& range) {
+			vector<float> tileMax((cols + tileSize - 1) / tileSize);
+			vector<int> tileX(tileMax.size()), tileY(tileMax.size());
+			for(int tileRow = range.start; tileRow < range.end; tileRow++) {
+				const int tileTop = tileRow * tileSize, tileBottom = min(tileTop + tileSize, rows);
+				
+				// the maximum of every tile in this row of tiles, reading each pixel once
+				fill(tileMax.begin(), tileMax.end(), threshold);
+				fill(tileX.begin(), tileX.end(), -1);
+				for(int y = tileTop; y < tileBottom; y++) {
+					const T* row = mat.ptr<T>(y);
+					for(int tile = 0, x = 0; x < cols; tile++) {
+						const int tileEnd = min(x + tileSize, cols);
+						float maximum = tileMax[tile];
+						int maximumX = -1;
+						for(; x < tileEnd; x++) {
+							if(row[x] > maximum) {
+								maximum = row[x];
+								maximumX = x;
+							}
+						}
+						if(maximumX >= 0) {
+							tileMax[tile] = maximum;
+							tileX[tile] = maximumX;
+							tileY[tile] = y;
+						}
+					}
+				}
+				
+				auto& found = tileRowPeaks[tileRow];
+				for(size_t tile = 0; tile < tileMax.size(); tile++) {
+					if(tileX[tile] < 0) {
+						continue;
+					}
+					const int x = tileX[tile], y = tileY[tile];
+					const T* row = mat.ptr<T>(y);
+					const float value = row[x];
+					
+					// non-maximum suppression, also finding the neighbourhood minimum
+					const int top = max(y - radius, 0), bottom = min(y + radius, rows - 1);
+					const int left = max(x - radius, 0), right = min(x + radius, cols - 1);
+					float minimum = value;
+					bool isPeak = true;
+					for(int ny = top; ny <= bottom && isPeak; ny++) {
+						const T* neighbours = mat.ptr<T>(ny);
+						for(int nx = left; nx <= right; nx++) {
+							const float neighbour = neighbours[nx];
+							// earlier pixels win ties, so plateaus give a single peak
+							bool before = ny < y || (ny == y && nx < x);
+							if(neighbour > value || (before && neighbour == value)) {
+								isPeak = false;
+								break;
+							}
+							minimum = min(minimum, neighbour);
+						}
+					}
+					if(!isPeak) {
+						continue;
+					}
+					
+					glm::vec2 position(x, y);
+					if(refinement == PEAK_REFINE_QUADRATIC) {
+						if(x > 0 && x + 1 < cols) {
+							const float l = row[x - 1], r = row[x + 1];
+							const float curvature = l - 2 * value + r;
+							if(curvature < 0) {
+								position.x += 0.5f * (l - r) / curvature;
+							}
+						}
+						if(y > 0 && y + 1 < rows) {
+							const float u = mat.ptr<T>(y - 1)[x], d = mat.ptr<T>(y + 1)[x];
+							const float curvature = u - 2 * value + d;
+							if(curvature < 0) {
+								position.y += 0.5f * (u - d) / curvature;
+							}
+						}
+					} else if(refinement == PEAK_REFINE_CENTROID) {
+						float sum = 0, sumX = 0, sumY = 0;
+						for(int ny = top; ny <= bottom; ny++) {
+							const T* neighbours = mat.ptr<T>(ny);
+							for(int nx = left; nx <= right; nx++) {
+								const float weight = (float) neighbours[nx] - threshold;
+								if(weight > 0) {
+									sum += weight;
+									sumX += weight * nx;
+									sumY += weight * ny;
+								}
+							}
+						}
+						position = glm::vec2(sumX / sum, sumY / sum);
+					}
+					
+					found.push_back({x, y, {position, value, value - minimum}});
+				}
+				
+				// row order, so equal peaks come out in the same order as a plain scan
+				sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+					return a.y < b.y || (a.y == b.y && a.x < b.x);
+				});
+			}
+		});
+		
+		for(auto& tileRow : tileRowPeaks) {
+			for(auto& found : tileRow) {
+				peaks.push_back(found.peak);
+			}
+		}
+	}
+	
+	void findPeaks(const Mat& mat, vector<Peak>& peaks, float threshold, int radius, PeakRefinement refinement, int maxPeaks) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findPeaks");
+		peaks.clear();
+		if(mat.empty()) {
+			return;
+		}
+		if(mat.channels() != 1) {
+			LogError("ofxCv::findPeaks") << "Expected a single channel image";
+			return;
+		}
+		radius = max(radius, 1);
+		switch(mat.depth()) {
+			case CV_8U: findPeaks<uchar>(mat, peaks, threshold, radius, refinement); break;
+			case CV_16U: findPeaks<ushort>(mat, peaks, threshold, radius, refinement); break;
+			case CV_32F: findPeaks<float>(mat, peaks, threshold, radius, refinement); break;
+			default:
+				LogError("ofxCv::findPeaks") << "Unsupported depth " << mat.depth() << ", use CV_8U, CV_16U or CV_32F";
+				return;
+		}
+		
+		// stable so that equal peaks stay in row order
+		stable_sort(peaks.begin(), peaks.end(), [](const Peak& a, const Peak& b) {
+			return a.value > b.value;
+		});
+		if(maxPeaks > 0 && peaks.size() > (size_t) maxPeaks) {
+			peaks.resize(maxPeaks);
+		}
+	}
+	
+	// accumulates one row of the source into the column profiles and returns the row's
+	// statistics. the SIMD overloads handle as much of the row as they can and return
+	// how many pixels they covered, the scalar loop does the rest.
+	template <typename S, typename A>
+	static int accumulateRowSimd(const S*, A*, A*, A*, int, A&, A&, A&) {
+		return 0;
+	}
+	
+#if CV_SIMD128
+	template <typename Load>
+	static int accumulateRowSimdFloat(Load load, float* colSum, float* colMin, float* colMax, int cols, float& rowSum, float& rowMin, float& rowMax) {
+		v_float32x4 sum = v_setzero_f32(), minimum = v_setall_f32(rowMin), maximum = v_setall_f32(rowMax);
+		int x = 0;
+		for(; x <= cols - 4; x += 4) {
+			v_float32x4 value = load(x);
+			v_store(colSum + x, v_load(colSum + x) + value);
+			v_store(colMin + x, v_min(v_load(colMin + x), value));
+			v_store(colMax + x, v_max(v_load(colMax + x), value));
+			sum += value;
+			minimum = v_min(minimum, value);
+			maximum = v_max(maximum, value);
+		}
+		rowSum += v_reduce_sum(sum);
+		rowMin = v_reduce_min(minimum);
+		rowMax = v_reduce_max(maximum);
+		return x;
+	}
+	
+	static int accumulateRowSimd(const uchar* src, float* colSum, float* colMin, float* colMax, int cols, float& rowSum, float& rowMin, float& rowMax) {
+		return accumulateRowSimdFloat([src](int x) {
+			return v_cvt_f32(v_reinterpret_as_s32(v_load_expand_q(src + x)));
+		}, colSum, colMin, colMax, cols, rowSum, rowMin, rowMax);
+	}
+	
+	static int accumulateRowSimd(const ushort* src, float* colSum, float* colMin, float* colMax, int cols, float& rowSum, float& rowMin, float& rowMax) {
+		return accumulateRowSimdFloat([src](int x) {
+			return v_cvt_f32(v_reinterpret_as_s32(v_load_expand(src + x)));
+		}, colSum, colMin, colMax, cols, rowSum, rowMin, rowMax);
+	}
+	
+	static int accumulateRowSimd(const float* src, float* colSum, float* colMin, float* colMax, int cols, float& rowSum, float& rowMin, float& rowMax) {
+		return accumulateRowSimdFloat([src](int x) {
+			return v_load(src + x);
+		}, colSum, colMin, colMax, cols, rowSum, rowMin, rowMax);
+	}
+#endif
+	
+	template <typename S, typename A>
+	static void accumulateProfiles(const Mat & mat, Profiles & profiles) {
+		const int rows = mat.rows, cols = mat.cols;
+		
+		// split into horizontal bands, each with its own column accumulators, then merge
+		const int bandCount = std::max(1, std::min(getNumThreads(), rows / 64));
+		Mat bandColSums(bandCount, cols, DataType<A>::type, Scalar(0));
+		Mat bandColMins(bandCount, cols, DataType<A>::type, Scalar(numeric_limits<A>::max()));
+		Mat bandColMaxs(bandCount, cols, DataType<A>::type, Scalar(numeric_limits<A>::lowest()));
+		
+		A* rowSums = profiles.rowSum.ptr<A>();
+		A* rowMins = profiles.rowMin.ptr<A>();
+		A* rowMaxs = profiles.rowMax.ptr<A>();
+		
+		parallelFor(Range(0, bandCount), [&](const Range & range) {
+			for(int band = range.start; band < range.end; band++) {
+				A* colSum = bandColSums.ptr<A>(band);
+				A* colMin = bandColMins.ptr<A>(band);
+				A* colMax = bandColMaxs.ptr<A>(band);
+				const int rowEnd = rows * (band + 1) / bandCount;
+				for(int y = rows * band / bandCount; y < rowEnd; y++) {
+					const S* src = mat.ptr<S>(y);
+					A rowSum = 0, rowMin = numeric_limits<A>::max(), rowMax = numeric_limits<A>::lowest();
+					int x = accumulateRowSimd(src, colSum, colMin, colMax, cols, rowSum, rowMin, rowMax);
+					for(; x < cols; x++) {
+						const A value = src[x];
+						colSum[x] += value;
+						colMin[x] = std::min(colMin[x], value);
+						colMax[x] = std::max(colMax[x], value);
+						rowSum += value;
+						rowMin = std::min(rowMin, value);
+						rowMax = std::max(rowMax, value);
+					}
+					rowSums[y] = rowSum;
+					rowMins[y] = rowMin;
+					rowMaxs[y] = rowMax;
+				}
+			}
+		});
+		
+		A* colSums = profiles.colSum.ptr<A>();
+		A* colMins = profiles.colMin.ptr<A>();
+		A* colMaxs = profiles.colMax.ptr<A>();
+		for(int x = 0; x < cols; x++) {
+			colSums[x] = bandColSums.at<A>(0, x);
+			colMins[x] = bandColMins.at<A>(0, x);
+			colMaxs[x] = bandColMaxs.at<A>(0, x);
+		}
+		for(int band = 1; band < bandCount; band++) {
+			const A* colSum = bandColSums.ptr<A>(band);
+			const A* colMin = bandColMins.ptr<A>(band);
+			const A* colMax = bandColMaxs.ptr<A>(band);
+			for(int x = 0; x < cols; x++) {
+				colSums[x] += colSum[x];
+				colMins[x] = std::min(colMins[x], colMin[x]);
+				colMaxs[x] = std::max(colMaxs[x], colMax[x]);
+			}
+		}
+	}
+	
+	template <typename A>
+	static bool accumulateProfiles(const Mat & mat, Profiles & profiles) {
+		switch(mat.depth()) {
+			case CV_8U: accumulateProfiles<uchar, A>(mat, profiles); return true;
+			case CV_8S: accumulateProfiles<schar, A>(mat, profiles); return true;
+			case CV_16U: accumulateProfiles<ushort, A>(mat, profiles); return true;
+			case CV_16S: accumulateProfiles<short, A>(mat, profiles); return true;
+			case CV_32S: accumulateProfiles<int, A>(mat, profiles); return true;
+			case CV_32F: accumulateProfiles<float, A>(mat, profiles); return true;
+			case CV_64F: accumulateProfiles<double, A>(mat, profiles); return true;
+			default: return false;
+		}
+	}
+	
+	void reduceProfiles(const Mat & mat, Profiles & profiles, int accumulatorDepth) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::reduceProfiles");
+		if(accumulatorDepth != CV_32F && accumulatorDepth != CV_64F) {
+			LogWarning("ofxCv::reduceProfiles") << "accumulatorDepth should be CV_32F or CV_64F, using CV_32F";
+			accumulatorDepth = CV_32F;
+		}
+		
+		if(mat.empty()) {
+			// e.g. rows x 0 still has a (zero) profile entry per row
+			const int type = CV_MAKETYPE(accumulatorDepth, mat.channels());
+			auto zeros = [type](Mat & profile, int length) {
+				profile.create(max(length, 0), 1, type);
+				profile.setTo(Scalar::all(0));
+			};
+			for(auto profile : { &profiles.rowSum, &profiles.rowMean, &profiles.rowMin, &profiles.rowMax }) {
+				zeros(*profile, mat.rows);
+			}
+			for(auto profile : { &profiles.colSum, &profiles.colMean, &profiles.colMin, &profiles.colMax }) {
+				zeros(*profile, mat.cols);
+			}
+			return;
+		}
+		
+		if(mat.channels() != 1) {
+			// cv::reduce handles channels separately, at the cost of a pass per statistic
+			cv::reduce(mat, profiles.rowSum, 1, REDUCE_SUM, accumulatorDepth);
+			cv::reduce(mat, profiles.rowMean, 1, REDUCE_AVG, accumulatorDepth);
+			cv::reduce(mat, profiles.rowMin, 1, REDUCE_MIN, -1);
+			cv::reduce(mat, profiles.rowMax, 1, REDUCE_MAX, -1);
+			cv::reduce(mat, profiles.colSum, 0, REDUCE_SUM, accumulatorDepth);
+			cv::reduce(mat, profiles.colMean, 0, REDUCE_AVG, accumulatorDepth);
+			cv::reduce(mat, profiles.colMin, 0, REDUCE_MIN, -1);
+			cv::reduce(mat, profiles.colMax, 0, REDUCE_MAX, -1);
+			profiles.colSum = profiles.colSum.t();
+			profiles.colMean = profiles.colMean.t();
+			profiles.colMin = profiles.colMin.t();
+			profiles.colMax = profiles.colMax.t();
+			
+			// REDUCE_MIN/MAX only write the source depth, so convert to match the other profiles
+			profiles.rowMin.convertTo(profiles.rowMin, accumulatorDepth);
+			profiles.rowMax.convertTo(profiles.rowMax, accumulatorDepth);
+			profiles.colMin.convertTo(profiles.colMin, accumulatorDepth);
+			profiles.colMax.convertTo(profiles.colMax, accumulatorDepth);
+			return;
+		}
+		
+		const int type = CV_MAKETYPE(accumulatorDepth, 1);
+		profiles.rowSum.create(mat.rows, 1, type);
+		profiles.rowMin.create(mat.rows, 1, type);
+		profiles.rowMax.create(mat.rows, 1, type);
+		profiles.colSum.create(mat.cols, 1, type);
+		profiles.colMin.create(mat.cols, 1, type);
+		profiles.colMax.create(mat.cols, 1, type);
+		
+		bool supported = accumulatorDepth == CV_64F
+			? accumulateProfiles<double>(mat, profiles)
+			: accumulateProfiles<float>(mat, profiles);
+		if(!supported) {
+			LogError("ofxCv::reduceProfiles") << "Unsupported depth " << mat.depth();
+			return;
+		}
+		
+		profiles.rowMean = profiles.rowSum * (1.0 / mat.cols);
+		profiles.colMean = profiles.colSum * (1.0 / mat.rows);
+	}
+	
+	void getProfileExtent(const Mat & profile, float thresh, bool invert, int & first, int & last) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::getProfileExtent");
+		Mat values = profile;
+		if(values.depth() != CV_32F) {
+			profile.convertTo(values, CV_32F);
+		}
+		
+		// same as threshold() with THRESH_BINARY or THRESH_BINARY_INV
+		ScanPredicate predicate = invert ? SCAN_LESS_EQUAL : SCAN_GREATER;
+		first = max(findFirst(values, predicate, thresh), 0);
+		last = max(findLast(values, predicate, thresh), 0);
+	}
+	
+	struct ScanEqual {
+		template <typename V> V operator()(const V& a, const V& b) const { return a == b; }
+		bool operator()(uchar a, uchar b) const { return a == b; }
+		bool operator()(ushort a, ushort b) const { return a == b; }
+		bool operator()(float a, float b) const { return a == b; }
+	};
+	
+	struct ScanNotEqual {
+		template <typename V> V operator()(const V& a, const V& b) const { return a != b; }
+		bool operator()(uchar a, uchar b) const { return a != b; }
+		bool operator()(ushort a, ushort b) const { return a != b; }
+		bool operator()(float a, float b) const { return a != b; }
+	};
+	
+	struct ScanGreater {
+		template <typename V> V operator()(const V& a, const V& b) const { return a > b; }
+		bool operator()(uchar a, uchar b) const { return a > b; }
+		bool operator()(ushort a, ushort b) const { return a > b; }
+		bool operator()(float a, float b) const { return a > b; }
+	};
+	
+	struct ScanLessEqual {
+		template <typename V> V operator()(const V& a, const V& b) const { return a <= b; }
+		bool operator()(uchar a, uchar b) const { return a <= b; }
+		bool operator()(ushort a, ushort b) const { return a <= b; }
+		bool operator()(float a, float b) const { return a <= b; }
+	};
+	
+#if CV_SIMD128
+	static inline v_uint8x16 scanBroadcast(uchar value) { return v_setall_u8(value); }
+	static inline v_uint16x8 scanBroadcast(ushort value) { return v_setall_u16(value); }
+	static inline v_float32x4 scanBroadcast(float value) { return v_setall_f32(value); }
+	
+	static inline int highestBit(unsigned int mask) {
+		int bit = 0;
+		while(mask >>= 1) {
+			bit++;
+		}
+		return bit;
+	}
+#endif
+	
+	// the compare is compiled into the loop, one lane mask per vector
+	template <typename T, typename Compare>
+	static int scanFirst(const T* data, int count, T value, Compare compare) {
+		int i = 0;
+#if CV_SIMD128
+		const auto values = scanBroadcast(value);
+		const int lanes = decltype(values)::nlanes;
+		for(; i <= count - lanes; i += lanes) {
+			int mask = v_signmask(compare(v_load(data + i), values));
+			if(mask) {
+				return i + (int) trailingZeros32(mask);
+			}
+		}
+#endif
+		for(; i < count; i++) {
+			if(compare(data[i], value)) {
+				return i;
+			}
+		}
+		return -1;
+	}
+	
+	template <typename T, typename Compare>
+	static int scanLast(const T* data, int count, T value, Compare compare) {
+		int i = count;
+#if CV_SIMD128
+		const auto values = scanBroadcast(value);
+		const int lanes = decltype(values)::nlanes;
+		for(; i >= lanes; i -= lanes) {
+			int mask = v_signmask(compare(v_load(data + i - lanes), values));
+			if(mask) {
+				return i - lanes + highestBit(mask);
+			}
+		}
+#endif
+		for(; i > 0; i--) {
+			if(compare(data[i - 1], value)) {
+				return i - 1;
+			}
+		}
+		return -1;
+	}
+	
+	// the predicate against a double, resolved for the element type. integer types
+	// can make it always or never true (e.g. > -1 or == 0.5).
+	enum ScanOutcome {
+		SCAN_ALWAYS,
+		SCAN_NEVER,
+		SCAN_COMPARE
+	};
+	
+	template <typename T>
+	static ScanOutcome resolveScan(ScanPredicate& predicate, double value, T& typed) {
+		if(numeric_limits<T>::is_integer) {
+			const double lowest = numeric_limits<T>::lowest(), highest = numeric_limits<T>::max();
+			if(predicate == SCAN_EQUAL || predicate == SCAN_NOT_EQUAL) {
+				bool representable = value >= lowest && value <= highest && value == floor(value);
+				if(!representable) {
+					return predicate == SCAN_EQUAL ? SCAN_NEVER : SCAN_ALWAYS;
+				}
+				typed = (T) value;
+				return SCAN_COMPARE;
+			}
+			// x > 2.5 is x > 2 for integers, and x <= 2.5 is x <= 2
+			value = floor(value);
+			if(value < lowest) {
+				return predicate == SCAN_GREATER ? SCAN_ALWAYS : SCAN_NEVER;
+			}
+			if(value >= highest) {
+				return predicate == SCAN_GREATER ? SCAN_NEVER : SCAN_ALWAYS;
+			}
+		}
+		typed = (T) value;
+		return SCAN_COMPARE;
+	}
+	
+	template <typename T>
+	static int scan(const T* data, int count, ScanPredicate predicate, double value, bool forward) {
+		T typed = 0;
+		switch(resolveScan(predicate, value, typed)) {
+			case SCAN_ALWAYS: return count == 0 ? -1 : (forward ? 0 : count - 1);
+			case SCAN_NEVER: return -1;
+			default: break;
+		}
+		switch(predicate) {
+			case SCAN_EQUAL: return forward ? scanFirst(data, count, typed, ScanEqual()) : scanLast(data, count, typed, ScanEqual());
+			case SCAN_NOT_EQUAL: return forward ? scanFirst(data, count, typed, ScanNotEqual()) : scanLast(data, count, typed, ScanNotEqual());
+			case SCAN_GREATER: return forward ? scanFirst(data, count, typed, ScanGreater()) : scanLast(data, count, typed, ScanGreater());
+			default: return forward ? scanFirst(data, count, typed, ScanLessEqual()) : scanLast(data, count, typed, ScanLessEqual());
+		}
+	}
+	
+	static int scan(const void* data, int depth, int count, ScanPredicate predicate, double value, bool forward) {
+		switch(depth) {
+			case CV_8U: return scan((const uchar*) data, count, predicate, value, forward);
+			case CV_16U: return scan((const ushort*) data, count, predicate, value, forward);
+			case CV_32F: return scan((const float*) data, count, predicate, value, forward);
+			default:
+				LogError("ofxCv::findFirst") << "Unsupported depth " << depth << ", use CV_8U, CV_16U or CV_32F";
+				return -1;
+		}
+	}
+	
+	static int scan(const Mat& arr, ScanPredicate predicate, double value, bool forward) {
+		if(arr.channels() != 1) {
+			LogError("ofxCv::findFirst") << "Expected a single channel array";
+			return -1;
+		}
+		// e.g. a column of a larger Mat
+		Mat flat = arr.isContinuous() ? arr : arr.clone();
+		return scan(flat.ptr(), flat.depth(), (int) flat.total(), predicate, value, forward);
+	}
+	
+	int findFirst(const Mat& arr, ScanPredicate predicate, double value) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findFirst");
+		return scan(arr, predicate, value, true);
+	}
+	
+	int findLast(const Mat& arr, ScanPredicate predicate, double value) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findLast");
+		return scan(arr, predicate, value, false);
+	}
+	
+	int findFirst(const Mat& arr, unsigned char target) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findFirst");
+		return max(findFirst(arr, SCAN_EQUAL, target), 0);
+	}
+	
+	int findLast(const Mat& arr, unsigned char target) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findLast");
+		return max(findLast(arr, SCAN_EQUAL, target), 0);
+	}
+	
+	static bool checkMask(const Mat& mask, const char* module) {
+		int depth = mask.depth();
+		if(mask.channels() != 1 || (depth != CV_8U && depth != CV_16U && depth != CV_32F)) {
+			LogError(module) << "Expected a single channel CV_8U, CV_16U or CV_32F mask";
+			return false;
+		}
+		return true;
+	}
+	
+	bool getNonZeroExtents(const Mat& mask, cv::Rect& extents) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::getNonZeroExtents");
+		extents = cv::Rect();
+		if(mask.empty() || !checkMask(mask, "ofxCv::getNonZeroExtents")) {
+			return false;
+		}
+		
+		const int rows = mask.rows, cols = mask.cols, depth = mask.depth();
+		const size_t elementSize = mask.elemSize();
+		auto first = [&](int y, int start, int end) {
+			int x = scan(mask.ptr(y) + start * elementSize, depth, end - start, SCAN_NOT_EQUAL, 0, true);
+			return x < 0 ? -1 : start + x;
+		};
+		auto last = [&](int y, int start, int end) {
+			int x = scan(mask.ptr(y) + start * elementSize, depth, end - start, SCAN_NOT_EQUAL, 0, false);
+			return x < 0 ? -1 : start + x;
+		};
+		
+		// top and bottom rows, which also seed the left and right extents
+		int top = 0, left = -1;
+		for(; top < rows && left < 0; top++) {
+			left = first(top, 0, cols);
+		}
+		if(left < 0) {
+			return false;
+		}
+		top--;
+		int bottom = rows - 1, right = -1;
+		for(; bottom >= top && right < 0; bottom--) {
+			right = last(bottom, 0, cols);
+		}
+		bottom++;
+		
+		// the rows in between only need to be searched outside the current extents.
+		// bands shrink their own extents and are merged after.
+		const int middle = bottom - top + 1;
+		const int bandCount = max(1, min(getNumThreads(), middle / 64));
+		vector<Vec2i> bandExtents(bandCount, Vec2i(left, right));
+		parallelFor(Range(0, bandCount), [&](const Range & range) {
+			for(int band = range.start; band < range.end; band++) {
+				int bandLeft = left, bandRight = right;
+				const int rowEnd = top + middle * (band + 1) / bandCount;
+				for(int y = top + middle * band / bandCount; y < rowEnd; y++) {
+					if(bandLeft == 0 && bandRight == cols - 1) {
+						break;
+					}
+					if(bandLeft > 0) {
+						int x = first(y, 0, bandLeft);
+						if(x >= 0) {
+							bandLeft = x;
+						}
+					}
+					if(bandRight < cols - 1) {
+						int x = last(y, bandRight + 1, cols);
+						if(x >= 0) {
+							bandRight = x;
+						}
+					}
+				}
+				bandExtents[band] = Vec2i(bandLeft, bandRight);
+			}
+		});
+		for(auto& bandExtent : bandExtents) {
+			left = min(left, bandExtent[0]);
+			right = max(right, bandExtent[1]);
+		}
+		
+		extents = cv::Rect(left, top, right - left + 1, bottom - top + 1);
+		return true;
+	}
+	
+	void getRowExtents(const Mat& mask, vector<Vec2i>& extents) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::getRowExtents");
+		extents.assign(mask.rows, Vec2i(-1, -1));
+		if(mask.empty() || !checkMask(mask, "ofxCv::getRowExtents")) {
+			return;
+		}
+		
+		const int cols = mask.cols, depth = mask.depth();
+		const size_t elementSize = mask.elemSize();
+		parallelFor(Range(0, mask.rows), [&](const Range & range) {
+			for(int y = range.start; y < range.end; y++) {
+				const uchar* row = mask.ptr(y);
+				int first = scan(row, depth, cols, SCAN_NOT_EQUAL, 0, true);
+				if(first >= 0) {
+					// the last can't be before the first, so only scan what's left
+					int last = scan(row + first * elementSize, depth, cols - first, SCAN_NOT_EQUAL, 0, false);
+					extents[y] = Vec2i(first, first + last);
+				}
+			}
+		});
+	}
+	
+	float weightedAverageAngle(const vector<Vec4i>& lines) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::weightedAverageAngle");
+		// lines have no direction, so average on the circle of 2x the angle.
+		// averaging the raw angles breaks for lines either side of +/-pi.
+		float sumX = 0, sumY = 0;
+		glm::vec2 start, end;
+		for(int i = 0; i < lines.size(); i++) {
+			start = { lines[i][0], lines[i][1] };
+			end = { lines[i][2], lines[i][3] };
+			auto diff = end - start;
+			float length = glm::length(diff);
+			float weight = length * length;
+			float angle = atan2f(diff.y, diff.x);
+			sumX += cosf(2 * angle) * weight;
+			sumY += sinf(2 * angle) * weight;
+		}
+		return atan2f(sumY, sumX) / 2;
+	}
+	
+	// Visvalingam & Whyatt, "Line generalisation by repeated elimination of points" (1993)
+	// vertices are removed smallest triangle first. the heap holds stale entries
+	// for vertices whose neighbours have changed, which are skipped when popped.
+	vector<cv::Point2f> getConvexPolygon(const vector<cv::Point2f>& convexHull, int targetPoints) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::getConvexPolygon");
+		const int n = convexHull.size();
+		targetPoints = max(targetPoints, 3);
+		if(n <= targetPoints) {
+			return convexHull;
+		}
+		
+		vector<int> previous(n), next(n), version(n, 0);
+		for(int i = 0; i < n; i++) {
+			previous[i] = (i + n - 1) % n;
+			next[i] = (i + 1) % n;
+		}
+		auto area = [&](int i) {
+			const Point2f& a = convexHull[previous[i]];
+			const Point2f& b = convexHull[i];
+			const Point2f& c = convexHull[next[i]];
+			return abs((b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y));
+		};
+		
+		struct Entry {
+			float area;
+			int index;
+			int version;
+			bool operator<(const Entry& other) const {
+				// smallest area on top, ties broken by index so the result is deterministic
+				return area != other.area ? area > other.area : index > other.index;
+			}
+		};
+		vector<Entry> entries(n);
+		for(int i = 0; i < n; i++) {
+			entries[i] = {area(i), i, 0};
+		}
+		priority_queue<Entry> heap(less<Entry>(), std::move(entries));
+		
+		vector<bool> removed(n, false);
+		int remaining = n;
+		while(remaining > targetPoints && !heap.empty()) {
+			Entry entry = heap.top();
+			heap.pop();
+			if(removed[entry.index] || entry.version != version[entry.index]) {
+				continue;
+			}
+			removed[entry.index] = true;
+			remaining--;
+			
+			int before = previous[entry.index], after = next[entry.index];
+			next[before] = after;
+			previous[after] = before;
+			heap.push({area(before), before, ++version[before]});
+			heap.push({area(after), after, ++version[after]});
+		}
+		
+		vector<cv::Point2f> result;
+		result.reserve(remaining);
+		for(int i = 0; i < n; i++) {
+			if(!removed[i]) {
+				result.push_back(convexHull[i]);
+			}
+		}
+		return result;
+	}
+	
+	void getConvexPolygons(const vector<vector<cv::Point2f>>& convexHulls, vector<vector<cv::Point2f>>& polygons, int targetPoints) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::getConvexPolygons");
+		polygons.resize(convexHulls.size());
+		parallelFor(Range(0, convexHulls.size()), [&](const Range& range) {
+			for(int i = range.start; i < range.end; i++) {
+				polygons[i] = getConvexPolygon(convexHulls[i], targetPoints);
+			}
+		});
+	}
+	
+	vector<vector<cv::Point2f>> getConvexPolygons(const vector<vector<cv::Point2f>>& convexHulls, int targetPoints) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::getConvexPolygons");
+		vector<vector<cv::Point2f>> polygons;
+		getConvexPolygons(convexHulls, polygons, targetPoints);
+		return polygons;
+	}
+}
\ No newline at end of file
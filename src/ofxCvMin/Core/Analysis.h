@@ -0,0 +1,110 @@
+/*
+ image and point analysis which only needs OpenCV and glm: peaks, row/column
+ profiles, scanning for values, mask extents, line angles and intersections,
+ and convex polygons.
+
+ the template versions which take ofPixels or ofImage are in Helpers.h.
+ */
+
+#pragma once
+
+#include "Platform.h"
+#include "opencv2/opencv.hpp"
+#include <glm/glm.hpp>
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	enum PeakRefinement {
+		PEAK_REFINE_NONE,
+		PEAK_REFINE_QUADRATIC, // fit a parabola through the peak and its neighbours on each axis
+		PEAK_REFINE_CENTROID // weighted centre of the neighbourhood above the threshold
+	};
+	
+	struct Peak {
+		glm::vec2 position;
+		float value;
+		float strength; // value minus the lowest value in its neighbourhood
+	};
+	
+	// every local maximum above threshold in a single channel CV_8U, CV_16U or CV_32F image,
+	// strongest first. a local maximum is the largest value within radius pixels (ties go to
+	// the first in row order). maxPeaks = 0 returns all of them.
+	void findPeaks(const Mat& mat, vector<Peak>& peaks, float threshold, int radius = 2, PeakRefinement refinement = PEAK_REFINE_QUADRATIC, int maxPeaks = 0);
+	
+	// per-row and per-column statistics of an image, all gathered in one pass.
+	// each profile is a column vector (rows x 1 or cols x 1) of the accumulator depth,
+	// all zeros when the image is empty.
+	struct Profiles {
+		Mat rowSum, rowMean, rowMin, rowMax;
+		Mat colSum, colMean, colMin, colMax;
+	};
+	
+	// accumulatorDepth is CV_32F or CV_64F. use CV_64F for sums over large 16/32-bit images.
+	void reduceProfiles(const Mat & mat, Profiles & profiles, int accumulatorDepth = CV_32F);
+	
+	// predicates for the scanning functions below
+	enum ScanPredicate {
+		SCAN_EQUAL,
+		SCAN_NOT_EQUAL,
+		SCAN_GREATER,
+		SCAN_LESS_EQUAL
+	};
+	
+	// first/last element of a single channel CV_8U, CV_16U or CV_32F array (scanned in
+	// memory order) matching the predicate against value, or -1 if there is none.
+	// these stop as soon as they find a match.
+	int findFirst(const Mat& arr, ScanPredicate predicate, double value);
+	int findLast(const Mat& arr, ScanPredicate predicate, double value);
+	
+	// index of target, or 0 if it isn't found
+	int findFirst(const Mat& arr, unsigned char target);
+	int findLast(const Mat& arr, unsigned char target);
+	
+	// bounding rectangle of the non-zero pixels of a CV_8U, CV_16U or CV_32F mask.
+	// returns false if the mask is empty.
+	bool getNonZeroExtents(const Mat& mask, cv::Rect& extents);
+	
+	// (first, last) non-zero column of each row, or (-1, -1) for empty rows
+	void getRowExtents(const Mat& mask, vector<Vec2i>& extents);
+	
+	// first/last index of a profile (e.g. Profiles::rowMean) above the threshold, or below it if invert
+	void getProfileExtent(const Mat & profile, float thresh, bool invert, int & first, int & last);
+	
+	// given a vector of lines, this function will find the average angle (-pi/2 to pi/2)
+	float weightedAverageAngle(const vector<Vec4i>& lines);
+	
+	// (nearest point) to the two given lines
+	// for lots of lines at once, see intersectRays()
+	template <class T>
+	Point3_<T> intersectLineLine(Point3_<T> lineStart1, Point3_<T> lineEnd1, Point3_<T> lineStart2, Point3_<T> lineEnd2) {
+		Point3_<T> v1(lineEnd1 - lineStart1), v2(lineEnd2 - lineStart2), w(lineStart1 - lineStart2);
+		T a = v1.dot(v1), b = v1.dot(v2), c = v2.dot(v2), d = v1.dot(w), e = v2.dot(w);
+		T denominator = a * c - b * b;
+		T lambda1 = (b * e - c * d) / denominator, lambda2 = (a * e - b * d) / denominator;
+		return (1./2) * ((lineStart1 + v1 * lambda1) + (lineStart2 + v2 * lambda2));
+	}
+	
+	// (nearest point on a line) to the given point
+	template <class T>
+	Point3_<T> intersectPointLine(Point3_<T> point, Point3_<T> lineStart, Point3_<T> lineEnd) {
+		Point3_<T> ray = lineEnd - lineStart;
+		T u = (point - lineStart).dot(ray) / ray.dot(ray);
+		return lineStart + u * ray;
+	}
+	
+	// (nearest point on a ray) to the given point
+	template <class T>
+	Point3_<T> intersectPointRay(Point3_<T> point, Point3_<T> ray) {
+		return ray * (point.dot(ray) / ray.dot(ray));
+	}
+	
+	// simplifies a convex hull to exactly targetPoints vertices (at least 3) by repeatedly
+	// removing the vertex which changes the area the least
+	vector<cv::Point2f> getConvexPolygon(const vector<cv::Point2f>& convexHull, int targetPoints);
+	
+	// many hulls at once, in parallel (e.g. one per blob)
+	void getConvexPolygons(const vector<vector<cv::Point2f>>& convexHulls, vector<vector<cv::Point2f>>& polygons, int targetPoints);
+	vector<vector<cv::Point2f>> getConvexPolygons(const vector<vector<cv::Point2f>>& convexHulls, int targetPoints);
+}
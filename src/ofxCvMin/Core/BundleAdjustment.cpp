@@ -0,0 +1,531 @@
+#include "BundleAdjustment.h"
+#include "Instrumentation.h"
+#include "ThreadingConfig.h"
+
+#include <map>
+#include <utility>
+
+using namespace std;
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	//----------
+	int BundleAdjustment::addDevice(const Device & device) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::BundleAdjustment::addDevice");
+		this->devices.push_back(device);
+		return (int) this->devices.size() - 1;
+	}
+
+	//----------
+	int BundleAdjustment::addBoardPose() {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::BundleAdjustment::addBoardPose");
+		return this->addBoardPose(BoardPose());
+	}
+
+	//----------
+	int BundleAdjustment::addBoardPose(const BoardPose & boardPose) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::BundleAdjustment::addBoardPose");
+		this->boardPoses.push_back(boardPose);
+		return (int) this->boardPoses.size() - 1;
+	}
+
+	//----------
+	void BundleAdjustment::addView(const View & view) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::BundleAdjustment::addView");
+		if (view.objectPoints.size() != view.imagePoints.size()) {
+			LogError("ofxCv::BundleAdjustment") << "View has " << view.objectPoints.size() << " object points but " << view.imagePoints.size() << " image points";
+			return;
+		}
+		this->views.push_back(view);
+	}
+
+	//----------
+	void BundleAdjustment::addView(int deviceIndex, int boardPoseIndex, const vector<Point3f> & objectPoints, const vector<Point2f> & imagePoints) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::BundleAdjustment::addView");
+		View view;
+		view.deviceIndex = deviceIndex;
+		view.boardPoseIndex = boardPoseIndex;
+		view.objectPoints = objectPoints;
+		view.imagePoints = imagePoints;
+		this->addView(view);
+	}
+
+	//----------
+	void BundleAdjustment::clear() {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::BundleAdjustment::clear");
+		this->devices.clear();
+		this->boardPoses.clear();
+		this->views.clear();
+	}
+
+	//----------
+	const vector<BundleAdjustment::Device> & BundleAdjustment::getDevices() const {
+		return this->devices;
+	}
+
+	//----------
+	const vector<BundleAdjustment::BoardPose> & BundleAdjustment::getBoardPoses() const {
+		return this->boardPoses;
+	}
+
+	//----------
+	const vector<BundleAdjustment::View> & BundleAdjustment::getViews() const {
+		return this->views;
+	}
+
+	//----------
+	BundleAdjustment::Result BundleAdjustment::solve() {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::BundleAdjustment::solve");
+		return this->solve(Settings());
+	}
+
+	//----------
+	BundleAdjustment::Result BundleAdjustment::solve(const Settings & settings) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::BundleAdjustment::solve");
+		ThreadingConfig::ScopedLane lane(Lane::Background);
+		Result result;
+
+		for (const auto & view : this->views) {
+			if (view.deviceIndex < 0 || view.deviceIndex >= (int) this->devices.size()
+				|| view.boardPoseIndex < 0 || view.boardPoseIndex >= (int) this->boardPoses.size()) {
+				LogError("ofxCv::BundleAdjustment") << "View references a device or board pose which doesn't exist";
+				return result;
+			}
+		}
+
+		this->initialiseBoardPoses();
+		this->packParameters();
+
+		// parameters which are fixed have their jacobian columns zeroed
+		this->deviceMasks.assign(this->devices.size(), Vec<uchar, DeviceParameterCount>::all(1));
+		for (size_t i = 0; i < this->devices.size(); i++) {
+			auto & device = this->devices[i];
+			auto & mask = this->deviceMasks[i];
+			if (device.fixExtrinsics || (i == 0 && settings.fixFirstDeviceExtrinsics)) {
+				for (int j = 0; j < 6; j++) {
+					mask[j] = 0;
+				}
+			}
+			if (device.fixIntrinsics) {
+				for (int j = 6; j < 10; j++) {
+					mask[j] = 0;
+				}
+			}
+			if (device.fixDistortion || device.fixIntrinsics) {
+				for (int j = 10; j < DeviceParameterCount; j++) {
+					mask[j] = 0;
+				}
+			}
+		}
+
+		const int deviceCount = (int) this->devices.size();
+		const int poseCount = (int) this->boardPoses.size();
+		const int reducedSize = deviceCount * DeviceParameterCount;
+
+		// which devices observe each pose, for the sparse Schur complement
+		vector<vector<int>> posesDevices(poseCount);
+		for (const auto & view : this->views) {
+			auto & poseDevices = posesDevices[view.boardPoseIndex];
+			if (find(poseDevices.begin(), poseDevices.end(), view.deviceIndex) == poseDevices.end()) {
+				poseDevices.push_back(view.deviceIndex);
+			}
+		}
+
+		auto toRms = [this](double squaredError) {
+			return this->observationCount > 0 ? sqrt(squaredError / (double) this->observationCount) : 0.0;
+		};
+
+		vector<ViewNormals> viewNormals(this->views.size());
+		double squaredError = this->evaluate(this->deviceParameters, this->poseParameters, &viewNormals);
+		result.initialRmsError = toRms(squaredError);
+
+		double lambda = settings.initialLambda;
+		bool normalsValid = true;
+
+		typedef Matx<double, DeviceParameterCount, DeviceParameterCount> DeviceBlock;
+		typedef Matx<double, DeviceParameterCount, PoseParameterCount> CrossBlock;
+		typedef Matx<double, PoseParameterCount, PoseParameterCount> PoseBlock;
+
+		vector<DeviceBlock> U(deviceCount);
+		vector<PoseBlock> V(poseCount);
+		map<pair<int, int>, CrossBlock> W;
+		vector<Vec<double, DeviceParameterCount>> deviceGradients(deviceCount);
+		vector<Vec<double, PoseParameterCount>> poseGradients(poseCount);
+
+		for (int iteration = 0; iteration < settings.maxIterations; iteration++) {
+			// accumulate the per-view normal equations into the block structure
+			if (normalsValid) {
+				fill(U.begin(), U.end(), DeviceBlock::zeros());
+				fill(V.begin(), V.end(), PoseBlock::zeros());
+				W.clear();
+				fill(deviceGradients.begin(), deviceGradients.end(), Vec<double, DeviceParameterCount>::all(0));
+				fill(poseGradients.begin(), poseGradients.end(), Vec<double, PoseParameterCount>::all(0));
+
+				for (size_t i = 0; i < this->views.size(); i++) {
+					const auto & view = this->views[i];
+					const auto & normals = viewNormals[i];
+					U[view.deviceIndex] += normals.U;
+					V[view.boardPoseIndex] += normals.V;
+					W[make_pair(view.deviceIndex, view.boardPoseIndex)] += normals.W;
+					deviceGradients[view.deviceIndex] += normals.deviceGradient;
+					poseGradients[view.boardPoseIndex] += normals.poseGradient;
+				}
+				normalsValid = false;
+			}
+
+			// damp the pose blocks and invert them
+			vector<PoseBlock> VInverse(poseCount);
+			for (int p = 0; p < poseCount; p++) {
+				auto damped = V[p];
+				for (int j = 0; j < PoseParameterCount; j++) {
+					damped(j, j) = damped(j, j) == 0.0 ? 1.0 : damped(j, j) * (1.0 + lambda);
+				}
+				bool inverted = false;
+				VInverse[p] = damped.inv(DECOMP_CHOLESKY, &inverted);
+				if (!inverted) {
+					VInverse[p] = damped.inv(DECOMP_SVD);
+				}
+			}
+
+			// reduced camera system S * deltaDevices = rhs
+			Mat S(reducedSize, reducedSize, CV_64F, Scalar(0));
+			Mat rhs(reducedSize, 1, CV_64F, Scalar(0));
+			for (int d = 0; d < deviceCount; d++) {
+				auto damped = U[d];
+				for (int j = 0; j < DeviceParameterCount; j++) {
+					damped(j, j) = damped(j, j) == 0.0 ? 1.0 : damped(j, j) * (1.0 + lambda);
+				}
+				Mat(damped).copyTo(S(cv::Rect(d * DeviceParameterCount, d * DeviceParameterCount, DeviceParameterCount, DeviceParameterCount)));
+				Mat(deviceGradients[d]).copyTo(rhs.rowRange(d * DeviceParameterCount, (d + 1) * DeviceParameterCount));
+			}
+			for (int p = 0; p < poseCount; p++) {
+				const auto & poseDevices = posesDevices[p];
+				for (auto i : poseDevices) {
+					const auto WVInverse = W[make_pair(i, p)] * VInverse[p];
+					Mat rhsBlock = rhs.rowRange(i * DeviceParameterCount, (i + 1) * DeviceParameterCount);
+					rhsBlock -= Mat(WVInverse * poseGradients[p]);
+					for (auto j : poseDevices) {
+						Mat SBlock = S(cv::Rect(j * DeviceParameterCount, i * DeviceParameterCount, DeviceParameterCount, DeviceParameterCount));
+						SBlock -= Mat(WVInverse * W[make_pair(j, p)].t());
+					}
+				}
+			}
+
+			Mat deltaDevices;
+			if (!cv::solve(S, rhs, deltaDevices, DECOMP_CHOLESKY)) {
+				cv::solve(S, rhs, deltaDevices, DECOMP_SVD);
+			}
+
+			// back-substitute for the poses
+			auto trialDeviceParameters = this->deviceParameters;
+			auto trialPoseParameters = this->poseParameters;
+			double stepNormSquared = 0.0;
+			for (int d = 0; d < deviceCount; d++) {
+				for (int j = 0; j < DeviceParameterCount; j++) {
+					auto delta = deltaDevices.at<double>(d * DeviceParameterCount + j);
+					trialDeviceParameters[d][j] += delta;
+					stepNormSquared += delta * delta;
+				}
+			}
+			for (int p = 0; p < poseCount; p++) {
+				auto poseRhs = poseGradients[p];
+				for (auto d : posesDevices[p]) {
+					Vec<double, DeviceParameterCount> deltaDevice(deltaDevices.ptr<double>(d * DeviceParameterCount));
+					poseRhs -= W[make_pair(d, p)].t() * deltaDevice;
+				}
+				auto deltaPose = VInverse[p] * poseRhs;
+				trialPoseParameters[p] += deltaPose;
+				stepNormSquared += deltaPose.dot(deltaPose);
+			}
+
+			// try the step
+			vector<ViewNormals> trialNormals(this->views.size());
+			auto trialSquaredError = this->evaluate(trialDeviceParameters, trialPoseParameters, &trialNormals);
+
+			IterationReport report;
+			report.iteration = iteration;
+			report.lambda = lambda;
+			report.stepNorm = sqrt(stepNormSquared);
+			report.stepAccepted = trialSquaredError < squaredError;
+
+			// converged = the error or the step stopped changing. stalled = no step reduces the error
+			bool converged = false, stalled = false;
+			if (report.stepAccepted) {
+				auto relativeChange = (squaredError - trialSquaredError) / max(squaredError, DBL_MIN);
+				this->deviceParameters = trialDeviceParameters;
+				this->poseParameters = trialPoseParameters;
+				viewNormals.swap(trialNormals);
+				squaredError = trialSquaredError;
+				normalsValid = true;
+				lambda = max(lambda / 10.0, 1e-12);
+				converged = relativeChange < settings.minRelativeErrorChange;
+			}
+			else {
+				lambda *= 10.0;
+				stalled = lambda > 1e12;
+			}
+			converged |= report.stepNorm < settings.minStepNorm;
+
+			report.rmsError = toRms(squaredError);
+			result.iterations.push_back(report);
+			if (settings.logIterations) {
+				LogNotice("ofxCv::BundleAdjustment") << "Iteration " << iteration << " : rms error " << report.rmsError << "px, lambda " << report.lambda << ", step " << report.stepNorm << (report.stepAccepted ? "" : " (rejected)");
+			}
+			if (settings.onIteration) {
+				settings.onIteration(report);
+			}
+
+			if (converged) {
+				result.converged = true;
+				break;
+			}
+			if (stalled) {
+				LogWarning("ofxCv::BundleAdjustment") << "Stopped at iteration " << iteration << " : no step reduces the error";
+				break;
+			}
+		}
+
+		this->unpackParameters();
+		result.finalRmsError = toRms(squaredError);
+		return result;
+	}
+
+	//----------
+	vector<float> BundleAdjustment::getViewErrors() const {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::BundleAdjustment::getViewErrors");
+		vector<float> errors;
+		for (const auto & view : this->views) {
+			const auto & device = this->devices[view.deviceIndex];
+			const auto & boardPose = this->boardPoses[view.boardPoseIndex];
+			if (boardPose.rotation.empty() || view.objectPoints.empty()) {
+				errors.push_back(0.0f);
+				continue;
+			}
+			Mat rotation, translation;
+			composeRT(boardPose.rotation, boardPose.translation, device.rotation, device.translation, rotation, translation);
+			vector<Point2f> projected;
+			projectPoints(view.objectPoints, rotation, translation, device.cameraMatrix, device.distortionCoefficients, projected);
+			double squaredError = 0.0;
+			for (size_t i = 0; i < projected.size(); i++) {
+				auto difference = projected[i] - view.imagePoints[i];
+				squaredError += difference.dot(difference);
+			}
+			errors.push_back(sqrt(squaredError / (double) projected.size()));
+		}
+		return errors;
+	}
+
+	//----------
+	void BundleAdjustment::initialiseBoardPoses() {
+		for (size_t p = 0; p < this->boardPoses.size(); p++) {
+			auto & boardPose = this->boardPoses[p];
+			if (!boardPose.rotation.empty() && !boardPose.translation.empty()) {
+				continue;
+			}
+
+			for (const auto & view : this->views) {
+				if (view.boardPoseIndex != (int) p || view.objectPoints.size() < 4) {
+					continue;
+				}
+				const auto & device = this->devices[view.deviceIndex];
+
+				// board -> device
+				Mat rotationBoardDevice, translationBoardDevice;
+				if (!solvePnP(view.objectPoints, view.imagePoints, device.cameraMatrix, device.distortionCoefficients, rotationBoardDevice, translationBoardDevice)) {
+					continue;
+				}
+
+				// device -> world is the inverse of the device extrinsics
+				Mat deviceRotation, deviceTranslation, deviceRotation3x3;
+				device.rotation.convertTo(deviceRotation, CV_64F);
+				device.translation.convertTo(deviceTranslation, CV_64F);
+				Rodrigues(deviceRotation, deviceRotation3x3);
+				Mat rotationDeviceWorld = -deviceRotation;
+				Mat translationDeviceWorld = -deviceRotation3x3.t() * deviceTranslation;
+
+				composeRT(rotationBoardDevice, translationBoardDevice, rotationDeviceWorld, translationDeviceWorld, boardPose.rotation, boardPose.translation);
+				break;
+			}
+
+			if (boardPose.rotation.empty()) {
+				LogWarning("ofxCv::BundleAdjustment") << "Couldn't initialise board pose [" << p << "], it will start at the world origin";
+				boardPose.rotation = Mat::zeros(3, 1, CV_64F);
+				boardPose.translation = Mat::zeros(3, 1, CV_64F);
+			}
+		}
+	}
+
+	//----------
+	void BundleAdjustment::packParameters() {
+		this->deviceParameters.resize(this->devices.size());
+		for (size_t i = 0; i < this->devices.size(); i++) {
+			const auto & device = this->devices[i];
+			auto & parameters = this->deviceParameters[i];
+			parameters = DeviceParameters::all(0);
+
+			Mat rotation, translation, cameraMatrix, distortion;
+			device.rotation.convertTo(rotation, CV_64F);
+			device.translation.convertTo(translation, CV_64F);
+			device.cameraMatrix.convertTo(cameraMatrix, CV_64F);
+			device.distortionCoefficients.convertTo(distortion, CV_64F);
+
+			for (int j = 0; j < 3; j++) {
+				parameters[j] = rotation.at<double>(j);
+				parameters[3 + j] = translation.at<double>(j);
+			}
+			parameters[6] = cameraMatrix.at<double>(0, 0);
+			parameters[7] = cameraMatrix.at<double>(1, 1);
+			parameters[8] = cameraMatrix.at<double>(0, 2);
+			parameters[9] = cameraMatrix.at<double>(1, 2);
+			for (int j = 0; j < min((int) distortion.total(), 5); j++) {
+				parameters[10 + j] = distortion.at<double>(j);
+			}
+		}
+
+		this->poseParameters.resize(this->boardPoses.size());
+		for (size_t i = 0; i < this->boardPoses.size(); i++) {
+			Mat rotation, translation;
+			this->boardPoses[i].rotation.convertTo(rotation, CV_64F);
+			this->boardPoses[i].translation.convertTo(translation, CV_64F);
+			for (int j = 0; j < 3; j++) {
+				this->poseParameters[i][j] = rotation.at<double>(j);
+				this->poseParameters[i][3 + j] = translation.at<double>(j);
+			}
+		}
+
+		this->observationCount = 0;
+		for (const auto & view : this->views) {
+			this->observationCount += view.objectPoints.size();
+		}
+	}
+
+	//----------
+	void BundleAdjustment::unpackParameters() {
+		for (size_t i = 0; i < this->devices.size(); i++) {
+			auto & device = this->devices[i];
+			const auto & parameters = this->deviceParameters[i];
+			device.rotation = (Mat_<double>(3, 1) << parameters[0], parameters[1], parameters[2]);
+			device.translation = (Mat_<double>(3, 1) << parameters[3], parameters[4], parameters[5]);
+			device.cameraMatrix = (Mat_<double>(3, 3) << parameters[6], 0, parameters[8], 0, parameters[7], parameters[9], 0, 0, 1);
+			device.distortionCoefficients = (Mat_<double>(5, 1) << parameters[10], parameters[11], parameters[12], parameters[13], parameters[14]);
+		}
+		for (size_t i = 0; i < this->boardPoses.size(); i++) {
+			auto & boardPose = this->boardPoses[i];
+			const auto & parameters = this->poseParameters[i];
+			boardPose.rotation = (Mat_<double>(3, 1) << parameters[0], parameters[1], parameters[2]);
+			boardPose.translation = (Mat_<double>(3, 1) << parameters[3], parameters[4], parameters[5]);
+		}
+	}
+
+	//----------
+	double BundleAdjustment::evaluate(const vector<DeviceParameters> & deviceParameters, const vector<PoseParameters> & poseParameters, vector<ViewNormals> * normals) const {
+		vector<double> viewErrors(this->views.size(), 0.0);
+
+		// each view writes only to its own slot, the reduction happens afterwards on the calling thread
+		parallelFor(Range(0, (int) this->views.size()), [&](const Range & range) {
+			for (int i = range.start; i < range.end; i++) {
+				const auto & view = this->views[i];
+				viewErrors[i] = this->evaluateView(view
+					, deviceParameters[view.deviceIndex]
+					, poseParameters[view.boardPoseIndex]
+					, normals ? &(*normals)[i] : nullptr);
+			}
+		});
+
+		double squaredError = 0.0;
+		for (auto viewError : viewErrors) {
+			squaredError += viewError;
+		}
+		return squaredError;
+	}
+
+	//----------
+	double BundleAdjustment::evaluateView(const View & view, const DeviceParameters & deviceParameters, const PoseParameters & poseParameters, ViewNormals * normals) const {
+		const auto pointCount = (int) view.objectPoints.size();
+		if (pointCount == 0) {
+			if (normals) {
+				*normals = ViewNormals();
+				normals->squaredError = 0.0;
+			}
+			return 0.0;
+		}
+
+		Matx31d rotationBoard(poseParameters[0], poseParameters[1], poseParameters[2]);
+		Matx31d translationBoard(poseParameters[3], poseParameters[4], poseParameters[5]);
+		Matx31d rotationDevice(deviceParameters[0], deviceParameters[1], deviceParameters[2]);
+		Matx31d translationDevice(deviceParameters[3], deviceParameters[4], deviceParameters[5]);
+		Matx33d cameraMatrix(deviceParameters[6], 0, deviceParameters[8]
+			, 0, deviceParameters[7], deviceParameters[9]
+			, 0, 0, 1);
+		Matx<double, 5, 1> distortion(deviceParameters[10], deviceParameters[11], deviceParameters[12], deviceParameters[13], deviceParameters[14]);
+
+		// board -> device
+		Mat rotation, translation;
+		Mat dr3dr1, dr3dt1, dr3dr2, dr3dt2, dt3dr1, dt3dt1, dt3dr2, dt3dt2;
+		composeRT(rotationBoard, translationBoard, rotationDevice, translationDevice
+			, rotation, translation
+			, dr3dr1, dr3dt1, dr3dr2, dr3dt2, dt3dr1, dt3dt1, dt3dr2, dt3dt2);
+
+		vector<Point2f> projected;
+		Mat jacobian;
+		if (normals) {
+			// columns are rvec(3), tvec(3), focal(2), principal point(2), distortion(5)
+			projectPoints(view.objectPoints, rotation, translation, cameraMatrix, distortion, projected, jacobian);
+		}
+		else {
+			projectPoints(view.objectPoints, rotation, translation, cameraMatrix, distortion, projected);
+		}
+
+		Mat residuals(pointCount * 2, 1, CV_64F);
+		double squaredError = 0.0;
+		for (int i = 0; i < pointCount; i++) {
+			auto difference = projected[i] - view.imagePoints[i];
+			residuals.at<double>(i * 2 + 0) = difference.x;
+			residuals.at<double>(i * 2 + 1) = difference.y;
+			squaredError += difference.dot(difference);
+		}
+
+		if (normals) {
+			Mat jacobianRotation = jacobian.colRange(0, 3);
+			Mat jacobianTranslation = jacobian.colRange(3, 6);
+
+			// chain rule through composeRT
+			Mat jacobianDevice(pointCount * 2, DeviceParameterCount, CV_64F);
+			Mat(jacobianRotation * dr3dr2 + jacobianTranslation * dt3dr2).copyTo(jacobianDevice.colRange(0, 3));
+			Mat(jacobianTranslation * dt3dt2).copyTo(jacobianDevice.colRange(3, 6));
+			jacobian.colRange(6, 15).copyTo(jacobianDevice.colRange(6, 15));
+
+			Mat jacobianPose(pointCount * 2, PoseParameterCount, CV_64F);
+			Mat(jacobianRotation * dr3dr1 + jacobianTranslation * dt3dr1).copyTo(jacobianPose.colRange(0, 3));
+			Mat(jacobianTranslation * dt3dt1).copyTo(jacobianPose.colRange(3, 6));
+
+			const auto & deviceMask = this->deviceMasks[view.deviceIndex];
+			for (int j = 0; j < DeviceParameterCount; j++) {
+				if (!deviceMask[j]) {
+					jacobianDevice.col(j).setTo(0);
+				}
+			}
+			if (this->boardPoses[view.boardPoseIndex].fixed) {
+				jacobianPose.setTo(0);
+			}
+
+			Mat U, V, W, deviceGradient, poseGradient;
+			gemm(jacobianDevice, jacobianDevice, 1.0, noArray(), 0.0, U, GEMM_1_T);
+			gemm(jacobianPose, jacobianPose, 1.0, noArray(), 0.0, V, GEMM_1_T);
+			gemm(jacobianDevice, jacobianPose, 1.0, noArray(), 0.0, W, GEMM_1_T);
+			gemm(jacobianDevice, residuals, -1.0, noArray(), 0.0, deviceGradient, GEMM_1_T);
+			gemm(jacobianPose, residuals, -1.0, noArray(), 0.0, poseGradient, GEMM_1_T);
+
+			U.copyTo(normals->U);
+			V.copyTo(normals->V);
+			W.copyTo(normals->W);
+			deviceGradient.copyTo(normals->deviceGradient);
+			poseGradient.copyTo(normals->poseGradient);
+			normals->squaredError = squaredError;
+		}
+
+		return squaredError;
+	}
+}
@@ -0,0 +1,127 @@
+/*
+ bundle adjustment jointly refines the intrinsics and extrinsics of several
+ devices (cameras and projectors) together with the poses of the boards they
+ observed, starting from the independent calibrations produced by e.g.
+ calibrateProjector or calibrateCameraWorldRemoveOutliers.
+
+ the solver is Levenberg-Marquardt on the sparse normal equations. board poses
+ are eliminated with the Schur complement, leaving a small dense system over the
+ device parameters, so each iteration is linear in the number of observations.
+ */
+
+#pragma once
+
+#include "Platform.h"
+#include "opencv2/opencv.hpp"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	class BundleAdjustment {
+	public:
+		// a camera or projector. rotation/translation map world -> device (as calibrateCamera)
+		struct Device {
+			cv::Size imageSize;
+			cv::Mat cameraMatrix;
+			cv::Mat distortionCoefficients; // k1, k2, p1, p2, k3 (shorter is padded with zeros)
+			cv::Mat rotation;
+			cv::Mat translation;
+
+			bool fixIntrinsics = false;
+			bool fixDistortion = false;
+			bool fixExtrinsics = false;
+		};
+
+		// rotation/translation map board -> world. leave empty to initialise with solvePnP
+		struct BoardPose {
+			cv::Mat rotation;
+			cv::Mat translation;
+			bool fixed = false;
+		};
+
+		// one device seeing one board pose
+		struct View {
+			int deviceIndex;
+			int boardPoseIndex;
+			vector<Point3f> objectPoints;
+			vector<Point2f> imagePoints;
+		};
+
+		struct IterationReport {
+			int iteration;
+			double rmsError;
+			double lambda;
+			double stepNorm;
+			bool stepAccepted;
+		};
+
+		struct Settings {
+			int maxIterations = 100;
+			double initialLambda = 1e-3;
+			double minRelativeErrorChange = 1e-9;
+			double minStepNorm = 1e-12;
+
+			// the world frame is defined by the first device unless you fix something else
+			bool fixFirstDeviceExtrinsics = true;
+
+			bool logIterations = false;
+			std::function<void(const IterationReport &)> onIteration;
+		};
+
+		struct Result {
+			double initialRmsError = 0.0;
+			double finalRmsError = 0.0;
+			// false when it ran out of iterations, or stalled with no step reducing the error
+			bool converged = false;
+			vector<IterationReport> iterations;
+		};
+
+		int addDevice(const Device &);
+		int addBoardPose();
+		int addBoardPose(const BoardPose &);
+		void addView(const View &);
+		void addView(int deviceIndex, int boardPoseIndex, const vector<Point3f> & objectPoints, const vector<Point2f> & imagePoints);
+		void clear();
+
+		Result solve();
+		Result solve(const Settings &);
+
+		const vector<Device> & getDevices() const;
+		const vector<BoardPose> & getBoardPoses() const;
+		const vector<View> & getViews() const;
+
+		// per-view rms reprojection error with the current parameters
+		vector<float> getViewErrors() const;
+
+		static const int DeviceParameterCount = 15; // rvec, tvec, fx, fy, cx, cy, k1, k2, p1, p2, k3
+		static const int PoseParameterCount = 6; // rvec, tvec
+	protected:
+		typedef Vec<double, DeviceParameterCount> DeviceParameters;
+		typedef Vec<double, PoseParameterCount> PoseParameters;
+
+		struct ViewNormals {
+			Matx<double, DeviceParameterCount, DeviceParameterCount> U;
+			Matx<double, PoseParameterCount, PoseParameterCount> V;
+			Matx<double, DeviceParameterCount, PoseParameterCount> W;
+			Vec<double, DeviceParameterCount> deviceGradient;
+			Vec<double, PoseParameterCount> poseGradient;
+			double squaredError;
+		};
+
+		void initialiseBoardPoses();
+		void packParameters();
+		void unpackParameters();
+		double evaluate(const vector<DeviceParameters> &, const vector<PoseParameters> &, vector<ViewNormals> * normals) const;
+		double evaluateView(const View &, const DeviceParameters &, const PoseParameters &, ViewNormals * normals) const;
+
+		vector<Device> devices;
+		vector<BoardPose> boardPoses;
+		vector<View> views;
+
+		vector<DeviceParameters> deviceParameters;
+		vector<PoseParameters> poseParameters;
+		vector<Vec<uchar, DeviceParameterCount>> deviceMasks;
+		size_t observationCount = 0;
+	};
+}
@@ -0,0 +1,448 @@
+#include "Calibration.h"
+#include "Instrumentation.h"
+#include "ThreadingConfig.h"
+
+#include <algorithm>
+#include <set>
+
+using namespace std;
+
+namespace ofxCv {
+	
+	using namespace cv;
+	
+	//see notes at :
+	// https://paper.dropbox.com/doc/OpenCV-openFrameworks-transforms-v3dvp2ZIVufVZfSpqQain
+	glm::mat4 makeMatrix(Mat rotation, Mat translation) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::makeMatrix");
+		// accept float or double, row or column vectors
+		Matx31d tm;
+		translation.reshape(1, 3).convertTo(tm, CV_64F);
+		if(rotation.rows == 3 && rotation.cols == 3) {
+			Matx33d rm;
+			rotation.convertTo(rm, CV_64F);
+			return makeMatrix(rm, tm);
+		} else {
+			Matx31d rotationVector;
+			rotation.reshape(1, 3).convertTo(rotationVector, CV_64F);
+			return makeMatrix(rotationVector, tm);
+		}
+	}
+
+	void decomposeMatrix(const glm::mat4 & transform, Mat & rotationVector, Mat & translation) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::decomposeMatrix");
+		cv::Mat mat3x3(3, 3, CV_64F);
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				mat3x3.at<double>(i, j) = transform[j][i]; //transposed
+			}
+		}
+		cv::Rodrigues(mat3x3, rotationVector);
+
+		translation = cv::Mat(3, 1, CV_64F);
+		for (int i = 0; i < 3; i++) {
+			translation.at<double>(i) = transform[3][i];
+		}
+	}
+
+	//a reference : http://strawlab.org/2011/11/05/augmented-reality-with-OpenGL/#the_opengl_projection_matrix_from_hz_intrinsic_parameters
+	glm::mat4 makeProjectionMatrix(Mat cameraMatrix, cv::Size imageSize) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::makeProjectionMatrix");
+		float focalLengthX = cameraMatrix.at<double>(0, 0);
+		float focalLengthY = cameraMatrix.at<double>(1, 1);
+		float ppx = cameraMatrix.at<double>(0, 2);
+		float ppy = cameraMatrix.at<double>(1, 2);
+
+		// the same matrix as ofMatrix4x4 with postMultTranslate(lensOffset), built directly
+		glm::mat4 projection(1.0f);
+		projection[0][0] = 2.0f * focalLengthX / (float)imageSize.width;
+		projection[1][1] = -2.0f * focalLengthY / (float)imageSize.height;
+		projection[2] = glm::vec4(2 * (ppx / (float) imageSize.width) - 1.0f, 1.0f - 2 * (ppy / (float) imageSize.height), 1.0f, 1.0f);
+		projection[3][3] = 0.0f;
+
+		return projection;
+	}
+
+	vector<cv::Point3f> makeCheckerboardPoints(cv::Size size, float spacing, bool centered) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::makeCheckerboardPoints");
+		vector<glm::vec3> corners;
+
+		glm::vec3 offset;
+		if (centered) {
+			offset = -glm::vec3(size.width - 1, size.height - 1, 0) * spacing * 0.5f;
+		}
+		else {
+			offset = glm::vec3(spacing, spacing, 0.0f); // first inner corner is 1 square in
+		}
+
+		for (int j = 0; j < size.height; j++) {
+			for (int i = 0; i < size.width; i++) {
+				corners.push_back(glm::vec3(i, j, 0) * spacing + offset);
+			}
+		}
+		return toCv(corners);
+	}
+
+	vector<Point3f> makeAsymmetricCirclePoints(cv::Size size, float spacing, bool centered) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::makeAsymmetricCirclePoints");
+		vector<glm::vec3> points;
+
+		glm::vec3 center(0.0f);
+		if (centered) {
+			center = glm::vec3(size.width * 2.0f - 1.0f, size.height - 1.0f, 0) * spacing * 0.5f;
+		}
+
+		for (int j = 0; j<size.height; j++) {
+			for (int i = 0; i<size.width; i++) {
+				points.push_back(glm::vec3(
+					i * 2 + (j % 2),
+					j,
+					0
+					) * spacing - center);
+			}
+		}
+		return toCv(points);
+	}
+
+	vector<Point3f> makeBoardPoints(BoardType boardType, cv::Size size, float spacing, bool centered) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::makeBoardPoints");
+		switch (boardType) {
+		case BoardType::AsymmetricCircles:
+			return makeAsymmetricCirclePoints(size, spacing, centered);
+			break;
+		case BoardType::Checkerboard:
+			return makeCheckerboardPoints(size, spacing, centered);
+			break;
+		default:
+			return vector<Point3f>();
+		}
+	}
+
+	vector<Point2f> undistortImagePoints(const vector<Point2f> & distortedPixelCoordinates, cv::Mat cameraMatrix, cv::Mat distortionCoefficients) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::undistortImagePoints");
+		vector<Point2f> normalisedPoints;
+		cv::undistortPoints(distortedPixelCoordinates, normalisedPoints, cameraMatrix, distortionCoefficients);
+		auto fx = cameraMatrix.at<double>(0, 0);
+		auto fy = cameraMatrix.at<double>(1, 1);
+		auto cx = cameraMatrix.at<double>(0, 2);
+		auto cy = cameraMatrix.at<double>(1, 2);
+		
+		vector<Point2f> undistortedPixelCoordinates(distortedPixelCoordinates.size());
+		auto undistortedPixelCoordinatesIterator = undistortedPixelCoordinates.begin();
+		for (const auto & normalisedPoint : normalisedPoints) {
+			auto & undistorted = *undistortedPixelCoordinatesIterator++;
+			undistorted.x = normalisedPoint.x * fx + cx;
+			undistorted.y = normalisedPoint.y * fy + cy;
+		}
+
+		return undistortedPixelCoordinates;
+	}
+
+	float reprojectionError(const vector<cv::Point2f>& imagePoints
+		, const vector<cv::Point3f>& worldPoints
+		, const cv::Mat& rotationVector
+		, const cv::Mat& translation
+		, const cv::Mat& cameraMatrix
+		, const cv::Mat& distortionCoeffients)
+	{
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::reprojectionError");
+
+		// Reproject the world points into image space
+		vector<Point2f> reprojectedImageCoordinates;
+		cv::projectPoints(worldPoints
+			, rotationVector
+			, translation
+			, cameraMatrix
+			, distortionCoeffients
+			, reprojectedImageCoordinates);
+
+		// Take the sum of the errors
+		float reprojectionErrorSquaredSum = 0.0f;
+		for (int i = 0; i < reprojectedImageCoordinates.size(); i++) {
+			const auto difference = reprojectedImageCoordinates[i] - imagePoints[i];
+			reprojectionErrorSquaredSum += difference.dot(difference);
+		}
+		return sqrt(reprojectionErrorSquaredSum / (float)reprojectedImageCoordinates.size());
+	}
+
+	bool findChessboardCornersPreTest(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & corners, int testResolution) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findChessboardCornersPreTest");
+		if (image.rows > testResolution || image.cols > testResolution) {
+			cv::Mat lowRes;
+			cv::resize(image, lowRes, cv::Size(testResolution, testResolution));
+			vector<cv::Point2f> lowResPoints;
+			if (cv::findChessboardCorners(lowRes, patternSize, lowResPoints)) {
+				int maxX = 0;
+				int maxY = 0;
+				int minX = testResolution;
+				int minY = testResolution;
+
+				//find bounding box (roi) of found board
+				for (auto & lowResPoint : lowResPoints) {
+					if (lowResPoint.x < minX) {
+						minX = lowResPoint.x;
+					}
+					if (lowResPoint.y < minY) {
+						minY = lowResPoint.y;
+					}
+					if (lowResPoint.x > maxX) {
+						maxX = lowResPoint.x;
+					}
+					if (lowResPoint.y > maxY) {
+						maxY = lowResPoint.y;
+					}
+				}
+
+				//move these coords into original image space
+				maxX = maxX * image.cols / testResolution;
+				maxY = maxY * image.rows / testResolution;
+				minX = minX * image.cols / testResolution;
+				minY = minY * image.rows / testResolution;
+
+				//create a buffer around found points by 1 square size
+				int boardResolutionMin = MIN(patternSize.width, patternSize.height);
+				int strideX = (maxX - minX) / boardResolutionMin;
+				int strideY = (maxY - minY) / boardResolutionMin;
+
+				//apply buffer to bounds
+				minX -= strideX * 4;
+				maxX += strideX * 4;
+				minY -= strideY * 4;
+				maxY += strideY * 4;
+
+				//clamp new bounds
+				if (minX < 0)
+				{
+					minX = 0;
+				}
+				if (minY < 0)
+				{
+					minY = 0;
+				}
+				if (maxX > image.cols - 1)
+				{
+					maxX = image.cols - 1;
+				}
+				if (maxY > image.rows - 1)
+				{
+					maxY = image.rows - 1;
+				}
+
+				//copy roi into new matrix
+				auto roiRect = cv::Rect(minX, minY, maxX - minX, maxY - minY);
+				auto croppedFromLarge = image(roiRect);
+
+				//find in cropped image
+				vector<Point2f> croppedCorners;
+				bool foundInCropped = findChessboardCorners(croppedFromLarge, patternSize, croppedCorners);
+
+				if (foundInCropped) {
+					//'uncrop' corners
+					corners.clear();
+					for (auto & corner : croppedCorners) {
+						corners.push_back(corner + Point2f(minX, minY));
+					}
+
+					refineCheckerboardCorners(image, patternSize, corners);
+					return true;
+				}
+				else {
+					LogWarning("ofxCv::findChessboardCornersPreTest") << "Could find in low res, but not high res";
+					corners.clear();
+					for (auto & lowResCorner : lowResPoints) {
+						auto corner = lowResCorner;
+						corner.x *= (float)image.cols / (float)lowRes.cols;
+						corner.y *= (float)image.rows / (float)lowRes.rows;
+						corners.push_back(corner);
+					}
+
+					refineCheckerboardCorners(image, patternSize, corners);
+					return true;
+				}
+			}
+			else {
+				return false;
+			}
+		}
+		else {
+			return findChessboardCorners(image, patternSize, corners);
+		}
+	}
+
+	SimpleBlobDetector::Params getDefaultFindCircleBlobDetectorParams(Mat image, float minBlobWidthPct, float maxBlobWidthPct) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::getDefaultFindCircleBlobDetectorParams");
+		float minArea = pow(minBlobWidthPct * image.cols, 2);
+		float maxArea = pow(maxBlobWidthPct * image.cols, 2);
+
+		SimpleBlobDetector::Params params;
+		params.minArea = minArea;
+		params.maxArea = maxArea;
+
+		return params;
+	}
+
+	bool findAsymmetricCircles(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & results, Ptr<FeatureDetector> featureDetector, int blockSize) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findAsymmetricCircles");
+
+		if (!featureDetector) {
+			featureDetector = SimpleBlobDetector::create(getDefaultFindCircleBlobDetectorParams(image));
+		}
+
+		if (blockSize == 0) {
+			//blockSize = image.cols * 0.05f;
+
+			//hack for Light Barrier
+			blockSize = 100;
+		}
+		blockSize = (blockSize / 2) * 2 + 1;
+		if (blockSize <= 1) {
+			blockSize = 3;
+		}
+
+		Mat thresholded;
+		cv::adaptiveThreshold(image, thresholded, 255, ADAPTIVE_THRESH_GAUSSIAN_C, THRESH_BINARY, blockSize, 2);
+
+		return findCirclesGrid(thresholded, patternSize, results, CALIB_CB_ASYMMETRIC_GRID | CALIB_CB_CLUSTERING, featureDetector);
+	}
+
+	bool findBoard(cv::Mat image, BoardType boardType, cv::Size patternSize, vector<cv::Point2f> & results, bool useOptimisers) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findBoard");
+		switch (boardType) {
+		case BoardType::Checkerboard:
+			if (useOptimisers) {
+				return findChessboardCornersPreTest(image, patternSize, results);
+			} else {
+				return findChessboardCorners(image, patternSize, results);
+			}
+			break;
+		case BoardType::AsymmetricCircles:
+			return findAsymmetricCircles(image, patternSize, results);
+		default:
+			return false;
+		}
+	}
+
+	bool refineCheckerboardCorners(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & corners, int desiredHalfWindowSize /*= 5*/) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::refineCheckerboardCorners");
+		int windowSize = desiredHalfWindowSize;
+
+		//make sure search size isn't too large
+		{
+			auto boundsOfCornerFinds = cv::boundingRect(corners);
+			auto cornerFindsMinorAxis = MIN(boundsOfCornerFinds.width, boundsOfCornerFinds.height);
+			auto boardMajorAxis = MAX(patternSize.width, patternSize.height);
+			auto spacingBetweenCornersInImage = cornerFindsMinorAxis / (float)boardMajorAxis;
+
+			if (spacingBetweenCornersInImage / 4 < windowSize) {
+				windowSize = spacingBetweenCornersInImage / 4;
+				if (windowSize % 2 == 0) {
+					windowSize++;
+				}
+			}
+
+			if (windowSize < 3) {
+				//window size is too small to use
+				return false;
+			}
+		}
+
+		int ignoreCenterPixelsSize = windowSize / 5;
+
+		auto subPixResults = corners;
+		try {
+			cv::cornerSubPix(image
+				, subPixResults
+				, Size(windowSize, windowSize)
+				, Size(ignoreCenterPixelsSize, ignoreCenterPixelsSize)
+				, TermCriteria(TermCriteria::MAX_ITER + TermCriteria::MAX_ITER, 50, 1e-5));
+
+			if (corners.size() != subPixResults.size()) {
+				return false;
+			}
+		}
+		catch (cv::Exception e) {
+			LogWarning("ofxCvMin") << "Couldn't perform sub-pixel refinement of checkerboard find : " << e.what();
+			return false;
+		}
+
+		//make sure none of the corners have walked outside their starting window
+		for (int i = 0; i < corners.size(); i++) {
+			auto difference = corners[i] - subPixResults[i];
+			if (difference.x * difference.x + difference.y * difference.y > windowSize * windowSize) {
+				//we walked too far!
+				return false;
+			}
+		}
+
+		corners = subPixResults;
+		return true;
+	}
+
+	glm::vec2 undistortPoint(const glm::vec2 & distortedPoint, cv::Mat cameraMatrix, cv::Mat distotionCoefficients) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::undistortPoint");
+		vector<Point2f> distortedPoints(1, toCv(distortedPoint));
+		vector<Point2f> undistortedPoints(1);
+
+		cv::undistortPoints(distortedPoints, undistortedPoints, cameraMatrix, distotionCoefficients);
+
+		return toOf(undistortedPoints[0]);
+	}
+
+	float calibrateCameraWorldRemoveOutliers(vector<Point3f> pointsWorld, vector<Point2f> pointsImage, cv::Size size, cv::Mat & cameraMatrix, cv::Mat & distortionCoefficients, cv::Mat & rotation, cv::Mat & translation, int flags, float maxError) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::calibrateCameraWorldRemoveOutliers");
+		ThreadingConfig::ScopedLane lane(Lane::Background);
+		const int pointCount = pointsWorld.size();
+
+		auto cameraMatrixCopy = cameraMatrix;
+
+		vector<Mat> rotations, translations;
+		float rmsErrorAll = cv::calibrateCamera(vector<vector<Point3f>>(1, pointsWorld), vector<vector<Point2f>>(1, pointsImage),
+			size, cameraMatrix, distortionCoefficients,
+			rotations, translations, flags);
+
+		vector<Point2f> projectedPoints;
+	
+		cv::projectPoints(pointsWorld, rotations[0], translations[0], cameraMatrix, distortionCoefficients, projectedPoints);
+		set<int> indicesToRemove;
+
+		for (int i = 0; i < pointCount; i++) {
+			auto error = cv::norm(projectedPoints[i] - pointsImage[i]);
+			if (error > maxError) {
+				LogNotice("ofxCvMin::calibrateCameraWorldRemoveOutliers") << "Removing point [" << i << "] = [" << pointsWorld[i] << "]->[" << pointsImage[i] << "] because its error is too high [" << error << "]";
+				indicesToRemove.insert(i);
+			}
+		}
+
+		vector<Point3f> trimmedPointsWorld;
+		vector<Point2f> trimmedPointsImage;
+
+		for (int i = 0; i < pointCount; i++) {
+			if (indicesToRemove.find(i) == indicesToRemove.end()) {
+				trimmedPointsWorld.push_back(pointsWorld[i]);
+				trimmedPointsImage.push_back(pointsImage[i]);
+			}
+		}
+
+		cameraMatrix = cameraMatrixCopy.clone();
+		
+		//ensure principal point inside image
+		{
+			cameraMatrix.at<double>(0, 2) = min(max(cameraMatrix.at<double>(0, 2), 0.01), 0.99 * (float)size.width);
+			cameraMatrix.at<double>(1, 2) = min(max(cameraMatrix.at<double>(1, 2), 0.01), 0.99 * (float)size.height);
+		}
+
+		float rmsErrorTrimmed = cv::calibrateCamera(vector<vector<Point3f>>(1, trimmedPointsWorld), vector<vector<Point2f>>(1, trimmedPointsImage)
+			, size
+			, cameraMatrix, distortionCoefficients
+			, rotations, translations
+			, flags);
+
+		if (rmsErrorTrimmed != rmsErrorAll) {
+			LogNotice("ofxCvMin::calibrateCameraWorldRemoveOutliers") << "Removing " << indicesToRemove.size() << "/" << pointCount << " points changed resprojection error from " << rmsErrorAll << "px to " << rmsErrorTrimmed << "px";
+		}
+
+		rotation = rotations[0];
+		translation = translations[0];
+		return rmsErrorTrimmed;
+	}
+}
\ No newline at end of file
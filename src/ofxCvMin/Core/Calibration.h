@@ -0,0 +1,152 @@
+/*
+ camera calibration which only needs OpenCV and glm: board points, finding and
+ refining boards in images, converting between rotation vectors and matrices,
+ and undistorting points.
+
+ the openFrameworks parts (board meshes, calibrateProjector with ofMatrix4x4)
+ are in Helpers.h and Wrappers.h.
+ */
+
+#pragma once
+
+#include "Platform.h"
+#include "Types.h"
+#include "opencv2/opencv.hpp"
+#include <glm/glm.hpp>
+
+namespace ofxCv {
+
+	enum BoardType {
+		Checkerboard,
+		AsymmetricCircles
+	};
+
+	using namespace cv;
+
+	glm::mat4 makeMatrix(Mat rotationVector, Mat translation);
+	void decomposeMatrix(const glm::mat4 &, Mat & rotationVector, Mat & translation);
+	
+	// fixed-size equivalent of cv::Rodrigues (rotation vector -> 3x3), doesn't allocate
+	template <class T>
+	Matx<T, 3, 3> rotationVectorToMatrix(const Matx<T, 3, 1> & rotationVector) {
+		const double rx = rotationVector(0), ry = rotationVector(1), rz = rotationVector(2);
+		const double theta = sqrt(rx * rx + ry * ry + rz * rz);
+		if(theta < DBL_EPSILON) {
+			return Matx<T, 3, 3>::eye();
+		}
+		const double x = rx / theta, y = ry / theta, z = rz / theta;
+		const double c = cos(theta), s = sin(theta), c1 = 1. - c;
+		return Matx<T, 3, 3>(c + c1 * x * x, c1 * x * y - s * z, c1 * x * z + s * y,
+			c1 * x * y + s * z, c + c1 * y * y, c1 * y * z - s * x,
+			c1 * x * z - s * y, c1 * y * z + s * x, c + c1 * z * z);
+	}
+	
+	// fixed-size equivalent of cv::Rodrigues (3x3 -> rotation vector). expects an orthonormal matrix
+	template <class T>
+	Matx<T, 3, 1> rotationMatrixToVector(const Matx<T, 3, 3> & R) {
+		double rx = R(2, 1) - R(1, 2), ry = R(0, 2) - R(2, 0), rz = R(1, 0) - R(0, 1);
+		const double s = sqrt((rx * rx + ry * ry + rz * rz) * 0.25);
+		const double c = std::max(std::min((R(0, 0) + R(1, 1) + R(2, 2) - 1.) * 0.5, 1.), -1.);
+		double theta = acos(c);
+		if(s < 1e-5) {
+			if(c > 0) {
+				return Matx<T, 3, 1>(0, 0, 0);
+			}
+			// rotation of pi, the axis comes from the diagonal (same approach as cv::Rodrigues)
+			rx = sqrt(std::max((R(0, 0) + 1.) * 0.5, 0.));
+			ry = sqrt(std::max((R(1, 1) + 1.) * 0.5, 0.)) * (R(0, 1) < 0 ? -1. : 1.);
+			rz = sqrt(std::max((R(2, 2) + 1.) * 0.5, 0.)) * (R(0, 2) < 0 ? -1. : 1.);
+			if(fabs(rx) < fabs(ry) && fabs(rx) < fabs(rz) && (R(1, 2) > 0) != (ry * rz > 0)) {
+				rz = -rz;
+			}
+			theta /= sqrt(rx * rx + ry * ry + rz * rz);
+			return Matx<T, 3, 1>(rx * theta, ry * theta, rz * theta);
+		}
+		const double scale = theta / (2. * s);
+		return Matx<T, 3, 1>(rx * scale, ry * scale, rz * scale);
+	}
+	
+	// allocation-free makeMatrix for float or double Matx/Vec input
+	template <class T>
+	glm::mat4 makeMatrix(const Matx<T, 3, 3> & rm, const Matx<T, 3, 1> & tm) {
+		return glm::mat4(rm(0, 0), rm(1, 0), rm(2, 0), 0.0f,
+			rm(0, 1), rm(1, 1), rm(2, 1), 0.0f,
+			rm(0, 2), rm(1, 2), rm(2, 2), 0.0f,
+			tm(0), tm(1), tm(2), 1.0f);
+	}
+	
+	template <class T>
+	glm::mat4 makeMatrix(const Matx<T, 3, 1> & rotationVector, const Matx<T, 3, 1> & translation) {
+		return makeMatrix(rotationVectorToMatrix(rotationVector), translation);
+	}
+	
+	// allocation-free decomposeMatrix. the upper 3x3 of the transform should be a pure rotation
+	template <class T>
+	void decomposeMatrix(const glm::mat4 & transform, Matx<T, 3, 1> & rotationVector, Matx<T, 3, 1> & translation) {
+		Matx<T, 3, 3> rotation;
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				rotation(i, j) = transform[j][i]; //transposed
+			}
+		}
+		rotationVector = rotationMatrixToVector(rotation);
+		translation = Matx<T, 3, 1>(transform[3][0], transform[3][1], transform[3][2]);
+	}
+	
+	// batch versions, e.g. for the rvecs/tvecs which come out of calibrateCamera
+	template <class T>
+	void makeMatrices(const Vec<T, 3> * rotationVectors, const Vec<T, 3> * translations, size_t count, glm::mat4 * transformsOut) {
+		for(size_t i = 0; i < count; i++) {
+			transformsOut[i] = makeMatrix(rotationVectors[i], translations[i]);
+		}
+	}
+	
+	template <class T>
+	void makeMatrices(const vector<Vec<T, 3>> & rotationVectors, const vector<Vec<T, 3>> & translations, vector<glm::mat4> & transformsOut) {
+		const auto count = std::min(rotationVectors.size(), translations.size());
+		transformsOut.resize(count);
+		makeMatrices(rotationVectors.data(), translations.data(), count, transformsOut.data());
+	}
+	
+	template <class T>
+	void decomposeMatrices(const glm::mat4 * transforms, size_t count, Vec<T, 3> * rotationVectorsOut, Vec<T, 3> * translationsOut) {
+		for(size_t i = 0; i < count; i++) {
+			decomposeMatrix(transforms[i], rotationVectorsOut[i], translationsOut[i]);
+		}
+	}
+	
+	template <class T>
+	void decomposeMatrices(const vector<glm::mat4> & transforms, vector<Vec<T, 3>> & rotationVectorsOut, vector<Vec<T, 3>> & translationsOut) {
+		rotationVectorsOut.resize(transforms.size());
+		translationsOut.resize(transforms.size());
+		decomposeMatrices(transforms.data(), transforms.size(), rotationVectorsOut.data(), translationsOut.data());
+	}
+	
+	glm::mat4 makeProjectionMatrix(Mat cameraMatrix, cv::Size imageSize);
+
+	vector<Point3f> makeCheckerboardPoints(cv::Size size, float spacing, bool centered = true);
+	vector<Point3f> makeAsymmetricCirclePoints(cv::Size size, float spacing, bool centered = true);
+	vector<Point3f> makeBoardPoints(BoardType, cv::Size size, float spacing, bool centered = true);
+
+	vector<Point2f> undistortImagePoints(const vector<Point2f> &, cv::Mat cameraMatrix, cv::Mat distortionCoefficients);
+	glm::vec2 undistortPoint(const glm::vec2 &, cv::Mat cameraMatrix, cv::Mat distotionCoefficients);
+
+	float reprojectionError(const vector<cv::Point2f>& imagePoints
+		, const vector<cv::Point3f>& worldPoints
+		, const cv::Mat& rotationVector
+		, const cv::Mat& translation
+		, const cv::Mat& cameraMatrix
+		, const cv::Mat& distortionCoeffients);
+
+	bool findChessboardCornersPreTest(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & corners, int testResolution = 512);
+	SimpleBlobDetector::Params getDefaultFindCircleBlobDetectorParams(Mat image, float minBlobWidthPct = 0.001f, float maxBlobWidthPct = 0.05f);
+	bool findAsymmetricCircles(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & results, Ptr<FeatureDetector> featureDetector = Ptr<FeatureDetector>(), int blockSize = 0);
+
+	/// useOptimisers refers to using techniques like pre-testing the checkerboard at low resolutions
+	bool findBoard(cv::Mat image, BoardType, cv::Size patternSize, vector<cv::Point2f> & results, bool useOptimisers = true);
+
+	/// Refine checkerboard corners. Note that all pixels inside the window should belong to the corner feature. Also the halfWindowSize is corrected for you if ofxCvMin thinks it's too large
+	bool refineCheckerboardCorners(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & corners, int desiredHalfWindowSize = 10);
+
+	float calibrateCameraWorldRemoveOutliers(vector<Point3f> pointsWorld, vector<Point2f> pointsImage, cv::Size size, cv::Mat & cameraMatrixOut, cv::Mat & distortionCoefficientsOuts, cv::Mat & rotation, cv::Mat & translationOut, int flags, float maxError = 20.0f);
+}
@@ -0,0 +1,471 @@
+#include "FrameAllocator.h"
+#include "Instrumentation.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+using namespace std;
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	// size classes are 256 bytes, then 4 per power of 2 (320, 384, 448, 512, 640..)
+	static const size_t minimumClassSize = 256;
+
+	// arena allocations are rounded up to this, which is also the alignment fastMalloc gives
+	static const size_t arenaAlignment = 64;
+
+	// smaller blocks come from fastMalloc even with a NUMA node, a page each would waste too much
+	static const size_t numaMinimumSize = 64 << 10;
+
+	// MPOL_BIND from <numaif.h> (which needs libnuma's headers)
+	static const int numaBindPolicy = 2;
+
+	//----------
+	static size_t getClassIndex(size_t bytes) {
+		if (bytes <= minimumClassSize) {
+			return 0;
+		}
+		size_t octave = 0;
+		while (((bytes - 1) >> (octave + 1)) != 0) {
+			octave++;
+		}
+		const size_t base = (size_t) 1 << octave;
+		const size_t step = base / 4;
+		const size_t sub = (bytes - base + step - 1) / step;
+		return (octave - 8) * 4 + sub;
+	}
+
+	//----------
+	static size_t getClassSize(size_t index) {
+		if (index == 0) {
+			return minimumClassSize;
+		}
+		const size_t base = minimumClassSize << ((index - 1) / 4);
+		return base + ((index - 1) % 4 + 1) * (base / 4);
+	}
+
+	//----------
+	static thread_local FrameAllocator * threadAllocator = nullptr;
+	static thread_local FrameAllocator::Lifetime threadLifetime = FrameAllocator::Lifetime::Pooled;
+	static std::atomic<FrameAllocator *> globalAllocator{ nullptr };
+
+	//----------
+	// OpenCV's default allocator is global, so this is installed once and picks
+	// the allocator for whichever thread is creating the Mat. Mats remember the
+	// allocator which made them (UMatData::currAllocator), so it never frees anything
+	class DispatchingMatAllocator : public MatAllocator {
+	public:
+		UMatData * allocate(int dims, const int * sizes, int type, void * data, size_t * step, AccessFlag flags, UMatUsageFlags usageFlags) const override {
+			const MatAllocator * allocator = threadAllocator;
+			if (!allocator) {
+				allocator = globalAllocator.load();
+			}
+			if (!allocator) {
+				allocator = Mat::getStdAllocator();
+			}
+			return allocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+		}
+
+		bool allocate(UMatData * data, AccessFlag accessFlags, UMatUsageFlags usageFlags) const override {
+			return Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+		}
+
+		void deallocate(UMatData * data) const override {
+			Mat::getStdAllocator()->deallocate(data);
+		}
+	};
+
+	//----------
+	static void installDispatchingMatAllocator() {
+		static DispatchingMatAllocator allocator;
+		static std::once_flag installed;
+		std::call_once(installed, []() {
+			Mat::setDefaultAllocator(&allocator);
+		});
+	}
+
+	//----------
+	FrameAllocator::FrameAllocator()
+		: FrameAllocator(Settings()) {
+
+	}
+
+	//----------
+	FrameAllocator::FrameAllocator(const Settings & settings)
+		: settings(settings) {
+		this->settings.maxPooledSize = std::max(this->settings.maxPooledSize, minimumClassSize);
+		this->settings.arenaSize = (this->settings.arenaSize + arenaAlignment - 1) & ~(arenaAlignment - 1);
+
+#ifdef __linux__
+		if (this->settings.numaNode >= (int) (sizeof(unsigned long) * 8)) {
+			LogWarning("ofxCv::FrameAllocator") << "NUMA node " << this->settings.numaNode << " is out of range, not binding";
+			this->settings.numaNode = -1;
+		}
+#else
+		if (this->settings.numaNode >= 0) {
+			LogWarning("ofxCv::FrameAllocator") << "NUMA binding is only available on Linux";
+			this->settings.numaNode = -1;
+		}
+#endif
+
+		this->poolCount = getClassIndex(this->settings.maxPooledSize) + 1;
+		this->pools.reset(new Pool[this->poolCount]);
+
+		if (this->settings.arenaSize > 0) {
+			this->arena = (unsigned char *) this->allocateSystem(this->settings.arenaSize);
+		}
+	}
+
+	//----------
+	FrameAllocator::~FrameAllocator() {
+		FrameAllocator * self = this;
+		globalAllocator.compare_exchange_strong(self, nullptr);
+
+		if (this->poolInUse.load() > 0 || this->arenaLive.load() > 0) {
+			LogWarning("ofxCv::FrameAllocator") << "Destroyed while " << this->poolInUse.load() << " pooled bytes and "
+				<< this->arenaLive.load() << " arena allocations are still in use";
+		}
+
+		this->trim();
+		if (this->arena) {
+			this->freeSystem(this->arena, this->settings.arenaSize);
+		}
+		for (auto header : this->freeHeaders) {
+			::operator delete(header);
+		}
+	}
+
+	//----------
+	void FrameAllocator::setGlobal(FrameAllocator * allocator) {
+		installDispatchingMatAllocator();
+		globalAllocator.store(allocator);
+	}
+
+	//----------
+	FrameAllocator::ScopedInstall::ScopedInstall(FrameAllocator * allocator, Lifetime lifetime)
+		: previousAllocator(threadAllocator)
+		, previousLifetime(threadLifetime)
+		, installed(allocator != nullptr) {
+		if (this->installed) {
+			installDispatchingMatAllocator();
+			threadAllocator = allocator;
+			threadLifetime = lifetime;
+		}
+	}
+
+	//----------
+	FrameAllocator::ScopedInstall::~ScopedInstall() {
+		if (this->installed) {
+			threadAllocator = this->previousAllocator;
+			threadLifetime = this->previousLifetime;
+		}
+	}
+
+	//----------
+	bool FrameAllocator::resetFrame() {
+		const auto live = this->arenaLive.load();
+		if (live > 0) {
+			LogWarning("ofxCv::FrameAllocator") << live << " Mats from this frame are still alive, not resetting the arena";
+			return false;
+		}
+		this->arenaOffset.store(0);
+		this->frameCount++;
+		return true;
+	}
+
+	//----------
+	void FrameAllocator::trim() {
+		for (size_t i = 0; i < this->poolCount; i++) {
+			auto & pool = this->pools[i];
+			vector<void *> freeBlocks;
+			{
+				std::lock_guard<std::mutex> lock(pool.lock);
+				std::swap(freeBlocks, pool.freeBlocks);
+			}
+			const auto size = getClassSize(i);
+			for (auto block : freeBlocks) {
+				this->freeSystem(block, size);
+			}
+			this->poolReserved -= size * freeBlocks.size();
+		}
+	}
+
+	//----------
+	const FrameAllocator::Settings & FrameAllocator::getSettings() const {
+		return this->settings;
+	}
+
+	//----------
+	FrameAllocator::Statistics FrameAllocator::getStatistics() const {
+		Statistics statistics;
+		statistics.arenaSize = this->settings.arenaSize;
+		statistics.arenaUsed = std::min(this->arenaOffset.load(), this->settings.arenaSize);
+		statistics.arenaPeak = this->arenaPeak.load();
+		statistics.arenaLive = this->arenaLive.load();
+		statistics.arenaOverflows = this->arenaOverflows.load();
+		statistics.frameCount = this->frameCount.load();
+		statistics.poolReserved = this->poolReserved.load();
+		statistics.poolInUse = this->poolInUse.load();
+		statistics.poolHits = this->poolHits.load();
+		statistics.poolMisses = this->poolMisses.load();
+		statistics.directAllocations = this->directAllocations.load();
+		return statistics;
+	}
+
+	//----------
+	vector<FrameAllocator::Site> FrameAllocator::getSites() const {
+		vector<Site> sites;
+		{
+			std::lock_guard<std::mutex> lock(this->siteLock);
+			for (const auto & site : this->sites) {
+				sites.push_back(site.second);
+			}
+		}
+		sort(sites.begin(), sites.end(), [](const Site & a, const Site & b) {
+			return a.bytes > b.bytes;
+		});
+		return sites;
+	}
+
+	//----------
+	string FrameAllocator::getStatisticsString() const {
+		const auto statistics = this->getStatistics();
+		const double MB = 1024.0 * 1024.0;
+
+		stringstream text;
+		text << std::fixed << std::setprecision(2);
+		text << "arena: " << statistics.arenaUsed / MB << " / " << statistics.arenaSize / MB << " MB used, "
+			<< statistics.arenaPeak / MB << " MB peak, " << statistics.arenaOverflows << " overflows, "
+			<< statistics.frameCount << " frames" << endl;
+		text << "pools: " << statistics.poolInUse / MB << " / " << statistics.poolReserved / MB << " MB in use, "
+			<< statistics.poolHits << " hits, " << statistics.poolMisses << " misses, "
+			<< statistics.directAllocations << " direct" << endl;
+		if (!Instrumentation::isAvailable()) {
+			return text.str();
+		}
+
+		text << std::left << std::setw(48) << "site" << std::right
+			<< std::setw(9) << "allocs"
+			<< std::setw(12) << "total MB"
+			<< std::setw(12) << "live MB"
+			<< std::setw(12) << "peak MB" << endl;
+		for (const auto & site : this->getSites()) {
+			text << std::left << std::setw(48) << site.name << std::right
+				<< std::setw(9) << site.count
+				<< std::setw(12) << site.bytes / MB
+				<< std::setw(12) << site.liveBytes / MB
+				<< std::setw(12) << site.peakLiveBytes / MB << endl;
+		}
+		return text.str();
+	}
+
+	//----------
+	UMatData * FrameAllocator::allocate(int dims, const int * sizes, int type, void * data0, size_t * step, AccessFlag, UMatUsageFlags) const {
+		// the same layout as OpenCV's StdMatAllocator
+		size_t total = CV_ELEM_SIZE(type);
+		for (int i = dims - 1; i >= 0; i--) {
+			if (step) {
+				if (data0 && step[i] != Mat::AUTO_STEP) {
+					CV_Assert(total <= step[i]);
+					total = step[i];
+				}
+				else {
+					step[i] = total;
+				}
+			}
+			total *= sizes[i];
+		}
+
+		auto u = this->makeUMatData();
+		u->size = total;
+		if (data0) {
+			u->data = u->origdata = (uchar *) data0;
+			u->flags |= UMatData::USER_ALLOCATED;
+			return u;
+		}
+
+		uchar * data = nullptr;
+		const auto lifetime = threadAllocator == this ? threadLifetime : Lifetime::Pooled;
+		if (lifetime == Lifetime::Frame && this->arena) {
+			const size_t aligned = (std::max(total, (size_t) 1) + arenaAlignment - 1) & ~(arenaAlignment - 1);
+			const size_t offset = this->arenaOffset.fetch_add(aligned);
+			if (offset + aligned <= this->settings.arenaSize) {
+				data = this->arena + offset;
+				this->arenaLive++;
+				auto peak = this->arenaPeak.load();
+				while (offset + aligned > peak && !this->arenaPeak.compare_exchange_weak(peak, offset + aligned)) { }
+			}
+			else {
+				this->arenaOverflows++;
+			}
+		}
+
+		if (!data) {
+			if (total <= this->settings.maxPooledSize) {
+				const auto index = getClassIndex(total);
+				const auto size = getClassSize(index);
+				{
+					auto & pool = this->pools[index];
+					std::lock_guard<std::mutex> lock(pool.lock);
+					if (!pool.freeBlocks.empty()) {
+						data = (uchar *) pool.freeBlocks.back();
+						pool.freeBlocks.pop_back();
+					}
+				}
+				if (data) {
+					this->poolHits++;
+				}
+				else {
+					this->poolMisses++;
+					data = (uchar *) this->allocateSystem(size);
+					this->poolReserved += size;
+				}
+				this->poolInUse += size;
+			}
+			else {
+				this->directAllocations++;
+				data = (uchar *) this->allocateSystem(total);
+			}
+		}
+
+		u->data = u->origdata = data;
+		u->userdata = (void *) Instrumentation::getCurrentScope();
+		this->recordSite(u, total, true);
+		return u;
+	}
+
+	//----------
+	bool FrameAllocator::allocate(UMatData * data, AccessFlag, UMatUsageFlags) const {
+		return data != nullptr;
+	}
+
+	//----------
+	void FrameAllocator::deallocate(UMatData * u) const {
+		if (!u) {
+			return;
+		}
+		CV_Assert(u->urefcount == 0);
+		CV_Assert(u->refcount == 0);
+
+		if (!(u->flags & UMatData::USER_ALLOCATED) && u->origdata) {
+			const auto total = u->size;
+			this->recordSite(u, total, false);
+
+			if (this->arena && u->origdata >= this->arena && u->origdata < this->arena + this->settings.arenaSize) {
+				// the memory comes back at resetFrame()
+				this->arenaLive--;
+			}
+			else if (total <= this->settings.maxPooledSize) {
+				const auto index = getClassIndex(total);
+				{
+					auto & pool = this->pools[index];
+					std::lock_guard<std::mutex> lock(pool.lock);
+					pool.freeBlocks.push_back(u->origdata);
+				}
+				this->poolInUse -= getClassSize(index);
+			}
+			else {
+				this->freeSystem(u->origdata, total);
+			}
+		}
+		this->freeUMatData(u);
+	}
+
+	//----------
+	void * FrameAllocator::allocateSystem(size_t bytes) const {
+#ifdef __linux__
+		if (this->settings.numaNode >= 0 && bytes >= numaMinimumSize) {
+			auto data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (data == MAP_FAILED) {
+				CV_Error(Error::StsNoMem, "ofxCv::FrameAllocator couldn't map memory");
+			}
+
+			// the kernel reads one bit fewer than maxnode
+			unsigned long nodeMask = 1UL << this->settings.numaNode;
+			if (syscall(SYS_mbind, data, bytes, numaBindPolicy, &nodeMask, sizeof(nodeMask) * 8 + 1, 0) != 0) {
+				static std::once_flag warned;
+				std::call_once(warned, [this]() {
+					LogWarning("ofxCv::FrameAllocator") << "Couldn't bind memory to NUMA node " << this->settings.numaNode;
+				});
+			}
+			return data;
+		}
+#endif
+		return fastMalloc(bytes);
+	}
+
+	//----------
+	void FrameAllocator::freeSystem(void * data, size_t bytes) const {
+#ifdef __linux__
+		if (this->settings.numaNode >= 0 && bytes >= numaMinimumSize) {
+			munmap(data, bytes);
+			return;
+		}
+#endif
+		fastFree(data);
+	}
+
+	//----------
+	UMatData * FrameAllocator::makeUMatData() const {
+		void * storage = nullptr;
+		{
+			std::lock_guard<std::mutex> lock(this->headerLock);
+			if (!this->freeHeaders.empty()) {
+				storage = this->freeHeaders.back();
+				this->freeHeaders.pop_back();
+			}
+		}
+		if (!storage) {
+			storage = ::operator new(sizeof(UMatData));
+		}
+		return new (storage) UMatData(this);
+	}
+
+	//----------
+	void FrameAllocator::freeUMatData(UMatData * u) const {
+		u->~UMatData();
+		std::lock_guard<std::mutex> lock(this->headerLock);
+		this->freeHeaders.push_back(u);
+	}
+
+	//----------
+	void FrameAllocator::recordSite(UMatData * u, size_t bytes, bool allocated) const {
+		// without instrumentation there are no scopes to tell apart, so don't take the lock
+		if (!Instrumentation::isAvailable()) {
+			return;
+		}
+		const auto tag = (const char *) u->userdata;
+
+		std::lock_guard<std::mutex> lock(this->siteLock);
+		auto it = find_if(this->sites.begin(), this->sites.end(), [tag](const pair<const char *, Site> & site) {
+			return site.first == tag;
+		});
+		if (it == this->sites.end()) {
+			Site site;
+			site.name = tag ? tag : "(no scope)";
+			this->sites.emplace_back(tag, site);
+			it = this->sites.end() - 1;
+		}
+
+		auto & site = it->second;
+		if (allocated) {
+			site.count++;
+			site.bytes += bytes;
+			site.liveBytes += bytes;
+			site.peakLiveBytes = std::max(site.peakLiveBytes, site.liveBytes);
+		}
+		else {
+			site.liveBytes -= bytes;
+		}
+	}
+}
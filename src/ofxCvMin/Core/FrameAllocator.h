@@ -0,0 +1,153 @@
+/*
+ a cv::MatAllocator which keeps memory rather than going back to malloc/free for
+ every temporary Mat.
+
+ there are two places memory comes from:
+ - the arena, for temporaries which only live during a frame. allocating moves
+   a pointer along one big block, freeing does nothing, and resetFrame() moves
+   the pointer back to the start (if nothing from the arena is still alive).
+   when the arena is full, allocations fall back to the pools.
+ - the pools, for everything else. sizes are rounded up to one of 4 classes per
+   power of 2 (so at most 25% is wasted), and freed blocks are kept for the next
+   allocation of that class until trim().
+
+ the allocator can be installed for every thread with setGlobal(), or for one
+ thread with a ScopedInstall (e.g. in each stage of a Pipeline, see
+ Pipeline::Settings::allocator). OpenCV's own worker threads (inside
+ parallel_for_) aren't covered by a ScopedInstall.
+
+ the arena should only be used by one thread at a time (one allocator per
+ stage), the pools can be shared. an allocator has to outlive every Mat it made.
+
+ on Linux, numaNode >= 0 binds all of the allocator's memory to that NUMA node.
+
+ each allocation is tagged with the innermost OFXCV_INSTRUMENT_SCOPE on its
+ thread (when built with OFXCV_INSTRUMENTATION), and getSites() shows what each
+ of those has allocated and still holds.
+ */
+
+#pragma once
+
+#include "Platform.h"
+#include "opencv2/opencv.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	class FrameAllocator : public MatAllocator {
+	public:
+		enum class Lifetime {
+			Frame, // from the arena, until resetFrame()
+			Pooled // from the pools, until the Mat is released
+		};
+
+		struct Settings {
+			size_t arenaSize = 64 << 20; // bytes, 0 = no arena
+			size_t maxPooledSize = 256 << 20; // larger allocations aren't kept when they're freed
+			int numaNode = -1; // Linux only, -1 = wherever the OS puts it
+		};
+
+		struct Statistics {
+			size_t arenaSize = 0;
+			size_t arenaUsed = 0; // since the last resetFrame()
+			size_t arenaPeak = 0; // most used in any one frame
+			size_t arenaLive = 0; // arena allocations not released yet
+			size_t arenaOverflows = 0; // arena allocations which went to the pools instead
+			size_t frameCount = 0;
+
+			size_t poolReserved = 0; // bytes held by the pools, in use or not
+			size_t poolInUse = 0;
+			size_t poolHits = 0; // pooled allocations which reused a freed block
+			size_t poolMisses = 0;
+			size_t directAllocations = 0; // larger than maxPooledSize
+		};
+
+		// what one call site has allocated through this allocator
+		struct Site {
+			string name;
+			size_t count = 0;
+			uint64_t bytes = 0;
+			uint64_t liveBytes = 0;
+			uint64_t peakLiveBytes = 0;
+		};
+
+		FrameAllocator();
+		FrameAllocator(const Settings &);
+		~FrameAllocator();
+
+		// every thread without a ScopedInstall uses the allocator's pools.
+		// pass nullptr to go back to OpenCV's allocator
+		static void setGlobal(FrameAllocator *);
+
+		// Mats created on this thread until the end of the scope use the allocator.
+		// nullptr leaves the thread as it was
+		class ScopedInstall {
+		public:
+			ScopedInstall(FrameAllocator *, Lifetime = Lifetime::Pooled);
+			~ScopedInstall();
+		protected:
+			FrameAllocator * previousAllocator;
+			Lifetime previousLifetime;
+			bool installed;
+		};
+
+		// rewinds the arena. returns false (and leaves the arena as it is) if
+		// any of this frame's Mats are still alive
+		bool resetFrame();
+
+		// frees the pools' unused blocks
+		void trim();
+
+		const Settings & getSettings() const;
+		Statistics getStatistics() const;
+
+		// sorted by bytes, largest first. empty when built without OFXCV_INSTRUMENTATION
+		vector<Site> getSites() const;
+		string getStatisticsString() const;
+
+		// cv::MatAllocator
+		UMatData * allocate(int dims, const int * sizes, int type, void * data, size_t * step, AccessFlag flags, UMatUsageFlags usageFlags) const override;
+		bool allocate(UMatData * data, AccessFlag accessFlags, UMatUsageFlags usageFlags) const override;
+		void deallocate(UMatData * data) const override;
+	protected:
+		struct Pool {
+			std::mutex lock;
+			vector<void *> freeBlocks;
+		};
+
+		void * allocateSystem(size_t bytes) const;
+		void freeSystem(void * data, size_t bytes) const;
+		UMatData * makeUMatData() const;
+		void freeUMatData(UMatData *) const;
+		void recordSite(UMatData *, size_t bytes, bool allocated) const;
+
+		Settings settings;
+
+		unsigned char * arena = nullptr;
+		mutable std::atomic<size_t> arenaOffset{ 0 };
+		mutable std::atomic<size_t> arenaLive{ 0 };
+		mutable std::atomic<size_t> arenaPeak{ 0 };
+		mutable std::atomic<size_t> arenaOverflows{ 0 };
+		std::atomic<size_t> frameCount{ 0 };
+
+		std::unique_ptr<Pool[]> pools;
+		size_t poolCount = 0;
+		mutable std::atomic<size_t> poolReserved{ 0 };
+		mutable std::atomic<size_t> poolInUse{ 0 };
+		mutable std::atomic<size_t> poolHits{ 0 };
+		mutable std::atomic<size_t> poolMisses{ 0 };
+		mutable std::atomic<size_t> directAllocations{ 0 };
+
+		// UMatData headers are recycled too, so a pooled Mat doesn't call new at all
+		mutable std::mutex headerLock;
+		mutable vector<void *> freeHeaders;
+
+		mutable std::mutex siteLock;
+		mutable vector<std::pair<const char *, Site>> sites; // few enough that a linear search is fine
+	};
+}
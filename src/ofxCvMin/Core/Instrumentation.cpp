@@ -0,0 +1,354 @@
+#include "Instrumentation.h"
+#include "Platform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+namespace ofxCv {
+	namespace Instrumentation {
+		enum EventType : uint8_t {
+			EVENT_SCOPE,
+			EVENT_ALLOCATION
+		};
+
+		struct Event {
+			const char * name;
+			uint64_t startTime;
+			uint64_t value; // duration (ns) or bytes
+			EventType type;
+		};
+
+		// written by one thread only, read by whoever exports
+		struct ThreadBuffer {
+			vector<Event> events;
+			uint64_t mask = 0;
+			std::atomic<uint64_t> written{ 0 };
+			std::atomic<uint64_t> cleared{ 0 }; // events before this were cleared
+			uint32_t threadIndex = 0;
+		};
+
+		static std::atomic<bool> enabled{ true };
+		static std::atomic<size_t> bufferCapacity{ 1 << 16 };
+
+		// buffers live as long as the program, so events from finished threads can still be exported
+		static std::mutex registryLock;
+		static vector<unique_ptr<ThreadBuffer>> registry;
+
+		static thread_local ThreadBuffer * threadBuffer = nullptr;
+		static thread_local const char * currentScope = nullptr;
+
+		//----------
+		static ThreadBuffer & getThreadBuffer() {
+			if (!threadBuffer) {
+				auto buffer = make_unique<ThreadBuffer>();
+				size_t size = 1;
+				while (size < bufferCapacity.load()) {
+					size <<= 1;
+				}
+				buffer->events.resize(size);
+				buffer->mask = size - 1;
+
+				std::lock_guard<std::mutex> lock(registryLock);
+				buffer->threadIndex = (uint32_t) registry.size();
+				threadBuffer = buffer.get();
+				registry.push_back(std::move(buffer));
+			}
+			return *threadBuffer;
+		}
+
+		//----------
+		static void record(const Event & event) {
+			auto & buffer = getThreadBuffer();
+			const uint64_t index = buffer.written.load(std::memory_order_relaxed);
+			buffer.events[index & buffer.mask] = event;
+			buffer.written.store(index + 1, std::memory_order_release);
+		}
+
+		//----------
+		// the events of every thread which are still in their rings
+		static void takeSnapshot(vector<pair<uint32_t, Event>> & events) {
+			std::lock_guard<std::mutex> lock(registryLock);
+			for (const auto & buffer : registry) {
+				const uint64_t capacity = buffer->mask + 1;
+				const uint64_t written = buffer->written.load(std::memory_order_acquire);
+				uint64_t first = written > capacity ? written - capacity : 0;
+				first = std::max(first, buffer->cleared.load());
+
+				vector<Event> copied;
+				copied.reserve((size_t) (written - first));
+				for (uint64_t i = first; i < written; i++) {
+					copied.push_back(buffer->events[i & buffer->mask]);
+				}
+
+				// anything the thread wrote over while we were copying is dropped
+				const uint64_t writtenAfter = buffer->written.load(std::memory_order_acquire);
+				const uint64_t valid = writtenAfter > capacity ? writtenAfter - capacity : 0;
+				for (uint64_t i = std::max(first, valid); i < written; i++) {
+					events.emplace_back(buffer->threadIndex, copied[(size_t) (i - first)]);
+				}
+			}
+		}
+
+		//----------
+		static string escapeJson(const char * text) {
+			string escaped;
+			for (auto c = text; *c; c++) {
+				if (*c == '"' || *c == '\\') {
+					escaped += '\\';
+				}
+				escaped += *c;
+			}
+			return escaped;
+		}
+
+		//----------
+		bool isAvailable() {
+#ifdef OFXCV_INSTRUMENTATION
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		//----------
+		void setEnabled(bool enabled) {
+			Instrumentation::enabled.store(enabled);
+		}
+
+		//----------
+		bool isEnabled() {
+			return enabled.load(std::memory_order_relaxed);
+		}
+
+		//----------
+		void setBufferCapacity(size_t events) {
+			bufferCapacity.store(std::max(events, (size_t) 1));
+		}
+
+		//----------
+		void clear() {
+			std::lock_guard<std::mutex> lock(registryLock);
+			for (auto & buffer : registry) {
+				buffer->cleared.store(buffer->written.load());
+			}
+		}
+
+		//----------
+		uint64_t getTime() {
+			return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		//----------
+		void recordScope(const char * name, uint64_t startTime, uint64_t endTime) {
+			record({ name, startTime, endTime - startTime, EVENT_SCOPE });
+		}
+
+		//----------
+		void recordAllocation(uint64_t bytes) {
+			if (!isEnabled()) {
+				return;
+			}
+			record({ currentScope ? currentScope : "(no scope)", getTime(), bytes, EVENT_ALLOCATION });
+		}
+
+		//----------
+		const char * getCurrentScope() {
+			return currentScope;
+		}
+
+		//----------
+		bool saveChromeTrace(const string & filename) {
+			if (!isAvailable()) {
+				LogWarning("ofxCv::Instrumentation") << "ofxCv was built without OFXCV_INSTRUMENTATION, so nothing has been recorded";
+			}
+
+			vector<pair<uint32_t, Event>> events;
+			takeSnapshot(events);
+
+			uint64_t origin = UINT64_MAX;
+			uint32_t threadCount = 0;
+			for (const auto & event : events) {
+				origin = std::min(origin, event.second.startTime);
+				threadCount = std::max(threadCount, event.first + 1);
+			}
+
+			ofstream file(getPath(filename));
+			if (!file) {
+				LogError("ofxCv::Instrumentation") << "Couldn't open " << filename << " for writing";
+				return false;
+			}
+
+			file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+			bool first = true;
+			auto separate = [&]() {
+				if (!first) {
+					file << ",\n";
+				}
+				first = false;
+			};
+
+			for (uint32_t thread = 0; thread < threadCount; thread++) {
+				separate();
+				file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+			}
+
+			file << std::fixed << std::setprecision(3);
+			for (const auto & entry : events) {
+				const auto & event = entry.second;
+				const double timestamp = (double) (event.startTime - origin) / 1000.0; // microseconds
+				separate();
+				if (event.type == EVENT_SCOPE) {
+					file << "{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"ofxCv\",\"ph\":\"X\",\"pid\":1,\"tid\":" << entry.first
+						<< ",\"ts\":" << timestamp << ",\"dur\":" << (double) event.value / 1000.0 << "}";
+				}
+				else {
+					file << "{\"name\":\"allocate\",\"cat\":\"allocation\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << entry.first
+						<< ",\"ts\":" << timestamp << ",\"args\":{\"bytes\":" << event.value << ",\"scope\":\"" << escapeJson(event.name) << "\"}}";
+				}
+			}
+			file << "\n]}\n";
+
+			if (!file) {
+				LogError("ofxCv::Instrumentation") << "Couldn't write " << filename;
+				return false;
+			}
+			return true;
+		}
+
+		//----------
+		vector<Summary> getSummary() {
+			vector<pair<uint32_t, Event>> events;
+			takeSnapshot(events);
+
+			// names are grouped by their text, the same literal can have several addresses
+			map<string, Summary> summaries;
+			map<string, vector<uint64_t>> durations;
+			for (const auto & entry : events) {
+				const auto & event = entry.second;
+				auto & summary = summaries[event.name];
+				if (event.type == EVENT_SCOPE) {
+					durations[event.name].push_back(event.value);
+				}
+				else {
+					summary.allocationCount++;
+					summary.allocationBytes += event.value;
+				}
+			}
+
+			vector<Summary> results;
+			for (auto & named : summaries) {
+				auto & summary = named.second;
+				summary.name = named.first;
+
+				auto & times = durations[named.first];
+				summary.count = times.size();
+				if (!times.empty()) {
+					sort(times.begin(), times.end());
+					auto seconds = [](uint64_t nanoseconds) {
+						return (double) nanoseconds / 1e9;
+					};
+					auto percentile = [&](double fraction) {
+						return seconds(times[std::min(times.size() - 1, (size_t) (fraction * times.size()))]);
+					};
+
+					uint64_t total = 0;
+					for (auto time : times) {
+						total += time;
+						int bucket = 0;
+						for (uint64_t microseconds = time / 1000; microseconds > 1; microseconds >>= 1) {
+							bucket++;
+						}
+						if (bucket >= (int) summary.histogram.size()) {
+							summary.histogram.resize(bucket + 1, 0);
+						}
+						summary.histogram[bucket]++;
+					}
+					summary.total = seconds(total);
+					summary.min = seconds(times.front());
+					summary.max = seconds(times.back());
+					summary.mean = summary.total / times.size();
+					summary.median = percentile(0.5);
+					summary.percentile90 = percentile(0.9);
+					summary.percentile99 = percentile(0.99);
+				}
+				results.push_back(std::move(summary));
+			}
+
+			sort(results.begin(), results.end(), [](const Summary & a, const Summary & b) {
+				return a.total > b.total;
+			});
+			return results;
+		}
+
+		//----------
+		string getSummaryString() {
+			const auto summaries = getSummary();
+
+			stringstream text;
+			text << std::left << std::setw(48) << "name" << std::right
+				<< std::setw(9) << "calls"
+				<< std::setw(12) << "total ms"
+				<< std::setw(11) << "mean ms"
+				<< std::setw(11) << "p50 ms"
+				<< std::setw(11) << "p99 ms"
+				<< std::setw(11) << "max ms"
+				<< std::setw(9) << "allocs"
+				<< std::setw(12) << "alloc KB"
+				<< "  histogram (us, log2)" << endl;
+
+			text << std::fixed << std::setprecision(3);
+			for (const auto & summary : summaries) {
+				text << std::left << std::setw(48) << summary.name << std::right
+					<< std::setw(9) << summary.count
+					<< std::setw(12) << summary.total * 1e3
+					<< std::setw(11) << summary.mean * 1e3
+					<< std::setw(11) << summary.median * 1e3
+					<< std::setw(11) << summary.percentile99 * 1e3
+					<< std::setw(11) << summary.max * 1e3
+					<< std::setw(9) << summary.allocationCount
+					<< std::setw(12) << (double) summary.allocationBytes / 1024.0
+					<< "  ";
+
+				// one character per bucket, scaled to the biggest bucket
+				const char levels[] = " .:-=+*#";
+				size_t biggest = 0;
+				for (auto count : summary.histogram) {
+					biggest = std::max(biggest, count);
+				}
+				for (auto count : summary.histogram) {
+					text << levels[count == 0 ? 0 : 1 + (count * 6) / biggest];
+				}
+				text << endl;
+			}
+			return text.str();
+		}
+
+		//----------
+		ScopedTimer::ScopedTimer(const char * name)
+			: name(name)
+			, parent(currentScope)
+			, startTime(0)
+			, enabled(isEnabled()) {
+			if (this->enabled) {
+				currentScope = name;
+				this->startTime = getTime();
+			}
+		}
+
+		//----------
+		ScopedTimer::~ScopedTimer() {
+			if (this->enabled) {
+				recordScope(this->name, this->startTime, getTime());
+				currentScope = this->parent;
+			}
+		}
+	}
+}
@@ -0,0 +1,99 @@
+/*
+ timing and allocation instrumentation for ofxCv's functions.
+
+ it's compiled in only when OFXCV_INSTRUMENTATION is defined (e.g. in the
+ project's preprocessor definitions). otherwise the OFXCV_INSTRUMENT_ macros
+ are empty, so the instrumented functions are exactly as they were.
+
+ each thread records events (a scope's start and duration, or an allocation
+ made by allocate() / imitate()) into its own ring buffer without locking. when
+ a ring is full the oldest events are overwritten. the events can be saved as
+ Chrome trace-event JSON (open in chrome://tracing or ui.perfetto.dev) or
+ summarised per function, with a histogram of durations. exporting while
+ other threads are still recording is fine, but any events overwritten during
+ the export are left out.
+
+ names must be string literals (or otherwise live forever), they're stored by pointer.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef OFXCV_INSTRUMENTATION
+#define OFXCV_INSTRUMENT_CONCAT_INNER(a, b) a##b
+#define OFXCV_INSTRUMENT_CONCAT(a, b) OFXCV_INSTRUMENT_CONCAT_INNER(a, b)
+#define OFXCV_INSTRUMENT_SCOPE(name) ofxCv::Instrumentation::ScopedTimer OFXCV_INSTRUMENT_CONCAT(ofxCvScopedTimer, __LINE__)(name)
+#define OFXCV_INSTRUMENT_ALLOCATION(bytes) ofxCv::Instrumentation::recordAllocation(bytes)
+#else
+#define OFXCV_INSTRUMENT_SCOPE(name)
+#define OFXCV_INSTRUMENT_ALLOCATION(bytes)
+#endif
+
+namespace ofxCv {
+	namespace Instrumentation {
+		struct Summary {
+			std::string name;
+			size_t count = 0;
+
+			// seconds
+			double total = 0.0;
+			double min = 0.0;
+			double max = 0.0;
+			double mean = 0.0;
+			double median = 0.0;
+			double percentile90 = 0.0;
+			double percentile99 = 0.0;
+
+			// histogram[i] counts calls which took [2^i, 2^(i+1)) microseconds (the first bucket includes anything faster)
+			std::vector<size_t> histogram;
+
+			// allocations made directly inside this scope
+			size_t allocationCount = 0;
+			uint64_t allocationBytes = 0;
+		};
+
+		// false when built without OFXCV_INSTRUMENTATION
+		bool isAvailable();
+
+		// recording can also be paused at runtime. it's on by default
+		void setEnabled(bool);
+		bool isEnabled();
+
+		// events kept per thread. only affects threads which haven't recorded anything yet
+		void setBufferCapacity(size_t events);
+
+		// forgets everything recorded so far
+		void clear();
+
+		// nanoseconds on a steady clock
+		uint64_t getTime();
+
+		void recordScope(const char * name, uint64_t startTime, uint64_t endTime);
+
+		// counted against the innermost scope on this thread
+		void recordAllocation(uint64_t bytes);
+
+		// the innermost scope on this thread, or nullptr (always nullptr without OFXCV_INSTRUMENTATION)
+		const char * getCurrentScope();
+
+		bool saveChromeTrace(const std::string & filename);
+
+		// sorted by total time, longest first
+		std::vector<Summary> getSummary();
+		std::string getSummaryString();
+
+		class ScopedTimer {
+		public:
+			ScopedTimer(const char * name);
+			~ScopedTimer();
+		protected:
+			const char * name;
+			const char * parent;
+			uint64_t startTime;
+			bool enabled;
+		};
+	}
+}
@@ -0,0 +1,287 @@
+#include "LaserLine.h"
+#include "Instrumentation.h"
+#include "ThreadingConfig.h"
+
+#include "opencv2/core/hal/intrin.hpp"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	//----------
+	// Sample(i) gives the i'th pixel along the column (or row), count long, peaking at `peak`
+	template<typename Sample>
+	static float estimateCenter(const Sample & sample, int count, int peak, const StripeSettings & settings) {
+		switch (settings.estimator) {
+		case STRIPE_CENTER_OF_MASS:
+		{
+			const int start = max(peak - settings.window, 0);
+			const int end = min(peak + settings.window, count - 1);
+			float sum = 0.0f, weightedSum = 0.0f;
+			for (int i = start; i <= end; i++) {
+				const float weight = sample(i) - settings.threshold;
+				if (weight > 0.0f) {
+					sum += weight;
+					weightedSum += weight * i;
+				}
+			}
+			return sum > 0.0f ? weightedSum / sum : (float) peak;
+		}
+
+		case STRIPE_GAUSSIAN:
+		{
+			if (peak == 0 || peak == count - 1) {
+				return (float) peak;
+			}
+			// logs of 0 would be -inf, so pixels are at least 1
+			const float a = log(max(sample(peak - 1), 1.0f));
+			const float b = log(max(sample(peak), 1.0f));
+			const float c = log(max(sample(peak + 1), 1.0f));
+			const float curvature = a - 2.0f * b + c;
+			return curvature < 0.0f ? peak + 0.5f * (a - c) / curvature : (float) peak;
+		}
+
+		case STRIPE_BLAIS_RIOUX:
+		default:
+		{
+			// g(i) = f(i-2) + f(i-1) - f(i+1) - f(i+2), which is negative on the rising side
+			// and positive on the falling side, crossing zero at the centre
+			auto g = [&](int i) {
+				auto f = [&](int j) {
+					return sample(min(max(j, 0), count - 1));
+				};
+				return f(i - 2) + f(i - 1) - f(i + 1) - f(i + 2);
+			};
+			for (int i = peak - 1; i <= peak; i++) {
+				const float g0 = g(i), g1 = g(i + 1);
+				if (g0 <= 0.0f && g1 > 0.0f) {
+					return i + g0 / (g0 - g1);
+				}
+			}
+			return (float) peak;
+		}
+		}
+	}
+
+	//----------
+	static float getConfidence(float peakValue, float mean, float maxValue) {
+		return min(max((peakValue - mean) / maxValue, 0.0f), 1.0f);
+	}
+
+#if CV_SIMD128
+	//----------
+	static inline v_uint16x8 loadStripePixels(const uchar * source) {
+		return v_load_expand(source);
+	}
+
+	//----------
+	static inline v_uint16x8 loadStripePixels(const ushort * source) {
+		return v_load(source);
+	}
+#endif
+
+	//----------
+	// one pass down the frame, keeping the brightest pixel of each column and the column sums
+	template<typename T>
+	static void findColumnPeaks(const Mat & frame, int rowStart, int rowEnd, ushort * peakValues, ushort * peakRows, unsigned * sums) {
+		const int cols = frame.cols;
+		fill(peakValues, peakValues + cols, 0);
+		fill(peakRows, peakRows + cols, 0);
+		fill(sums, sums + cols, 0);
+
+		for (int y = rowStart; y < rowEnd; y++) {
+			const T * row = frame.ptr<T>(y);
+			int x = 0;
+#if CV_SIMD128
+			const v_uint16x8 rowIndex = v_setall_u16((ushort) y);
+			for (; x <= cols - 8; x += 8) {
+				const v_uint16x8 value = loadStripePixels(row + x);
+				const v_uint16x8 peakValue = v_load(peakValues + x);
+				v_store(peakRows + x, v_select(value > peakValue, rowIndex, v_load(peakRows + x)));
+				v_store(peakValues + x, v_max(value, peakValue));
+
+				v_uint32x4 low, high;
+				v_expand(value, low, high);
+				v_store(sums + x, v_load(sums + x) + low);
+				v_store(sums + x + 4, v_load(sums + x + 4) + high);
+			}
+#endif
+			for (; x < cols; x++) {
+				const ushort value = row[x];
+				if (value > peakValues[x]) {
+					peakValues[x] = value;
+					peakRows[x] = (ushort) y;
+				}
+				sums[x] += value;
+			}
+		}
+	}
+
+	//----------
+	template<typename T>
+	static void findStripeCentersInColumns(const Mat & frame, StripeCenters & result, const StripeSettings & settings) {
+		const int rows = frame.rows, cols = frame.cols;
+		if (rows > numeric_limits<ushort>::max()) {
+			LogError("ofxCv::findStripeCenters") << "Frames taller than " << numeric_limits<ushort>::max() << " rows aren't supported";
+			fill(result.centers.begin(), result.centers.end(), numeric_limits<float>::quiet_NaN());
+			fill(result.confidences.begin(), result.confidences.end(), 0.0f);
+			return;
+		}
+
+		// each band finds its own column peaks, merged in order so that the first peak wins ties
+		const int bandCount = max(1, min(getNumThreads(), rows / 32));
+		Mat peakValues(bandCount, cols, CV_16UC1), peakRows(bandCount, cols, CV_16UC1), sums(bandCount, cols, CV_32SC1);
+		parallelFor(Range(0, bandCount), [&](const Range & range) {
+			for (int band = range.start; band < range.end; band++) {
+				findColumnPeaks<T>(frame, rows * band / bandCount, rows * (band + 1) / bandCount
+					, peakValues.ptr<ushort>(band), peakRows.ptr<ushort>(band), (unsigned *) sums.ptr<int>(band));
+			}
+		});
+
+		const float maxValue = numeric_limits<T>::max();
+		parallelFor(Range(0, cols), [&](const Range & range) {
+			for (int x = range.start; x < range.end; x++) {
+				ushort peakValue = peakValues.at<ushort>(0, x);
+				int peak = peakRows.at<ushort>(0, x);
+				double sum = (unsigned) sums.at<int>(0, x);
+				for (int band = 1; band < bandCount; band++) {
+					if (peakValues.at<ushort>(band, x) > peakValue) {
+						peakValue = peakValues.at<ushort>(band, x);
+						peak = peakRows.at<ushort>(band, x);
+					}
+					sum += (unsigned) sums.at<int>(band, x);
+				}
+
+				if (!(peakValue > settings.threshold)) {
+					result.centers[x] = numeric_limits<float>::quiet_NaN();
+					result.confidences[x] = 0.0f;
+					continue;
+				}
+
+				auto sample = [&](int y) {
+					return (float) frame.ptr<T>(y)[x];
+				};
+				result.centers[x] = estimateCenter(sample, rows, peak, settings);
+				result.confidences[x] = getConfidence(peakValue, (float) (sum / rows), maxValue);
+			}
+		});
+	}
+
+	//----------
+	// the brightest pixel of a row (the first, on ties) and the row sum
+	template<typename T>
+	static void findRowPeak(const T * row, int cols, ushort & peakValue, int & peak, double & sum) {
+		ushort maximum = 0;
+		uint64 total = 0;
+		int x = 0;
+#if CV_SIMD128
+		v_uint16x8 maxima = v_setzero_u16();
+		while (x <= cols - 8) {
+			// flushed every 8192 pixels, so the 32-bit lane sums can't overflow
+			v_uint32x4 sums = v_setzero_u32();
+			const int blockEnd = min(cols - 8, x + 8192 - 8);
+			for (; x <= blockEnd; x += 8) {
+				const v_uint16x8 value = loadStripePixels(row + x);
+				maxima = v_max(maxima, value);
+
+				v_uint32x4 low, high;
+				v_expand(value, low, high);
+				sums += low + high;
+			}
+			total += v_reduce_sum(sums);
+		}
+		maximum = v_reduce_max(maxima);
+#endif
+		for (; x < cols; x++) {
+			maximum = max(maximum, (ushort) row[x]);
+			total += row[x];
+		}
+
+		x = 0;
+#if CV_SIMD128
+		const v_uint16x8 target = v_setall_u16(maximum);
+		while (x <= cols - 8 && !v_check_any(loadStripePixels(row + x) == target)) {
+			x += 8;
+		}
+#endif
+		while (x < cols - 1 && row[x] != maximum) {
+			x++;
+		}
+
+		peakValue = maximum;
+		peak = x;
+		sum = (double) total;
+	}
+
+	//----------
+	template<typename T>
+	static void findStripeCentersInRows(const Mat & frame, StripeCenters & result, const StripeSettings & settings) {
+		const int cols = frame.cols;
+		const float maxValue = numeric_limits<T>::max();
+		parallelFor(Range(0, frame.rows), [&](const Range & range) {
+			for (int y = range.start; y < range.end; y++) {
+				const T * row = frame.ptr<T>(y);
+				ushort peakValue;
+				int peak;
+				double sum;
+				findRowPeak(row, cols, peakValue, peak, sum);
+
+				if (!(peakValue > settings.threshold)) {
+					result.centers[y] = numeric_limits<float>::quiet_NaN();
+					result.confidences[y] = 0.0f;
+					continue;
+				}
+
+				auto sample = [row](int x) {
+					return (float) row[x];
+				};
+				result.centers[y] = estimateCenter(sample, cols, peak, settings);
+				result.confidences[y] = getConfidence(peakValue, (float) (sum / cols), maxValue);
+			}
+		});
+	}
+
+	//----------
+	void findStripeCenters(const Mat & frame, StripeCenters & result, const StripeSettings & settings) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findStripeCenters");
+		if (frame.type() != CV_8UC1 && frame.type() != CV_16UC1) {
+			LogError("ofxCv::findStripeCenters") << "Expected a CV_8UC1 or CV_16UC1 frame";
+			return;
+		}
+
+		const auto count = settings.alongRows ? frame.rows : frame.cols;
+		result.centers.resize(count);
+		result.confidences.resize(count);
+		if (frame.empty()) {
+			return;
+		}
+
+		if (settings.alongRows) {
+			if (frame.depth() == CV_8U) {
+				findStripeCentersInRows<uchar>(frame, result, settings);
+			}
+			else {
+				findStripeCentersInRows<ushort>(frame, result, settings);
+			}
+		}
+		else {
+			if (frame.depth() == CV_8U) {
+				findStripeCentersInColumns<uchar>(frame, result, settings);
+			}
+			else {
+				findStripeCentersInColumns<ushort>(frame, result, settings);
+			}
+		}
+	}
+
+	//----------
+	void findStripeCenters(const Mat & frame, StripeCenters & result) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::findStripeCenters");
+		findStripeCenters(frame, result, StripeSettings());
+	}
+}
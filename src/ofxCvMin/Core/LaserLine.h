@@ -0,0 +1,62 @@
+/*
+ sub-pixel centre of a laser line (or any bright stripe) in every column of a
+ frame, or every row, for laser triangulation and line-scan capture.
+
+ finding the brightest pixel in each column is a single pass down the frame,
+ 8 columns at a time with SIMD, split into row bands across threads. the
+ column means are gathered in the same pass for the confidence. along rows,
+ each row is scanned 8 pixels at a time for its maximum and sum, one thread per
+ band of rows. then the centre is estimated from the few pixels around each peak.
+
+ estimators (see Fisher & Naidu, "A comparison of algorithms for subpixel peak
+ detection" 1996):
+ - centre of mass over a window around the peak
+ - Gaussian fit through the peak and its two neighbours
+ - Blais-Rioux: zero crossing of a 4th order derivative filter, which holds up
+   well on saturated stripes
+ */
+
+#pragma once
+
+#include "Platform.h"
+#include "opencv2/opencv.hpp"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	enum StripeEstimator {
+		STRIPE_CENTER_OF_MASS,
+		STRIPE_GAUSSIAN,
+		STRIPE_BLAIS_RIOUX
+	};
+
+	struct StripeSettings {
+		StripeEstimator estimator = STRIPE_GAUSSIAN;
+
+		// false = one centre per column (for a roughly horizontal line), true = one per row
+		bool alongRows = false;
+
+		// columns (or rows) with no pixel brighter than this have no centre
+		float threshold = 32.0f;
+
+		// half width of the centre of mass window (pixels)
+		int window = 3;
+	};
+
+	struct StripeCenters {
+		// sub-pixel row (or column) of the stripe, NaN where there is none
+		vector<float> centers;
+
+		// 0 to 1, how far the peak stands above the rest of its column (or row)
+		vector<float> confidences;
+
+		size_t size() const {
+			return this->centers.size();
+		}
+	};
+
+	// frame is CV_8UC1 or CV_16UC1. result is reused between calls without reallocating
+	void findStripeCenters(const Mat & frame, StripeCenters & result, const StripeSettings & settings);
+	void findStripeCenters(const Mat & frame, StripeCenters & result);
+}
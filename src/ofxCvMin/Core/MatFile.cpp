@@ -0,0 +1,355 @@
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MatFile.h"
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	static const char matFileMagic[8] = { 'O', 'F', 'X', 'C', 'V', 'M', 'A', 'T' };
+	static const uint32_t matFileVersion = 1;
+	static const size_t matFileHeaderSize = 512; // keeps the data 64 byte aligned in the mapping
+	static const int matFileMaxDims = 32; // CV_MAX_DIM, fixed here so the layout doesn't depend on the OpenCV build
+
+	struct MatFileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t headerSize;
+		int32_t type;
+		int32_t dims;
+		int32_t sizes[matFileMaxDims];
+		uint64_t steps[matFileMaxDims];
+		uint64_t dataSize;
+		uint64_t checksum;
+	};
+	static_assert(sizeof(MatFileHeader) <= matFileHeaderSize, "MatFileHeader doesn't fit in the header block");
+
+	//----------
+	// a multiplicative hash over 4 interleaved 64-bit lanes, so it runs near memory speed
+	static uint64_t matFileChecksum(const unsigned char * data, size_t size) {
+		const uint64_t prime = 0x9E3779B97F4A7C15ULL;
+		uint64_t lanes[4] = { size, prime, ~(uint64_t) size, prime * 3 };
+
+		size_t i = 0;
+		for (; i + 32 <= size; i += 32) {
+			for (int lane = 0; lane < 4; lane++) {
+				uint64_t word;
+				memcpy(&word, data + i + lane * 8, 8);
+				lanes[lane] = (lanes[lane] ^ word) * prime;
+				lanes[lane] ^= lanes[lane] >> 29;
+			}
+		}
+		for (; i < size; i++) {
+			lanes[0] = (lanes[0] ^ data[i]) * prime;
+		}
+
+		uint64_t hash = 0;
+		for (auto lane : lanes) {
+			hash = (hash ^ lane) * prime;
+			hash ^= hash >> 32;
+		}
+		return hash;
+	}
+
+	//----------
+	bool isBinaryMatFile(const string & filename) {
+		const auto dot = filename.find_last_of('.');
+		if (dot == string::npos) {
+			return false;
+		}
+		auto extension = filename.substr(dot + 1);
+		transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char) tolower(c); });
+		return extension == "cvmat";
+	}
+
+	//----------
+	bool saveMatBinary(const Mat & mat, const string & filename) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::saveMatBinary");
+		if (mat.dims > matFileMaxDims) {
+			LogError("ofxCv::saveMatBinary") << "Too many dimensions";
+			return false;
+		}
+
+		// the file is always laid out continuously
+		const Mat continuous = mat.isContinuous() ? mat : mat.clone();
+		const size_t dataSize = continuous.total() * continuous.elemSize();
+
+		MatFileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, matFileMagic, sizeof(matFileMagic));
+		header.version = matFileVersion;
+		header.headerSize = (uint32_t) matFileHeaderSize;
+		header.type = continuous.type();
+		header.dims = continuous.dims;
+		for (int i = 0; i < continuous.dims; i++) {
+			header.sizes[i] = continuous.size[i];
+			header.steps[i] = continuous.step[i];
+		}
+		header.dataSize = dataSize;
+		header.checksum = matFileChecksum(continuous.data, dataSize);
+
+		vector<char> headerBlock(matFileHeaderSize, 0);
+		memcpy(headerBlock.data(), &header, sizeof(header));
+
+		ofstream file(getPath(filename), ios::binary | ios::trunc);
+		if (!file) {
+			LogError("ofxCv::saveMatBinary") << "Couldn't open " << filename << " for writing";
+			return false;
+		}
+		file.write(headerBlock.data(), headerBlock.size());
+		if (dataSize > 0) {
+			file.write((const char *) continuous.data, dataSize);
+		}
+		if (!file) {
+			LogError("ofxCv::saveMatBinary") << "Couldn't write " << filename;
+			return false;
+		}
+		return true;
+	}
+
+	//----------
+	// the mapping of a file, released when the last Mat using it is
+	struct MappedFile {
+		void * base = nullptr;
+		size_t length = 0;
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = NULL;
+#endif
+
+		bool open(const string & path) {
+#ifdef _WIN32
+			this->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (this->file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(this->file, &size) || size.QuadPart == 0) {
+				return false;
+			}
+			this->length = (size_t) size.QuadPart;
+			this->mapping = CreateFileMappingA(this->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+			if (!this->mapping) {
+				return false;
+			}
+			this->base = MapViewOfFile(this->mapping, FILE_MAP_COPY, 0, 0, 0);
+			return this->base != nullptr;
+#else
+			const int descriptor = ::open(path.c_str(), O_RDONLY);
+			if (descriptor < 0) {
+				return false;
+			}
+			struct stat status;
+			if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+				::close(descriptor);
+				return false;
+			}
+			this->length = (size_t) status.st_size;
+			void * mapped = mmap(nullptr, this->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+			::close(descriptor); // the mapping holds its own reference
+			if (mapped == MAP_FAILED) {
+				return false;
+			}
+			this->base = mapped;
+			return true;
+#endif
+		}
+
+		~MappedFile() {
+#ifdef _WIN32
+			if (this->base) {
+				UnmapViewOfFile(this->base);
+			}
+			if (this->mapping) {
+				CloseHandle(this->mapping);
+			}
+			if (this->file != INVALID_HANDLE_VALUE) {
+				CloseHandle(this->file);
+			}
+#else
+			if (this->base) {
+				munmap(this->base, this->length);
+			}
+#endif
+		}
+	};
+
+	//----------
+	// only ever used to release mapped Mats (through UMatData::currAllocator)
+	class MappedMatAllocator : public MatAllocator {
+	public:
+		UMatData * allocate(int dims, const int * sizes, int type, void * data, size_t * step, AccessFlag flags, UMatUsageFlags usageFlags) const override {
+			return Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+		}
+
+		bool allocate(UMatData * data, AccessFlag accessFlags, UMatUsageFlags usageFlags) const override {
+			return Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+		}
+
+		void deallocate(UMatData * data) const override {
+			if (!data) {
+				return;
+			}
+			delete (MappedFile *) data->userdata;
+			delete data;
+		}
+	};
+
+	//----------
+	static MappedMatAllocator & getMappedMatAllocator() {
+		static MappedMatAllocator allocator;
+		return allocator;
+	}
+
+	//----------
+	static bool checkHeader(const MatFileHeader & header, size_t fileSize, const string & filename) {
+		if (memcmp(header.magic, matFileMagic, sizeof(matFileMagic)) != 0) {
+			LogError("ofxCv::loadMatBinary") << filename << " isn't a binary Mat file";
+			return false;
+		}
+		if (header.version != matFileVersion) {
+			LogError("ofxCv::loadMatBinary") << filename << " has unsupported version " << header.version;
+			return false;
+		}
+		if (header.headerSize < sizeof(MatFileHeader) || header.headerSize % 64 != 0
+			|| header.headerSize > fileSize || header.dataSize > fileSize - header.headerSize) {
+			LogError("ofxCv::loadMatBinary") << filename << " is truncated or corrupt";
+			return false;
+		}
+
+		// an empty Mat is saved with no dimensions and no data
+		if (header.dims == 0 && header.dataSize == 0) {
+			return true;
+		}
+
+		// everything below sizes the Mat we read into or lay over the mapping, so
+		// it all has to agree with dataSize
+		if (header.dims < 1 || header.dims > matFileMaxDims
+			|| (header.type & ~CV_MAT_TYPE_MASK) != 0 || CV_MAT_DEPTH(header.type) > CV_16F) {
+			LogError("ofxCv::loadMatBinary") << filename << " has an invalid type or dimensions";
+			return false;
+		}
+		uint64_t expectedSize = CV_ELEM_SIZE(header.type);
+		for (int i = header.dims - 1; i >= 0; i--) {
+			if (header.sizes[i] < 0 || header.steps[i] != expectedSize) {
+				LogError("ofxCv::loadMatBinary") << filename << " has invalid sizes or steps";
+				return false;
+			}
+			if (header.sizes[i] > 0 && expectedSize > header.dataSize / header.sizes[i]) {
+				LogError("ofxCv::loadMatBinary") << filename << " has sizes which don't match its data size";
+				return false;
+			}
+			expectedSize *= header.sizes[i];
+		}
+		if (expectedSize != header.dataSize) {
+			LogError("ofxCv::loadMatBinary") << filename << " has sizes which don't match its data size";
+			return false;
+		}
+		return true;
+	}
+
+	//----------
+	bool loadMatBinary(Mat & mat, const string & filename, bool memoryMap, bool verifyChecksum) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::loadMatBinary");
+		const auto path = getPath(filename);
+		MatFileHeader header;
+
+		if (memoryMap) {
+			auto mappedFile = new MappedFile();
+			if (!mappedFile->open(path) || mappedFile->length < sizeof(MatFileHeader)) {
+				LogError("ofxCv::loadMatBinary") << "Couldn't map " << filename;
+				delete mappedFile;
+				return false;
+			}
+			memcpy(&header, mappedFile->base, sizeof(header));
+			if (!checkHeader(header, mappedFile->length, filename)) {
+				delete mappedFile;
+				return false;
+			}
+
+			if (header.dims == 0) {
+				delete mappedFile;
+				mat.release();
+				return true;
+			}
+
+			auto data = (unsigned char *) mappedFile->base + header.headerSize;
+			if (verifyChecksum && matFileChecksum(data, header.dataSize) != header.checksum) {
+				LogError("ofxCv::loadMatBinary") << filename << " failed its checksum";
+				delete mappedFile;
+				return false;
+			}
+
+			size_t steps[matFileMaxDims];
+			for (int i = 0; i < header.dims; i++) {
+				steps[i] = (size_t) header.steps[i];
+			}
+			Mat mapped(header.dims, header.sizes, header.type, data, steps);
+
+			// hand ownership of the mapping to the Mat's reference count
+			auto owner = new UMatData(&getMappedMatAllocator());
+			owner->data = owner->origdata = data;
+			owner->size = header.dataSize;
+			owner->userdata = mappedFile;
+			owner->currAllocator = &getMappedMatAllocator();
+			owner->refcount = 1;
+			mapped.u = owner;
+
+			mat = mapped;
+			return true;
+		}
+
+		ifstream file(path, ios::binary | ios::ate);
+		if (!file) {
+			LogError("ofxCv::loadMatBinary") << "Couldn't open " << filename;
+			return false;
+		}
+		const size_t fileSize = (size_t) file.tellg();
+		file.seekg(0);
+		if (fileSize < sizeof(MatFileHeader) || !file.read((char *) &header, sizeof(header)) || !checkHeader(header, fileSize, filename)) {
+			return false;
+		}
+
+		if (header.dims == 0) {
+			mat.release();
+			return true;
+		}
+
+		// a ROI of the same size and type survives create(), but we read into it as one block
+		mat.create(header.dims, header.sizes, header.type);
+		if (!mat.isContinuous()) {
+			mat = Mat(header.dims, header.sizes, header.type);
+		}
+		file.seekg(header.headerSize);
+		if (!file.read((char *) mat.data, header.dataSize)) {
+			LogError("ofxCv::loadMatBinary") << "Couldn't read " << filename;
+			return false;
+		}
+		if (verifyChecksum && matFileChecksum(mat.data, header.dataSize) != header.checksum) {
+			LogError("ofxCv::loadMatBinary") << filename << " failed its checksum";
+			return false;
+		}
+		return true;
+	}
+}
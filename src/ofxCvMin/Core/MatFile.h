@@ -0,0 +1,29 @@
+/*
+ binary Mat files (.cvmat), used by loadMat and saveMat for filenames with that
+ extension. other extensions still go through cv::FileStorage.
+
+ the file is a fixed 512 byte header (type, dimensions, strides, data size and a
+ checksum of the data) followed by the raw data, so saving is one write and
+ loading can memory-map the file. a mapped Mat reads straight from the file's
+ pages and keeps the mapping open until the last Mat sharing it is released.
+ writing into a mapped Mat doesn't change the file (the mapping is copy-on-write).
+ */
+
+#pragma once
+
+#include "Platform.h"
+#include "opencv2/opencv.hpp"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	// true if the filename ends in .cvmat
+	bool isBinaryMatFile(const string & filename);
+
+	bool saveMatBinary(const Mat & mat, const string & filename);
+
+	// memoryMap = false reads the data into a normally allocated Mat instead.
+	// verifyChecksum reads all of the data once, which defeats some of the point of mapping
+	bool loadMatBinary(Mat & mat, const string & filename, bool memoryMap = true, bool verifyChecksum = false);
+}
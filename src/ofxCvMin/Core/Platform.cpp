@@ -0,0 +1,62 @@
+#include "Platform.h"
+
+#include <iostream>
+#include <mutex>
+
+namespace ofxCv {
+
+	// function statics, so they work during static initialisation too
+	static std::mutex & getPlatformLock() {
+		static std::mutex lock;
+		return lock;
+	}
+
+	static LogFunction & getLogFunction() {
+		static LogFunction function;
+		return function;
+	}
+
+	static PathFunction & getPathFunction() {
+		static PathFunction function;
+		return function;
+	}
+
+	//----------
+	void setLogFunction(LogFunction function) {
+		std::lock_guard<std::mutex> lock(getPlatformLock());
+		getLogFunction() = function;
+	}
+
+	//----------
+	void setPathFunction(PathFunction function) {
+		std::lock_guard<std::mutex> lock(getPlatformLock());
+		getPathFunction() = function;
+	}
+
+	//----------
+	void writeLog(LogLevel level, const string & module, const string & message) {
+		LogFunction function;
+		{
+			std::lock_guard<std::mutex> lock(getPlatformLock());
+			function = getLogFunction();
+		}
+		if (function) {
+			function(level, module, message);
+			return;
+		}
+
+		// the same layout as ofLog's console output
+		const char * levelNames[] = { "verbose", "notice", "warning", "error" };
+		std::cerr << "[" << levelNames[(int) level] << "] " << module << ": " << message << std::endl;
+	}
+
+	//----------
+	string getPath(const string & filename) {
+		PathFunction function;
+		{
+			std::lock_guard<std::mutex> lock(getPlatformLock());
+			function = getPathFunction();
+		}
+		return function ? function(filename) : filename;
+	}
+}
@@ -0,0 +1,83 @@
+/*
+ the few things the core needs from whatever it's running in: somewhere to
+ send log messages, and a way to turn filenames into paths.
+
+ the core (everything in this folder) only uses OpenCV and glm, so it can be
+ built on its own (ofxCvMinCoreLib) for headless workers. by default messages
+ go to std::cerr and filenames are used as they are. when the openFrameworks
+ layer is linked in, messages go to ofLog and filenames are relative to the
+ data folder, as they are everywhere else in ofxCv.
+ */
+
+#pragma once
+
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ofxCv {
+
+	// the core is written like the rest of ofxCv, which gets these from ofMain.h
+	using std::string;
+	using std::vector;
+
+	enum class LogLevel {
+		Verbose,
+		Notice,
+		Warning,
+		Error
+	};
+
+	typedef std::function<void(LogLevel, const string & module, const string & message)> LogFunction;
+	typedef std::function<string(const string & filename)> PathFunction;
+
+	// pass nullptr to go back to the defaults
+	void setLogFunction(LogFunction);
+	void setPathFunction(PathFunction);
+
+	void writeLog(LogLevel, const string & module, const string & message);
+	string getPath(const string & filename);
+
+	// used like ofLogError etc, the message is sent at the end of the statement
+	class LogMessage {
+	public:
+		LogMessage(LogLevel level, const string & module)
+			: level(level)
+			, module(module) { }
+
+		~LogMessage() {
+			writeLog(this->level, this->module, this->message.str());
+		}
+
+		template<class T>
+		LogMessage & operator<<(const T & value) {
+			this->message << value;
+			return *this;
+		}
+	protected:
+		LogLevel level;
+		string module;
+		std::ostringstream message;
+	};
+
+	class LogVerbose : public LogMessage {
+	public:
+		LogVerbose(const string & module) : LogMessage(LogLevel::Verbose, module) { }
+	};
+
+	class LogNotice : public LogMessage {
+	public:
+		LogNotice(const string & module) : LogMessage(LogLevel::Notice, module) { }
+	};
+
+	class LogWarning : public LogMessage {
+	public:
+		LogWarning(const string & module) : LogMessage(LogLevel::Warning, module) { }
+	};
+
+	class LogError : public LogMessage {
+	public:
+		LogError(const string & module) : LogMessage(LogLevel::Error, module) { }
+	};
+}
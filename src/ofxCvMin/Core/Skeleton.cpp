@@ -0,0 +1,238 @@
+#include "Skeleton.h"
+#include "Instrumentation.h"
+#include "ThreadingConfig.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	//----------
+	static void buildZhangSuen(unsigned char * table, int subIteration) {
+		for (int code = 0; code < 256; code++) {
+			int p[8];
+			for (int i = 0; i < 8; i++) {
+				p[i] = (code >> i) & 1;
+			}
+			const auto & n = p[0], & e = p[2], & s = p[4], & w = p[6];
+
+			int count = 0, transitions = 0;
+			for (int i = 0; i < 8; i++) {
+				count += p[i];
+				transitions += !p[i] && p[(i + 1) % 8];
+			}
+
+			bool remove = count >= 2 && count <= 6 && transitions == 1;
+			if (subIteration == 0) {
+				remove = remove && !(n && e && s) && !(e && s && w);
+			}
+			else {
+				remove = remove && !(n && e && w) && !(n && s && w);
+			}
+			table[code] = remove ? 1 : 0;
+		}
+	}
+
+	//----------
+	static void buildGuoHall(unsigned char * table, int subIteration) {
+		for (int code = 0; code < 256; code++) {
+			int p[8];
+			for (int i = 0; i < 8; i++) {
+				p[i] = (code >> i) & 1;
+			}
+			// p2..p9 in the paper's notation
+			const int p2 = p[0], p3 = p[1], p4 = p[2], p5 = p[3], p6 = p[4], p7 = p[5], p8 = p[6], p9 = p[7];
+
+			const int c = (!p2 && (p3 || p4)) + (!p4 && (p5 || p6)) + (!p6 && (p7 || p8)) + (!p8 && (p9 || p2));
+			const int n1 = (p9 || p2) + (p3 || p4) + (p5 || p6) + (p7 || p8);
+			const int n2 = (p2 || p3) + (p4 || p5) + (p6 || p7) + (p8 || p9);
+			const int n = min(n1, n2);
+			const int m = subIteration == 0
+				? ((p6 || p7 || !p9) && p8)
+				: ((p2 || p3 || !p5) && p4);
+
+			table[code] = (c == 1 && n >= 2 && n <= 3 && m == 0) ? 1 : 0;
+		}
+	}
+
+	//----------
+	const unsigned char * getSkeletonLookupTable(SkeletonMethod method, int subIteration) {
+		struct Tables {
+			unsigned char zhangSuen[2][256];
+			unsigned char guoHall[2][256];
+			Tables() {
+				for (int i = 0; i < 2; i++) {
+					buildZhangSuen(this->zhangSuen[i], i);
+					buildGuoHall(this->guoHall[i], i);
+				}
+			}
+		};
+		static const Tables tables;
+
+		subIteration = subIteration ? 1 : 0;
+		return method == SKELETON_GUO_HALL
+			? tables.guoHall[subIteration]
+			: tables.zhangSuen[subIteration];
+	}
+
+	//----------
+	int skeletonize(Mat & mask, SkeletonMethod method, int maxIterations) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::skeletonize");
+		const unsigned char * lookupTables[2] = {
+			getSkeletonLookupTable(method, 0),
+			getSkeletonLookupTable(method, 1)
+		};
+		return skeletonize(mask, lookupTables, maxIterations);
+	}
+
+	//----------
+	int skeletonize(Mat & mask, const unsigned char * lookupTables[2], int maxIterations) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::skeletonize");
+		if (mask.type() != CV_8UC1) {
+			LogError("ofxCv::skeletonize") << "Expected a CV_8UC1 mask";
+			return 0;
+		}
+		if (mask.empty()) {
+			return 0;
+		}
+
+		// work on a 0/1 copy with a 1 pixel border, so neighbours never need bounds checks
+		const int rows = mask.rows, cols = mask.cols;
+		const int width = cols + 2;
+		Mat padded(rows + 2, width, CV_8UC1, Scalar(0));
+		Mat(mask != 0).copyTo(padded(cv::Rect(1, 1, cols, rows)));
+		padded /= 255;
+		unsigned char * pixels = padded.ptr<unsigned char>();
+
+		// neighbour offsets, clockwise from north to match the lookup table bits
+		const int offsets[8] = { -width, -width + 1, 1, width + 1, width, width - 1, -1, -width - 1 };
+		auto neighbourhood = [&](int index) {
+			const unsigned char * p = pixels + index;
+			return p[offsets[0]]
+				| (p[offsets[1]] << 1)
+				| (p[offsets[2]] << 2)
+				| (p[offsets[3]] << 3)
+				| (p[offsets[4]] << 4)
+				| (p[offsets[5]] << 5)
+				| (p[offsets[6]] << 6)
+				| (p[offsets[7]] << 7);
+		};
+
+		// each stripe owns a range of rows: its frontiers, deletions and queued flags.
+		// a pixel is in frontier k if its neighbourhood changed since sub-iteration k last tested it
+		struct Stripe {
+			int rowStart;
+			int rowEnd;
+			vector<int> frontier[2];
+			vector<int> deletions;
+		};
+		const int stripeCount = max(1, min(getNumThreads() * 4, rows / 16));
+		vector<Stripe> stripes(stripeCount);
+		for (int i = 0; i < stripeCount; i++) {
+			stripes[i].rowStart = 1 + rows * i / stripeCount;
+			stripes[i].rowEnd = 1 + rows * (i + 1) / stripeCount;
+		}
+		Mat queued(padded.size(), CV_8UC1, Scalar(0));
+		unsigned char * queuedFlags = queued.ptr<unsigned char>();
+
+		// interior pixels can't be removed by either test, so start from the boundary pixels
+		parallelFor(Range(0, stripeCount), [&](const Range & range) {
+			for (int s = range.start; s < range.end; s++) {
+				auto & stripe = stripes[s];
+				for (int y = stripe.rowStart; y < stripe.rowEnd; y++) {
+					for (int x = 1; x <= cols; x++) {
+						const int index = y * width + x;
+						if (pixels[index] && neighbourhood(index) != 0xff) {
+							stripe.frontier[0].push_back(index);
+							stripe.frontier[1].push_back(index);
+							queuedFlags[index] = 3;
+						}
+					}
+				}
+			}
+		});
+
+		int iterations = 0;
+		int idleSubIterations = 0;
+		for (int subIteration = 0; maxIterations <= 0 || iterations < maxIterations; subIteration = 1 - subIteration) {
+			const auto table = lookupTables[subIteration];
+			const unsigned char bit = 1 << subIteration;
+
+			// decide which pixels go. this only reads pixels, so stripes can look across their edges
+			parallelFor(Range(0, stripeCount), [&](const Range & range) {
+				for (int s = range.start; s < range.end; s++) {
+					auto & stripe = stripes[s];
+					stripe.deletions.clear();
+					for (auto index : stripe.frontier[subIteration]) {
+						queuedFlags[index] &= ~bit;
+						if (pixels[index] && table[neighbourhood(index)]) {
+							stripe.deletions.push_back(index);
+						}
+					}
+					stripe.frontier[subIteration].clear();
+				}
+			});
+
+			size_t deletionCount = 0;
+			for (const auto & stripe : stripes) {
+				deletionCount += stripe.deletions.size();
+			}
+
+			if (subIteration == 1) {
+				iterations++;
+			}
+			if (deletionCount == 0) {
+				// done once both tests have passed over an unchanged image
+				if (++idleSubIterations >= 2) {
+					break;
+				}
+				continue;
+			}
+			idleSubIterations = 0;
+
+			// remove them, and queue their neighbours for both tests. every stripe only writes
+			// to its own rows, picking up removals from the stripes either side at its edges
+			parallelFor(Range(0, stripeCount), [&](const Range & range) {
+				for (int s = range.start; s < range.end; s++) {
+					auto & stripe = stripes[s];
+					for (auto index : stripe.deletions) {
+						pixels[index] = 0;
+					}
+
+					const int indexStart = stripe.rowStart * width;
+					const int indexEnd = stripe.rowEnd * width;
+					for (int source = max(s - 1, 0); source <= min(s + 1, stripeCount - 1); source++) {
+						for (auto index : stripes[source].deletions) {
+							for (auto offset : offsets) {
+								const int neighbour = index + offset;
+								if (neighbour < indexStart || neighbour >= indexEnd || !pixels[neighbour]) {
+									continue;
+								}
+								for (int k = 0; k < 2; k++) {
+									if (!(queuedFlags[neighbour] & (1 << k))) {
+										queuedFlags[neighbour] |= 1 << k;
+										stripe.frontier[k].push_back(neighbour);
+									}
+								}
+							}
+						}
+					}
+				}
+			});
+		}
+
+		// clear whatever was removed, leaving the rest of the mask as it was
+		parallelFor(Range(0, rows), [&](const Range & range) {
+			for (int y = range.start; y < range.end; y++) {
+				unsigned char * row = mask.ptr<unsigned char>(y);
+				const unsigned char * skeleton = padded.ptr<unsigned char>(y + 1) + 1;
+				for (int x = 0; x < cols; x++) {
+					if (!skeleton[x]) {
+						row[x] = 0;
+					}
+				}
+			}
+		});
+
+		return iterations;
+	}
+}
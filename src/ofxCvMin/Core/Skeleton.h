@@ -0,0 +1,39 @@
+/*
+ iterative skeletonisation (thinning) of binary masks, as used by thin().
+
+ both methods alternate two sub-iterations which each remove boundary pixels
+ whose 3x3 neighbourhood passes a test, until nothing changes. the test is a 256
+ entry lookup table on the 8 neighbours.
+
+ only pixels next to something that was removed are tested again, so the later
+ iterations (which remove very little) cost almost nothing. the image is split
+ into horizontal stripes which are processed in parallel. each sub-iteration
+ decides everything before removing anything, so the result doesn't depend on
+ the stripes or the order pixels are visited.
+ */
+
+#pragma once
+
+#include "Platform.h"
+#include "opencv2/opencv.hpp"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	enum SkeletonMethod {
+		SKELETON_ZHANG_SUEN, // Zhang & Suen, "A fast parallel algorithm for thinning digital patterns" (1984)
+		SKELETON_GUO_HALL // Guo & Hall, "Parallel thinning with two-subiteration algorithms" (1989), gives slightly thinner diagonals
+	};
+
+	// 256 entries, 1 = remove the centre pixel. the neighbours are bits 0-7 clockwise from
+	// north (N, NE, E, SE, S, SW, W, NW). subIteration is 0 or 1.
+	const unsigned char * getSkeletonLookupTable(SkeletonMethod method, int subIteration);
+
+	// thins the non-zero pixels of a CV_8UC1 mask in place. pixels which remain keep their value.
+	// maxIterations = 0 runs until the skeleton is complete. returns the number of iterations run.
+	int skeletonize(Mat & mask, SkeletonMethod method = SKELETON_ZHANG_SUEN, int maxIterations = 0);
+
+	// as above with your own pair of lookup tables (e.g. to keep end points)
+	int skeletonize(Mat & mask, const unsigned char * lookupTables[2], int maxIterations = 0);
+}
@@ -0,0 +1,550 @@
+#include "ThreadingConfig.h"
+
+#include "opencv2/core/parallel/parallel_backend.hpp"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+using namespace std;
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	typedef std::function<void()> Task;
+
+	class ThreadPool;
+
+	static thread_local ThreadPool * threadPool = nullptr; // the pool this thread is a worker of
+	static thread_local int threadIndex = -1;
+	static thread_local Lane threadLane = Lane::Frame;
+
+	static std::atomic<size_t> frameTaskCount{ 0 };
+	static std::atomic<size_t> backgroundTaskCount{ 0 };
+	static std::atomic<size_t> stealCount{ 0 };
+	static std::atomic<size_t> preemptionCount{ 0 };
+
+	// until setup(), parallelFor goes straight to cv::parallel_for_ so the pool
+	// doesn't start next to OpenCV's own threads
+	static std::atomic<bool> setupCalled{ false };
+
+	//----------
+	static void pinThread(int cpu) {
+#if defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if (cpu >= CPU_SETSIZE || pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+			LogWarning("ofxCv::ThreadingConfig") << "Couldn't pin a worker to CPU " << cpu;
+		}
+#elif defined(_WIN32)
+		if (cpu >= (int) (sizeof(DWORD_PTR) * 8) || SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu) == 0) {
+			LogWarning("ofxCv::ThreadingConfig") << "Couldn't pin a worker to CPU " << cpu;
+		}
+#else
+		(void) cpu;
+#endif
+	}
+
+	//----------
+	// a fixed set of workers. changing the settings makes a new pool and stops
+	// the old one once its queued work is done
+	class ThreadPool {
+	public:
+		ThreadPool(int threadCount, const vector<int> & cpus) {
+			for (int i = 0; i < threadCount; i++) {
+				this->workers.emplace_back(new Worker());
+			}
+			for (int i = 0; i < threadCount; i++) {
+				const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+				this->workers[i]->thread = std::thread([this, i, cpu]() {
+					this->run(i, cpu);
+				});
+			}
+		}
+
+		~ThreadPool() {
+			this->stop();
+		}
+
+		int getThreadCount() const {
+			return (int) this->workers.size();
+		}
+
+		bool isWaiting(Lane lane) const {
+			return this->waiting[(int) lane].load() > 0;
+		}
+
+		// returns false (and leaves the task alone) if there are no workers to run it
+		bool push(Task && task, Lane lane) {
+			if (this->workers.empty()) {
+				return false;
+			}
+			if (threadPool == this) {
+				// a worker's own tasks go at the back of its queue
+				auto & worker = *this->workers[threadIndex];
+				this->waiting[(int) lane]++;
+				std::lock_guard<std::mutex> lock(worker.lock);
+				worker.tasks[(int) lane].push_back(std::move(task));
+			}
+			else {
+				std::shared_lock<std::shared_mutex> stopLock(this->stopLock);
+				if (this->stopping.load()) {
+					return false;
+				}
+				this->waiting[(int) lane]++;
+				std::lock_guard<std::mutex> lock(this->injected.lock);
+				this->injected.tasks[(int) lane].push_back(std::move(task));
+			}
+			(lane == Lane::Frame ? frameTaskCount : backgroundTaskCount)++;
+
+			{
+				std::lock_guard<std::mutex> lock(this->wakeLock);
+			}
+			this->wake.notify_one();
+			return true;
+		}
+
+		// runs whatever is queued, then joins the workers
+		void stop() {
+			{
+				std::unique_lock<std::shared_mutex> lock(this->stopLock);
+				this->stopping.store(true);
+			}
+			{
+				std::lock_guard<std::mutex> lock(this->wakeLock);
+			}
+			this->wake.notify_all();
+			for (auto & worker : this->workers) {
+				if (worker->thread.joinable()) {
+					worker->thread.join();
+				}
+			}
+		}
+	protected:
+		struct Worker {
+			std::mutex lock;
+			std::deque<Task> tasks[2]; // a queue for each lane
+			std::thread thread;
+		};
+
+		//----------
+		void run(int index, int cpu) {
+			threadPool = this;
+			threadIndex = index;
+			if (cpu >= 0) {
+				pinThread(cpu);
+			}
+
+			Task task;
+			while (true) {
+				if (this->pop(index, task)) {
+					task();
+					task = nullptr;
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock(this->wakeLock);
+				this->wake.wait(lock, [this]() {
+					return this->stopping.load() || this->getWaitingCount() > 0;
+				});
+				if (this->stopping.load() && this->getWaitingCount() == 0) {
+					break;
+				}
+			}
+		}
+
+		//----------
+		bool pop(int index, Task & task) {
+			const size_t workerCount = this->workers.size();
+			for (int lane = 0; lane < 2; lane++) {
+				if (this->waiting[lane].load() == 0) {
+					continue;
+				}
+
+				// newest first from our own queue (its data is most likely still in cache),
+				// oldest first from everywhere else
+				if (this->take(*this->workers[index], lane, true, task)) {
+					return true;
+				}
+				if (this->take(this->injected, lane, false, task)) {
+					return true;
+				}
+				for (size_t i = 1; i < workerCount; i++) {
+					if (this->take(*this->workers[(index + i) % workerCount], lane, false, task)) {
+						stealCount++;
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		//----------
+		bool take(Worker & worker, int lane, bool newest, Task & task) {
+			std::lock_guard<std::mutex> lock(worker.lock);
+			auto & tasks = worker.tasks[lane];
+			if (tasks.empty()) {
+				return false;
+			}
+			if (newest) {
+				task = std::move(tasks.back());
+				tasks.pop_back();
+			}
+			else {
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			this->waiting[lane]--;
+			return true;
+		}
+
+		//----------
+		size_t getWaitingCount() const {
+			return this->waiting[0].load() + this->waiting[1].load();
+		}
+
+		vector<unique_ptr<Worker>> workers;
+		Worker injected; // tasks from threads outside the pool
+
+		std::atomic<size_t> waiting[2] = { { 0 }, { 0 } }; // queued tasks in each lane
+
+		std::mutex wakeLock;
+		std::condition_variable wake;
+
+		std::shared_mutex stopLock;
+		std::atomic<bool> stopping{ false };
+	};
+
+	//----------
+	struct ThreadingState {
+		std::mutex lock; // settings and pool
+		std::mutex resizeLock; // one change at a time
+		ThreadingConfig::Settings settings;
+		shared_ptr<ThreadPool> pool;
+		bool usedForOpenCv = false;
+	};
+
+	//----------
+	static ThreadingState & getState() {
+		// never destroyed, joining threads during static destruction hangs on Windows
+		static ThreadingState * state = new ThreadingState();
+		return *state;
+	}
+
+	//----------
+	static int getResolvedThreadCount(int threadCount) {
+		if (threadCount < 0) {
+			return std::max((int) std::thread::hardware_concurrency() - 1, 0);
+		}
+		return threadCount;
+	}
+
+	//----------
+	static shared_ptr<ThreadPool> getPool() {
+		auto & state = getState();
+		std::lock_guard<std::mutex> lock(state.lock);
+		if (!state.pool) {
+			state.pool = make_shared<ThreadPool>(getResolvedThreadCount(state.settings.threadCount), state.settings.cpus);
+		}
+		return state.pool;
+	}
+
+	//----------
+	static void applySettings(const ThreadingConfig::Settings & settings) {
+		if (threadPool) {
+			LogError("ofxCv::ThreadingConfig") << "Threading settings can't be changed from one of the pool's workers";
+			return;
+		}
+
+		auto & state = getState();
+		std::lock_guard<std::mutex> resizeLock(state.resizeLock);
+		shared_ptr<ThreadPool> previous;
+		{
+			std::lock_guard<std::mutex> lock(state.lock);
+			const auto threadCount = getResolvedThreadCount(settings.threadCount);
+			const bool unchanged = state.pool
+				&& state.pool->getThreadCount() == threadCount
+				&& state.settings.cpus == settings.cpus;
+			state.settings = settings;
+			if (unchanged) {
+				return;
+			}
+			previous = state.pool;
+			state.pool = make_shared<ThreadPool>(threadCount, settings.cpus);
+		}
+
+		// threads already in parallelFor keep the previous pool until they're done
+		if (previous) {
+			previous->stop();
+		}
+	}
+
+	//----------
+	struct ParallelJob {
+		const std::function<void(const Range &)> * body;
+		Range range;
+		int stripeCount;
+		Lane lane;
+
+		std::atomic<int> next{ 0 };
+		std::atomic<int> done{ 0 };
+
+		std::mutex lock;
+		std::condition_variable finished;
+		std::exception_ptr exception;
+	};
+
+	//----------
+	// runs stripes until there are none left. returns false if it stopped early
+	// because Frame work is waiting in yieldTo
+	static bool runStripes(ParallelJob & job, ThreadPool * yieldTo) {
+		ThreadingConfig::ScopedLane lane(job.lane);
+		const int64_t length = job.range.end - job.range.start;
+		while (true) {
+			if (yieldTo && yieldTo->isWaiting(Lane::Frame)) {
+				return false;
+			}
+			const int stripe = job.next.fetch_add(1);
+			if (stripe >= job.stripeCount) {
+				return true;
+			}
+
+			const Range range(job.range.start + (int) (length * stripe / job.stripeCount)
+				, job.range.start + (int) (length * (stripe + 1) / job.stripeCount));
+			try {
+				(*job.body)(range);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(job.lock);
+				if (!job.exception) {
+					job.exception = std::current_exception();
+				}
+			}
+
+			if (job.done.fetch_add(1) + 1 == job.stripeCount) {
+				std::lock_guard<std::mutex> lock(job.lock);
+				job.finished.notify_all();
+			}
+		}
+	}
+
+	//----------
+	static bool pushHelper(ThreadPool & pool, const shared_ptr<ParallelJob> & job) {
+		return pool.push([job]() {
+			// only Background helpers step aside, and they come back afterwards
+			auto yieldTo = job->lane == Lane::Background ? threadPool : nullptr;
+			if (!runStripes(*job, yieldTo)) {
+				preemptionCount++;
+				pushHelper(*threadPool, job);
+			}
+		}, job->lane);
+	}
+
+	//----------
+	// OpenCV's parallel_for_ (and cv::setNumThreads) on the pool
+	class OpenCvBackend : public cv::parallel::ParallelForAPI {
+	public:
+		void parallel_for(int tasks, FN_parallel_for_body_cb_t callback, void * data) override {
+			parallelFor(Range(0, tasks), [callback, data](const Range & range) {
+				callback(range.start, range.end, data);
+			}, tasks);
+		}
+
+		int getThreadNum() const override {
+			return threadIndex + 1; // 0 for threads outside the pool
+		}
+
+		int getNumThreads() const override {
+			return ThreadingConfig::getThreadCount() + 1;
+		}
+
+		int setNumThreads(int threadCount) override {
+			const auto previous = this->getNumThreads();
+			auto settings = ThreadingConfig::getSettings();
+			settings.threadCount = threadCount < 0 ? -1 : std::max(threadCount - 1, 0);
+			applySettings(settings);
+			return previous;
+		}
+
+		const char * getName() const override {
+			return "ofxCv";
+		}
+	};
+
+	//----------
+	void ThreadingConfig::setup() {
+		setup(Settings());
+	}
+
+	//----------
+	void ThreadingConfig::setup(const Settings & settings) {
+#if !defined(__linux__) && !defined(_WIN32)
+		if (!settings.cpus.empty()) {
+			LogWarning("ofxCv::ThreadingConfig") << "Pinning workers to CPUs is only available on Linux and Windows";
+		}
+#endif
+		applySettings(settings);
+
+		// before the backend, which calls parallelFor
+		setupCalled.store(true);
+
+		auto & state = getState();
+		if (settings.useForOpenCv && !state.usedForOpenCv) {
+			cv::parallel::setParallelForBackend(make_shared<OpenCvBackend>(), false);
+			state.usedForOpenCv = true;
+		}
+		cv::setNumThreads(getThreadCount() + 1);
+	}
+
+	//----------
+	ThreadingConfig::Settings ThreadingConfig::getSettings() {
+		auto & state = getState();
+		std::lock_guard<std::mutex> lock(state.lock);
+		return state.settings;
+	}
+
+	//----------
+	ThreadingConfig::Statistics ThreadingConfig::getStatistics() {
+		Statistics statistics;
+		statistics.frameTasks = frameTaskCount.load();
+		statistics.backgroundTasks = backgroundTaskCount.load();
+		statistics.steals = stealCount.load();
+		statistics.preemptions = preemptionCount.load();
+		return statistics;
+	}
+
+	//----------
+	void ThreadingConfig::setThreadCount(int threadCount) {
+		auto settings = getSettings();
+		settings.threadCount = threadCount;
+		applySettings(settings);
+
+		// with the backend installed this comes back to applySettings, which has nothing to do
+		cv::setNumThreads(getThreadCount() + 1);
+	}
+
+	//----------
+	int ThreadingConfig::getThreadCount() {
+		if (threadPool) {
+			return threadPool->getThreadCount();
+		}
+
+		// don't start the pool just to count it
+		auto & state = getState();
+		std::lock_guard<std::mutex> lock(state.lock);
+		return state.pool ? state.pool->getThreadCount() : getResolvedThreadCount(state.settings.threadCount);
+	}
+
+	//----------
+	void ThreadingConfig::setCpus(const vector<int> & cpus) {
+		auto settings = getSettings();
+		settings.cpus = cpus;
+		applySettings(settings);
+	}
+
+	//----------
+	std::future<void> ThreadingConfig::submit(std::function<void()> job, Lane lane) {
+		auto task = make_shared<std::packaged_task<void()>>(std::move(job));
+		auto future = task->get_future();
+		Task run = [task, lane]() {
+			ScopedLane scopedLane(lane);
+			(*task)();
+		};
+
+		shared_ptr<ThreadPool> owner;
+		auto pool = threadPool;
+		if (!pool) {
+			owner = getPool();
+			pool = owner.get();
+		}
+		if (!pool->push(std::move(run), lane)) {
+			run();
+		}
+		return future;
+	}
+
+	//----------
+	ThreadingConfig::ScopedLane::ScopedLane(Lane lane)
+		: previous(threadLane) {
+		threadLane = lane;
+	}
+
+	//----------
+	ThreadingConfig::ScopedLane::~ScopedLane() {
+		threadLane = this->previous;
+	}
+
+	//----------
+	Lane ThreadingConfig::getLane() {
+		return threadLane;
+	}
+
+	//----------
+	void parallelFor(const Range & range, const std::function<void(const Range &)> & body, double nstripes) {
+		const int length = range.end - range.start;
+		if (length <= 0) {
+			return;
+		}
+		if (!setupCalled.load(std::memory_order_relaxed)) {
+			cv::parallel_for_(range, body, nstripes);
+			return;
+		}
+		const int stripeCount = nstripes <= 0 ? length : std::max(std::min(length, (int) nstripes), 1);
+
+		// workers stay on their own pool, everyone else uses the current one
+		shared_ptr<ThreadPool> owner;
+		auto pool = threadPool;
+		if (!pool) {
+			owner = getPool();
+			pool = owner.get();
+		}
+		if (stripeCount == 1 || pool->getThreadCount() == 0) {
+			body(range);
+			return;
+		}
+
+		auto job = make_shared<ParallelJob>();
+		job->body = &body;
+		job->range = range;
+		job->stripeCount = stripeCount;
+		job->lane = threadLane;
+
+		const int helperCount = std::min(stripeCount - 1, pool->getThreadCount());
+		for (int i = 0; i < helperCount; i++) {
+			if (!pushHelper(*pool, job)) {
+				break;
+			}
+		}
+
+		// helpers which start after the stripes have run out do nothing, so only
+		// the stripes which were started need waiting for
+		runStripes(*job, nullptr);
+		std::exception_ptr exception;
+		{
+			std::unique_lock<std::mutex> lock(job->lock);
+			job->finished.wait(lock, [&job]() {
+				return job->done.load() == job->stripeCount;
+			});
+			std::swap(exception, job->exception);
+		}
+		if (exception) {
+			std::rethrow_exception(exception);
+		}
+	}
+}
@@ -0,0 +1,94 @@
+/*
+ one pool of worker threads for all of ofxCv's parallel work (and OpenCV's),
+ so they aren't all competing for the same cores.
+
+ ThreadingConfig::setup() sets how many workers there are and which CPUs they
+ run on. by default it also makes OpenCV's parallel_for_ run on the pool
+ (cv::parallel::setParallelForBackend), so cv::setNumThreads and
+ setThreadCount() become the same setting. call it once at startup (main() or
+ ofApp::setup()) before any other threads use OpenCV. until setup() is called,
+ parallelFor just calls cv::parallel_for_ (so there are no lanes), and the pool
+ only starts if something is submit()ted.
+
+ work runs in one of two lanes: Frame for per-frame work where latency matters,
+ Background for batch jobs like calibration re-solves. workers always take Frame
+ work first, and a Background parallelFor gives its workers back between stripes
+ whenever Frame work is waiting, so a long job holds up a frame by at most one
+ stripe. the lane belongs to the thread: everything inside a ScopedLane or a
+ submit() job, including the OpenCV calls it makes, runs in that lane.
+ BundleAdjustment::solve, calibrateCameraWorldRemoveOutliers and the
+ crossValidate functions always run in Background, everything else in the
+ caller's lane (Frame unless set otherwise).
+
+ each worker has its own queue and takes work from the others' when it runs
+ out. the thread calling parallelFor works through its own stripes too, so
+ nested calls can't deadlock.
+
+ threads which block (file writing, capture, Pipeline stages) still have their
+ own threads rather than taking workers from the pool.
+ */
+
+#pragma once
+
+#include "Platform.h"
+#include "opencv2/opencv.hpp"
+
+#include <functional>
+#include <future>
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	enum class Lane {
+		Frame,
+		Background
+	};
+
+	class ThreadingConfig {
+	public:
+		struct Settings {
+			int threadCount = -1; // workers, -1 = one less than the number of cores (the calling thread works too)
+			vector<int> cpus; // worker i is pinned to cpus[i % cpus.size()], empty = not pinned (Linux and Windows)
+			bool useForOpenCv = true; // run OpenCV's parallel_for_ on the pool (setup() only)
+		};
+
+		struct Statistics {
+			size_t frameTasks = 0;
+			size_t backgroundTasks = 0;
+			size_t steals = 0; // tasks a worker took from another worker's queue
+			size_t preemptions = 0; // times a Background parallelFor stepped aside for Frame work
+		};
+
+		// not thread-safe (because of cv::parallel::setParallelForBackend)
+		static void setup();
+		static void setup(const Settings &);
+		static Settings getSettings();
+		static Statistics getStatistics();
+
+		// also sets cv::setNumThreads. waits for the work already queued.
+		// can't be called from one of the workers
+		static void setThreadCount(int);
+		static int getThreadCount();
+		static void setCpus(const vector<int> &);
+
+		// runs a job on the pool in that lane. with no workers, it runs now.
+		// a job shouldn't wait for another job's future (there may be no worker free to run it)
+		static std::future<void> submit(std::function<void()> job, Lane = Lane::Background);
+
+		// the lane of this thread until the end of the scope
+		class ScopedLane {
+		public:
+			ScopedLane(Lane);
+			~ScopedLane();
+		protected:
+			Lane previous;
+		};
+
+		static Lane getLane();
+	};
+
+	// like cv::parallel_for_, on the pool in this thread's lane.
+	// nstripes <= 0 gives a stripe per item
+	void parallelFor(const Range & range, const std::function<void(const Range &)> & body, double nstripes = -1.0);
+}
@@ -0,0 +1,63 @@
+/*
+ the parts of utilities which don't need openFrameworks: depth and channel
+ helpers, and the glm <-> OpenCV matched types.
+
+ the openFrameworks types (ofPixels, ofColor, ofPolyline..) are added on top of
+ these in Utilities.h.
+ */
+
+#pragma once
+
+#include "Platform.h"
+#include "opencv2/opencv.hpp"
+#include <glm/glm.hpp>
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	// maximum possible values for that depth or matrix
+	float getMaxVal(int cvDepth);
+	float getMaxVal(const Mat& mat);
+	int getTargetChannelsFromCode(int conversionCode);
+
+	// matched types
+	// some types (e.g. ofVec2f) are equivalent and have the same memory layout
+	// and can therefore the memory which holds these types can be considered
+	// as either type. in this case, we list the matched types here (of on left,
+	// cv on right), and generate casting toOf(..) and toCv(..) functions.
+#define OFXCV_MATCHED_TYPE_OF_CV_HEADER(X, Y) \
+Y & toCv(X &);\
+const Y & toCv(const X &);\
+X & toOf(Y &);\
+const X & toOf(const Y &);
+
+#define OFXCV_MATCHED_TYPE_VECTOR_HEADER(X, Y) \
+OFXCV_MATCHED_TYPE_OF_CV_HEADER(X, Y) \
+OFXCV_MATCHED_TYPE_OF_CV_HEADER(vector<X>, vector<Y>) \
+OFXCV_MATCHED_TYPE_OF_CV_HEADER(vector<vector<X>>, vector<vector<Y>>)
+
+#define OFXCV_MATCHED_TYPE_OF_CV_BODY(X, Y) \
+Y & toCv(X & x) { \
+return * (Y *) & x; \
+} \
+const Y & toCv(const X & x) { \
+return * (const Y *) & x; \
+} \
+X & toOf(Y & y) { \
+return * (X *) & y; \
+} \
+const X & toOf(const Y & y) { \
+return * (const X *) & y; \
+} 
+
+#define OFXCV_MATCHED_TYPE_VECTOR_BODY(X, Y) \
+OFXCV_MATCHED_TYPE_OF_CV_BODY(X, Y) \
+OFXCV_MATCHED_TYPE_OF_CV_BODY(vector<X>, vector<Y>) \
+OFXCV_MATCHED_TYPE_OF_CV_BODY(vector<vector<X>>, vector<vector<Y>>)
+
+	OFXCV_MATCHED_TYPE_VECTOR_HEADER(glm::vec2, Point2f);
+	OFXCV_MATCHED_TYPE_VECTOR_HEADER(glm::vec3, Point3f);
+
+	Mat toCv(Mat& mat);
+}
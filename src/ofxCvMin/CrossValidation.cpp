@@ -0,0 +1,275 @@
+#include "CrossValidation.h"
+#include "Wrappers.h"
+#include "Core/ThreadingConfig.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	//----------
+	static double squaredError(const vector<Point2f> & a, const vector<Point2f> & b) {
+		double squaredErrorSum = 0.0;
+		for (size_t i = 0; i < a.size(); i++) {
+			auto difference = a[i] - b[i];
+			squaredErrorSum += difference.dot(difference);
+		}
+		return squaredErrorSum;
+	}
+
+	//----------
+	static float rmsError(const vector<Point2f> & a, const vector<Point2f> & b) {
+		if (a.empty()) {
+			return 0.0f;
+		}
+		return sqrt(squaredError(a, b) / (double) a.size());
+	}
+
+	//----------
+	template<typename T>
+	static vector<T> without(const vector<T> & views, size_t index) {
+		vector<T> result;
+		result.reserve(views.size() - 1);
+		for (size_t i = 0; i < views.size(); i++) {
+			if (i != index) {
+				result.push_back(views[i]);
+			}
+		}
+		return result;
+	}
+
+	//----------
+	// fullSquaredErrors/pointCounts are the full solution's reprojection of each view, so that
+	// both sides of the influence are rms errors over the same N - 1 views
+	static void calculateInfluence(CrossValidationResult & result, const vector<double> & fullSquaredErrors, const vector<size_t> & pointCounts) {
+		double totalSquaredError = 0.0;
+		size_t totalPoints = 0;
+		for (size_t i = 0; i < fullSquaredErrors.size(); i++) {
+			totalSquaredError += fullSquaredErrors[i];
+			totalPoints += pointCounts[i];
+		}
+
+		result.influence.resize(result.leaveOneOutErrors.size());
+		for (size_t i = 0; i < result.leaveOneOutErrors.size(); i++) {
+			const auto otherPoints = totalPoints - pointCounts[i];
+			const float fullErrorWithout = otherPoints > 0
+				? sqrt(std::max(totalSquaredError - fullSquaredErrors[i], 0.0) / (double) otherPoints)
+				: 0.0f;
+			result.influence[i] = fullErrorWithout - result.leaveOneOutErrors[i];
+		}
+	}
+
+	//----------
+	vector<int> CrossValidationResult::getViewsByInfluence() const {
+		vector<int> views(this->influence.size());
+		for (size_t i = 0; i < views.size(); i++) {
+			views[i] = (int) i;
+		}
+		// views which failed to solve (NaN) go last
+		auto key = [this](int view) {
+			auto value = this->influence[view];
+			return std::isnan(value) ? -numeric_limits<float>::infinity() : value;
+		};
+		sort(views.begin(), views.end(), [&key](int a, int b) {
+			return key(a) > key(b);
+		});
+		return views;
+	}
+
+	//----------
+	vector<int> CrossValidationResult::getOutlierViews(float factor) const {
+		vector<int> outliers;
+		if (this->heldOutErrors.empty()) {
+			return outliers;
+		}
+
+		// views which failed to solve (NaN) aren't ordered, so they're left out of the median
+		vector<float> sorted;
+		sorted.reserve(this->heldOutErrors.size());
+		for (auto error : this->heldOutErrors) {
+			if (!std::isnan(error)) {
+				sorted.push_back(error);
+			}
+		}
+		if (sorted.empty()) {
+			return outliers;
+		}
+		nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+		auto median = sorted[sorted.size() / 2];
+
+		for (size_t i = 0; i < this->heldOutErrors.size(); i++) {
+			if (!std::isnan(this->heldOutErrors[i]) && this->heldOutErrors[i] > median * factor) {
+				outliers.push_back((int) i);
+			}
+		}
+		return outliers;
+	}
+
+	//----------
+	CrossValidationResult crossValidateCamera(const vector<vector<Point3f>> & objectPoints
+		, const vector<vector<Point2f>> & imagePoints
+		, cv::Size imageSize
+		, const cv::Mat & cameraMatrix
+		, const cv::Mat & distortionCoefficients
+		, int flags) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::crossValidateCamera");
+		ThreadingConfig::ScopedLane lane(Lane::Background);
+		CrossValidationResult result;
+
+		const auto viewCount = objectPoints.size();
+		if (viewCount < 2 || imagePoints.size() != viewCount) {
+			ofLogError("ofxCv::crossValidateCamera") << "Need at least 2 views with matching object and image points";
+			return result;
+		}
+
+		// the full solution's extrinsics are used to warm start the held-out pose solves
+		auto fullCameraMatrix = cameraMatrix.clone();
+		auto fullDistortion = distortionCoefficients.clone();
+		vector<Mat> fullRotations, fullTranslations;
+		result.fullError = cv::calibrateCamera(objectPoints, imagePoints, imageSize
+			, fullCameraMatrix, fullDistortion
+			, fullRotations, fullTranslations
+			, flags | CALIB_USE_INTRINSIC_GUESS);
+
+		result.heldOutErrors.assign(viewCount, 0.0f);
+		result.leaveOneOutErrors.assign(viewCount, 0.0f);
+		vector<double> fullSquaredErrors(viewCount);
+		vector<size_t> pointCounts(viewCount);
+
+		parallelFor(Range(0, (int) viewCount), [&](const Range & range) {
+			for (int i = range.start; i < range.end; i++) {
+				vector<Point2f> fullProjected;
+				projectPoints(objectPoints[i], fullRotations[i], fullTranslations[i], fullCameraMatrix, fullDistortion, fullProjected);
+				fullSquaredErrors[i] = squaredError(fullProjected, imagePoints[i]);
+				pointCounts[i] = imagePoints[i].size();
+
+				// warm start from the full solution
+				auto looCameraMatrix = fullCameraMatrix.clone();
+				auto looDistortion = fullDistortion.clone();
+				vector<Mat> looRotations, looTranslations;
+				try {
+					result.leaveOneOutErrors[i] = cv::calibrateCamera(without(objectPoints, i), without(imagePoints, i), imageSize
+						, looCameraMatrix, looDistortion
+						, looRotations, looTranslations
+						, flags | CALIB_USE_INTRINSIC_GUESS);
+
+					// test against the held out view. its pose is free, the intrinsics are not
+					auto rotation = fullRotations[i].clone();
+					auto translation = fullTranslations[i].clone();
+					solvePnP(objectPoints[i], imagePoints[i], looCameraMatrix, looDistortion, rotation, translation, true);
+
+					vector<Point2f> projected;
+					projectPoints(objectPoints[i], rotation, translation, looCameraMatrix, looDistortion, projected);
+					result.heldOutErrors[i] = rmsError(projected, imagePoints[i]);
+				}
+				catch (const cv::Exception & e) {
+					ofLogWarning("ofxCv::crossValidateCamera") << "Couldn't solve without view [" << i << "] : " << e.what();
+					result.leaveOneOutErrors[i] = numeric_limits<float>::quiet_NaN();
+					result.heldOutErrors[i] = numeric_limits<float>::quiet_NaN();
+				}
+			}
+		});
+
+		calculateInfluence(result, fullSquaredErrors, pointCounts);
+		return result;
+	}
+
+	//----------
+	CrossValidationResult crossValidateProjector(const vector<vector<glm::vec3>> & worldPointsPerView
+		, const vector<vector<glm::vec2>> & projectorPointsPerView
+		, int projectorWidth, int projectorHeight
+		, bool projectorPointsAreNormalized
+		, float initialLensOffset, float initialThrowRatio
+		, int flags) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::crossValidateProjector");
+		ThreadingConfig::ScopedLane lane(Lane::Background);
+		CrossValidationResult result;
+
+		const auto viewCount = worldPointsPerView.size();
+		if (viewCount < 2 || projectorPointsPerView.size() != viewCount) {
+			ofLogError("ofxCv::crossValidateProjector") << "Need at least 2 views with matching world and projector points";
+			return result;
+		}
+
+		// work in projector pixels throughout
+		vector<vector<Point3f>> world(viewCount);
+		vector<vector<Point2f>> projector(viewCount);
+		for (size_t i = 0; i < viewCount; i++) {
+			world[i] = toCv(worldPointsPerView[i]);
+			for (const auto & projectorPoint : projectorPointsPerView[i]) {
+				if (projectorPointsAreNormalized) {
+					projector[i].push_back(Point2f(ofMap(projectorPoint.x, -1, +1, 0, projectorWidth)
+						, ofMap(projectorPoint.y, -1, +1, 0, projectorHeight)));
+				}
+				else {
+					projector[i].push_back(toCv(projectorPoint));
+				}
+			}
+		}
+
+		auto concatenate = [](const vector<vector<Point3f>> & worldViews, const vector<vector<Point2f>> & projectorViews
+			, vector<Point3f> & worldOut, vector<Point2f> & projectorOut) {
+			for (size_t i = 0; i < worldViews.size(); i++) {
+				worldOut.insert(worldOut.end(), worldViews[i].begin(), worldViews[i].end());
+				projectorOut.insert(projectorOut.end(), projectorViews[i].begin(), projectorViews[i].end());
+			}
+		};
+
+		// full solution (the projector has a single pose, so all views are one calibrateCamera view)
+		Mat fullCameraMatrix, fullRotation, fullTranslation;
+		{
+			vector<Point3f> allWorld;
+			vector<Point2f> allProjector;
+			concatenate(world, projector, allWorld, allProjector);
+			result.fullError = calibrateProjector(fullCameraMatrix, fullRotation, fullTranslation
+				, toOf(allWorld), toOf(allProjector)
+				, projectorWidth, projectorHeight
+				, false
+				, initialLensOffset, initialThrowRatio
+				, false, flags);
+		}
+
+		result.heldOutErrors.assign(viewCount, 0.0f);
+		result.leaveOneOutErrors.assign(viewCount, 0.0f);
+		vector<double> fullSquaredErrors(viewCount);
+		vector<size_t> pointCounts(viewCount);
+
+		parallelFor(Range(0, (int) viewCount), [&](const Range & range) {
+			for (int i = range.start; i < range.end; i++) {
+				// calibrateProjector doesn't return its distortion, which the default flags hold at zero
+				vector<Point2f> fullProjected;
+				projectPoints(world[i], fullRotation, fullTranslation, fullCameraMatrix, noArray(), fullProjected);
+				fullSquaredErrors[i] = squaredError(fullProjected, projector[i]);
+				pointCounts[i] = projector[i].size();
+
+				vector<Point3f> looWorld;
+				vector<Point2f> looProjector;
+				concatenate(without(world, i), without(projector, i), looWorld, looProjector);
+
+				auto looCameraMatrix = fullCameraMatrix.clone();
+				Mat looDistortion = Mat::zeros(5, 1, CV_64F);
+				vector<Mat> looRotations, looTranslations;
+				try {
+					result.leaveOneOutErrors[i] = cv::calibrateCamera(vector<vector<Point3f>>(1, looWorld), vector<vector<Point2f>>(1, looProjector)
+						, cv::Size(projectorWidth, projectorHeight)
+						, looCameraMatrix, looDistortion
+						, looRotations, looTranslations
+						, flags | CALIB_USE_INTRINSIC_GUESS
+						, TermCriteria(TermCriteria::COUNT + TermCriteria::EPS, 1000, DBL_EPSILON));
+
+					// the projector doesn't move between views, so the held out view uses the same pose
+					vector<Point2f> projected;
+					projectPoints(world[i], looRotations[0], looTranslations[0], looCameraMatrix, looDistortion, projected);
+					result.heldOutErrors[i] = rmsError(projected, projector[i]);
+				}
+				catch (const cv::Exception & e) {
+					ofLogWarning("ofxCv::crossValidateProjector") << "Couldn't solve without view [" << i << "] : " << e.what();
+					result.leaveOneOutErrors[i] = numeric_limits<float>::quiet_NaN();
+					result.heldOutErrors[i] = numeric_limits<float>::quiet_NaN();
+				}
+			}
+		});
+
+		calculateInfluence(result, fullSquaredErrors, pointCounts);
+		return result;
+	}
+}
@@ -0,0 +1,57 @@
+/*
+ leave-one-view-out cross-validation for calibrations. each of the N problems
+ leaves out one view, is re-solved starting from the full solution, and is then
+ tested against the view it didn't see. the problems are solved in parallel.
+
+ views with a high held-out error or a large positive influence (i.e. the
+ calibration gets better without them) are candidates for pruning.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "opencv2/opencv.hpp"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	struct CrossValidationResult {
+		// rms error of the calibration with all views
+		float fullError = 0.0f;
+
+		// rms error of each view, reprojected through the calibration which didn't include it
+		vector<float> heldOutErrors;
+
+		// rms error of the calibration when each view is left out
+		vector<float> leaveOneOutErrors;
+
+		// the full calibration's rms error over the other views - leaveOneOutError, so both are
+		// over the same points. positive means the other views fit better without that view
+		vector<float> influence;
+
+		// views sorted by how much they hurt the calibration (worst first)
+		vector<int> getViewsByInfluence() const;
+
+		// views whose held-out error is more than `factor` times the median held-out error
+		vector<int> getOutlierViews(float factor = 3.0f) const;
+	};
+
+	// views are as you would pass them to cv::calibrateCamera. cameraMatrix and
+	// distortionCoefficients are the full solution (e.g. from calibrateCamera).
+	CrossValidationResult crossValidateCamera(const vector<vector<Point3f>> & objectPoints
+		, const vector<vector<Point2f>> & imagePoints
+		, cv::Size imageSize
+		, const cv::Mat & cameraMatrix
+		, const cv::Mat & distortionCoefficients
+		, int flags = 0);
+
+	// world/projector point sets are grouped by the view (e.g. board position) they were captured in,
+	// and are otherwise as you would pass them to calibrateProjector.
+	CrossValidationResult crossValidateProjector(const vector<vector<glm::vec3>> & worldPointsPerView
+		, const vector<vector<glm::vec2>> & projectorPointsPerView
+		, int projectorWidth, int projectorHeight
+		, bool projectorPointsAreNormalized
+		, float initialLensOffset, float initialThrowRatio = 1.4f
+		, int flags = CALIB_FIX_K1 | CALIB_FIX_K2 | CALIB_FIX_K3 | CALIB_FIX_K4 | CALIB_FIX_K5 | CALIB_FIX_K6 | CALIB_ZERO_TANGENT_DIST | CALIB_USE_INTRINSIC_GUESS | CALIB_FIX_ASPECT_RATIO);
+}
@@ -0,0 +1,243 @@
+#include "Deskew.h"
+#include "Core/ThreadingConfig.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	//----------
+	void Deskew::setup(const Settings & settings) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::Deskew::setup");
+		this->settings = settings;
+		this->map1.release();
+		this->map2.release();
+	}
+
+	//----------
+	const Deskew::Settings & Deskew::getSettings() const {
+		return this->settings;
+	}
+
+	//----------
+	float Deskew::estimate(const Mat & image) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::Deskew::estimate");
+		this->confidence = 0.0f;
+		this->method = Method::None;
+		if (image.empty()) {
+			return 0.0f;
+		}
+
+		// downsample before anything else, converting to gray on the small image
+		Mat small;
+		const double scale = min(1.0, (double) this->settings.workingWidth / image.cols);
+		if (scale < 1.0) {
+			resize(image, small, cv::Size(), scale, scale, INTER_AREA);
+		}
+		else {
+			small = image;
+		}
+		Mat gray;
+		if (small.channels() == 1) {
+			gray = small;
+		}
+		else {
+			cvtColor(small, gray, small.channels() == 4 ? COLOR_BGRA2GRAY : COLOR_BGR2GRAY);
+		}
+		if (gray.depth() != CV_8U) {
+			double minimum, maximum;
+			minMaxLoc(gray, &minimum, &maximum);
+			gray.convertTo(gray, CV_8U, maximum > minimum ? 255.0 / (maximum - minimum) : 1.0, maximum > minimum ? -minimum * 255.0 / (maximum - minimum) : 0.0);
+		}
+
+		float angle = 0.0f;
+		if (this->estimateProjectionProfile(gray, angle)) {
+			this->method = Method::ProjectionProfile;
+			if (this->confidence >= this->settings.minimumConfidence || !this->settings.useHoughFallback) {
+				return angle;
+			}
+		}
+
+		if (this->settings.useHoughFallback) {
+			float houghAngle;
+			if (this->estimateHough(gray, houghAngle)) {
+				this->method = Method::Hough;
+				return houghAngle;
+			}
+		}
+
+		return this->method == Method::ProjectionProfile ? angle : 0.0f;
+	}
+
+	//----------
+	void Deskew::apply(const Mat & image, Mat & result, float angle) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::Deskew::apply");
+		// rebuild the maps only when the geometry changes
+		if (this->map1.empty() || this->mapSize != image.size() || this->mapAngle != angle) {
+			const int rows = image.rows, cols = image.cols;
+			Mat rotation = getRotationMatrix2D(Point2f(cols / 2.0f, rows / 2.0f), angle, 1.0);
+			Mat inverse;
+			invertAffineTransform(rotation, inverse);
+			const Matx23d m = inverse;
+
+			Mat mapX(rows, cols, CV_32FC1), mapY(rows, cols, CV_32FC1);
+			parallelFor(Range(0, rows), [&](const Range & range) {
+				for (int y = range.start; y < range.end; y++) {
+					float * rowX = mapX.ptr<float>(y);
+					float * rowY = mapY.ptr<float>(y);
+					const double baseX = m(0, 1) * y + m(0, 2);
+					const double baseY = m(1, 1) * y + m(1, 2);
+					for (int x = 0; x < cols; x++) {
+						rowX[x] = (float) (m(0, 0) * x + baseX);
+						rowY[x] = (float) (m(1, 0) * x + baseY);
+					}
+				}
+			});
+
+			// fixed point maps are much faster to remap with
+			convertMaps(mapX, mapY, this->map1, this->map2, CV_16SC2);
+			this->mapSize = image.size();
+			this->mapAngle = angle;
+		}
+
+		remap(image, result, this->map1, this->map2, this->settings.interpolation, BORDER_CONSTANT, this->settings.fill);
+	}
+
+	//----------
+	float Deskew::deskew(const Mat & image, Mat & result) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::Deskew::deskew");
+		auto angle = this->estimate(image);
+		this->apply(image, result, angle);
+		return angle;
+	}
+
+	//----------
+	float Deskew::getConfidence() const {
+		return this->confidence;
+	}
+
+	//----------
+	Deskew::Method Deskew::getMethod() const {
+		return this->method;
+	}
+
+	//----------
+	bool Deskew::estimateProjectionProfile(const Mat & gray, float & angle) {
+		// the foreground is whichever side of the Otsu threshold has fewer pixels
+		// (ink on paper, or the dark squares and their edges on a board)
+		Mat binary;
+		threshold(gray, binary, 0, 255, THRESH_BINARY | THRESH_OTSU);
+		if (countNonZero(binary) > (int) binary.total() / 2) {
+			bitwise_not(binary, binary);
+		}
+
+		const int foregroundCount = countNonZero(binary);
+		if (foregroundCount < 2) {
+			return false;
+		}
+		const int stride = max(1, (int) ceil(sqrt((double) foregroundCount / this->settings.maxPoints)));
+
+		// relative to the centre to keep the profile range small
+		this->points.clear();
+		const float centerX = binary.cols / 2.0f, centerY = binary.rows / 2.0f;
+		for (int y = 0; y < binary.rows; y += stride) {
+			const unsigned char * row = binary.ptr<unsigned char>(y);
+			for (int x = 0; x < binary.cols; x += stride) {
+				if (row[x]) {
+					this->points.push_back(Point2f(x - centerX, y - centerY));
+				}
+			}
+		}
+
+		// the profile variance is proportional to the sum of squared bin counts
+		// (the mean is fixed by the point count), so that's what's compared
+		const float halfDiagonal = sqrt(centerX * centerX + centerY * centerY);
+		const int binCount = (int) ceil(2.0f * halfDiagonal / stride) + 2;
+		auto score = [&](float candidate) {
+			const float radians = ofDegToRad(candidate);
+			const float s = sin(radians) / stride, c = cos(radians) / stride;
+			const float offset = halfDiagonal / stride + 0.5f;
+			vector<int> bins(binCount, 0);
+			for (const auto & point : this->points) {
+				bins[(int) (point.y * c - point.x * s + offset)]++;
+			}
+			double sum = 0.0;
+			for (auto count : bins) {
+				sum += (double) count * count;
+			}
+			return sum;
+		};
+
+		auto search = [&](float center, float range, float step, vector<double> & scores) {
+			const int stepCount = (int) floor(range / step);
+			const int candidateCount = 2 * stepCount + 1;
+			scores.assign(candidateCount, 0.0);
+			parallelFor(Range(0, candidateCount), [&](const Range & r) {
+				for (int i = r.start; i < r.end; i++) {
+					scores[i] = score(center + (i - stepCount) * step);
+				}
+			});
+			const auto best = max_element(scores.begin(), scores.end()) - scores.begin();
+			return center + (best - stepCount) * step;
+		};
+
+		// coarse search over the whole range
+		vector<double> scores;
+		auto step = max(this->settings.coarseStep, 1e-3f);
+		angle = search(0.0f, this->settings.maxAngle, step, scores);
+
+		// how much the peak stands out from the average
+		double meanScore = 0.0;
+		for (auto value : scores) {
+			meanScore += value;
+		}
+		meanScore /= scores.size();
+		const auto peakScore = *max_element(scores.begin(), scores.end());
+		this->confidence = meanScore > 0.0 ? (float) (peakScore / meanScore - 1.0) : 0.0f;
+
+		// then refine around the best
+		while (step > this->settings.fineStep) {
+			const auto range = step;
+			step = max(step / 5.0f, this->settings.fineStep);
+			angle = search(angle, range, step, scores);
+		}
+
+		return true;
+	}
+
+	//----------
+	bool Deskew::estimateHough(const Mat & gray, float & angle) {
+		Mat edges;
+		Canny(gray, edges, 50, 150);
+
+		vector<Vec4i> lines;
+		const double minLineLength = (gray.rows + gray.cols) / 16;
+		HoughLinesP(edges, lines, 1, CV_PI / 180, 50, minLineLength, 3);
+		if (lines.empty()) {
+			return false;
+		}
+
+		// horizontal and vertical lines both show the skew, so average on a circle
+		// with period 90 degrees (i.e. of 4x the angle)
+		double sumX = 0.0, sumY = 0.0, weightSum = 0.0;
+		for (const auto & line : lines) {
+			const double dx = line[2] - line[0], dy = line[3] - line[1];
+			const double weight = dx * dx + dy * dy;
+			const double lineAngle = atan2(dy, dx);
+			sumX += weight * cos(4.0 * lineAngle);
+			sumY += weight * sin(4.0 * lineAngle);
+			weightSum += weight;
+		}
+		if (sumX == 0.0 && sumY == 0.0) {
+			return false;
+		}
+
+		angle = ofRadToDeg(atan2(sumY, sumX) / 4.0);
+		if (abs(angle) > this->settings.maxAngle) {
+			return false;
+		}
+
+		// resultant length, 1 = all lines agree
+		this->confidence = (float) (sqrt(sumX * sumX + sumY * sumY) / weightSum);
+		return true;
+	}
+}
@@ -0,0 +1,97 @@
+/*
+ Deskew estimates the small rotation of a document or calibration board in an
+ image and removes it. it's a faster and more reliable alternative to autorotate.
+
+ the angle is found by projecting the foreground pixels of a downsampled copy of
+ the image onto a range of angles. text lines and board rows make the profile
+ spikiest (highest variance) when they are level. the search is coarse to fine,
+ so only a few dozen angles are tried.
+
+ if the profile doesn't have a clear peak (e.g. there are no regular rows), the
+ angle can be taken from Hough lines on the image's edges instead.
+
+ apply() caches its remap, so deskewing a stream of frames of the same size by
+ the same angle only pays for the remap.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "opencv2/opencv.hpp"
+#include "Utilities.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	class Deskew {
+	public:
+		struct Settings {
+			// search range either side of level (degrees)
+			float maxAngle = 15.0f;
+
+			// first search step, and the step to stop refining at (degrees)
+			float coarseStep = 1.0f;
+			float fineStep = 0.05f;
+
+			// the image is downsampled to this width for estimation
+			int workingWidth = 1024;
+
+			// foreground pixels beyond this many are subsampled
+			int maxPoints = 100000;
+
+			// use Hough lines when the profile peak is weaker than minimumConfidence
+			bool useHoughFallback = true;
+			float minimumConfidence = 0.1f;
+
+			int interpolation = INTER_LINEAR;
+			Scalar fill = Scalar::all(0);
+		};
+
+		enum class Method {
+			None,
+			ProjectionProfile,
+			Hough
+		};
+
+		void setup(const Settings &);
+		const Settings & getSettings() const;
+
+		// returns the skew in degrees, with the same sign convention as rotate()
+		float estimate(const Mat & image);
+
+		// rotates as rotate(image, result, angle) would, so that content skewed by angle is level
+		void apply(const Mat & image, Mat & result, float angle);
+
+		// estimate and apply
+		float deskew(const Mat & image, Mat & result);
+
+		// how much the best angle's profile variance stands out from the others (0 = not at all)
+		float getConfidence() const;
+		Method getMethod() const;
+	protected:
+		bool estimateProjectionProfile(const Mat & gray, float & angle);
+		bool estimateHough(const Mat & gray, float & angle);
+
+		Settings settings;
+		float confidence = 0.0f;
+		Method method = Method::None;
+
+		// foreground points of the working image
+		vector<Point2f> points;
+
+		// remap cache
+		Mat map1, map2;
+		cv::Size mapSize;
+		float mapAngle = 0.0f;
+	};
+
+	// one-shot version, for when you're not deskewing lots of images
+	template <class S, class D>
+	float deskew(S& src, D& dst) {
+		imitate(dst, src);
+		Mat srcMat = toCv(src), dstMat = toCv(dst);
+		Deskew deskewer;
+		return deskewer.deskew(srcMat, dstMat);
+	}
+}
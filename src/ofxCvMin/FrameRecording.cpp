@@ -0,0 +1,750 @@
+#include "FrameRecording.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	static const char recordingMagic[8] = { 'O', 'F', 'X', 'C', 'V', 'R', 'E', 'C' };
+	static const char indexMagic[8] = { 'O', 'F', 'X', 'C', 'V', 'I', 'D', 'X' };
+	static const uint32_t recordingVersion = 1;
+	static const uint32_t frameMagic = 0x4D415246; // FRAM
+
+	struct RecordingHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t reserved;
+	};
+
+	struct FrameHeader {
+		uint32_t magic;
+		uint32_t headerSize;
+		uint64_t index;
+		int64_t timestamp;
+		int32_t type;
+		int32_t rows;
+		int32_t cols;
+		uint32_t flags;
+		uint64_t rawSize;
+		uint64_t payloadSize;
+	};
+
+	struct IndexFooter {
+		uint64_t indexOffset;
+		uint64_t frameCount;
+		char magic[8];
+	};
+
+	enum FrameFlags : uint32_t {
+		FRAME_COMPRESSED = 1
+	};
+
+	//----------
+	// 8 and 16-bit integer images are stored as the difference from the pixel to the left
+	static bool usesDelta(int depth) {
+		return depth == CV_8U || depth == CV_8S || depth == CV_16U || depth == CV_16S;
+	}
+
+	//----------
+	// the bytes of each element are split into planes (all the low bytes, then all the next...)
+	// which gives the compressor long runs of similar bytes to work with
+	static void filterFrame(const Mat & image, vector<unsigned char> & out) {
+		const size_t elementSize = image.elemSize1();
+		const int channels = image.channels();
+		const int rowScalars = image.cols * channels;
+		const size_t count = image.total() * channels;
+		out.resize(count * elementSize);
+		const bool delta = usesDelta(image.depth());
+
+		for (int y = 0; y < image.rows; y++) {
+			const size_t rowStart = (size_t) y * rowScalars;
+			if (elementSize == 1 && delta) {
+				const unsigned char * row = image.ptr<unsigned char>(y);
+				unsigned char * planes = out.data() + rowStart;
+				for (int x = 0; x < rowScalars; x++) {
+					planes[x] = (unsigned char) (row[x] - (x >= channels ? row[x - channels] : 0));
+				}
+			}
+			else if (elementSize == 2 && delta) {
+				const unsigned short * row = image.ptr<unsigned short>(y);
+				unsigned char * low = out.data() + rowStart;
+				unsigned char * high = out.data() + count + rowStart;
+				for (int x = 0; x < rowScalars; x++) {
+					const unsigned short value = (unsigned short) (row[x] - (x >= channels ? row[x - channels] : 0));
+					low[x] = (unsigned char) value;
+					high[x] = (unsigned char) (value >> 8);
+				}
+			}
+			else {
+				const unsigned char * row = image.ptr<unsigned char>(y);
+				for (int x = 0; x < rowScalars; x++) {
+					for (size_t plane = 0; plane < elementSize; plane++) {
+						out[plane * count + rowStart + x] = row[x * elementSize + plane];
+					}
+				}
+			}
+		}
+	}
+
+	//----------
+	static void unfilterFrame(const unsigned char * planes, Mat & image) {
+		const size_t elementSize = image.elemSize1();
+		const int channels = image.channels();
+		const int rowScalars = image.cols * channels;
+		const size_t count = image.total() * channels;
+		const bool delta = usesDelta(image.depth());
+
+		for (int y = 0; y < image.rows; y++) {
+			const size_t rowStart = (size_t) y * rowScalars;
+			if (elementSize == 1 && delta) {
+				unsigned char * row = image.ptr<unsigned char>(y);
+				const unsigned char * source = planes + rowStart;
+				for (int x = 0; x < rowScalars; x++) {
+					row[x] = (unsigned char) (source[x] + (x >= channels ? row[x - channels] : 0));
+				}
+			}
+			else if (elementSize == 2 && delta) {
+				unsigned short * row = image.ptr<unsigned short>(y);
+				const unsigned char * low = planes + rowStart;
+				const unsigned char * high = planes + count + rowStart;
+				for (int x = 0; x < rowScalars; x++) {
+					const unsigned short value = (unsigned short) (low[x] | (high[x] << 8));
+					row[x] = (unsigned short) (value + (x >= channels ? row[x - channels] : 0));
+				}
+			}
+			else {
+				unsigned char * row = image.ptr<unsigned char>(y);
+				for (int x = 0; x < rowScalars; x++) {
+					for (size_t plane = 0; plane < elementSize; plane++) {
+						row[x * elementSize + plane] = planes[plane * count + rowStart + x];
+					}
+				}
+			}
+		}
+	}
+
+	// a block is a series of sequences, each:
+	//  token: literal count (high 4 bits), match length - 4 (low 4 bits). 15 = more follows as bytes of 255 + remainder
+	//  the literals
+	//  match offset (2 bytes, little endian) and any extra match length
+	// the last sequence is literals only, and ends the block.
+	static const int minimumMatch = 4;
+	static const int hashBits = 16;
+
+	//----------
+	static inline uint32_t read32(const unsigned char * data) {
+		uint32_t value;
+		memcpy(&value, data, 4);
+		return value;
+	}
+
+	//----------
+	static inline void writeLength(vector<unsigned char> & out, size_t length) {
+		while (length >= 255) {
+			out.push_back(255);
+			length -= 255;
+		}
+		out.push_back((unsigned char) length);
+	}
+
+	//----------
+	static void writeSequence(vector<unsigned char> & out, const unsigned char * literals, size_t literalCount, size_t offset, size_t matchLength) {
+		const size_t matchCode = matchLength ? matchLength - minimumMatch : 0;
+		out.push_back((unsigned char) ((min(literalCount, (size_t) 15) << 4) | min(matchCode, (size_t) 15)));
+		if (literalCount >= 15) {
+			writeLength(out, literalCount - 15);
+		}
+		out.insert(out.end(), literals, literals + literalCount);
+		if (matchLength) {
+			out.push_back((unsigned char) offset);
+			out.push_back((unsigned char) (offset >> 8));
+			if (matchCode >= 15) {
+				writeLength(out, matchCode - 15);
+			}
+		}
+	}
+
+	//----------
+	static void compress(const unsigned char * source, size_t size, vector<unsigned char> & out) {
+		out.clear();
+		out.reserve(size + size / 255 + 16);
+
+		vector<uint32_t> table(1 << hashBits, 0); // position + 1, 0 = empty
+		size_t anchor = 0;
+		size_t position = 0;
+		while (size >= minimumMatch && position + minimumMatch <= size) {
+			const uint32_t sequence = read32(source + position);
+			const uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+			const size_t candidate = table[hash];
+			table[hash] = (uint32_t) (position + 1);
+
+			if (candidate == 0 || position - (candidate - 1) > 0xffff || read32(source + candidate - 1) != sequence) {
+				// skip faster through data which doesn't compress
+				position += 1 + ((position - anchor) >> 6);
+				continue;
+			}
+
+			const size_t match = candidate - 1;
+			size_t length = minimumMatch;
+			while (position + length < size && source[match + length] == source[position + length]) {
+				length++;
+			}
+
+			writeSequence(out, source + anchor, position - anchor, position - match, length);
+			position += length;
+			anchor = position;
+		}
+
+		writeSequence(out, source + anchor, size - anchor, 0, 0);
+	}
+
+	//----------
+	static bool decompress(const unsigned char * source, size_t size, unsigned char * out, size_t outSize) {
+		size_t in = 0, written = 0;
+		auto readLength = [&](size_t & length) {
+			unsigned char byte;
+			do {
+				if (in >= size) {
+					return false;
+				}
+				byte = source[in++];
+				length += byte;
+			} while (byte == 255);
+			return true;
+		};
+
+		while (in < size) {
+			const unsigned char token = source[in++];
+			size_t literalCount = token >> 4;
+			if (literalCount == 15 && !readLength(literalCount)) {
+				return false;
+			}
+			if (in + literalCount > size || written + literalCount > outSize) {
+				return false;
+			}
+			memcpy(out + written, source + in, literalCount);
+			in += literalCount;
+			written += literalCount;
+
+			if (in == size) {
+				break;
+			}
+
+			if (in + 2 > size) {
+				return false;
+			}
+			const size_t offset = source[in] | (source[in + 1] << 8);
+			in += 2;
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !readLength(matchLength)) {
+				return false;
+			}
+			matchLength += minimumMatch;
+			if (offset == 0 || offset > written || written + matchLength > outSize) {
+				return false;
+			}
+
+			// matches can overlap what they're copying, so go byte by byte
+			const unsigned char * from = out + written - offset;
+			for (size_t i = 0; i < matchLength; i++) {
+				out[written + i] = from[i];
+			}
+			written += matchLength;
+		}
+		return written == outSize;
+	}
+
+	//----------
+	// everything decodeFrame sizes its buffers and Mat from, checked before anything is allocated
+	static bool checkFrameHeader(const FrameHeader & header, uint64_t frameOffset, uint64_t fileSize, size_t frameIndex) {
+		if (header.headerSize < sizeof(FrameHeader) || frameOffset > fileSize
+			|| header.headerSize > fileSize - frameOffset || header.payloadSize > fileSize - frameOffset - header.headerSize) {
+			ofLogError("ofxCv::FramePlayer") << "Frame " << frameIndex << " is truncated";
+			return false;
+		}
+		if ((header.type & ~CV_MAT_TYPE_MASK) != 0 || CV_MAT_DEPTH(header.type) > CV_16F
+			|| header.rows <= 0 || header.cols <= 0) {
+			ofLogError("ofxCv::FramePlayer") << "Frame " << frameIndex << " has an invalid type or size";
+			return false;
+		}
+		const uint64_t elementSize = CV_ELEM_SIZE(header.type);
+		const uint64_t pixelCount = (uint64_t) header.rows * (uint64_t) header.cols;
+		if (pixelCount > numeric_limits<uint64_t>::max() / elementSize || pixelCount * elementSize != header.rawSize) {
+			ofLogError("ofxCv::FramePlayer") << "Frame " << frameIndex << " has an inconsistent size";
+			return false;
+		}
+
+		// each compressed byte expands to at most 255, so a short payload can't ask for a huge buffer
+		const bool compressed = (header.flags & FRAME_COMPRESSED) != 0;
+		if (compressed ? header.rawSize / 255 > header.payloadSize : header.payloadSize != header.rawSize) {
+			ofLogError("ofxCv::FramePlayer") << "Frame " << frameIndex << " has an inconsistent size";
+			return false;
+		}
+		return true;
+	}
+
+	//----------
+	FrameRecorder::~FrameRecorder() {
+		this->close();
+	}
+
+	//----------
+	bool FrameRecorder::open(const string & filename, const Settings & settings) {
+		this->close();
+
+		this->settings = settings;
+		this->settings.queueSize = std::max(this->settings.queueSize, (size_t) 1);
+		this->file.open(ofToDataPath(filename, true), ios::binary | ios::trunc);
+		if (!this->file) {
+			ofLogError("ofxCv::FrameRecorder") << "Couldn't open " << filename << " for writing";
+			return false;
+		}
+
+		this->index.clear();
+		this->writeBuffer.clear();
+		this->writeBuffer.reserve(this->settings.writeBufferSize + (1 << 16));
+		this->fileOffset = 0;
+		this->frameCount = 0;
+		this->rawBytes = 0;
+		this->bytesWritten = 0;
+
+		RecordingHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, recordingMagic, sizeof(recordingMagic));
+		header.version = recordingVersion;
+		this->append(&header, sizeof(header));
+
+		this->closing = false;
+		this->thread = std::thread([this]() {
+			this->threadedFunction();
+		});
+		return true;
+	}
+
+	//----------
+	bool FrameRecorder::open(const string & filename) {
+		return this->open(filename, Settings());
+	}
+
+	//----------
+	bool FrameRecorder::isOpen() const {
+		return this->file.is_open();
+	}
+
+	//----------
+	bool FrameRecorder::add(const Mat & frame, int64_t timestamp) {
+		if (!this->isOpen()) {
+			ofLogError("ofxCv::FrameRecorder") << "Not open";
+			return false;
+		}
+		if (frame.empty()) {
+			return false;
+		}
+
+		Frame entry{ frame.clone(), timestamp < 0 ? (int64_t) ofGetElapsedTimeMicros() : timestamp };
+
+		std::unique_lock<std::mutex> lock(this->lock);
+		this->spaceAvailable.wait(lock, [this]() {
+			return this->queue.size() < this->settings.queueSize;
+		});
+		this->queue.push_back(std::move(entry));
+		lock.unlock();
+
+		this->frameAvailable.notify_one();
+		return true;
+	}
+
+	//----------
+	void FrameRecorder::close() {
+		if (!this->isOpen()) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(this->lock);
+			this->closing = true;
+		}
+		this->frameAvailable.notify_all();
+		this->thread.join();
+
+		// the index and footer go after the last frame
+		IndexFooter footer;
+		footer.indexOffset = this->fileOffset;
+		footer.frameCount = this->index.size();
+		memcpy(footer.magic, indexMagic, sizeof(indexMagic));
+		for (const auto & entry : this->index) {
+			const uint64_t offset = entry.first;
+			const int64_t timestamp = entry.second;
+			this->append(&offset, sizeof(offset));
+			this->append(&timestamp, sizeof(timestamp));
+		}
+		this->append(&footer, sizeof(footer));
+		this->flushWriteBuffer();
+
+		this->file.close();
+	}
+
+	//----------
+	size_t FrameRecorder::getFrameCount() const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->frameCount;
+	}
+
+	//----------
+	size_t FrameRecorder::getQueueDepth() const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->queue.size();
+	}
+
+	//----------
+	uint64_t FrameRecorder::getRawBytes() const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->rawBytes;
+	}
+
+	//----------
+	uint64_t FrameRecorder::getBytesWritten() const {
+		std::lock_guard<std::mutex> lock(this->lock);
+		return this->bytesWritten;
+	}
+
+	//----------
+	void FrameRecorder::threadedFunction() {
+		while (true) {
+			Frame frame;
+			{
+				std::unique_lock<std::mutex> lock(this->lock);
+				this->frameAvailable.wait(lock, [this]() {
+					return this->closing || !this->queue.empty();
+				});
+				if (this->queue.empty()) {
+					break;
+				}
+				frame = std::move(this->queue.front());
+				this->queue.pop_front();
+			}
+			this->spaceAvailable.notify_one();
+
+			filterFrame(frame.image, this->filtered);
+			const vector<unsigned char> * payload = &this->filtered;
+			uint32_t flags = 0;
+			if (this->settings.compress) {
+				compress(this->filtered.data(), this->filtered.size(), this->compressed);
+				if (this->compressed.size() < this->filtered.size()) {
+					payload = &this->compressed;
+					flags |= FRAME_COMPRESSED;
+				}
+			}
+
+			FrameHeader header;
+			header.magic = frameMagic;
+			header.headerSize = sizeof(FrameHeader);
+			header.index = this->index.size();
+			header.timestamp = frame.timestamp;
+			header.type = frame.image.type();
+			header.rows = frame.image.rows;
+			header.cols = frame.image.cols;
+			header.flags = flags;
+			header.rawSize = this->filtered.size();
+			header.payloadSize = payload->size();
+
+			this->index.push_back(make_pair(this->fileOffset, frame.timestamp));
+			this->append(&header, sizeof(header));
+			this->append(payload->data(), payload->size());
+			if (this->writeBuffer.size() >= this->settings.writeBufferSize) {
+				this->flushWriteBuffer();
+			}
+
+			std::lock_guard<std::mutex> lock(this->lock);
+			this->frameCount++;
+			this->rawBytes += this->filtered.size();
+		}
+	}
+
+	//----------
+	void FrameRecorder::append(const void * data, size_t size) {
+		auto bytes = (const unsigned char *) data;
+		this->writeBuffer.insert(this->writeBuffer.end(), bytes, bytes + size);
+		this->fileOffset += size;
+	}
+
+	//----------
+	void FrameRecorder::flushWriteBuffer() {
+		if (this->writeBuffer.empty()) {
+			return;
+		}
+		this->file.write((const char *) this->writeBuffer.data(), this->writeBuffer.size());
+		if (!this->file) {
+			ofLogError("ofxCv::FrameRecorder") << "Write failed";
+		}
+		{
+			std::lock_guard<std::mutex> lock(this->lock);
+			this->bytesWritten += this->writeBuffer.size();
+		}
+		this->writeBuffer.clear();
+	}
+
+	//----------
+	FramePlayer::~FramePlayer() {
+		this->close();
+	}
+
+	//----------
+	bool FramePlayer::open(const string & filename, const Settings & settings) {
+		this->close();
+		this->settings = settings;
+
+		this->file.open(ofToDataPath(filename, true), ios::binary);
+		if (!this->file) {
+			ofLogError("ofxCv::FramePlayer") << "Couldn't open " << filename;
+			return false;
+		}
+
+		RecordingHeader header;
+		if (!this->file.read((char *) &header, sizeof(header)) || memcmp(header.magic, recordingMagic, sizeof(recordingMagic)) != 0) {
+			ofLogError("ofxCv::FramePlayer") << filename << " isn't a frame recording";
+			this->file.close();
+			return false;
+		}
+		if (header.version != recordingVersion) {
+			ofLogError("ofxCv::FramePlayer") << filename << " has unsupported version " << header.version;
+			this->file.close();
+			return false;
+		}
+
+		if (!this->readIndex()) {
+			ofLogWarning("ofxCv::FramePlayer") << filename << " has no index (wasn't closed properly?), scanning frames";
+			this->rebuildIndex();
+		}
+
+		this->playhead = 0;
+		this->closing = false;
+		this->thread = std::thread([this]() {
+			this->threadedFunction();
+		});
+		return true;
+	}
+
+	//----------
+	bool FramePlayer::open(const string & filename) {
+		return this->open(filename, Settings());
+	}
+
+	//----------
+	bool FramePlayer::isOpen() const {
+		return this->file.is_open();
+	}
+
+	//----------
+	void FramePlayer::close() {
+		if (!this->isOpen()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(this->cacheLock);
+			this->closing = true;
+		}
+		this->wanted.notify_all();
+		this->thread.join();
+
+		this->cache.clear();
+		this->index.clear();
+		this->file.close();
+	}
+
+	//----------
+	size_t FramePlayer::getFrameCount() const {
+		return this->index.size();
+	}
+
+	//----------
+	int64_t FramePlayer::getTimestamp(size_t frameIndex) const {
+		return frameIndex < this->index.size() ? this->index[frameIndex].second : -1;
+	}
+
+	//----------
+	bool FramePlayer::getFrame(size_t frameIndex, Mat & frame) {
+		if (frameIndex >= this->index.size()) {
+			ofLogError("ofxCv::FramePlayer") << "Frame " << frameIndex << " is out of range (" << this->index.size() << " frames)";
+			return false;
+		}
+
+		bool found = false;
+		{
+			std::lock_guard<std::mutex> lock(this->cacheLock);
+			auto findFrame = this->cache.find(frameIndex);
+			if (findFrame != this->cache.end()) {
+				// hand over the prefetched frame rather than copying it
+				frame = findFrame->second;
+				this->cache.erase(findFrame);
+				found = true;
+			}
+		}
+
+		if (!found) {
+			found = this->decodeFrame(frameIndex, frame);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(this->cacheLock);
+			this->playhead = frameIndex;
+			for (auto it = this->cache.begin(); it != this->cache.end(); ) {
+				if (it->first <= frameIndex || it->first > frameIndex + (size_t) this->settings.prefetchCount) {
+					it = this->cache.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+		}
+		this->wanted.notify_one();
+
+		return found;
+	}
+
+	//----------
+	bool FramePlayer::readIndex() {
+		this->file.seekg(0, ios::end);
+		const uint64_t fileSize = (uint64_t) this->file.tellg();
+		if (fileSize < sizeof(RecordingHeader) + sizeof(IndexFooter)) {
+			return false;
+		}
+
+		IndexFooter footer;
+		this->file.seekg(fileSize - sizeof(IndexFooter));
+		if (!this->file.read((char *) &footer, sizeof(footer)) || memcmp(footer.magic, indexMagic, sizeof(indexMagic)) != 0) {
+			this->file.clear();
+			return false;
+		}
+		if (footer.indexOffset + footer.frameCount * 16 + sizeof(IndexFooter) != fileSize) {
+			return false;
+		}
+
+		this->index.resize(footer.frameCount);
+		this->file.seekg(footer.indexOffset);
+		for (auto & entry : this->index) {
+			this->file.read((char *) &entry.first, sizeof(entry.first));
+			this->file.read((char *) &entry.second, sizeof(entry.second));
+		}
+		if (!this->file) {
+			this->file.clear();
+			this->index.clear();
+			return false;
+		}
+		return true;
+	}
+
+	//----------
+	bool FramePlayer::rebuildIndex() {
+		this->index.clear();
+		this->file.clear();
+		this->file.seekg(0, ios::end);
+		const uint64_t fileSize = (uint64_t) this->file.tellg();
+
+		// frames run up to the first one which is incomplete
+		uint64_t offset = sizeof(RecordingHeader);
+		while (offset + sizeof(FrameHeader) <= fileSize) {
+			FrameHeader header;
+			this->file.seekg(offset);
+			if (!this->file.read((char *) &header, sizeof(header)) || header.magic != frameMagic) {
+				break;
+			}
+			// compared without adding, so a corrupt payloadSize can't wrap around
+			if (header.headerSize < sizeof(FrameHeader) || header.headerSize > fileSize - offset
+				|| header.payloadSize > fileSize - offset - header.headerSize) {
+				break;
+			}
+			const uint64_t next = offset + header.headerSize + header.payloadSize;
+			this->index.push_back(make_pair(offset, header.timestamp));
+			offset = next;
+		}
+		this->file.clear();
+		return !this->index.empty();
+	}
+
+	//----------
+	bool FramePlayer::decodeFrame(size_t frameIndex, Mat & frame) {
+		FrameHeader header;
+		vector<unsigned char> payload;
+		{
+			std::lock_guard<std::mutex> lock(this->fileLock);
+			this->file.seekg(0, ios::end);
+			const uint64_t fileSize = (uint64_t) this->file.tellg();
+			this->file.seekg(this->index[frameIndex].first);
+			if (!this->file.read((char *) &header, sizeof(header)) || header.magic != frameMagic) {
+				this->file.clear();
+				ofLogError("ofxCv::FramePlayer") << "Frame " << frameIndex << " is corrupt";
+				return false;
+			}
+			if (!checkFrameHeader(header, this->index[frameIndex].first, fileSize, frameIndex)) {
+				return false;
+			}
+			payload.resize(header.payloadSize);
+			this->file.seekg(this->index[frameIndex].first + header.headerSize);
+			if (!this->file.read((char *) payload.data(), payload.size())) {
+				this->file.clear();
+				ofLogError("ofxCv::FramePlayer") << "Frame " << frameIndex << " is truncated";
+				return false;
+			}
+		}
+
+		Mat image(header.rows, header.cols, header.type);
+		if (header.flags & FRAME_COMPRESSED) {
+			vector<unsigned char> filtered(header.rawSize);
+			if (!decompress(payload.data(), payload.size(), filtered.data(), filtered.size())) {
+				ofLogError("ofxCv::FramePlayer") << "Frame " << frameIndex << " failed to decompress";
+				return false;
+			}
+			unfilterFrame(filtered.data(), image);
+		}
+		else {
+			unfilterFrame(payload.data(), image);
+		}
+
+		frame = image;
+		return true;
+	}
+
+	//----------
+	void FramePlayer::threadedFunction() {
+		std::unique_lock<std::mutex> lock(this->cacheLock);
+		while (true) {
+			// the first frame after the playhead which isn't decoded yet
+			size_t next = 0;
+			auto findNext = [this, &next]() {
+				if (this->index.empty()) {
+					return false;
+				}
+				const size_t end = std::min(this->playhead + (size_t) this->settings.prefetchCount, this->index.size() - 1);
+				for (next = this->playhead + 1; next <= end; next++) {
+					if (this->cache.find(next) == this->cache.end()) {
+						return true;
+					}
+				}
+				return false;
+			};
+			this->wanted.wait(lock, [&]() {
+				return this->closing || findNext();
+			});
+			if (this->closing) {
+				return;
+			}
+
+			lock.unlock();
+			Mat frame;
+			const bool success = this->decodeFrame(next, frame);
+			lock.lock();
+
+			// the playhead may have moved on while decoding
+			if (success && next > this->playhead && next <= this->playhead + (size_t) this->settings.prefetchCount) {
+				this->cache[next] = frame;
+			}
+			else if (!success) {
+				// don't keep retrying a broken frame, wait for the playhead to move
+				this->wanted.wait(lock);
+				if (this->closing) {
+					return;
+				}
+			}
+		}
+	}
+}
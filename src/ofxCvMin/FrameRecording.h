@@ -0,0 +1,124 @@
+/*
+ lossless recording and playback of raw camera frames (any Mat type, including
+ 16-bit depth and Bayer), for replaying real footage through a pipeline.
+
+ each frame is filtered (a horizontal delta for 8/16-bit integer images, then
+ the bytes of each element are split into planes) and compressed with a small
+ LZ77 coder in the style of LZ4, which decodes at memory speed. the file ends
+ with an index of frame offsets and timestamps, so the player can seek to any
+ frame. if the recording wasn't closed properly the player rebuilds the index
+ by scanning the frames.
+
+ FrameRecorder compresses and writes on a background thread, in large
+ sequential writes. FramePlayer decodes frames on a background thread ahead of
+ the last one asked for.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "opencv2/opencv.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	class FrameRecorder {
+	public:
+		struct Settings {
+			bool compress = true;
+			size_t queueSize = 32; // frames waiting to be written. add() blocks when it's full
+			size_t writeBufferSize = 8 << 20; // bytes collected before each write
+		};
+
+		~FrameRecorder();
+
+		bool open(const string & filename, const Settings &);
+		bool open(const string & filename);
+		bool isOpen() const;
+
+		// the frame is copied. timestamp is in microseconds, or -1 for the time now
+		bool add(const Mat & frame, int64_t timestamp = -1);
+
+		// writes everything queued, then the index
+		void close();
+
+		size_t getFrameCount() const;
+		size_t getQueueDepth() const;
+		uint64_t getRawBytes() const;
+		uint64_t getBytesWritten() const;
+	protected:
+		struct Frame {
+			Mat image;
+			int64_t timestamp;
+		};
+
+		void threadedFunction();
+		void append(const void * data, size_t size);
+		void flushWriteBuffer();
+
+		Settings settings;
+		std::ofstream file;
+		std::thread thread;
+
+		mutable std::mutex lock;
+		std::condition_variable frameAvailable;
+		std::condition_variable spaceAvailable;
+		std::deque<Frame> queue;
+		bool closing = false;
+
+		// only touched by the writing thread until close()
+		vector<unsigned char> writeBuffer;
+		vector<unsigned char> filtered;
+		vector<unsigned char> compressed;
+		vector<pair<uint64_t, int64_t>> index;
+		uint64_t fileOffset = 0;
+
+		size_t frameCount = 0;
+		uint64_t rawBytes = 0;
+		uint64_t bytesWritten = 0;
+	};
+
+	class FramePlayer {
+	public:
+		struct Settings {
+			int prefetchCount = 8; // frames decoded ahead of the last one asked for
+		};
+
+		~FramePlayer();
+
+		bool open(const string & filename, const Settings &);
+		bool open(const string & filename);
+		bool isOpen() const;
+		void close();
+
+		size_t getFrameCount() const;
+		int64_t getTimestamp(size_t frameIndex) const;
+
+		// the returned Mat isn't shared with the player, so it can be written to
+		bool getFrame(size_t frameIndex, Mat & frame);
+	protected:
+		bool readIndex();
+		bool rebuildIndex();
+		bool decodeFrame(size_t frameIndex, Mat & frame);
+		void threadedFunction();
+
+		Settings settings;
+		std::ifstream file;
+		std::mutex fileLock;
+		vector<pair<uint64_t, int64_t>> index;
+
+		std::thread thread;
+		std::mutex cacheLock;
+		std::condition_variable wanted;
+		map<size_t, Mat> cache;
+		size_t playhead = 0;
+		bool closing = false;
+	};
+}
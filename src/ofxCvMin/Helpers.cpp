@@ -5,217 +5,110 @@ namespace ofxCv {
 	
 	using namespace cv;
 	
-	//see notes at :
-	// https://paper.dropbox.com/doc/OpenCV-openFrameworks-transforms-v3dvp2ZIVufVZfSpqQain
-	glm::mat4 makeMatrix(Mat rotation, Mat translation) {
-		Mat rot3x3;
-		if(rotation.rows == 3 && rotation.cols == 3) {
-			rot3x3 = rotation;
-		} else {
-			Rodrigues(rotation, rot3x3);
-		}
-		double* rm = rot3x3.ptr<double>(0);
-		double* tm = translation.ptr<double>(0);
-		return glm::mat4(rm[0], rm[3], rm[6], 0.0f,
-			rm[1], rm[4], rm[7], 0.0f,
-			rm[2], rm[5], rm[8], 0.0f,
-			tm[0], tm[1], tm[2], 1.0f);
-	}
-
-
-	void decomposeMatrix(const glm::mat4 & transform, Mat & rotationVector, Mat & translation) {
-		cv::Mat mat3x3(3, 3, CV_64F);
-		for (int i = 0; i < 3; i++) {
-			for (int j = 0; j < 3; j++) {
-				mat3x3.at<double>(i, j) = transform[j][i]; //transposed
-			}
-		}
-		cv::Rodrigues(mat3x3, rotationVector);
-
-		translation = cv::Mat(3, 1, CV_64F);
-		for (int i = 0; i < 3; i++) {
-			translation.at<double>(i) = transform[3][i];
-		}
-	}
-
-	//a reference : http://strawlab.org/2011/11/05/augmented-reality-with-OpenGL/#the_opengl_projection_matrix_from_hz_intrinsic_parameters
-	glm::mat4 makeProjectionMatrix(Mat cameraMatrix, cv::Size imageSize) {
-		float focalLengthX = cameraMatrix.at<double>(0, 0);
-		float focalLengthY = cameraMatrix.at<double>(1, 1);
-		float ppx = cameraMatrix.at<double>(0, 2);
-		float ppy = cameraMatrix.at<double>(1, 2);
-
-		ofMatrix4x4 projection;
-		projection(0, 0) = 2.0f * focalLengthX / (float)imageSize.width;
-		projection(1, 1) = -2.0f * focalLengthY / (float)imageSize.height;
-		projection(2,3) = 1.0f;
-		projection(3,3) = 0.0f;
-
-		const ofVec3f lensOffset(2 * (ppx / (float) imageSize.width) - 1.0f, 1.0f - 2 * (ppy / (float) imageSize.height), 0.0f);
-		projection.postMultTranslate(lensOffset);
-
-		return projection;
+	// board meshes are made of quads, each 4 vertices and 2 triangles.
+	// the arrays are sized up front and filled in place.
+	static void allocateBoardMesh(ofMesh & mesh, size_t quadCount) {
+		mesh.getVertices().resize(quadCount * 4);
+		mesh.getColors().resize(quadCount * 4);
+		mesh.getIndices().resize(quadCount * 6);
+		mesh.setMode(ofPrimitiveMode::OF_PRIMITIVE_TRIANGLES);
 	}
 	
-	vector<cv::Point3f> makeCheckerboardPoints(cv::Size size, float spacing, bool centered) {
-		vector<glm::vec3> corners;
-
-		glm::vec3 offset;
-		if (centered) {
-			offset = -glm::vec3(size.width - 1, size.height - 1, 0) * spacing * 0.5f;
-		}
-		else {
-			offset = glm::vec3(spacing, spacing, 0.0f); // first inner corner is 1 square in
-		}
-
-		for (int j = 0; j < size.height; j++) {
-			for (int i = 0; i < size.width; i++) {
-				corners.push_back(glm::vec3(i, j, 0) * spacing + offset);
-			}
-		}
-		return toCv(corners);
+	static void setBoardQuad(ofMesh & mesh, size_t quad
+		, const glm::vec3 & topLeft, const glm::vec3 & topRight, const glm::vec3 & bottomLeft, const glm::vec3 & bottomRight
+		, const ofFloatColor & color) {
+		const auto first = (ofIndexType) (quad * 4);
+		auto vertices = mesh.getVertices().data() + first;
+		vertices[0] = topLeft;
+		vertices[1] = topRight;
+		vertices[2] = bottomLeft;
+		vertices[3] = bottomRight;
+		
+		auto colors = mesh.getColors().data() + first;
+		colors[0] = colors[1] = colors[2] = colors[3] = color;
+		
+		auto indices = mesh.getIndices().data() + quad * 6;
+		indices[0] = first + 2;
+		indices[1] = first + 1;
+		indices[2] = first;
+		indices[3] = first + 3;
+		indices[4] = first + 1;
+		indices[5] = first + 2;
 	}
-
+	
 	ofMesh makeCheckerboardMesh(cv::Size size, float spacing, bool centered) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::makeCheckerboardMesh");
 		ofMesh mesh;
+		allocateBoardMesh(mesh, 1 + (size.width + 1) * (size.height + 1));
 
-		ofVec3f center;
+		glm::vec3 center;
 		if (centered) {
-			center = ofVec3f(size.width + 1, size.height + 1, 0) * spacing * 0.5f;
+			center = glm::vec3(size.width + 1, size.height + 1, 0) * spacing * 0.5f;
 		}
 		
 		//board face
-		const auto topLeft = ofVec3f(-1, -1, 0.0f) * spacing - center;
-		const auto topRight = ofVec3f(2 + size.width, -1, 0.0f) * spacing - center;
-		const auto bottomLeft = ofVec3f(-1, size.height + 2, 0.0f) * spacing - center;
-		const auto bottomRight = ofVec3f(2 + size.width, size.height + 2, 0.0f) * spacing - center;
-		
-		const auto z = + spacing / 50.0f;
-		const auto offset = ofVec3f(0, 0, z);
-		mesh.addVertex(bottomLeft + offset);
-		mesh.addVertex(topRight + offset);
-		mesh.addVertex(topLeft + offset);
-
-		mesh.addVertex(bottomRight + offset);
-		mesh.addVertex(topRight + offset);
-		mesh.addVertex(bottomLeft + offset);
-
-		mesh.addColor(ofColor(255));
-		mesh.addColor(ofColor(255));
-		mesh.addColor(ofColor(255));
-
-		mesh.addColor(ofColor(255));
-		mesh.addColor(ofColor(255));
-		mesh.addColor(ofColor(255));
-
+		const auto offset = glm::vec3(0, 0, spacing / 50.0f);
+		setBoardQuad(mesh, 0
+			, glm::vec3(-1, -1, 0.0f) * spacing - center + offset
+			, glm::vec3(2 + size.width, -1, 0.0f) * spacing - center + offset
+			, glm::vec3(-1, size.height + 2, 0.0f) * spacing - center + offset
+			, glm::vec3(2 + size.width, size.height + 2, 0.0f) * spacing - center + offset
+			, ofFloatColor(1.0f));
+
+		size_t quad = 1;
 		for (int i = 0; i<size.width + 1; i++) {
 			for(int j=0; j<size.height + 1; j++) {
 				auto black = i % 2 == j % 2;
-				auto squareTopLeft = ofVec3f(i, j, 0) * spacing - center;
-				
-				mesh.addVertex(squareTopLeft);
-				mesh.addVertex(squareTopLeft + ofVec3f(0, spacing, 0));
-				mesh.addVertex(squareTopLeft + ofVec3f(spacing, 0, 0));
-
-				mesh.addVertex(squareTopLeft + ofVec3f(spacing, 0, 0));
-				mesh.addVertex(squareTopLeft + ofVec3f(0, spacing, 0));
-				mesh.addVertex(squareTopLeft + ofVec3f(spacing, spacing, 0));
-
-				for(int c=0; c<6; c++) {
-					mesh.addColor(ofFloatColor(black ? 0.0f : 1.0f));
-				}
+				auto squareTopLeft = glm::vec3(i, j, 0) * spacing - center;
+				setBoardQuad(mesh, quad++
+					, squareTopLeft
+					, squareTopLeft + glm::vec3(spacing, 0, 0)
+					, squareTopLeft + glm::vec3(0, spacing, 0)
+					, squareTopLeft + glm::vec3(spacing, spacing, 0)
+					, ofFloatColor(black ? 0.0f : 1.0f));
 			}
 		}
 
-		mesh.setMode(ofPrimitiveMode::OF_PRIMITIVE_TRIANGLES);
 		return mesh;
 	}
 
-	vector<Point3f> makeAsymmetricCirclePoints(cv::Size size, float spacing, bool centered) {
-		vector<glm::vec3> points;
-
-		ofVec3f center;
-		if (centered) {
-			center = glm::vec3(size.width * 2.0f - 1.0f, size.height - 1.0f, 0) * spacing * 0.5f;
-		}
-
-		for (int j = 0; j<size.height; j++) {
-			for (int i = 0; i<size.width; i++) {
-				points.push_back(glm::vec3(
-					i * 2 + (j % 2),
-					j,
-					0
-					) * spacing - center);
-			}
-		}
-		return toCv(points);
-	}
-
 	ofMesh makeAsymmetricCircleMesh(cv::Size size, float spacing, bool centered) {
-		ofMesh mesh;
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::makeAsymmetricCircleMesh");
 		const auto points = toOf(makeAsymmetricCirclePoints(size, spacing, centered));
+		ofMesh mesh;
+		allocateBoardMesh(mesh, 1 + points.size());
 		
-		ofVec3f center;
+		glm::vec3 center;
 		if (centered) {
-			center = ofVec3f(size.width * 2.0f, size.height, 0) * spacing * 0.5f;
+			center = glm::vec3(size.width * 2.0f, size.height, 0) * spacing * 0.5f;
 		}
 
 		//board face
-		const auto topLeft = ofVec3f(-1, -1, 0.0f) * spacing - center;
-		const auto topRight = ofVec3f(1 + size.width * 2, -1, 0.0f) * spacing - center;
-		const auto bottomLeft = ofVec3f(-1, size.height + 1, 0.0f) * spacing - center;
-		const auto bottomRight = ofVec3f(1 + size.width * 2, size.height + 1, 0.0f) * spacing - center;
-
-		mesh.addVertex(bottomLeft);
-		mesh.addVertex(topRight);
-		mesh.addVertex(topLeft);
-
-		mesh.addVertex(bottomRight);
-		mesh.addVertex(topRight);
-		mesh.addVertex(bottomLeft);
-
-		mesh.addColor(ofColor(255));
-		mesh.addColor(ofColor(255));
-		mesh.addColor(ofColor(255));
-
-		mesh.addColor(ofColor(255));
-		mesh.addColor(ofColor(255));
-		mesh.addColor(ofColor(255));
+		setBoardQuad(mesh, 0
+			, glm::vec3(-1, -1, 0.0f) * spacing - center
+			, glm::vec3(1 + size.width * 2, -1, 0.0f) * spacing - center
+			, glm::vec3(-1, size.height + 1, 0.0f) * spacing - center
+			, glm::vec3(1 + size.width * 2, size.height + 1, 0.0f) * spacing - center
+			, ofFloatColor(1.0f));
 
 		const auto r = spacing / 10.0f;
 		const auto z = (-spacing / 50.0f) / r; // /r since *r later
-		for (auto & point : points) {
-			mesh.addVertex(point + ofVec3f(-1, +1, z) * r);
-			mesh.addVertex(point + ofVec3f(+1, -1, z) * r);
-			mesh.addVertex(point + ofVec3f(-1, -1, z) * r);
-			mesh.addVertex(point + ofVec3f(-1, +1, z) * r);
-			mesh.addVertex(point + ofVec3f(+1, +1, z) * r);
-			mesh.addVertex(point + ofVec3f(+1, -1, z) * r);
-			mesh.addColor(ofColor(0));
-			mesh.addColor(ofColor(0));
-			mesh.addColor(ofColor(0));
-			mesh.addColor(ofColor(0));
-			mesh.addColor(ofColor(0));
-			mesh.addColor(ofColor(0));
+		size_t quad = 1;
+		for (const auto & point : points) {
+			const glm::vec3 position = point;
+			setBoardQuad(mesh, quad++
+				, position + glm::vec3(-1, -1, z) * r
+				, position + glm::vec3(+1, -1, z) * r
+				, position + glm::vec3(-1, +1, z) * r
+				, position + glm::vec3(+1, +1, z) * r
+				, ofFloatColor(0.0f));
 		}
 
 		return mesh;
 	}
 
-	vector<Point3f> makeBoardPoints(BoardType boardType, cv::Size size, float spacing, bool centered) {
-		switch (boardType) {
-		case BoardType::AsymmetricCircles:
-			return makeAsymmetricCirclePoints(size, spacing, centered);
-			break;
-		case BoardType::Checkerboard:
-			return makeCheckerboardPoints(size, spacing, centered);
-			break;
-		default:
-			return vector<Point3f>();
-		}
-	}
-
 	ofMesh makeBoardMesh(BoardType boardType, cv::Size size, float spacing, bool centered) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::makeBoardMesh");
 		switch (boardType) {
 		case BoardType::AsymmetricCircles:
 			return makeAsymmetricCircleMesh(size, spacing, centered);
@@ -228,50 +121,65 @@ namespace ofxCv {
 		}
 	}
 	
-	vector<Point2f> undistortImagePoints(const vector<Point2f> & distortedPixelCoordinates, cv::Mat cameraMatrix, cv::Mat distortionCoefficients) {
-		vector<Point2f> normalisedPoints;
-		cv::undistortPoints(distortedPixelCoordinates, normalisedPoints, cameraMatrix, distortionCoefficients);
-		auto fx = cameraMatrix.at<double>(0, 0);
-		auto fy = cameraMatrix.at<double>(1, 1);
-		auto cx = cameraMatrix.at<double>(0, 2);
-		auto cy = cameraMatrix.at<double>(1, 2);
-		
-		vector<Point2f> undistortedPixelCoordinates(distortedPixelCoordinates.size());
-		auto undistortedPixelCoordinatesIterator = undistortedPixelCoordinates.begin();
-		for (const auto & normalisedPoint : normalisedPoints) {
-			auto & undistorted = *undistortedPixelCoordinatesIterator++;
-			undistorted.x = normalisedPoint.x * fx + cx;
-			undistorted.y = normalisedPoint.y * fy + cy;
+	struct BoardMeshCache {
+		struct Key {
+			BoardType boardType;
+			int width;
+			int height;
+			float spacing;
+			bool centered;
+			bool operator<(const Key & other) const {
+				return tie(boardType, width, height, spacing, centered)
+					< tie(other.boardType, other.width, other.height, other.spacing, other.centered);
+			}
+		};
+		map<Key, ofMesh> meshes;
+		mutex lock;
+	};
+	
+	static BoardMeshCache & getBoardMeshCache() {
+		static BoardMeshCache cache;
+		return cache;
+	}
+	
+	const ofMesh & getBoardMesh(BoardType boardType, cv::Size size, float spacing, bool centered) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::getBoardMesh");
+		auto & cache = getBoardMeshCache();
+		lock_guard<mutex> lock(cache.lock);
+		const BoardMeshCache::Key key{ boardType, size.width, size.height, spacing, centered };
+		auto findMesh = cache.meshes.find(key);
+		if (findMesh == cache.meshes.end()) {
+			findMesh = cache.meshes.emplace(key, makeBoardMesh(boardType, size, spacing, centered)).first;
 		}
-
-		return undistortedPixelCoordinates;
+		return findMesh->second;
 	}
-
-	float reprojectionError(const vector<cv::Point2f>& imagePoints
-		, const vector<cv::Point3f>& worldPoints
-		, const cv::Mat& rotationVector
-		, const cv::Mat& translation
-		, const cv::Mat& cameraMatrix
-		, const cv::Mat& distortionCoeffients)
-	{
-
-		// Reproject the world points into image space
-		vector<Point2f> reprojectedImageCoordinates;
-		cv::projectPoints(worldPoints
-			, rotationVector
-			, translation
-			, cameraMatrix
-			, distortionCoeffients
-			, reprojectedImageCoordinates);
-
-		// Take the sum of the errors
-		float reprojectionErrorSquaredSum = 0.0f;
-		for (int i = 0; i < reprojectedImageCoordinates.size(); i++) {
-			reprojectionErrorSquaredSum += glm::distance2(toOf(reprojectedImageCoordinates[i]), toOf(imagePoints[i]));
+	
+	size_t getBoardMeshCacheMemory() {
+		auto & cache = getBoardMeshCache();
+		lock_guard<mutex> lock(cache.lock);
+		size_t bytes = 0;
+		for (auto & it : cache.meshes) {
+			auto & mesh = it.second;
+			bytes += mesh.getNumVertices() * sizeof(glm::vec3)
+				+ mesh.getNumColors() * sizeof(ofFloatColor)
+				+ mesh.getNumIndices() * sizeof(ofIndexType);
 		}
-		return sqrt(reprojectionErrorSquaredSum / (float)reprojectedImageCoordinates.size());
+		return bytes;
 	}
-
+	
+	size_t getBoardMeshCacheCount() {
+		auto & cache = getBoardMeshCache();
+		lock_guard<mutex> lock(cache.lock);
+		return cache.meshes.size();
+	}
+	
+	void clearBoardMeshCache() {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::clearBoardMeshCache");
+		auto & cache = getBoardMeshCache();
+		lock_guard<mutex> lock(cache.lock);
+		cache.meshes.clear();
+	}
+	
 	void drawMat(Mat& mat, float x, float y) {
 		drawMat(mat, x, y, mat.cols, mat.rows);
 	}
@@ -310,75 +218,6 @@ namespace ofxCv {
 		return (x / 2) * 2 + 1;
 	}
 	
-	int findFirst(const Mat& arr, unsigned char target) {
-		for(int i = 0; i < arr.rows; i++) {
-			if(arr.at<unsigned char>(i) == target) {
-				return i;
-			}
-		}
-		return 0;
-	}
-	
-	int findLast(const Mat& arr, unsigned char target) {
-		for(int i = arr.rows - 1; i >= 0; i--) {
-			if(arr.at<unsigned char>(i) == target) {
-				return i;
-			}
-		}
-		return 0;
-	}
-	
-	float weightedAverageAngle(const vector<Vec4i>& lines) {
-		float angleSum = 0;
-		glm::vec2 start, end;
-		float weights = 0;
-		for(int i = 0; i < lines.size(); i++) {
-			start = { lines[i][0], lines[i][1] };
-			end = { lines[i][2], lines[i][3] };
-			auto diff = end - start;
-			float length = glm::length(diff);
-			float weight = length * length;
-			float angle = atan2f(diff.y, diff.x);
-			angleSum += angle * weight;
-			weights += weight;
-		}
-		return angleSum / weights;
-	}
-	
-	vector<cv::Point2f> getConvexPolygon(const vector<cv::Point2f>& convexHull, int targetPoints) {
-		vector<cv::Point2f> result = convexHull;
-		
-		static const unsigned int maxIterations = 16;
-		static const double infinity = numeric_limits<double>::infinity();
-		double minEpsilon = 0;
-		double maxEpsilon = infinity;
-		double curEpsilon = 16; // good initial guess
-		
-		// unbounded binary search to simplify the convex hull until it's targetPoints
-		if(result.size() > targetPoints) {
-			for(int i = 0; i < maxIterations; i++) {
-				approxPolyDP(Mat(convexHull), result, curEpsilon, true);
-				if(result.size() == targetPoints) {
-					break;
-				}
-				if(result.size() > targetPoints) {
-					minEpsilon = curEpsilon;
-					if(maxEpsilon == infinity) {
-						curEpsilon = curEpsilon *  2;
-					} else {
-						curEpsilon = (maxEpsilon + minEpsilon) / 2;
-					}
-				}
-				if(result.size() < targetPoints) {
-					maxEpsilon = curEpsilon;
-					curEpsilon = (maxEpsilon + minEpsilon) / 2;
-				}
-			}
-		}
-		
-		return result;
-	}
-	
 	void drawHighlightString(string text, ofPoint position, ofColor background, ofColor foreground) {
 		drawHighlightString(text, position.x, position.y, background, foreground);
 	}
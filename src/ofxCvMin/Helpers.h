@@ -7,37 +7,26 @@
 
 #include "opencv2/opencv.hpp"
 #include "ofMain.h"
+#include "Utilities.h"
+#include "Core/Analysis.h"
+#include "Core/Calibration.h"
+#include "Core/Skeleton.h"
 
 namespace ofxCv {
 	
-	enum BoardType {
-		Checkerboard,
-		AsymmetricCircles
-	};
-
 	using namespace cv;
 	
-	glm::mat4 makeMatrix(Mat rotationVector, Mat translation);
-	void decomposeMatrix(const glm::mat4 &, Mat & rotationVector, Mat & translation);
-	glm::mat4 makeProjectionMatrix(Mat cameraMatrix, cv::Size imageSize);
-	
-	vector<Point3f> makeCheckerboardPoints(cv::Size size, float spacing, bool centered = true);
+	// the points these are made from are in Core/Calibration.h
 	ofMesh makeCheckerboardMesh(cv::Size size, float spacing, bool centered = true);
-
-	vector<Point3f> makeAsymmetricCirclePoints(cv::Size size, float spacing, bool centered = true);
 	ofMesh makeAsymmetricCircleMesh(cv::Size size, float spacing, bool centered = true);
-
-	vector<Point3f> makeBoardPoints(BoardType, cv::Size size, float spacing, bool centered = true);
 	ofMesh makeBoardMesh(BoardType, cv::Size, float spacing, bool centered = true);
-
-	vector<Point2f> undistortImagePoints(const vector<Point2f> &, cv::Mat cameraMatrix, cv::Mat distortionCoefficients);
-
-	float reprojectionError(const vector<cv::Point2f>& imagePoints
-		, const vector<cv::Point3f>& worldPoints
-		, const cv::Mat& rotationVector
-		, const cv::Mat& translation
-		, const cv::Mat& cameraMatrix
-		, const cv::Mat& distortionCoeffients);
+	
+	// the same mesh, made once per (BoardType, size, spacing, centered) and kept.
+	// references stay valid until clearBoardMeshCache()
+	const ofMesh & getBoardMesh(BoardType, cv::Size, float spacing, bool centered = true);
+	size_t getBoardMeshCacheMemory(); // bytes
+	size_t getBoardMeshCacheCount();
+	void clearBoardMeshCache();
 
 	void drawMat(Mat& mat, float x, float y);
 	void drawMat(Mat& mat, float x, float y, float width, float height);
@@ -91,176 +80,98 @@ namespace ofxCv {
 		return glm::vec2(maxLoc.x, maxLoc.y);
 	}
 	
+	template <class T>
+	vector<Peak> findPeaks(T& img, float threshold, int radius = 2, PeakRefinement refinement = PEAK_REFINE_QUADRATIC, int maxPeaks = 0) {
+		vector<Peak> peaks;
+		findPeaks(toCv(img), peaks, threshold, radius, refinement, maxPeaks);
+		return peaks;
+	}
+	
+	template <class T>
+	Profiles getProfiles(T& img, int accumulatorDepth = CV_32F) {
+		Profiles profiles;
+		reduceProfiles(toCv(img), profiles, accumulatorDepth);
+		return profiles;
+	}
+	
+	// if you need more than one of these, call getProfiles() once instead.
+	// for finding laser lines, see findStripeCenters()
 	template <class T>
 	Mat meanCols(T& img) {
-		Mat mat = toCv(img);
-		Mat colMat(mat.cols, 1, mat.type());
-		for(int i = 0; i < mat.cols; i++) {
-			colMat.row(i) = mean(mat.col(i));
-		}	
-		return colMat;
+		return getProfiles(img).colMean;
 	}
 	
 	template <class T>
 	Mat meanRows(T& img) {
-		Mat mat = toCv(img);
-		Mat rowMat(mat.rows, 1, mat.type());
-		for(int i = 0; i < mat.rows; i++) {
-			rowMat.row(i) = mean(mat.row(i));
-		}
-		return rowMat;
+		return getProfiles(img).rowMean;
 	}
 	
 	template <class T>
 	Mat sumCols(T& img) {
-		Mat mat = toCv(img);
-		Mat colMat(mat.cols, 1, CV_32FC1);
-		for(int i = 0; i < mat.cols; i++) {
-			colMat.row(i) = sum(mat.col(i));
-		}	
-		return colMat;
+		return getProfiles(img).colSum;
 	}
 	
 	template <class T>
 	Mat sumRows(T& img) {
-		Mat mat = toCv(img);
-		Mat rowMat(mat.rows, 1, CV_32FC1);
-		for(int i = 0; i < mat.rows; i++) {
-			rowMat.row(i) = sum(mat.row(i));
-		}
-		return rowMat;
+		return getProfiles(img).rowSum;
 	}
 	
 	template <class T>
 	Mat minCols(T& img) {
-		Mat mat = toCv(img);
-		Mat colMat(mat.cols, 1, CV_32FC1);
-		double minVal, maxVal;
-		for(int i = 0; i < mat.cols; i++) {
-			minMaxLoc(mat.col(i), &minVal, &maxVal); 
-			colMat.row(i) = minVal;
-		}	
-		return colMat;
+		return getProfiles(img).colMin;
 	}
 	
 	template <class T>
 	Mat minRows(T& img) {
-		Mat mat = toCv(img);
-		Mat rowMat(mat.rows, 1, CV_32FC1);
-		double minVal, maxVal;
-		for(int i = 0; i < mat.rows; i++) {
-			minMaxLoc(mat.row(i), &minVal, &maxVal); 
-			rowMat.row(i) = minVal;
-		}
-		return rowMat;
+		return getProfiles(img).rowMin;
 	}
 	
 	template <class T>
 	Mat maxCols(T& img) {
-		Mat mat = toCv(img);
-		Mat colMat(mat.cols, 1, CV_32FC1);
-		double minVal, maxVal;
-		for(int i = 0; i < mat.cols; i++) {
-			minMaxLoc(mat.col(i), &minVal, &maxVal); 
-			colMat.row(i) = maxVal;
-		}	
-		return colMat;
+		return getProfiles(img).colMax;
 	}
 	
 	template <class T>
 	Mat maxRows(T& img) {
-		Mat mat = toCv(img);
-		Mat rowMat(mat.rows, 1, CV_32FC1);
-		double minVal, maxVal;
-		for(int i = 0; i < mat.rows; i++) {
-			minMaxLoc(mat.row(i), &minVal, &maxVal); 
-			rowMat.row(i) = maxVal;
-		}
-		return rowMat;
+		return getProfiles(img).rowMax;
 	}
 	
-	int findFirst(const Mat& arr, unsigned char target);
-	int findLast(const Mat& arr, unsigned char target);
-	
 	template <class T>
 	void getBoundingBox(T& img, ofRectangle& box, int thresh, bool invert) {
-		Mat mat = toCv(img);
-		int flags = (invert ? THRESH_BINARY_INV : THRESH_BINARY);
+		auto profiles = getProfiles(img);
+		int first, last;
 		
-		Mat rowMat = meanRows(mat);
-		threshold(rowMat, rowMat, thresh, 255, flags);
-		box.y = findFirst(rowMat, 255);
-		box.height = findLast(rowMat, 255);
-		box.height -= box.y;
+		getProfileExtent(profiles.rowMean, thresh, invert, first, last);
+		box.y = first;
+		box.height = last - first;
 		
-		Mat colMat = meanCols(mat);
-		threshold(colMat, colMat, thresh, 255, flags);
-		box.x = findFirst(colMat, 255);
-		box.width = findLast(colMat, 255);
-		box.width -= box.x;
+		getProfileExtent(profiles.colMean, thresh, invert, first, last);
+		box.x = first;
+		box.width = last - first;
 	}
 	
-	float weightedAverageAngle(const vector<Vec4i>& lines);
-	
-	// (nearest point) to the two given lines
+	// bounding box of the non-zero pixels of a mask, returns false if there are none
 	template <class T>
-	Point3_<T> intersectLineLine(Point3_<T> lineStart1, Point3_<T> lineEnd1, Point3_<T> lineStart2, Point3_<T> lineEnd2) {
-		Point3_<T> v1(lineEnd1 - lineStart1), v2(lineEnd2 - lineStart2);
-		T v1v1 = v1.dot(v1), v2v2 = v2.dot(v2), v1v2 = v1.dot(v2), v2v1 = v2.dot(v1);
-		Mat_<T> lambda = (1. / (v1v1 * v2v2 - v1v2 * v1v2))
-		* ((Mat_<T>(2, 2) << v2v2, v1v2, v2v1, v1v1)
-			 * (Mat_<T>(2, 1) << v1.dot(lineStart2 - lineStart1), v2.dot(lineStart1 - lineStart2)));
-		return (1./2) * ((lineStart1 + v1 * lambda(0)) + (lineStart2 + v2 * lambda(1)));
-	}
-	
-	// (nearest point on a line) to the given point
-	template <class T>
-	Point3_<T> intersectPointLine(Point3_<T> point, Point3_<T> lineStart, Point3_<T> lineEnd) {
-		Point3_<T> ray = lineEnd - lineStart;
-		T u = (point - lineStart).dot(ray) / ray.dot(ray);
-		return lineStart + u * ray;
-	}
-	
-	// (nearest point on a ray) to the given point
-	template <class T>
-	Point3_<T> intersectPointRay(Point3_<T> point, Point3_<T> ray) {
-		return ray * (point.dot(ray) / ray.dot(ray));
+	bool getBoundingBox(T& img, ofRectangle& box) {
+		cv::Rect extents;
+		bool found = getNonZeroExtents(toCv(img), extents);
+		box = toOf(extents);
+		return found;
 	}
 	
 	// morphological thinning, also called skeletonization, strangely missing from opencv
 	// here is a description of the algorithm http://homepages.inf.ed.ac.uk/rbf/HIPR2/thin.htm
+	// this runs until the skeleton is complete, see skeletonize() for the options
 	template <class T>
 	void thin(T& img) {
 		Mat mat = toCv(img);
-		int w = mat.cols, h = mat.rows;
-		int ia1=-w-1,ia2=-w-0,ia3=-w+1,ib1=-0-1,ib3=-0+1,ic1=+w-1,ic2=+w-0,ic3=+w+1;
-		unsigned char* p = mat.ptr<unsigned char>();
-		vector<unsigned int> q;
-		for(int y = 1; y + 1 < h; y++) {
-			for(int x = 1; x + 1 < w; x++) {
-				int i = y * w + x;
-				if(p[i]) {
-					q.push_back(i);
-				}
-			}
-		}
-		int n = q.size();	
-		for(int i=0;i<n;i++){int j=q[i];if(!p[j+ia1]&&!p[j+ia2]&&!p[j+ia3]&&p[j+ic1]&&p[j+ic2]&&p[j+ic3]){p[j]=0;}}
-		for(int i=0;i<n;i++){int j=q[i];if(!p[j+ia3]&&!p[j+ib3]&&!p[j+ic3]&&p[j+ia1]&&p[j+ib1]&&p[j+ic1]){p[j]=0;}}
-		for(int i=0;i<n;i++){int j=q[i];if(!p[j+ic1]&&!p[j+ic2]&&!p[j+ic3]&&p[j+ia1]&&p[j+ia2]&&p[j+ia3]){p[j]=0;}}
-		for(int i=0;i<n;i++){int j=q[i];if(!p[j+ia1]&&!p[j+ib1]&&!p[j+ic1]&&p[j+ia3]&&p[j+ib3]&&p[j+ic3]){p[j]=0;}}
-		for(int i=0;i<n;i++){int j=q[i];if(!p[j+ia2]&&!p[j+ia3]&&!p[j+ib3]&&p[j+ib1]&&p[j+ic2]){p[j]=0;}}
-		for(int i=0;i<n;i++){int j=q[i];if(!p[j+ib3]&&!p[j+ic3]&&!p[j+ic2]&&p[j+ib1]&&p[j+ia2]){p[j]=0;}}
-		for(int i=0;i<n;i++){int j=q[i];if(!p[j+ic2]&&!p[j+ic1]&&!p[j+ib1]&&p[j+ia2]&&p[j+ib3]){p[j]=0;}}
-		for(int i=0;i<n;i++){int j=q[i];if(!p[j+ib1]&&!p[j+ia1]&&!p[j+ia2]&&p[j+ic2]&&p[j+ib3]){p[j]=0;}}
+		skeletonize(mat);
 	}
 	
-	// given a vector of lines, this function will find the average angle
-	float weightedAverageAngle(const vector<Vec4i>& lines);
-	
 	// finds the average angle of hough lines, unrotates by that amount and
 	// returns the average rotation. you can supply your own thresholded image
 	// for hough lines, or let it run canny detection for you.
+	// for documents and boards, deskew() is faster and more reliable.
 	template <class S, class T, class D>
 	float autorotate(S& src, D& dst, float threshold1 = 50, float threshold2 = 200) {
 		Mat thresh;
@@ -285,8 +196,6 @@ namespace ofxCv {
 		return rotationAmount;
 	}
 	
-	vector<cv::Point2f> getConvexPolygon(const vector<cv::Point2f>& convexHull, int targetPoints);
-	
 	static const ofColor cyanPrint = ofColor::fromHex(0x00abec);
 	static const ofColor magentaPrint = ofColor::fromHex(0xec008c);
 	static const ofColor yellowPrint = ofColor::fromHex(0xffee00);
@@ -0,0 +1,391 @@
+#include "Pipeline.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	//----------
+	// spin briefly when there's nothing to do, then back off to short sleeps
+	class Backoff {
+	public:
+		void wait() {
+			if (this->count < 64) {
+				std::this_thread::yield();
+			}
+			else {
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+			this->count++;
+		}
+
+		void reset() {
+			this->count = 0;
+		}
+	protected:
+		int count = 0;
+	};
+
+	//----------
+	Pipeline::~Pipeline() {
+		this->stop();
+	}
+
+	//----------
+	void Pipeline::addSource(const string & name, SourceFunction function) {
+		if (!this->stages.empty()) {
+			ofLogError("ofxCv::Pipeline") << "The source (" << name << ") must be the first stage";
+			return;
+		}
+		auto stage = make_unique<Stage>();
+		stage->name = name;
+		stage->type = StageType::Source;
+		stage->source = function;
+		this->append(std::move(stage));
+	}
+
+	//----------
+	void Pipeline::addStage(const string & name, StageFunction function) {
+		auto stage = make_unique<Stage>();
+		stage->name = name;
+		stage->type = StageType::Process;
+		stage->process = function;
+		this->append(std::move(stage));
+	}
+
+	//----------
+	void Pipeline::addSink(const string & name, SinkFunction function) {
+		auto stage = make_unique<Stage>();
+		stage->name = name;
+		stage->type = StageType::Sink;
+		stage->sink = function;
+		this->append(std::move(stage));
+	}
+
+	//----------
+	void Pipeline::clear() {
+		this->stop();
+		this->stages.clear();
+	}
+
+	//----------
+	bool Pipeline::start(const Settings & settings) {
+		this->stop();
+		if (this->stages.empty()) {
+			ofLogError("ofxCv::Pipeline") << "Can't start without any stages";
+			return false;
+		}
+
+		this->settings = settings;
+		this->settings.queueSize = std::max(this->settings.queueSize, (size_t) 1);
+
+		// a queue in front of each stage (except a source), and after the last one (unless it's a sink)
+		this->queues.clear();
+		auto makeQueue = [this]() {
+			this->queues.emplace_back(new RingBuffer<Frame>());
+			this->queues.back()->allocate(this->settings.queueSize);
+			return this->queues.back().get();
+		};
+
+		this->inputQueue = nullptr;
+		this->outputQueue = nullptr;
+		RingBuffer<Frame> * previous = nullptr;
+		for (auto & stage : this->stages) {
+			if (stage->type != StageType::Source) {
+				stage->input = previous ? previous : makeQueue();
+				if (!previous) {
+					this->inputQueue = stage->input;
+				}
+			}
+			stage->output = stage->type == StageType::Sink ? nullptr : makeQueue();
+			stage->dropWhenFull = stage->type == StageType::Source && this->settings.dropWhenFull;
+			stage->pending = Frame();
+			stage->hasPending = false;
+			stage->frameCount = 0;
+			stage->busy.store(false);
+			previous = stage->output;
+		}
+		this->outputQueue = previous;
+		this->sendCount = 0;
+		this->resetCounters();
+
+		this->running.store(true);
+		if (this->settings.threadCount <= 0) {
+			for (auto & stage : this->stages) {
+				auto stagePointer = stage.get();
+				this->threads.emplace_back([this, stagePointer]() {
+					Backoff backoff;
+					while (this->running.load(std::memory_order_relaxed)) {
+						if (this->step(*stagePointer)) {
+							backoff.reset();
+						}
+						else {
+							backoff.wait();
+						}
+					}
+				});
+			}
+		}
+		else {
+			for (int i = 0; i < this->settings.threadCount; i++) {
+				this->threads.emplace_back([this, i]() {
+					Backoff backoff;
+					const size_t stageCount = this->stages.size();
+					while (this->running.load(std::memory_order_relaxed)) {
+						// each thread starts its round at a different stage
+						bool worked = false;
+						for (size_t j = 0; j < stageCount; j++) {
+							auto & stage = *this->stages[(i + j) % stageCount];
+							if (stage.busy.exchange(true, std::memory_order_acquire)) {
+								continue;
+							}
+							worked |= this->step(stage);
+							stage.busy.store(false, std::memory_order_release);
+						}
+						if (worked) {
+							backoff.reset();
+						}
+						else {
+							backoff.wait();
+						}
+					}
+				});
+			}
+		}
+		return true;
+	}
+
+	//----------
+	bool Pipeline::start() {
+		return this->start(Settings());
+	}
+
+	//----------
+	void Pipeline::stop() {
+		if (!this->running.exchange(false)) {
+			return;
+		}
+		for (auto & thread : this->threads) {
+			thread.join();
+		}
+		this->threads.clear();
+
+		// let go of any frames still in flight
+		for (auto & stage : this->stages) {
+			stage->pending = Frame();
+			stage->hasPending = false;
+			stage->input = nullptr;
+			stage->output = nullptr;
+		}
+		this->queues.clear();
+		this->inputQueue = nullptr;
+		this->outputQueue = nullptr;
+	}
+
+	//----------
+	bool Pipeline::isRunning() const {
+		return this->running.load();
+	}
+
+	//----------
+	bool Pipeline::send(const Mat & frame) {
+		if (!this->inputQueue) {
+			ofLogError("ofxCv::Pipeline") << "send() needs a running pipeline without a source";
+			return false;
+		}
+
+		Frame entry;
+		auto & pooled = acquire(this->sendPool);
+		frame.copyTo(pooled);
+		entry.image = pooled;
+		entry.index = this->sendCount++;
+		entry.timestamp = ofGetElapsedTimeMicros();
+
+		if (this->settings.dropWhenFull) {
+			if (!this->inputQueue->push(entry)) {
+				this->recordDropped(*this->stages.front());
+				return false;
+			}
+			return true;
+		}
+
+		Backoff backoff;
+		while (!this->inputQueue->push(entry)) {
+			if (!this->running.load()) {
+				return false;
+			}
+			backoff.wait();
+		}
+		return true;
+	}
+
+	//----------
+	bool Pipeline::receive(Mat & result, bool latest) {
+		if (!this->outputQueue) {
+			return false;
+		}
+
+		Frame frame;
+		if (!this->outputQueue->pop(frame)) {
+			return false;
+		}
+		if (latest) {
+			while (this->outputQueue->pop(frame)) { }
+		}
+		result = frame.image;
+		return true;
+	}
+
+	//----------
+	size_t Pipeline::getStageCount() const {
+		return this->stages.size();
+	}
+
+	//----------
+	const string & Pipeline::getStageName(size_t stage) const {
+		return this->stages.at(stage)->name;
+	}
+
+	//----------
+	Pipeline::Counters Pipeline::getCounters(size_t stageIndex) const {
+		const auto & stage = *this->stages.at(stageIndex);
+		std::lock_guard<std::mutex> lock(stage.counterLock);
+		auto counters = stage.counters;
+		counters.elapsedTime = (double) (ofGetElapsedTimeMicros() - stage.counterStartTime) / 1e6;
+		return counters;
+	}
+
+	//----------
+	void Pipeline::resetCounters() {
+		const auto now = ofGetElapsedTimeMicros();
+		for (auto & stage : this->stages) {
+			std::lock_guard<std::mutex> lock(stage->counterLock);
+			stage->counters = Counters();
+			stage->counterStartTime = now;
+		}
+	}
+
+	//----------
+	void Pipeline::append(unique_ptr<Stage> && stage) {
+		if (this->isRunning()) {
+			ofLogError("ofxCv::Pipeline") << "Can't add " << stage->name << " while running";
+			return;
+		}
+		if (!this->stages.empty() && this->stages.back()->type == StageType::Sink) {
+			ofLogError("ofxCv::Pipeline") << "Can't add " << stage->name << " after the sink (" << this->stages.back()->name << ")";
+			return;
+		}
+		this->stages.push_back(std::move(stage));
+	}
+
+	//----------
+	// does one frame's worth of work if there is any. only ever runs on one thread at a time for each stage
+	bool Pipeline::step(Stage & stage) {
+		// a frame which couldn't be passed on last time goes first
+		if (stage.hasPending) {
+			if (!stage.output->push(stage.pending)) {
+				return false;
+			}
+			stage.hasPending = false;
+			return true;
+		}
+
+		FrameAllocator::ScopedInstall allocator(this->settings.allocator);
+
+		Frame frame;
+		const auto startTime = ofGetElapsedTimeMicros();
+		switch (stage.type) {
+		case StageType::Source:
+		{
+			auto & output = acquire(stage.pool);
+			if (!stage.source(output)) {
+				return false;
+			}
+			frame.image = output;
+			frame.index = stage.frameCount++;
+			frame.timestamp = startTime;
+			break;
+		}
+		case StageType::Process:
+		{
+			Frame input;
+			if (!stage.input->pop(input)) {
+				return false;
+			}
+			auto & output = acquire(stage.pool);
+			const bool keep = stage.process(input.image, output);
+			if (output.u && output.u == input.image.u) {
+				// passed straight through, so don't let the pool hold on to the previous stage's Mat
+				frame.image = std::move(output);
+			}
+			else {
+				frame.image = output;
+			}
+			frame.index = input.index;
+			frame.timestamp = input.timestamp;
+			if (!keep) {
+				return true;
+			}
+			break;
+		}
+		case StageType::Sink:
+		{
+			if (!stage.input->pop(frame)) {
+				return false;
+			}
+			stage.sink(frame.image);
+			this->record(stage, startTime, frame);
+			return true;
+		}
+		}
+
+		this->record(stage, startTime, frame);
+
+		if (!stage.output->push(frame)) {
+			if (stage.dropWhenFull) {
+				this->recordDropped(stage);
+			}
+			else {
+				stage.pending = std::move(frame);
+				stage.hasPending = true;
+			}
+		}
+		return true;
+	}
+
+	//----------
+	void Pipeline::record(Stage & stage, uint64_t startTime, const Frame & frame) {
+		const auto now = ofGetElapsedTimeMicros();
+		const double processTime = (double) (now - startTime) / 1e6;
+		const double latency = (double) (now - frame.timestamp) / 1e6;
+
+		std::lock_guard<std::mutex> lock(stage.counterLock);
+		auto & counters = stage.counters;
+		counters.processed++;
+		counters.processTimeTotal += processTime;
+		counters.processTimeMax = std::max(counters.processTimeMax, processTime);
+		counters.latencyTotal += latency;
+		counters.latencyMax = std::max(counters.latencyMax, latency);
+	}
+
+	//----------
+	void Pipeline::recordDropped(Stage & stage) {
+		std::lock_guard<std::mutex> lock(stage.counterLock);
+		stage.counters.dropped++;
+	}
+
+	//----------
+	// a Mat which nothing outside the pool is using (or a new one)
+	Mat & Pipeline::acquire(std::deque<Mat> & pool) {
+		for (auto & mat : pool) {
+			// Mats without a reference count (e.g. wrapping someone else's data) are dropped rather than reused
+			if (!mat.u || CV_XADD(&mat.u->refcount, 0) == 1) {
+				if (!mat.u) {
+					mat.release();
+				}
+				return mat;
+			}
+		}
+		pool.emplace_back();
+		return pool.back();
+	}
+}
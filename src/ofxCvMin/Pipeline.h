@@ -0,0 +1,217 @@
+/*
+ a chain of processing stages which run at the same time, so e.g. capture,
+ processing and output overlap rather than all happening in update().
+
+ stages are joined by lock-free single producer / single consumer ring buffers
+ of frames. each stage writes into Mats from its own pool, which are handed to
+ the next stage by reference (no copying) and reused once everything
+ downstream has let go of them. so a stage's output Mat may still hold an old
+ frame : write all of it (functions which call create() on their output, like
+ most of OpenCV, do this anyway).
+
+ with Settings::allocator, the stages' outputs and temporaries come from a
+ FrameAllocator's pools instead of malloc. a stage can also use an arena for
+ its temporaries with its own FrameAllocator, a ScopedInstall with
+ Lifetime::Frame and resetFrame() at the end of the stage function.
+
+ each stage runs on its own thread, or (threadCount > 0) all stages share a
+ pool of threads, with each stage still only running on one thread at a time.
+
+ the first stage can be a source (which makes frames), or frames can be sent in
+ with send(). the last stage can be a sink, or results can be taken out with
+ receive(). send() and receive() should each only be called from one thread
+ (e.g. update()).
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "opencv2/opencv.hpp"
+#include "Core/FrameAllocator.h"
+
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	// lock-free queue for exactly one pushing thread and one popping thread
+	template<class T>
+	class RingBuffer {
+	public:
+		// not thread safe. the capacity is rounded up to a power of 2
+		void allocate(size_t capacity) {
+			size_t size = 1;
+			while (size < capacity) {
+				size <<= 1;
+			}
+			this->slots.assign(size, T());
+			this->mask = size - 1;
+			this->head.store(0);
+			this->tail.store(0);
+		}
+
+		// the value is moved from only if there's space
+		bool push(T & value) {
+			const size_t tail = this->tail.load(std::memory_order_relaxed);
+			if (tail - this->head.load(std::memory_order_acquire) > this->mask) {
+				return false;
+			}
+			this->slots[tail & this->mask] = std::move(value);
+			this->tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool pop(T & value) {
+			const size_t head = this->head.load(std::memory_order_relaxed);
+			if (head == this->tail.load(std::memory_order_acquire)) {
+				return false;
+			}
+			value = std::move(this->slots[head & this->mask]);
+			this->head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		size_t size() const {
+			return this->tail.load(std::memory_order_acquire) - this->head.load(std::memory_order_acquire);
+		}
+
+		size_t capacity() const {
+			return this->slots.size();
+		}
+	protected:
+		vector<T> slots;
+		size_t mask = 0;
+
+		// on separate cache lines, so the two threads don't fight over them
+		alignas(64) std::atomic<size_t> head{ 0 };
+		alignas(64) std::atomic<size_t> tail{ 0 };
+	};
+
+	class Pipeline {
+	public:
+		struct Frame {
+			Mat image;
+			uint64_t index = 0;
+			uint64_t timestamp = 0; // microseconds (ofGetElapsedTimeMicros) when it entered the pipeline
+		};
+
+		// return false when there's no new frame
+		typedef std::function<bool(Mat & output)> SourceFunction;
+
+		// return false to not pass anything on for this frame
+		typedef std::function<bool(const Mat & input, Mat & output)> StageFunction;
+
+		typedef std::function<void(const Mat & input)> SinkFunction;
+
+		struct Settings {
+			size_t queueSize = 4; // frames between each pair of stages
+			int threadCount = 0; // 0 = a thread for each stage
+			bool dropWhenFull = true; // the source (or send()) drops frames rather than waiting when the first queue is full
+			FrameAllocator * allocator = nullptr; // Mats made by the stages come from its pools. it has to outlive the pipeline
+		};
+
+		struct Counters {
+			size_t processed = 0;
+			size_t dropped = 0; // frames the source (or send()) couldn't pass on
+			double processTimeTotal = 0.0; // seconds in this stage's function
+			double processTimeMax = 0.0;
+			double latencyTotal = 0.0; // seconds from entering the pipeline to leaving this stage
+			double latencyMax = 0.0;
+			double elapsedTime = 0.0; // seconds since start() or resetCounters()
+
+			double getProcessTimeMean() const {
+				return this->processed ? this->processTimeTotal / this->processed : 0.0;
+			}
+
+			double getLatencyMean() const {
+				return this->processed ? this->latencyTotal / this->processed : 0.0;
+			}
+
+			// frames per second
+			double getThroughput() const {
+				return this->elapsedTime > 0.0 ? this->processed / this->elapsedTime : 0.0;
+			}
+		};
+
+		~Pipeline();
+
+		// stages run in the order they're added. a source can only be first and a sink only last.
+		// stages can only be added while the pipeline is stopped
+		void addSource(const string & name, SourceFunction);
+		void addStage(const string & name, StageFunction);
+		void addSink(const string & name, SinkFunction);
+		void clear();
+
+		bool start(const Settings &);
+		bool start();
+		void stop();
+		bool isRunning() const;
+
+		// for pipelines without a source. the frame is copied into a pooled Mat.
+		// returns false if it was dropped
+		bool send(const Mat & frame);
+
+		// for pipelines without a sink. latest = true skips over any older results.
+		// the result shares its data with the pipeline's pool until it's released or reassigned
+		bool receive(Mat & result, bool latest = true);
+
+		size_t getStageCount() const;
+		const string & getStageName(size_t stage) const;
+		Counters getCounters(size_t stage) const;
+		void resetCounters();
+	protected:
+		enum class StageType {
+			Source,
+			Process,
+			Sink
+		};
+
+		struct Stage {
+			string name;
+			StageType type;
+			SourceFunction source;
+			StageFunction process;
+			SinkFunction sink;
+
+			RingBuffer<Frame> * input = nullptr;
+			RingBuffer<Frame> * output = nullptr;
+			bool dropWhenFull = false;
+
+			// a frame waiting for space in the output queue
+			Frame pending;
+			bool hasPending = false;
+
+			std::deque<Mat> pool;
+			uint64_t frameCount = 0;
+
+			// held by whichever thread is running this stage (when threads are shared)
+			std::atomic<bool> busy{ false };
+
+			mutable std::mutex counterLock;
+			Counters counters;
+			uint64_t counterStartTime = 0;
+		};
+
+		void append(unique_ptr<Stage> &&);
+		bool step(Stage &);
+		void record(Stage &, uint64_t startTime, const Frame &);
+		void recordDropped(Stage &);
+		static Mat & acquire(std::deque<Mat> & pool);
+
+		Settings settings;
+		vector<unique_ptr<Stage>> stages;
+		vector<unique_ptr<RingBuffer<Frame>>> queues;
+		vector<std::thread> threads;
+		std::atomic<bool> running{ false };
+
+		RingBuffer<Frame> * inputQueue = nullptr;
+		RingBuffer<Frame> * outputQueue = nullptr;
+		std::deque<Mat> sendPool;
+		uint64_t sendCount = 0;
+	};
+}
@@ -0,0 +1,293 @@
+#include "PoseTracker.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	//----------
+	void PoseTracker::setup(cv::Mat cameraMatrix, cv::Mat distortionCoefficients, BoardType boardType, cv::Size patternSize, float spacing, bool centered) {
+		this->setup(cameraMatrix, distortionCoefficients, makeBoardPoints(boardType, patternSize, spacing, centered));
+	}
+
+	//----------
+	void PoseTracker::setup(cv::Mat cameraMatrix, cv::Mat distortionCoefficients, const vector<Point3f> & objectPoints) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::PoseTracker::setup");
+		cameraMatrix.convertTo(this->cameraMatrix, CV_64F);
+		distortionCoefficients.convertTo(this->distortionCoefficients, CV_64F);
+		this->objectPoints = objectPoints;
+
+		// refinePose only models k1, k2, p1, p2, k3
+		this->intrinsics = Matx33d::eye();
+		if (this->cameraMatrix.rows == 3 && this->cameraMatrix.cols == 3) {
+			this->intrinsics = Matx33d(this->cameraMatrix);
+		}
+		this->distortion = Vec<double, 5>();
+		this->canRefine = true;
+		const auto distortionCount = (int) this->distortionCoefficients.total();
+		for (int i = 0; i < distortionCount; i++) {
+			auto coefficient = this->distortionCoefficients.ptr<double>()[i];
+			if (i < 5) {
+				this->distortion[i] = coefficient;
+			}
+			else if (coefficient != 0.0) {
+				this->canRefine = false;
+			}
+		}
+
+		// IPPE needs all the object points on the z = 0 plane
+		this->objectPointsArePlanar = objectPoints.size() >= 4;
+		for (const auto & objectPoint : objectPoints) {
+			if (objectPoint.z != 0.0f) {
+				this->objectPointsArePlanar = false;
+				break;
+			}
+		}
+
+		this->reset();
+	}
+
+	//----------
+	void PoseTracker::setSettings(const Settings & settings) {
+		this->settings = settings;
+	}
+
+	//----------
+	const PoseTracker::Settings & PoseTracker::getSettings() const {
+		return this->settings;
+	}
+
+	//----------
+	bool PoseTracker::update(const vector<Point2f> & imagePoints) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::PoseTracker::update");
+		if (imagePoints.size() != this->objectPoints.size()) {
+			ofLogError("ofxCv::PoseTracker") << "Expected " << this->objectPoints.size() << " image points, received " << imagePoints.size();
+			this->tracking = false;
+			return false;
+		}
+		if (imagePoints.size() < 4) {
+			ofLogError("ofxCv::PoseTracker") << "Need at least 4 points to solve a pose, received " << imagePoints.size();
+			this->tracking = false;
+			return false;
+		}
+
+		// measuredRotation/Translation still hold last frame's solution, which is the warm start
+		bool success = false;
+		if (this->tracking && this->canRefine) {
+			success = this->refinePose(imagePoints, this->measuredRotation, this->measuredTranslation);
+		}
+		if (this->tracking && !success) {
+			success = solvePnP(this->objectPoints, imagePoints
+				, this->cameraMatrix, this->distortionCoefficients
+				, this->measuredRotation, this->measuredTranslation
+				, true, SOLVEPNP_ITERATIVE);
+		}
+		else if (!this->tracking) {
+			success = solvePnP(this->objectPoints, imagePoints
+				, this->cameraMatrix, this->distortionCoefficients
+				, this->measuredRotation, this->measuredTranslation
+				, false, this->objectPointsArePlanar ? SOLVEPNP_IPPE : SOLVEPNP_ITERATIVE);
+		}
+
+		if (!success) {
+			this->tracking = false;
+			return false;
+		}
+
+		if (!this->measureReprojectionError(imagePoints, rotationVectorToMatrix(this->measuredRotation), this->measuredTranslation, this->reprojectionError)
+			|| this->reprojectionError > this->settings.maxReprojectionError) {
+			this->tracking = false;
+			return false;
+		}
+
+		auto smoothing = (double) ofClamp(this->settings.smoothing, 0.0f, 1.0f);
+		auto snap = this->settings.snapDistance > 0.0f
+			&& norm(this->measuredTranslation - this->translation) > this->settings.snapDistance;
+
+		if (!this->tracking || smoothing == 0.0 || snap) {
+			this->rotation = this->measuredRotation;
+			this->translation = this->measuredTranslation;
+		}
+		else {
+			// move along the geodesic between the filtered and measured rotations
+			auto filteredRotation = rotationVectorToMatrix(this->rotation);
+			auto step = rotationMatrixToVector(Matx33d(filteredRotation.t() * rotationVectorToMatrix(this->measuredRotation)));
+			this->rotation = rotationMatrixToVector(Matx33d(filteredRotation * rotationVectorToMatrix(Matx31d(step * (1.0 - smoothing)))));
+
+			this->translation = this->translation * smoothing + this->measuredTranslation * (1.0 - smoothing);
+		}
+
+		this->transform = makeMatrix(this->rotation, this->translation);
+		this->tracking = true;
+		return true;
+	}
+
+	//----------
+	void PoseTracker::reset() {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::PoseTracker::reset");
+		this->tracking = false;
+		this->rotation = Matx31d();
+		this->translation = Matx31d();
+		this->transform = glm::mat4(1.0f);
+		this->reprojectionError = 0.0f;
+	}
+
+	//----------
+	bool PoseTracker::isTracking() const {
+		return this->tracking;
+	}
+
+	//----------
+	const glm::mat4 & PoseTracker::getTransform() const {
+		return this->transform;
+	}
+
+	//----------
+	const Matx31d & PoseTracker::getRotationVector() const {
+		return this->rotation;
+	}
+
+	//----------
+	const Matx31d & PoseTracker::getTranslation() const {
+		return this->translation;
+	}
+
+	//----------
+	float PoseTracker::getReprojectionError() const {
+		return this->reprojectionError;
+	}
+
+	//----------
+	bool PoseTracker::refinePose(const vector<Point2f> & imagePoints, Matx31d & rotationVector, Matx31d & translation) const {
+		// Levenberg-Marquardt from the warm start, with the rotation updated as R <- exp(dw) * R
+		auto rotation = rotationVectorToMatrix(rotationVector);
+		const auto count = this->objectPoints.size();
+
+		auto accumulate = [&](const Matx33d & rotation, const Matx31d & translation, Matx66d * JtJ, Matx61d * Jtr, double & cost) {
+			cost = 0.0;
+			Point2d imagePoint;
+			Matx<double, 2, 6> jacobian;
+			for (size_t i = 0; i < count; i++) {
+				if (!this->project(this->objectPoints[i], rotation, translation, imagePoint, JtJ ? &jacobian : nullptr)) {
+					return false;
+				}
+				Matx21d residual(imagePoint.x - imagePoints[i].x, imagePoint.y - imagePoints[i].y);
+				cost += residual.dot(residual);
+				if (JtJ) {
+					*JtJ += jacobian.t() * jacobian;
+					*Jtr += jacobian.t() * residual;
+				}
+			}
+			return true;
+		};
+
+		Matx66d JtJ;
+		Matx61d Jtr;
+		double cost;
+		if (!accumulate(rotation, translation, &JtJ, &Jtr, cost)) {
+			return false;
+		}
+
+		double lambda = 1e-3;
+		for (int iteration = 0; iteration < 10; iteration++) {
+			auto damped = JtJ;
+			for (int i = 0; i < 6; i++) {
+				damped(i, i) += lambda * std::max(JtJ(i, i), DBL_EPSILON);
+			}
+			Matx61d step = damped.solve(-Jtr, DECOMP_CHOLESKY);
+			if (norm(step) < 1e-10) {
+				break;
+			}
+
+			Matx33d candidateRotation = rotationVectorToMatrix(Matx31d(step(0), step(1), step(2))) * rotation;
+			Matx31d candidateTranslation = translation + Matx31d(step(3), step(4), step(5));
+			double candidateCost;
+			if (accumulate(candidateRotation, candidateTranslation, nullptr, nullptr, candidateCost) && candidateCost < cost) {
+				auto converged = cost - candidateCost <= 1e-10 * cost;
+				rotation = candidateRotation;
+				translation = candidateTranslation;
+				lambda = std::max(lambda / 10.0, 1e-7);
+				if (converged) {
+					break;
+				}
+				JtJ = Matx66d();
+				Jtr = Matx61d();
+				accumulate(rotation, translation, &JtJ, &Jtr, cost);
+			}
+			else {
+				lambda *= 10.0;
+				if (lambda > 1e7) {
+					break;
+				}
+			}
+		}
+
+		rotationVector = rotationMatrixToVector(rotation);
+		return true;
+	}
+
+	//----------
+	bool PoseTracker::project(const Point3f & objectPoint, const Matx33d & rotation, const Matx31d & translation, Point2d & imagePoint, Matx<double, 2, 6> * jacobian) const {
+		// same model as projectPoints with 5 distortion coefficients
+		const Matx31d rotated = rotation * Matx31d(objectPoint.x, objectPoint.y, objectPoint.z);
+		const Matx31d camera = rotated + translation;
+		if (camera(2) <= 0.0) {
+			return false;
+		}
+
+		const double k1 = this->distortion[0], k2 = this->distortion[1], p1 = this->distortion[2], p2 = this->distortion[3], k3 = this->distortion[4];
+		const double fx = this->intrinsics(0, 0), skew = this->intrinsics(0, 1), cx = this->intrinsics(0, 2);
+		const double fy = this->intrinsics(1, 1), cy = this->intrinsics(1, 2);
+
+		const double z = 1.0 / camera(2);
+		const double x = camera(0) * z, y = camera(1) * z;
+		const double r2 = x * x + y * y;
+		const double radial = 1.0 + r2 * (k1 + r2 * (k2 + r2 * k3));
+		const double xd = x * radial + 2.0 * p1 * x * y + p2 * (r2 + 2.0 * x * x);
+		const double yd = y * radial + p1 * (r2 + 2.0 * y * y) + 2.0 * p2 * x * y;
+		imagePoint.x = fx * xd + skew * yd + cx;
+		imagePoint.y = fy * yd + cy;
+
+		if (jacobian) {
+			// d(u, v)/d(xd, yd) * d(xd, yd)/d(x, y) * d(x, y)/d(camera) * d(camera)/d(dw, dt)
+			const double radialSlope = 2.0 * (k1 + r2 * (2.0 * k2 + r2 * 3.0 * k3));
+			const Matx22d distorted(
+				radial + x * x * radialSlope + 2.0 * p1 * y + 6.0 * p2 * x, x * y * radialSlope + 2.0 * p1 * x + 2.0 * p2 * y,
+				x * y * radialSlope + 2.0 * p1 * x + 2.0 * p2 * y, radial + y * y * radialSlope + 6.0 * p1 * y + 2.0 * p2 * x);
+			const Matx22d pixels(fx, skew, 0.0, fy);
+			const Matx23d normalized(z, 0.0, -x * z, 0.0, z, -y * z);
+			const double motionValues[] = {
+				0.0, rotated(2), -rotated(1), 1.0, 0.0, 0.0,
+				-rotated(2), 0.0, rotated(0), 0.0, 1.0, 0.0,
+				rotated(1), -rotated(0), 0.0, 0.0, 0.0, 1.0 };
+			const Matx<double, 3, 6> motion(motionValues);
+			*jacobian = pixels * distorted * normalized * motion;
+		}
+		return true;
+	}
+
+	//----------
+	bool PoseTracker::measureReprojectionError(const vector<Point2f> & imagePoints, const Matx33d & rotation, const Matx31d & translation, float & error) const {
+		double squaredErrorSum = 0.0;
+		if (this->canRefine) {
+			Point2d imagePoint;
+			for (size_t i = 0; i < imagePoints.size(); i++) {
+				if (!this->project(this->objectPoints[i], rotation, translation, imagePoint, nullptr)) {
+					return false;
+				}
+				auto difference = imagePoint - Point2d(imagePoints[i]);
+				squaredErrorSum += difference.dot(difference);
+			}
+		}
+		else {
+			// distortion model beyond refinePose, so this path allocates like solvePnP does
+			vector<Point2f> reprojectedPoints;
+			projectPoints(this->objectPoints, rotationMatrixToVector(rotation), translation, this->cameraMatrix, this->distortionCoefficients, reprojectedPoints);
+			for (size_t i = 0; i < imagePoints.size(); i++) {
+				Point2d difference = reprojectedPoints[i] - imagePoints[i];
+				squaredErrorSum += difference.dot(difference);
+			}
+		}
+		error = (float) sqrt(squaredErrorSum / (double) imagePoints.size());
+		return true;
+	}
+}
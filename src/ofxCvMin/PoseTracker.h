@@ -0,0 +1,74 @@
+/*
+ PoseTracker solves the pose of a board on every frame, warm-starting from the
+ previous frame's pose and smoothing the result over time. it's intended for AR
+ overlays where findBoard runs every frame and the result goes straight into a
+ glm::mat4 (same convention as makeMatrix).
+
+ when there's no previous pose (first frame, or after tracking is lost) the pose
+ is solved from scratch with solvePnP (IPPE, which is exact for planar boards such
+ as those made by makeBoardPoints). after that, a few Levenberg-Marquardt steps
+ refine the last pose, all in Matx, so a tracked frame doesn't allocate. that
+ refinement uses projectPoints' model with up to 5 distortion coefficients
+ (k1, k2, p1, p2, k3). with more, every frame goes through solvePnP instead.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "opencv2/opencv.hpp"
+#include "Helpers.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	class PoseTracker {
+	public:
+		struct Settings {
+			// 0 = no smoothing, towards 1 = heavier smoothing
+			float smoothing = 0.5f;
+
+			// poses with a larger rms reprojection error (px) are rejected and tracking is reset
+			float maxReprojectionError = 4.0f;
+
+			// jumps larger than this (world units) skip smoothing. 0 = never skip
+			float snapDistance = 0.0f;
+		};
+
+		void setup(cv::Mat cameraMatrix, cv::Mat distortionCoefficients, BoardType, cv::Size patternSize, float spacing, bool centered = true);
+		void setup(cv::Mat cameraMatrix, cv::Mat distortionCoefficients, const vector<Point3f> & objectPoints);
+		void setSettings(const Settings &);
+		const Settings & getSettings() const;
+
+		// returns false if the pose couldn't be solved (the previous transform is kept)
+		bool update(const vector<Point2f> & imagePoints);
+		void reset();
+
+		bool isTracking() const;
+		const glm::mat4 & getTransform() const;
+		const Matx31d & getRotationVector() const;
+		const Matx31d & getTranslation() const;
+		float getReprojectionError() const;
+	protected:
+		bool refinePose(const vector<Point2f> & imagePoints, Matx31d & rotationVector, Matx31d & translation) const;
+		bool project(const Point3f & objectPoint, const Matx33d & rotation, const Matx31d & translation, Point2d & imagePoint, Matx<double, 2, 6> * jacobian) const;
+		bool measureReprojectionError(const vector<Point2f> & imagePoints, const Matx33d & rotation, const Matx31d & translation, float & error) const;
+
+		cv::Mat cameraMatrix;
+		cv::Mat distortionCoefficients;
+		Matx33d intrinsics; // cameraMatrix and the first 5 distortion coefficients, for refinePose
+		Vec<double, 5> distortion;
+		bool canRefine = false;
+		vector<Point3f> objectPoints;
+		bool objectPointsArePlanar = false;
+		Settings settings;
+
+		bool tracking = false;
+		Matx31d rotation;
+		Matx31d translation;
+		Matx31d measuredRotation;
+		Matx31d measuredTranslation;
+		glm::mat4 transform;
+		float reprojectionError = 0.0f;
+	};
+}
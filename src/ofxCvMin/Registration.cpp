@@ -0,0 +1,246 @@
+#include "Registration.h"
+#include "Core/Instrumentation.h"
+#include "Core/ThreadingConfig.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	struct SimilarityTransform {
+		Matx33f rotationScale; // scale * R
+		Vec3f translation;
+
+		Vec3f apply(const Vec3f & point) const {
+			return this->rotationScale * point + this->translation;
+		}
+
+		glm::mat4 toOf() const {
+			const auto & m = this->rotationScale;
+			return glm::mat4(m(0, 0), m(1, 0), m(2, 0), 0.0f,
+				m(0, 1), m(1, 1), m(2, 1), 0.0f,
+				m(0, 2), m(1, 2), m(2, 2), 0.0f,
+				this->translation[0], this->translation[1], this->translation[2], 1.0f);
+		}
+	};
+
+	//----------
+	// Umeyama, "Least-squares estimation of transformation parameters between two point patterns" (1991)
+	// all the statistics are gathered in one pass. sums are taken relative to the first
+	// point to avoid cancellation when the clouds are far from the origin.
+	static bool umeyama(const PointSet3f & from, const PointSet3f & to, const unsigned char * mask, const size_t * indices, size_t count, bool withScale, SimilarityTransform & result) {
+		if (count == 0) {
+			return false;
+		}
+
+		const auto fromOrigin = Vec3d(from[indices ? indices[0] : 0]);
+		const auto toOrigin = Vec3d(to[indices ? indices[0] : 0]);
+
+		Vec3d fromSum, toSum;
+		Matx33d crossSum;
+		double fromSquaredSum = 0.0;
+		size_t n = 0;
+
+		for (size_t i = 0; i < count; i++) {
+			const auto index = indices ? indices[i] : i;
+			if (mask && !mask[index]) {
+				continue;
+			}
+			const auto x = Vec3d(from[index]) - fromOrigin;
+			const auto y = Vec3d(to[index]) - toOrigin;
+			fromSum += x;
+			toSum += y;
+			fromSquaredSum += x.dot(x);
+			for (int r = 0; r < 3; r++) {
+				for (int c = 0; c < 3; c++) {
+					crossSum(r, c) += y[r] * x[c];
+				}
+			}
+			n++;
+		}
+		if (n < 3) {
+			return false;
+		}
+
+		const auto fromMean = fromSum * (1.0 / n);
+		const auto toMean = toSum * (1.0 / n);
+		const Matx33d covariance = crossSum * (1.0 / n) - toMean * fromMean.t();
+		const double fromVariance = fromSquaredSum / n - fromMean.dot(fromMean);
+		if (fromVariance <= DBL_EPSILON) {
+			return false;
+		}
+
+		Matx31d w;
+		Matx33d u, vt;
+		SVD::compute(covariance, w, u, vt);
+
+		Matx33d s = Matx33d::eye();
+		if (determinant(u) * determinant(vt) < 0.0) {
+			s(2, 2) = -1.0;
+		}
+
+		const Matx33d rotation = u * s * vt;
+		double scale = 1.0;
+		if (withScale) {
+			scale = (w(0) * s(0, 0) + w(1) * s(1, 1) + w(2) * s(2, 2)) / fromVariance;
+		}
+
+		const Vec3d translation = (toMean + toOrigin) - scale * (rotation * (fromMean + fromOrigin));
+
+		result.rotationScale = rotation * scale;
+		result.translation = translation;
+		return true;
+	}
+
+	//----------
+	static glm::mat4 estimateClosedForm(const PointSet3f & from, const PointSet3f & to, const unsigned char * mask, bool withScale) {
+		if (from.size() != to.size()) {
+			ofLogError("ofxCv::estimateRigid3D") << "Point sets differ in size (" << from.size() << " vs " << to.size() << ")";
+			return glm::mat4(1.0f);
+		}
+		SimilarityTransform transform;
+		if (!umeyama(from, to, mask, nullptr, from.size(), withScale, transform)) {
+			return glm::mat4(1.0f);
+		}
+		return transform.toOf();
+	}
+
+	//----------
+	glm::mat4 estimateRigid3D(const PointSet3f & from, const PointSet3f & to, const unsigned char * mask) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::estimateRigid3D");
+		return estimateClosedForm(from, to, mask, false);
+	}
+
+	//----------
+	glm::mat4 estimateSimilarity3D(const PointSet3f & from, const PointSet3f & to, const unsigned char * mask) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::estimateSimilarity3D");
+		return estimateClosedForm(from, to, mask, true);
+	}
+
+	//----------
+	static void markInliers(const PointSet3f & from, const PointSet3f & to, const SimilarityTransform & transform, float threshold, vector<unsigned char> & inliers) {
+		inliers.resize(from.size());
+		const auto thresholdSquared = threshold * threshold;
+		parallelFor(Range(0, (int) from.size()), [&](const Range & range) {
+			for (int i = range.start; i < range.end; i++) {
+				const auto error = transform.apply(from[i]) - to[i];
+				inliers[i] = error.dot(error) <= thresholdSquared ? 1 : 0;
+			}
+		});
+	}
+
+	//----------
+	// Nister, "Preemptive RANSAC for live structure and motion estimation" (2003)
+	static glm::mat4 estimateRansac(const PointSet3f & from, const PointSet3f & to, vector<unsigned char> & inliers, const RegistrationRansacSettings & settings, bool withScale) {
+		const auto count = from.size();
+		if (count != to.size() || count < 3) {
+			ofLogError("ofxCv::estimateRigid3DRansac") << "Need at least 3 matching points";
+			inliers.assign(count, 0);
+			return glm::mat4(1.0f);
+		}
+
+		RNG rng(settings.seed);
+
+		// points are scored in a random order so that each block is a fair sample
+		vector<size_t> order(count);
+		for (size_t i = 0; i < count; i++) {
+			order[i] = i;
+		}
+		for (size_t i = count - 1; i > 0; i--) {
+			swap(order[i], order[rng.uniform(0, (int) i + 1)]);
+		}
+
+		// generate hypotheses from minimal samples
+		struct Hypothesis {
+			SimilarityTransform transform;
+			double cost = 0.0;
+		};
+		vector<Hypothesis> hypotheses;
+		hypotheses.reserve(settings.hypothesisCount);
+		const int maxAttempts = settings.hypothesisCount * 10;
+		for (int attempt = 0; attempt < maxAttempts && (int) hypotheses.size() < settings.hypothesisCount; attempt++) {
+			size_t sample[3];
+			sample[0] = rng.uniform(0, (int) count);
+			do { sample[1] = rng.uniform(0, (int) count); } while (sample[1] == sample[0]);
+			do { sample[2] = rng.uniform(0, (int) count); } while (sample[2] == sample[0] || sample[2] == sample[1]);
+
+			// reject near-collinear samples
+			const auto a = from[sample[0]], b = from[sample[1]], c = from[sample[2]];
+			const auto ab = b - a, ac = c - a;
+			if (norm(ab.cross(ac)) <= 1e-6 * (ab.dot(ab) + ac.dot(ac))) {
+				continue;
+			}
+
+			Hypothesis hypothesis;
+			if (umeyama(from, to, nullptr, sample, 3, withScale, hypothesis.transform)) {
+				hypotheses.push_back(hypothesis);
+			}
+		}
+		if (hypotheses.empty()) {
+			ofLogError("ofxCv::estimateRigid3DRansac") << "Couldn't generate any hypotheses (are the points degenerate?)";
+			inliers.assign(count, 0);
+			return glm::mat4(1.0f);
+		}
+
+		// preemptive scoring with a truncated quadratic (MSAC) cost
+		const auto thresholdSquared = (double) settings.inlierThreshold * settings.inlierThreshold;
+		const auto blockSize = (size_t) max(settings.blockSize, 1);
+		size_t alive = hypotheses.size();
+		size_t scored = 0;
+		while (alive > 1 && scored < count) {
+			const auto blockEnd = min(scored + blockSize, count);
+			parallelFor(Range(0, (int) alive), [&](const Range & range) {
+				for (int h = range.start; h < range.end; h++) {
+					auto & hypothesis = hypotheses[h];
+					double cost = 0.0;
+					for (size_t i = scored; i < blockEnd; i++) {
+						const auto index = order[i];
+						const auto error = hypothesis.transform.apply(from[index]) - to[index];
+						cost += min((double) error.dot(error), thresholdSquared);
+					}
+					hypothesis.cost += cost;
+				}
+			});
+			scored = blockEnd;
+
+			sort(hypotheses.begin(), hypotheses.begin() + alive, [](const Hypothesis & a, const Hypothesis & b) {
+				return a.cost < b.cost;
+			});
+			alive = max(alive / 2, (size_t) 1);
+		}
+
+		// refine the winner on its inliers
+		auto best = hypotheses.front().transform;
+		markInliers(from, to, best, settings.inlierThreshold, inliers);
+		SimilarityTransform refined;
+		if (umeyama(from, to, inliers.data(), nullptr, count, withScale, refined)) {
+			best = refined;
+			markInliers(from, to, best, settings.inlierThreshold, inliers);
+		}
+
+		return best.toOf();
+	}
+
+	//----------
+	glm::mat4 estimateRigid3DRansac(const PointSet3f & from, const PointSet3f & to, vector<unsigned char> & inliers, const RegistrationRansacSettings & settings) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::estimateRigid3DRansac");
+		return estimateRansac(from, to, inliers, settings, false);
+	}
+
+	//----------
+	glm::mat4 estimateRigid3DRansac(const PointSet3f & from, const PointSet3f & to, vector<unsigned char> & inliers) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::estimateRigid3DRansac");
+		return estimateRansac(from, to, inliers, RegistrationRansacSettings(), false);
+	}
+
+	//----------
+	glm::mat4 estimateSimilarity3DRansac(const PointSet3f & from, const PointSet3f & to, vector<unsigned char> & inliers, const RegistrationRansacSettings & settings) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::estimateSimilarity3DRansac");
+		return estimateRansac(from, to, inliers, settings, true);
+	}
+
+	//----------
+	glm::mat4 estimateSimilarity3DRansac(const PointSet3f & from, const PointSet3f & to, vector<unsigned char> & inliers) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::estimateSimilarity3DRansac");
+		return estimateRansac(from, to, inliers, RegistrationRansacSettings(), true);
+	}
+}
@@ -0,0 +1,72 @@
+/*
+ rigid (rotation + translation) and similarity (rotation + translation + uniform
+ scale) alignment of 3D point sets, as a faster and more constrained alternative
+ to estimateAffine3D.
+
+ the closed-form estimators use Umeyama's method and make a single pass over the
+ points. the RANSAC estimators use preemptive scoring: all hypotheses are scored
+ on a block of points, the worse half is dropped, and so on, with the scoring of
+ each block spread across threads.
+
+ transforms are returned as glm::mat4 which map `from` onto `to`.
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "opencv2/opencv.hpp"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	// a non-owning view of 3D points, either as separate x/y/z arrays (SoA) or
+	// interleaved (e.g. vector<glm::vec3>). nothing is copied.
+	struct PointSet3f {
+		PointSet3f(const float * x, const float * y, const float * z, size_t count, size_t stride = 1)
+			: x(x), y(y), z(z), count(count), stride(stride) { }
+
+		// anything laid out as 3 floats (glm::vec3, Point3f, ofVec3f)
+		template<typename VectorType>
+		PointSet3f(const vector<VectorType> & points)
+			: x((const float *) points.data())
+			, y((const float *) points.data() + 1)
+			, z((const float *) points.data() + 2)
+			, count(points.size())
+			, stride(3) {
+			static_assert(sizeof(VectorType) == 3 * sizeof(float), "PointSet3f expects 3 packed floats per point");
+		}
+
+		size_t size() const {
+			return this->count;
+		}
+
+		Vec3f operator[](size_t i) const {
+			const auto offset = i * this->stride;
+			return Vec3f(this->x[offset], this->y[offset], this->z[offset]);
+		}
+
+		const float * x;
+		const float * y;
+		const float * z;
+		size_t count;
+		size_t stride;
+	};
+
+	struct RegistrationRansacSettings {
+		float inlierThreshold = 0.01f; // distance in world units
+		int hypothesisCount = 512;
+		int blockSize = 1024; // points scored per preemption round
+		uint64 seed = 0x12345678;
+	};
+
+	// closed form fits. mask (optional) selects which points to use
+	glm::mat4 estimateRigid3D(const PointSet3f & from, const PointSet3f & to, const unsigned char * mask = nullptr);
+	glm::mat4 estimateSimilarity3D(const PointSet3f & from, const PointSet3f & to, const unsigned char * mask = nullptr);
+
+	// robust fits. inliers is resized to the point count (1 = inlier)
+	glm::mat4 estimateRigid3DRansac(const PointSet3f & from, const PointSet3f & to, vector<unsigned char> & inliers, const RegistrationRansacSettings & settings);
+	glm::mat4 estimateRigid3DRansac(const PointSet3f & from, const PointSet3f & to, vector<unsigned char> & inliers);
+	glm::mat4 estimateSimilarity3DRansac(const PointSet3f & from, const PointSet3f & to, vector<unsigned char> & inliers, const RegistrationRansacSettings & settings);
+	glm::mat4 estimateSimilarity3DRansac(const PointSet3f & from, const PointSet3f & to, vector<unsigned char> & inliers);
+}
@@ -0,0 +1,468 @@
+#include "StructuredLight.h"
+#include "Utilities.h"
+#include "Core/ThreadingConfig.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	//----------
+	static int bitsFor(int size) {
+		int bits = 1;
+		while ((1 << bits) < size) {
+			bits++;
+		}
+		return bits;
+	}
+
+	//----------
+	static uint16_t grayToBinary(uint16_t gray) {
+		gray ^= gray >> 1;
+		gray ^= gray >> 2;
+		gray ^= gray >> 4;
+		gray ^= gray >> 8;
+		return gray;
+	}
+
+	//----------
+	void StructuredLight::setup(const Settings & settings) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::StructuredLight::setup");
+		this->settings = settings;
+		this->bitsX = bitsFor(settings.projectorWidth);
+		this->bitsY = bitsFor(settings.projectorHeight);
+
+		this->patterns.clear();
+		if (this->bitsX > 16 || this->bitsY > 16) {
+			ofLogError("ofxCv::StructuredLight") << "Projector resolution is too large for 16 bit codes";
+			this->reset();
+			return;
+		}
+		if (settings.phaseShiftSteps < 0 || settings.phaseShiftSteps == 1 || settings.phaseShiftSteps == 2) {
+			ofLogError("ofxCv::StructuredLight") << "phaseShiftSteps should be 0 or at least 3, the phase can't be recovered from " << settings.phaseShiftSteps;
+			this->reset();
+			return;
+		}
+
+		this->patterns.push_back({ PatternType::White, 0, false });
+		this->patterns.push_back({ PatternType::Black, 0, false });
+		for (int axis = 0; axis < 2; axis++) {
+			auto type = axis == 0 ? PatternType::GrayCodeX : PatternType::GrayCodeY;
+			auto bits = axis == 0 ? this->bitsX : this->bitsY;
+			for (int bit = 0; bit < bits; bit++) {
+				this->patterns.push_back({ type, bit, false });
+				if (settings.useInverse) {
+					this->patterns.push_back({ type, bit, true });
+				}
+			}
+		}
+		for (int axis = 0; axis < 2; axis++) {
+			auto type = axis == 0 ? PatternType::PhaseShiftX : PatternType::PhaseShiftY;
+			for (int step = 0; step < settings.phaseShiftSteps; step++) {
+				this->patterns.push_back({ type, step, false });
+			}
+		}
+
+		this->reset();
+	}
+
+	//----------
+	const StructuredLight::Settings & StructuredLight::getSettings() const {
+		return this->settings;
+	}
+
+	//----------
+	size_t StructuredLight::getPatternCount() const {
+		return this->patterns.size();
+	}
+
+	//----------
+	const StructuredLight::Pattern & StructuredLight::getPatternInfo(size_t index) const {
+		return this->patterns.at(index);
+	}
+
+	//----------
+	void StructuredLight::getPattern(size_t index, cv::Mat & pattern) const {
+		const auto & info = this->patterns.at(index);
+		const auto width = this->settings.projectorWidth;
+		const auto height = this->settings.projectorHeight;
+
+		switch (info.type) {
+		case PatternType::White:
+			pattern.create(height, width, CV_8UC1);
+			pattern.setTo(255);
+			return;
+		case PatternType::Black:
+			pattern.create(height, width, CV_8UC1);
+			pattern.setTo(0);
+			return;
+		default:
+			break;
+		}
+
+		// every pattern varies along one axis only, so build one line and repeat it
+		const bool alongX = info.type == PatternType::GrayCodeX || info.type == PatternType::PhaseShiftX;
+		const int length = alongX ? width : height;
+		Mat line(1, length, CV_8UC1);
+		auto linePixels = line.ptr<uchar>();
+
+		if (info.type == PatternType::GrayCodeX || info.type == PatternType::GrayCodeY) {
+			const int shift = (alongX ? this->bitsX : this->bitsY) - 1 - info.index;
+			for (int i = 0; i < length; i++) {
+				const int gray = i ^ (i >> 1);
+				const bool on = ((gray >> shift) & 1) != (info.inverse ? 1 : 0);
+				linePixels[i] = on ? 255 : 0;
+			}
+		}
+		else {
+			const double period = this->settings.phaseShiftPeriod;
+			const double offset = 2.0 * CV_PI * info.index / (double) this->settings.phaseShiftSteps;
+			for (int i = 0; i < length; i++) {
+				linePixels[i] = saturate_cast<uchar>(127.5 + 127.5 * cos(2.0 * CV_PI * i / period - offset));
+			}
+		}
+
+		if (alongX) {
+			repeat(line, height, 1, pattern);
+		}
+		else {
+			repeat(line.t(), 1, width, pattern);
+		}
+	}
+
+	//----------
+	void StructuredLight::reset() {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::StructuredLight::reset");
+		this->white.release();
+		this->black.release();
+		this->midLevel.release();
+		this->grayCodeX.release();
+		this->grayCodeY.release();
+		for (int i = 0; i < 2; i++) {
+			this->phaseX[i].release();
+			this->phaseY[i].release();
+		}
+		this->decoded.assign(this->patterns.size(), false);
+		this->decodedCount = 0;
+		this->pending.clear();
+	}
+
+	//----------
+	void StructuredLight::addCapture(size_t index, const cv::Mat & frame) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::StructuredLight::addCapture");
+		if (index >= this->patterns.size()) {
+			ofLogError("ofxCv::StructuredLight") << "Pattern index [" << index << "] is out of range";
+			return;
+		}
+		if (this->decoded[index] || this->pending.count(index)) {
+			ofLogWarning("ofxCv::StructuredLight") << "Pattern [" << index << "] has already been captured";
+			return;
+		}
+
+		Mat gray;
+		this->toGray8(frame, gray);
+		if (!this->white.empty() && gray.size() != this->white.size()) {
+			ofLogError("ofxCv::StructuredLight") << "Capture size differs from the previous captures";
+			return;
+		}
+
+		if (this->white.empty()) {
+			// first frame of the sequence, allocate the accumulators
+			this->white = Mat::zeros(gray.size(), CV_8UC1);
+			this->black = Mat::zeros(gray.size(), CV_8UC1);
+			this->grayCodeX = Mat::zeros(gray.size(), CV_16UC1);
+			this->grayCodeY = Mat::zeros(gray.size(), CV_16UC1);
+			if (this->settings.phaseShiftSteps > 0) {
+				for (int i = 0; i < 2; i++) {
+					this->phaseX[i] = Mat::zeros(gray.size(), CV_32FC1);
+					this->phaseY[i] = Mat::zeros(gray.size(), CV_32FC1);
+				}
+			}
+		}
+
+		// only hold on to the frame if it has to wait for another one
+		if (this->canDecode(index)) {
+			this->decode(index, gray);
+		}
+		else {
+			this->pending[index] = gray.data == frame.data ? gray.clone() : gray;
+		}
+
+		// anything which was waiting on this frame
+		bool progress = true;
+		while (progress) {
+			progress = false;
+			for (auto it = this->pending.begin(); it != this->pending.end(); ++it) {
+				if (this->canDecode(it->first)) {
+					auto pendingIndex = it->first;
+					auto pendingFrame = it->second;
+					this->pending.erase(it);
+					this->decode(pendingIndex, pendingFrame);
+					progress = true;
+					break;
+				}
+			}
+		}
+	}
+
+	//----------
+	bool StructuredLight::isComplete() const {
+		return !this->patterns.empty() && this->decodedCount == this->patterns.size();
+	}
+
+	//----------
+	size_t StructuredLight::getCapturedCount() const {
+		return this->decodedCount + this->pending.size();
+	}
+
+	//----------
+	bool StructuredLight::canDecode(size_t index) const {
+		const auto & pattern = this->patterns[index];
+		switch (pattern.type) {
+		case PatternType::GrayCodeX:
+		case PatternType::GrayCodeY:
+			if (this->settings.useInverse) {
+				// decoded as a pair when the inverse arrives (the inverse always follows the positive)
+				return pattern.inverse
+					? this->pending.count(index - 1) > 0
+					: this->pending.count(index + 1) > 0;
+			}
+			else {
+				return this->decoded[0] && this->decoded[1];
+			}
+		default:
+			return true;
+		}
+	}
+
+	//----------
+	void StructuredLight::decode(size_t index, const cv::Mat & frame) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::StructuredLight::decode");
+		const auto & pattern = this->patterns[index];
+		switch (pattern.type) {
+		case PatternType::White:
+		case PatternType::Black:
+			frame.copyTo(pattern.type == PatternType::White ? this->white : this->black);
+			if (!this->settings.useInverse && this->decoded[pattern.type == PatternType::White ? 1 : 0]) {
+				// without inverses, every Gray code bit is compared against the mid level between white and black
+				addWeighted(this->white, 0.5, this->black, 0.5, 0.0, this->midLevel);
+			}
+			break;
+		case PatternType::GrayCodeX:
+		case PatternType::GrayCodeY:
+			if (this->settings.useInverse) {
+				auto otherIndex = pattern.inverse ? index - 1 : index + 1;
+				auto other = this->pending[otherIndex];
+				this->pending.erase(otherIndex);
+				if (pattern.inverse) {
+					this->decodeGrayCodeBit(pattern, other, frame);
+				}
+				else {
+					this->decodeGrayCodeBit(pattern, frame, other);
+				}
+				this->decoded[otherIndex] = true;
+				this->decodedCount++;
+			}
+			else {
+				this->decodeGrayCodeBit(pattern, frame, this->midLevel);
+			}
+			break;
+		case PatternType::PhaseShiftX:
+		case PatternType::PhaseShiftY:
+			this->decodePhaseShiftStep(pattern, frame);
+			break;
+		}
+
+		this->decoded[index] = true;
+		this->decodedCount++;
+	}
+
+	//----------
+	void StructuredLight::decodeGrayCodeBit(const Pattern & pattern, const cv::Mat & positive, const cv::Mat & negative) {
+		auto & code = pattern.type == PatternType::GrayCodeX ? this->grayCodeX : this->grayCodeY;
+		const int bits = pattern.type == PatternType::GrayCodeX ? this->bitsX : this->bitsY;
+		const uint16_t bitValue = (uint16_t) (1 << (bits - 1 - pattern.index));
+
+		parallelFor(Range(0, code.rows), [&](const Range & range) {
+			for (int y = range.start; y < range.end; y++) {
+				const auto positiveRow = positive.ptr<uchar>(y);
+				const auto negativeRow = negative.ptr<uchar>(y);
+				auto codeRow = code.ptr<uint16_t>(y);
+				for (int x = 0; x < code.cols; x++) {
+					if (positiveRow[x] > negativeRow[x]) {
+						codeRow[x] |= bitValue;
+					}
+				}
+			}
+		});
+	}
+
+	//----------
+	void StructuredLight::decodePhaseShiftStep(const Pattern & pattern, const cv::Mat & frame) {
+		auto & accumulators = pattern.type == PatternType::PhaseShiftX ? this->phaseX : this->phaseY;
+		const double offset = 2.0 * CV_PI * pattern.index / (double) this->settings.phaseShiftSteps;
+		const float sinOffset = sin(offset);
+		const float cosOffset = cos(offset);
+
+		parallelFor(Range(0, frame.rows), [&](const Range & range) {
+			for (int y = range.start; y < range.end; y++) {
+				const auto frameRow = frame.ptr<uchar>(y);
+				auto sinRow = accumulators[0].ptr<float>(y);
+				auto cosRow = accumulators[1].ptr<float>(y);
+				for (int x = 0; x < frame.cols; x++) {
+					sinRow[x] += frameRow[x] * sinOffset;
+					cosRow[x] += frameRow[x] * cosOffset;
+				}
+			}
+		});
+	}
+
+	//----------
+	void StructuredLight::getProjectorMap(cv::Mat & projectorCoordinates, cv::Mat & mask) const {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::StructuredLight::getProjectorMap");
+		if (!this->isComplete()) {
+			ofLogWarning("ofxCv::StructuredLight") << "getProjectorMap called before all patterns were captured (" << this->decodedCount << "/" << this->patterns.size() << ")";
+		}
+		if (this->white.empty()) {
+			projectorCoordinates.release();
+			mask.release();
+			return;
+		}
+
+		projectorCoordinates.create(this->white.size(), CV_32FC2);
+		mask.create(this->white.size(), CV_8UC1);
+
+		const bool usePhase = this->settings.phaseShiftSteps > 0 && !this->phaseX[0].empty();
+		const float period = this->settings.phaseShiftPeriod;
+		const int width = this->settings.projectorWidth;
+		const int height = this->settings.projectorHeight;
+		const int minimumContrast = this->settings.minimumContrast;
+
+		// combine the integer Gray code with the phase within its period
+		auto refine = [period](float coarse, float sinSum, float cosSum) {
+			auto phase = atan2(sinSum, cosSum);
+			if (phase < 0.0f) {
+				phase += 2.0f * (float) CV_PI;
+			}
+			auto fine = floor(coarse / period) * period + phase / (2.0f * (float) CV_PI) * period;
+			if (fine - coarse > period / 2.0f) {
+				fine -= period;
+			}
+			else if (coarse - fine > period / 2.0f) {
+				fine += period;
+			}
+			return fine;
+		};
+
+		parallelFor(Range(0, this->white.rows), [&](const Range & range) {
+			for (int y = range.start; y < range.end; y++) {
+				const auto whiteRow = this->white.ptr<uchar>(y);
+				const auto blackRow = this->black.ptr<uchar>(y);
+				const auto codeXRow = this->grayCodeX.ptr<uint16_t>(y);
+				const auto codeYRow = this->grayCodeY.ptr<uint16_t>(y);
+				auto outputRow = projectorCoordinates.ptr<Vec2f>(y);
+				auto maskRow = mask.ptr<uchar>(y);
+
+				for (int x = 0; x < this->white.cols; x++) {
+					const int projectorX = grayToBinary(codeXRow[x]);
+					const int projectorY = grayToBinary(codeYRow[x]);
+					const bool valid = (int) whiteRow[x] - (int) blackRow[x] >= minimumContrast
+						&& projectorX < width && projectorY < height;
+
+					if (!valid) {
+						outputRow[x] = Vec2f(-1, -1);
+						maskRow[x] = 0;
+						continue;
+					}
+
+					if (usePhase) {
+						outputRow[x] = Vec2f(refine(projectorX, this->phaseX[0].ptr<float>(y)[x], this->phaseX[1].ptr<float>(y)[x])
+							, refine(projectorY, this->phaseY[0].ptr<float>(y)[x], this->phaseY[1].ptr<float>(y)[x]));
+					}
+					else {
+						outputRow[x] = Vec2f(projectorX, projectorY);
+					}
+					maskRow[x] = 255;
+				}
+			}
+		});
+	}
+
+	//----------
+	vector<bool> StructuredLight::getProjectorPoints(const vector<glm::vec2> & cameraPoints, vector<glm::vec2> & projectorPoints, int windowSize) const {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::StructuredLight::getProjectorPoints");
+		Mat projectorCoordinates, mask;
+		this->getProjectorMap(projectorCoordinates, mask);
+
+		vector<bool> found(cameraPoints.size(), false);
+		projectorPoints.assign(cameraPoints.size(), glm::vec2(0, 0));
+		if (projectorCoordinates.empty()) {
+			return found;
+		}
+
+		const int halfWindow = max(windowSize / 2, 0);
+		for (size_t i = 0; i < cameraPoints.size(); i++) {
+			const int cx = (int) round(cameraPoints[i].x);
+			const int cy = (int) round(cameraPoints[i].y);
+
+			Vec2d sum;
+			int count = 0;
+			for (int y = max(cy - halfWindow, 0); y <= min(cy + halfWindow, mask.rows - 1); y++) {
+				for (int x = max(cx - halfWindow, 0); x <= min(cx + halfWindow, mask.cols - 1); x++) {
+					if (mask.at<uchar>(y, x)) {
+						sum += Vec2d(projectorCoordinates.at<Vec2f>(y, x));
+						count++;
+					}
+				}
+			}
+
+			if (count > 0) {
+				projectorPoints[i] = glm::vec2(sum[0] / count, sum[1] / count);
+				found[i] = true;
+			}
+		}
+		return found;
+	}
+
+	//----------
+	void StructuredLight::getCorrespondences(vector<glm::vec2> & cameraPoints, vector<glm::vec2> & projectorPoints, int stride) const {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::StructuredLight::getCorrespondences");
+		Mat projectorCoordinates, mask;
+		this->getProjectorMap(projectorCoordinates, mask);
+
+		cameraPoints.clear();
+		projectorPoints.clear();
+		stride = max(stride, 1);
+		for (int y = 0; y < mask.rows; y += stride) {
+			for (int x = 0; x < mask.cols; x += stride) {
+				if (mask.at<uchar>(y, x)) {
+					const auto & projectorPoint = projectorCoordinates.at<Vec2f>(y, x);
+					cameraPoints.push_back(glm::vec2(x, y));
+					projectorPoints.push_back(glm::vec2(projectorPoint[0], projectorPoint[1]));
+				}
+			}
+		}
+	}
+
+	//----------
+	void StructuredLight::toGray8(const cv::Mat & frame, cv::Mat & gray) const {
+		Mat singleChannel;
+		switch (frame.channels()) {
+		case 4:
+			cvtColor(frame, singleChannel, COLOR_RGBA2GRAY);
+			break;
+		case 3:
+			cvtColor(frame, singleChannel, COLOR_RGB2GRAY);
+			break;
+		default:
+			singleChannel = frame;
+			break;
+		}
+
+		if (singleChannel.depth() == CV_8U) {
+			gray = singleChannel;
+		}
+		else {
+			singleChannel.convertTo(gray, CV_8U, 255.0 / getMaxVal(singleChannel.depth()));
+		}
+	}
+}
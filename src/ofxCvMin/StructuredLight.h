@@ -0,0 +1,110 @@
+/*
+ StructuredLight generates Gray code (and optionally phase shift) patterns for a
+ projector, and decodes the captured camera frames into a dense camera->projector
+ map.
+
+ frames are decoded as they arrive into bit-packed per-pixel accumulators, so
+ memory stays at a few camera frames however many patterns are used. the
+ results can be sampled at e.g. detected board corners to give projector
+ points for calibrateProjector.
+
+ pattern order:
+ - white, black (for the shadow/contrast mask)
+ - Gray code bits for x then y, most significant first, each followed by its inverse if useInverse
+ - phase shift steps for x then y (if phaseShiftSteps > 0)
+ */
+
+#pragma once
+
+#include "ofMain.h"
+#include "opencv2/opencv.hpp"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	class StructuredLight {
+	public:
+		struct Settings {
+			int projectorWidth = 1920;
+			int projectorHeight = 1080;
+
+			// capture each Gray code bit together with its inverse for robust thresholding
+			bool useInverse = true;
+
+			// 0 = Gray code only. otherwise at least 3, e.g. 4 steps per axis for sub-pixel projector coordinates
+			int phaseShiftSteps = 0;
+			int phaseShiftPeriod = 16; // projector pixels
+
+			// pixels with less difference between white and black are masked out
+			int minimumContrast = 10;
+		};
+
+		enum class PatternType {
+			White,
+			Black,
+			GrayCodeX,
+			GrayCodeY,
+			PhaseShiftX,
+			PhaseShiftY
+		};
+
+		struct Pattern {
+			PatternType type;
+			int index; // bit (0 = most significant) or phase step
+			bool inverse;
+		};
+
+		void setup(const Settings &);
+		const Settings & getSettings() const;
+
+		size_t getPatternCount() const;
+		const Pattern & getPatternInfo(size_t index) const;
+
+		// CV_8UC1 at projector resolution
+		void getPattern(size_t index, cv::Mat & pattern) const;
+
+		// start decoding a new capture sequence
+		void reset();
+
+		// frames can be any depth/channels, and should arrive in pattern order.
+		// frames which arrive early are held until they can be decoded.
+		void addCapture(size_t index, const cv::Mat & frame);
+		bool isComplete() const;
+		size_t getCapturedCount() const;
+
+		// CV_32FC2 projector pixel coordinates per camera pixel, and CV_8UC1 mask of valid pixels
+		void getProjectorMap(cv::Mat & projectorCoordinates, cv::Mat & mask) const;
+
+		// samples the map around each camera point. windowSize is the neighbourhood averaged over.
+		// returns which points found valid projector coordinates.
+		vector<bool> getProjectorPoints(const vector<glm::vec2> & cameraPoints, vector<glm::vec2> & projectorPoints, int windowSize = 5) const;
+
+		// every `stride` camera pixels, for dense correspondences
+		void getCorrespondences(vector<glm::vec2> & cameraPoints, vector<glm::vec2> & projectorPoints, int stride = 8) const;
+	protected:
+		void decode(size_t index, const cv::Mat & frame);
+		void decodeGrayCodeBit(const Pattern &, const cv::Mat & positive, const cv::Mat & negative);
+		void decodePhaseShiftStep(const Pattern &, const cv::Mat & frame);
+		bool canDecode(size_t index) const;
+		void toGray8(const cv::Mat & frame, cv::Mat & gray) const;
+
+		Settings settings;
+		vector<Pattern> patterns;
+		int bitsX = 0;
+		int bitsY = 0;
+
+		// accumulators at camera resolution
+		cv::Mat white;
+		cv::Mat black;
+		cv::Mat midLevel; // (white + black) / 2, when not using inverses
+		cv::Mat grayCodeX; // CV_16U, Gray code bits OR'd in as they arrive
+		cv::Mat grayCodeY;
+		cv::Mat phaseX[2]; // CV_32F, running sums of I*sin, I*cos
+		cv::Mat phaseY[2];
+
+		vector<bool> decoded;
+		size_t decodedCount = 0;
+		map<size_t, cv::Mat> pending;
+	};
+}
@@ -0,0 +1,142 @@
+#include "Triangulation.h"
+#include "Core/Instrumentation.h"
+#include "Core/ThreadingConfig.h"
+#include "ofMain.h"
+
+#include "opencv2/core/hal/intrin.hpp"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	// with w = origin1 - origin2, minimising |w + s d1 - t d2| gives the 2x2 system
+	//  | a  -b | |s|   |-d|
+	//  | b  -c | |t| = |-e|
+	// where a = d1.d1, b = d1.d2, c = d2.d2, d = d1.w, e = d2.w
+
+	//----------
+	static void intersectRaysScalar(const PointSet3f & origins1, const PointSet3f & directions1
+		, const PointSet3f & origins2, const PointSet3f & directions2
+		, RayIntersections & result
+		, float thresholdSquared
+		, int start, int end) {
+		const float nan = numeric_limits<float>::quiet_NaN();
+		for (int i = start; i < end; i++) {
+			const auto p1 = origins1[i], v1 = directions1[i];
+			const auto p2 = origins2[i], v2 = directions2[i];
+			const auto w = p1 - p2;
+			const float a = v1.dot(v1), b = v1.dot(v2), c = v2.dot(v2);
+			const float d = v1.dot(w), e = v2.dot(w);
+			const float denominator = a * c - b * b;
+
+			if (!(denominator > thresholdSquared * a * c)) {
+				result.x[i] = result.y[i] = result.z[i] = result.gap[i] = nan;
+				result.valid[i] = 0;
+				continue;
+			}
+
+			const float s = (b * e - c * d) / denominator;
+			const float t = (a * e - b * d) / denominator;
+			const auto closest1 = p1 + s * v1;
+			const auto closest2 = p2 + t * v2;
+			const auto midpoint = (closest1 + closest2) * 0.5f;
+			result.x[i] = midpoint[0];
+			result.y[i] = midpoint[1];
+			result.z[i] = midpoint[2];
+			result.gap[i] = (float) norm(closest1 - closest2);
+			result.valid[i] = 1;
+		}
+	}
+
+#if CV_SIMD128
+	//----------
+	static void intersectRaysSimd(const PointSet3f & origins1, const PointSet3f & directions1
+		, const PointSet3f & origins2, const PointSet3f & directions2
+		, RayIntersections & result
+		, float thresholdSquared
+		, int start, int end) {
+		const v_float32x4 half = v_setall_f32(0.5f);
+		const v_float32x4 threshold = v_setall_f32(thresholdSquared);
+		const v_float32x4 nan = v_setall_f32(numeric_limits<float>::quiet_NaN());
+
+		int i = start;
+		for (; i <= end - 4; i += 4) {
+			const v_float32x4 p1x = v_load(origins1.x + i), p1y = v_load(origins1.y + i), p1z = v_load(origins1.z + i);
+			const v_float32x4 v1x = v_load(directions1.x + i), v1y = v_load(directions1.y + i), v1z = v_load(directions1.z + i);
+			const v_float32x4 p2x = v_load(origins2.x + i), p2y = v_load(origins2.y + i), p2z = v_load(origins2.z + i);
+			const v_float32x4 v2x = v_load(directions2.x + i), v2y = v_load(directions2.y + i), v2z = v_load(directions2.z + i);
+
+			const v_float32x4 wx = p1x - p2x, wy = p1y - p2y, wz = p1z - p2z;
+			const v_float32x4 a = v1x * v1x + v1y * v1y + v1z * v1z;
+			const v_float32x4 b = v1x * v2x + v1y * v2y + v1z * v2z;
+			const v_float32x4 c = v2x * v2x + v2y * v2y + v2z * v2z;
+			const v_float32x4 d = v1x * wx + v1y * wy + v1z * wz;
+			const v_float32x4 e = v2x * wx + v2y * wy + v2z * wz;
+			const v_float32x4 denominator = a * c - b * b;
+			const v_float32x4 valid = denominator > threshold * a * c;
+
+			const v_float32x4 inverse = v_setall_f32(1.0f) / denominator;
+			const v_float32x4 s = (b * e - c * d) * inverse;
+			const v_float32x4 t = (a * e - b * d) * inverse;
+
+			const v_float32x4 c1x = v_muladd(s, v1x, p1x), c1y = v_muladd(s, v1y, p1y), c1z = v_muladd(s, v1z, p1z);
+			const v_float32x4 c2x = v_muladd(t, v2x, p2x), c2y = v_muladd(t, v2y, p2y), c2z = v_muladd(t, v2z, p2z);
+			const v_float32x4 gx = c1x - c2x, gy = c1y - c2y, gz = c1z - c2z;
+
+			v_store(result.x.data() + i, v_select(valid, (c1x + c2x) * half, nan));
+			v_store(result.y.data() + i, v_select(valid, (c1y + c2y) * half, nan));
+			v_store(result.z.data() + i, v_select(valid, (c1z + c2z) * half, nan));
+			v_store(result.gap.data() + i, v_select(valid, v_sqrt(gx * gx + gy * gy + gz * gz), nan));
+
+			const int mask = v_signmask(valid);
+			for (int lane = 0; lane < 4; lane++) {
+				result.valid[i + lane] = (mask >> lane) & 1;
+			}
+		}
+
+		intersectRaysScalar(origins1, directions1, origins2, directions2, result, thresholdSquared, i, end);
+	}
+#endif
+
+	//----------
+	void intersectRays(const PointSet3f & origins1, const PointSet3f & directions1
+		, const PointSet3f & origins2, const PointSet3f & directions2
+		, RayIntersections & result
+		, float parallelThreshold) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::intersectRays");
+		const auto count = origins1.size();
+		if (directions1.size() != count || origins2.size() != count || directions2.size() != count) {
+			ofLogError("ofxCv::intersectRays") << "Ray arrays differ in size";
+			return;
+		}
+
+		result.x.resize(count);
+		result.y.resize(count);
+		result.z.resize(count);
+		result.gap.resize(count);
+		result.valid.resize(count);
+
+		const float thresholdSquared = parallelThreshold * parallelThreshold;
+#if CV_SIMD128
+		const bool packed = origins1.stride == 1 && directions1.stride == 1
+			&& origins2.stride == 1 && directions2.stride == 1;
+#endif
+
+		// blocks big enough to amortise the thread dispatch
+		const int blockSize = 4096;
+		const int blockCount = (int) ((count + blockSize - 1) / blockSize);
+		parallelFor(Range(0, blockCount), [&](const Range & range) {
+			for (int block = range.start; block < range.end; block++) {
+				const int start = block * blockSize;
+				const int end = (int) min(count, (size_t) start + blockSize);
+#if CV_SIMD128
+				if (packed) {
+					intersectRaysSimd(origins1, directions1, origins2, directions2, result, thresholdSquared, start, end);
+					continue;
+				}
+#endif
+				intersectRaysScalar(origins1, directions1, origins2, directions2, result, thresholdSquared, start, end);
+			}
+		});
+	}
+}
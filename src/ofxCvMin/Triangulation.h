@@ -0,0 +1,46 @@
+/*
+ batched ray-ray triangulation, e.g. for camera-projector correspondences from
+ StructuredLight.
+
+ each pair of rays (origin1 + s * direction1, origin2 + t * direction2) gives the
+ midpoint of their closest approach and the gap between them there, the same as
+ intersectLineLine but without any allocation per ray.
+
+ the rays are given as PointSet3f views. when all of them are separate x/y/z
+ arrays (stride 1) 4 rays are solved at a time with SIMD, otherwise one at a
+ time. blocks of rays are spread across threads.
+ */
+
+#pragma once
+
+#include "opencv2/opencv.hpp"
+#include "Registration.h"
+
+namespace ofxCv {
+
+	using namespace cv;
+
+	struct RayIntersections {
+		// midpoints of closest approach
+		vector<float> x;
+		vector<float> y;
+		vector<float> z;
+
+		// distance between the rays at their closest approach
+		vector<float> gap;
+
+		// 0 where the rays are (close to) parallel. midpoint and gap are NaN there
+		vector<unsigned char> valid;
+
+		size_t size() const {
+			return this->x.size();
+		}
+	};
+
+	// parallelThreshold is the sine of the smallest angle between rays which is solved.
+	// the result's vectors are only reallocated if they need to grow, so reuse it between calls.
+	void intersectRays(const PointSet3f & origins1, const PointSet3f & directions1
+		, const PointSet3f & origins2, const PointSet3f & directions2
+		, RayIntersections & result
+		, float parallelThreshold = 1e-4f);
+}
@@ -12,6 +12,8 @@
 #include "ofMain.h"
 #include "opencv2/opencv.hpp"
 #include <glm/glm.hpp>
+#include "Core/Instrumentation.h"
+#include "Core/Types.h"
 
 namespace ofxCv {
 	
@@ -105,6 +107,7 @@ namespace ofxCv {
 		int iw = getWidth(img), ih = getHeight(img);
 		int it = getCvImageType(img);
 		if(iw != width || ih != height || it != cvType) {
+			OFXCV_INSTRUMENT_ALLOCATION((uint64_t) width * height * CV_ELEM_SIZE(cvType));
 			img.allocate(width, height, getOfImageType(cvType));
 		}
 	}
@@ -112,6 +115,7 @@ namespace ofxCv {
 		int iw = getWidth(img), ih = getHeight(img);
 		int it = getCvImageType(img);
 		if(iw != width || ih != height || it != cvType) {
+			OFXCV_INSTRUMENT_ALLOCATION((uint64_t) width * height * CV_ELEM_SIZE(cvType));
 			img.create(height, width, cvType);
 		}
 	}
@@ -134,29 +138,7 @@ namespace ofxCv {
 		imitate(mirror, original, getCvImageType(original));
 	}
 	
-	// maximum possible values for that depth or matrix
-	float getMaxVal(int cvDepth);
-	float getMaxVal(const Mat& mat);
-	int getTargetChannelsFromCode(int conversionCode);
-    
-	// matched types
-	// some types (e.g. ofVec2f) are equivalent and have the same memory layout
-	// and can therefore the memory which holds these types can be considered
-	// as either type. in this case, we list the matched types here (of on left,
-	// cv on right), and generate casting toOf(..) and toCv(..) functions.
-#define OFXCV_MATCHED_TYPE_OF_CV_HEADER(X, Y) \
-Y & toCv(X &);\
-const Y & toCv(const X &);\
-X & toOf(Y &);\
-const X & toOf(const Y &);
-
-#define OFXCV_MATCHED_TYPE_VECTOR_HEADER(X, Y) \
-OFXCV_MATCHED_TYPE_OF_CV_HEADER(X, Y) \
-OFXCV_MATCHED_TYPE_OF_CV_HEADER(vector<X>, vector<Y>) \
-OFXCV_MATCHED_TYPE_OF_CV_HEADER(vector<vector<X>>, vector<vector<Y>>)
-
-	OFXCV_MATCHED_TYPE_VECTOR_HEADER(glm::vec2, Point2f);
-	OFXCV_MATCHED_TYPE_VECTOR_HEADER(glm::vec3, Point3f);
+	// matched types, see Core/Types.h for the glm ones
 	OFXCV_MATCHED_TYPE_VECTOR_HEADER(ofColor, Scalar);
 	
 	// toCv functions
@@ -169,7 +151,6 @@ OFXCV_MATCHED_TYPE_OF_CV_HEADER(vector<vector<X>>, vector<vector<Y>>)
 	// is used for small objects where the compiler can optimize the copying if
 	// necessary. the reference is avoided to make inline toCv/toOf use easier.
 	
-	Mat toCv(Mat& mat);
 	template <class T> inline Mat toCv(ofPixels_<T>& pix) {
 		return Mat(pix.getHeight(), pix.getWidth(), getCvImageType(pix), pix.getData(), 0);
 	}
@@ -5,31 +5,43 @@ namespace ofxCv {
 	using namespace cv;
 
 	void loadMat(Mat& mat, string filename) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::loadMat");
+		if (isBinaryMatFile(filename)) {
+			loadMatBinary(mat, filename);
+			return;
+		}
 		FileStorage fs(ofToDataPath(filename), FileStorage::READ);
 		fs["Mat"] >> mat;
 	}
 
 	void saveMat(Mat mat, string filename) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::saveMat");
+		if (isBinaryMatFile(filename)) {
+			saveMatBinary(mat, filename);
+			return;
+		}
 		FileStorage fs(ofToDataPath(filename), FileStorage::WRITE);
 		fs << "Mat" << mat;
 	}
 
-	void saveImage(Mat& mat, string filename) {
+	bool saveImage(Mat& mat, string filename) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::saveImage");
 		if (mat.depth() == CV_8U) {
 			ofPixels pix8u;
 			toOf(mat, pix8u);
-			ofSaveImage(pix8u, filename);
+			return ofSaveImage(pix8u, filename);
 		}
 		else if (mat.depth() == CV_16U) {
 			ofShortPixels pix16u;
 			toOf(mat, pix16u);
-			ofSaveImage(pix16u, filename);
+			return ofSaveImage(pix16u, filename);
 		}
 		else if (mat.depth() == CV_32F) {
 			ofFloatPixels pix32f;
 			toOf(mat, pix32f);
-			ofSaveImage(pix32f, filename);
+			return ofSaveImage(pix32f, filename);
 		}
+		return false;
 	}
 
 	Vec3b convertColor(Vec3b color, int code) {
@@ -46,6 +58,7 @@ namespace ofxCv {
 	}
 
 	ofPolyline convexHull(const ofPolyline& polyline) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::convexHull");
 		vector<cv::Point2f> contour = toCv(polyline);
 		vector<cv::Point2f> hull;
 		convexHull(Mat(contour), hull);
@@ -53,21 +66,25 @@ namespace ofxCv {
 	}
 
 	cv::RotatedRect minAreaRect(const ofPolyline& polyline) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::minAreaRect");
 		return minAreaRect(Mat(toCv(polyline)));
 	}
 
 	cv::RotatedRect fitEllipse(const ofPolyline& polyline) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::fitEllipse");
 		return fitEllipse(Mat(toCv(polyline)));
 	}
 
 	void fitLine(const ofPolyline& polyline, ofVec2f& point, ofVec2f& direction) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::fitLine");
 		Vec4f line;
 		fitLine(Mat(toCv(polyline)), line, DIST_L2, 0, .01, .01);
 		direction.set(line[0], line[1]);
 		point.set(line[2], line[3]);
 	}
 
-	ofMatrix4x4 estimateAffine3D(vector<ofVec3f>& from, vector<ofVec3f>& to, float accuracy) {
+	ofMatrix4x4 estimateAffine3D(const vector<ofVec3f>& from, const vector<ofVec3f>& to, float accuracy) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::estimateAffine3D");
 		if (from.size() != to.size() || from.size() == 0 || to.size() == 0) {
 			return ofMatrix4x4();
 		}
@@ -75,238 +92,23 @@ namespace ofxCv {
 		return estimateAffine3D(from, to, outliers, accuracy);
 	}
 
-	ofMatrix4x4 estimateAffine3D(vector<ofVec3f>& from, vector<ofVec3f>& to, vector<unsigned char>& outliers, float accuracy) {
-		Mat fromMat(1, from.size(), CV_32FC3, &from[0]);
-		Mat toMat(1, to.size(), CV_32FC3, &to[0]);
+	ofMatrix4x4 estimateAffine3D(const vector<ofVec3f>& from, const vector<ofVec3f>& to, vector<unsigned char>& outliers, float accuracy) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::estimateAffine3D");
+		// wrap the data without copying (cv only reads these)
+		Mat fromMat(1, from.size(), CV_32FC3, (void*) from.data());
+		Mat toMat(1, to.size(), CV_32FC3, (void*) to.data());
 		Mat affine;
 		estimateAffine3D(fromMat, toMat, affine, outliers, 3, accuracy);
-		ofMatrix4x4 affine4x4;
-		affine4x4.set(affine.ptr<double>());
-		affine4x4(3, 0) = 0;
-		affine4x4(3, 1) = 0;
-		affine4x4(3, 2) = 0;
-		affine4x4(3, 3) = 1;
-		Mat affine4x4Mat(4, 4, CV_32F, affine4x4.getPtr());
-		affine4x4Mat = affine4x4Mat.t();
-		affine4x4.set(affine4x4Mat.ptr<float>());
-		return affine4x4;
-	}
-
-	bool findChessboardCornersPreTest(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & corners, int testResolution) {
-		if (image.rows > testResolution || image.cols > testResolution) {
-			cv::Mat lowRes;
-			cv::resize(image, lowRes, cv::Size(testResolution, testResolution));
-			vector<cv::Point2f> lowResPoints;
-			if (cv::findChessboardCorners(lowRes, patternSize, lowResPoints)) {
-				int maxX = 0;
-				int maxY = 0;
-				int minX = testResolution;
-				int minY = testResolution;
-
-				//find bounding box (roi) of found board
-				for (auto & lowResPoint : lowResPoints) {
-					if (lowResPoint.x < minX) {
-						minX = lowResPoint.x;
-					}
-					if (lowResPoint.y < minY) {
-						minY = lowResPoint.y;
-					}
-					if (lowResPoint.x > maxX) {
-						maxX = lowResPoint.x;
-					}
-					if (lowResPoint.y > maxY) {
-						maxY = lowResPoint.y;
-					}
-				}
-
-				//move these coords into original image space
-				maxX = maxX * image.cols / testResolution;
-				maxY = maxY * image.rows / testResolution;
-				minX = minX * image.cols / testResolution;
-				minY = minY * image.rows / testResolution;
-
-				//create a buffer around found points by 1 square size
-				int boardResolutionMin = MIN(patternSize.width, patternSize.height);
-				int strideX = (maxX - minX) / boardResolutionMin;
-				int strideY = (maxY - minY) / boardResolutionMin;
-
-				//apply buffer to bounds
-				minX -= strideX * 4;
-				maxX += strideX * 4;
-				minY -= strideY * 4;
-				maxY += strideY * 4;
-
-				//clamp new bounds
-				if (minX < 0)
-				{
-					minX = 0;
-				}
-				if (minY < 0)
-				{
-					minY = 0;
-				}
-				if (maxX > image.cols - 1)
-				{
-					maxX = image.cols - 1;
-				}
-				if (maxY > image.rows - 1)
-				{
-					maxY = image.rows - 1;
-				}
-
-				//copy roi into new matrix
-				auto roiRect = cv::Rect(minX, minY, maxX - minX, maxY - minY);
-				auto croppedFromLarge = image(roiRect);
-
-				//find in cropped image
-				vector<Point2f> croppedCorners;
-				bool foundInCropped = findChessboardCorners(croppedFromLarge, patternSize, croppedCorners);
-
-				if (foundInCropped) {
-					//'uncrop' corners
-					corners.clear();
-					for (auto & corner : croppedCorners) {
-						corners.push_back(corner + Point2f(minX, minY));
-					}
-
-					refineCheckerboardCorners(image, patternSize, corners);
-					return true;
-				}
-				else {
-					ofLogWarning("ofxCv::findChessboardCornersPreTest") << "Could find in low res, but not high res";
-					corners.clear();
-					for (auto & lowResCorner : lowResPoints) {
-						auto corner = lowResCorner;
-						corner.x *= (float)image.cols / (float)lowRes.cols;
-						corner.y *= (float)image.rows / (float)lowRes.rows;
-						corners.push_back(corner);
-					}
-
-					refineCheckerboardCorners(image, patternSize, corners);
-					return true;
-				}
-			}
-			else {
-				return false;
-			}
-		}
-		else {
-			return findChessboardCorners(image, patternSize, corners);
-		}
-	}
-
-	SimpleBlobDetector::Params getDefaultFindCircleBlobDetectorParams(Mat image, float minBlobWidthPct, float maxBlobWidthPct) {
-		float minArea = pow(minBlobWidthPct * image.cols, 2);
-		float maxArea = pow(maxBlobWidthPct * image.cols, 2);
-
-		SimpleBlobDetector::Params params;
-		params.minArea = minArea;
-		params.maxArea = maxArea;
-
-		return params;
-	}
-
-	bool findAsymmetricCircles(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & results, Ptr<FeatureDetector> featureDetector, int blockSize) {
-
-		if (!featureDetector) {
-			featureDetector = SimpleBlobDetector::create(getDefaultFindCircleBlobDetectorParams(image));
-		}
-
-		if (blockSize == 0) {
-			//blockSize = image.cols * 0.05f;
-
-			//hack for Light Barrier
-			blockSize = 100;
-		}
-		blockSize = (blockSize / 2) * 2 + 1;
-		if (blockSize <= 1) {
-			blockSize = 3;
-		}
-
-		Mat thresholded;
-		cv::adaptiveThreshold(image, thresholded, 255, ADAPTIVE_THRESH_GAUSSIAN_C, THRESH_BINARY, blockSize, 2);
-
-		return findCirclesGrid(thresholded, patternSize, results, CALIB_CB_ASYMMETRIC_GRID | CALIB_CB_CLUSTERING, featureDetector);
-	}
-
-	bool findBoard(cv::Mat image, BoardType boardType, cv::Size patternSize, vector<cv::Point2f> & results, bool useOptimisers) {
-		switch (boardType) {
-		case BoardType::Checkerboard:
-			if (useOptimisers) {
-				return findChessboardCornersPreTest(image, patternSize, results);
-			} else {
-				return findChessboardCorners(image, patternSize, results);
-			}
-			break;
-		case BoardType::AsymmetricCircles:
-			return findAsymmetricCircles(image, patternSize, results);
-		default:
-			return false;
-		}
-	}
-
-	bool refineCheckerboardCorners(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & corners, int desiredHalfWindowSize /*= 5*/) {
-		int windowSize = desiredHalfWindowSize;
-
-		//make sure search size isn't too large
-		{
-			auto boundsOfCornerFinds = cv::boundingRect(corners);
-			auto cornerFindsMinorAxis = MIN(boundsOfCornerFinds.width, boundsOfCornerFinds.height);
-			auto boardMajorAxis = MAX(patternSize.width, patternSize.height);
-			auto spacingBetweenCornersInImage = cornerFindsMinorAxis / (float)boardMajorAxis;
-
-			if (spacingBetweenCornersInImage / 4 < windowSize) {
-				windowSize = spacingBetweenCornersInImage / 4;
-				if (windowSize % 2 == 0) {
-					windowSize++;
-				}
-			}
-
-			if (windowSize < 3) {
-				//window size is too small to use
-				return false;
-			}
+		if (affine.empty()) {
+			return ofMatrix4x4();
 		}
 
-		int ignoreCenterPixelsSize = windowSize / 5;
-
-		auto subPixResults = corners;
-		try {
-			cv::cornerSubPix(image
-				, subPixResults
-				, Size(windowSize, windowSize)
-				, Size(ignoreCenterPixelsSize, ignoreCenterPixelsSize)
-				, TermCriteria(TermCriteria::MAX_ITER + TermCriteria::MAX_ITER, 50, 1e-5));
-
-			if (corners.size() != subPixResults.size()) {
-				return false;
-			}
-		}
-		catch (cv::Exception e) {
-			ofLogWarning("ofxCvMin") << "Couldn't perform sub-pixel refinement of checkerboard find : " << e.what();
-			return false;
-		}
-
-		//make sure none of the corners have walked outside their starting window
-		for (int i = 0; i < corners.size(); i++) {
-			auto difference = corners[i] - subPixResults[i];
-			if (difference.x * difference.x + difference.y * difference.y > windowSize * windowSize) {
-				//we walked too far!
-				return false;
-			}
-		}
-
-		corners = subPixResults;
-		return true;
-	}
-
-	glm::vec2 undistortPoint(const glm::vec2 & distortedPoint, cv::Mat cameraMatrix, cv::Mat distotionCoefficients) {
-		vector<Point2f> distortedPoints(1, toCv(distortedPoint));
-		vector<Point2f> undistortedPoints(1);
-
-		cv::undistortPoints(distortedPoints, undistortedPoints, cameraMatrix, distotionCoefficients);
-
-		return toOf(undistortedPoints[0]);
+		// affine is 3x4 premultiplied, ofMatrix4x4 is postmultiplied so we fill it transposed
+		const double* a = affine.ptr<double>();
+		return ofMatrix4x4(a[0], a[4], a[8], 0,
+			a[1], a[5], a[9], 0,
+			a[2], a[6], a[10], 0,
+			a[3], a[7], a[11], 1);
 	}
 
 	float calibrateProjector(cv::Mat & cameraMatrixOut
@@ -316,6 +118,7 @@ namespace ofxCv {
 		, bool projectorPointsAreNormalized
 		, float initialLensOffset, float initialThrowRatio
 		, bool trimOutliers, int flags) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::calibrateProjector");
 		vector<cv::Point2f> projector;
 		if (projectorPointsAreNormalized) {
 			for (const auto & projectorNormalisedPoint : projectorPoints) {
@@ -367,6 +170,7 @@ namespace ofxCv {
 		, bool projectorPointsAreNormalized
 		, float initialLensOffset, float initialThrowRatio
 		, bool trimOutliers, int flags) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::calibrateProjector");
 
 		cv::Mat cameraMatrix, rotation, translation;
 		float error = calibrateProjector(cameraMatrix
@@ -386,60 +190,4 @@ namespace ofxCv {
 		projectionOut = makeProjectionMatrix(cameraMatrix, cv::Size(projectorWidth, projectorHeight));
 		return error;
 	}
-
-	float calibrateCameraWorldRemoveOutliers(vector<Point3f> pointsWorld, vector<Point2f> pointsImage, cv::Size size, cv::Mat & cameraMatrix, cv::Mat & distortionCoefficients, cv::Mat & rotation, cv::Mat & translation, int flags, float maxError) {
-		const int pointCount = pointsWorld.size();
-
-		auto cameraMatrixCopy = cameraMatrix;
-
-		vector<Mat> rotations, translations;
-		float rmsErrorAll = cv::calibrateCamera(vector<vector<Point3f>>(1, pointsWorld), vector<vector<Point2f>>(1, pointsImage),
-			size, cameraMatrix, distortionCoefficients,
-			rotations, translations, flags);
-
-		vector<Point2f> projectedPoints;
-	
-		cv::projectPoints(pointsWorld, rotations[0], translations[0], cameraMatrix, distortionCoefficients, projectedPoints);
-		set<int> indicesToRemove;
-
-		for (int i = 0; i < pointCount; i++) {
-			auto error = glm::length(toOf(projectedPoints[i] - pointsImage[i]));
-			if (error > maxError) {
-				ofLogNotice("ofxCvMin::calibrateCameraWorldRemoveOutliers") << "Removing point [" << i << "] = [" << pointsWorld[i] << "]->[" << pointsImage[i] << "] because its error is too high [" << error << "]";
-				indicesToRemove.insert(i);
-			}
-		}
-
-		vector<Point3f> trimmedPointsWorld;
-		vector<Point2f> trimmedPointsImage;
-
-		for (int i = 0; i < pointCount; i++) {
-			if (indicesToRemove.find(i) == indicesToRemove.end()) {
-				trimmedPointsWorld.push_back(pointsWorld[i]);
-				trimmedPointsImage.push_back(pointsImage[i]);
-			}
-		}
-
-		cameraMatrix = cameraMatrixCopy.clone();
-		
-		//ensure principal point inside image
-		{
-			cameraMatrix.at<double>(0, 2) = ofClamp(cameraMatrix.at<double>(0, 2), 0.01, 0.99 * (float)size.width);
-			cameraMatrix.at<double>(1, 2) = ofClamp(cameraMatrix.at<double>(1, 2), 0.01, 0.99 * (float)size.height);
-		}
-
-		float rmsErrorTrimmed = cv::calibrateCamera(vector<vector<Point3f>>(1, trimmedPointsWorld), vector<vector<Point2f>>(1, trimmedPointsImage)
-			, size
-			, cameraMatrix, distortionCoefficients
-			, rotations, translations
-			, flags);
-
-		if (rmsErrorTrimmed != rmsErrorAll) {
-			ofLogNotice("ofxCvMin::calibrateCameraWorldRemoveOutliers") << "Removing " << indicesToRemove.size() << "/" << pointCount << " points changed resprojection error from " << rmsErrorAll << "px to " << rmsErrorTrimmed << "px";
-		}
-
-		rotation = rotations[0];
-		translation = translations[0];
-		return rmsErrorTrimmed;
-	}
 }
\ No newline at end of file
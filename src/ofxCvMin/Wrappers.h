@@ -31,14 +31,19 @@
 #include "opencv2/opencv.hpp"
 #include "Utilities.h"
 #include "Helpers.h"
+#include "Core/MatFile.h"
 
 namespace ofxCv {
 	
 	using namespace cv;
 	
+	// .cvmat files are raw binary (and memory-mapped when loading), see MatFile.h.
+	// anything else (.yml, .xml, .json) goes through FileStorage
 	void loadMat(Mat& mat, string filename);
 	void saveMat(Mat mat, string filename);
-	void saveImage(Mat& mat, string filename);
+	// returns false if the depth isn't 8U, 16U or 32F or the image couldn't be written.
+	// to save without waiting for the encoder, see AsyncImageWriter
+	bool saveImage(Mat& mat, string filename);
 	
 	// wrapThree are based on functions that operate on three Mat objects.
 	// the first two are inputs, and the third is an output. for example,
@@ -52,6 +57,7 @@ namespace ofxCv {
 #define wrapThree(name) \
 template <class X, class Y, class Result>\
 void name(X& x, Y& y, Result& result) {\
+OFXCV_INSTRUMENT_SCOPE("ofxCv::" #name);\
 imitate(y, x);\
 imitate(result, x);\
 Mat xMat = toCv(x), yMat = toCv(y);\
@@ -82,6 +88,7 @@ cv::name(xMat, yMat, resultMat);\
 	// also useful for taking the average/mixing two images
 	template <class X, class Y, class R>
 	void lerp(X& x, Y& y, R& result, float amt = .5) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::lerp");
 		imitate(result, x);
 		Mat xMat = toCv(x), yMat = toCv(y);
 		Mat resultMat = toCv(result);
@@ -97,6 +104,7 @@ cv::name(xMat, yMat, resultMat);\
 	// normalize the min/max to [0, max for this type] out of place
 	template <class S, class D>
 	void normalize(S& src, D& dst) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::normalize");
 		imitate(dst, src);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
 		cv::normalize(srcMat, dstMat, 0, getMaxVal(getDepth(dst)), NORM_MINMAX);
@@ -111,6 +119,7 @@ cv::name(xMat, yMat, resultMat);\
 	// threshold out of place
 	template <class S, class D>
 	void threshold(S& src, D& dst, float thresholdValue, bool invert = false) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::threshold");
 		imitate(dst, src);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
 		int thresholdType = invert ? THRESH_BINARY_INV : THRESH_BINARY;
@@ -127,6 +136,7 @@ cv::name(xMat, yMat, resultMat);\
 	// erode out of place
 	template <class S, class D>
 	void erode(S& src, D& dst, int iterations = 1) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::erode");
 		imitate(dst, src);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
 		cv::erode(srcMat, dstMat, Mat(), cv::Point(-1, -1), iterations);
@@ -141,6 +151,7 @@ cv::name(xMat, yMat, resultMat);\
 	// dilate out of place
 	template <class S, class D>
 	void dilate(S& src, D& dst, int iterations = 1) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::dilate");
 		imitate(dst, src);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
 		cv::dilate(srcMat, dstMat, Mat(), cv::Point(-1, -1), iterations);
@@ -155,6 +166,7 @@ cv::name(xMat, yMat, resultMat);\
 	// automatic threshold (grayscale 8-bit only) out of place
 	template <class S, class D>
 	void autothreshold(S& src, D& dst, bool invert = false) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::autothreshold");
 		imitate(dst, src);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
 		int flags = THRESH_OTSU | (invert ? THRESH_BINARY_INV : THRESH_BINARY);
@@ -171,6 +183,7 @@ cv::name(xMat, yMat, resultMat);\
 	// you can convert whole images...
 	template <class S, class D>
 	void convertColor(S& src, D& dst, int code) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::convertColor");
 		// cvtColor allocates Mat for you, but we need this to handle ofImage etc.
 		int targetChannels = getTargetChannelsFromCode(code);
 		imitate(dst, src, getCvImageType(targetChannels, getDepth(src)));
@@ -200,6 +213,7 @@ cv::name(xMat, yMat, resultMat);\
 	// Gaussian blur
 	template <class S, class D>
 	void blur(S& src, D& dst, int size) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::blur");
 		imitate(dst, src);
 		size = forceOdd(size);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
@@ -215,6 +229,7 @@ cv::name(xMat, yMat, resultMat);\
 	// Median blur
 	template <class S, class D>
 	void medianBlur(S& src, D& dst, int size) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::medianBlur");
 		imitate(dst, src);
 		size = forceOdd(size);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
@@ -230,6 +245,7 @@ cv::name(xMat, yMat, resultMat);\
 	// histogram equalization, adds support for color images
 	template <class S, class D>
 	void equalizeHist(S& src, D& dst) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::equalizeHist");
 		imitate(dst, src);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
 		if(srcMat.channels() > 1) {
@@ -255,6 +271,7 @@ cv::name(xMat, yMat, resultMat);\
 	// example thresholds might be 0,30 or 50,200
 	template <class S, class D>
 	void Canny(S& src, D& dst, double threshold1, double threshold2, int apertureSize=3, bool L2gradient=false) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::Canny");
 		imitate(dst, src, CV_8UC1);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
 		cv::Canny(srcMat, dstMat, threshold1, threshold2, apertureSize, L2gradient);
@@ -331,6 +348,7 @@ cv::name(xMat, yMat, resultMat);\
 	
 	template <class S, class D>
 	void flip(S& src, D& dst, int code) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::flip");
 		imitate(dst, src);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
 		cv::flip(srcMat, dstMat, code);
@@ -340,6 +358,7 @@ cv::name(xMat, yMat, resultMat);\
 	// the displacement and use remap.
 	template <class S, class D>
 	void rotate(S& src, D& dst, double angle, ofColor fill = ofColor::black, int interpolation = INTER_LINEAR) {
+		OFXCV_INSTRUMENT_SCOPE("ofxCv::rotate");
 		imitate(dst, src);
 		Mat srcMat = toCv(src), dstMat = toCv(dst);
 		Point2f center(srcMat.rows / 2, srcMat.cols / 2);
@@ -369,21 +388,11 @@ cv::name(xMat, yMat, resultMat);\
 	}
 	
 	// finds the 3x4 matrix that best describes the (premultiplied) affine transformation between two point clouds
-	ofMatrix4x4 estimateAffine3D(vector<ofVec3f>& from, vector<ofVec3f>& to, float accuracy = .99);
-	ofMatrix4x4 estimateAffine3D(vector<ofVec3f>& from, vector<ofVec3f>& to, vector<unsigned char>& outliers, float accuracy = .99);
+	// for rigid or similarity transforms see estimateRigid3D / estimateSimilarity3D in Registration.h
+	ofMatrix4x4 estimateAffine3D(const vector<ofVec3f>& from, const vector<ofVec3f>& to, float accuracy = .99);
+	ofMatrix4x4 estimateAffine3D(const vector<ofVec3f>& from, const vector<ofVec3f>& to, vector<unsigned char>& outliers, float accuracy = .99);
 	
-	bool findChessboardCornersPreTest(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & corners, int testResolution = 512);
-	SimpleBlobDetector::Params getDefaultFindCircleBlobDetectorParams(Mat image, float minBlobWidthPct = 0.001f, float maxBlobWidthPct = 0.05f);
-	bool findAsymmetricCircles(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & results, Ptr<FeatureDetector> featureDetector = Ptr<FeatureDetector>(), int blockSize = 0);
-
-	/// useOptimisers refers to using techniques like pre-testing the checkerboard at low resolutions
-	bool findBoard(cv::Mat image, BoardType, cv::Size patternSize, vector<cv::Point2f> & results, bool useOptimisers = true);
-
-	/// Refine checkerboard corners. Note that all pixels inside the window should belong to the corner feature. Also the halfWindowSize is corrected for you if ofxCvMin thinks it's too large
-	bool refineCheckerboardCorners(cv::Mat image, cv::Size patternSize, vector<cv::Point2f> & corners, int desiredHalfWindowSize = 10);
-
-	glm::vec2 undistortPoint(const glm::vec2 &, cv::Mat cameraMatrix, cv::Mat distotionCoefficients);
-
+	// findBoard, refineCheckerboardCorners and calibrateCameraWorldRemoveOutliers are in Core/Calibration.h
 	float calibrateProjector(cv::Mat & cameraMatrixOut
 		, cv::Mat & rotationOut, cv::Mat & translationOut
 		, vector<glm::vec3> world, vector<glm::vec2> projectorPoints
@@ -398,6 +407,4 @@ cv::name(xMat, yMat, resultMat);\
 		, bool projectorPointsAreNormalized
 		, float initialLensOffset, float initialThrowRatio = 1.4f
 		, bool trimOutliers = false, int flags = CALIB_FIX_K1 | CALIB_FIX_K2 | CALIB_FIX_K3 | CALIB_FIX_K4 | CALIB_FIX_K5 | CALIB_FIX_K6 | CALIB_ZERO_TANGENT_DIST | CALIB_USE_INTRINSIC_GUESS | CALIB_FIX_ASPECT_RATIO);
-
-	float calibrateCameraWorldRemoveOutliers(vector<Point3f> pointsWorld, vector<Point2f> pointsImage, cv::Size size, cv::Mat & cameraMatrixOut, cv::Mat & distortionCoefficientsOuts, cv::Mat & rotation, cv::Mat & translationOut, int flags, float maxError = 20.0f);
 }
@@ -0,0 +1,24 @@
+#pragma once
+
+// the parts of ofxCvMin which only need OpenCV and glm, for programs which
+// don't run openFrameworks (e.g. headless workers). build ofxCvMinCoreLib, or
+// compile src/ofxCvMin/Core/*.cpp, and put glm and the OpenCV includes on the path.
+// ofxCvMin.h includes all of this too.
+
+// cv
+#include "opencv2/opencv.hpp"
+
+// ofxCvMin core
+#include "ofxCvMin/Core/Platform.h"
+#include "ofxCvMin/Core/Types.h"
+#include "ofxCvMin/Core/Analysis.h"
+#include "ofxCvMin/Core/Calibration.h"
+
+// subsystems
+#include "ofxCvMin/Core/BundleAdjustment.h"
+#include "ofxCvMin/Core/Skeleton.h"
+#include "ofxCvMin/Core/LaserLine.h"
+#include "ofxCvMin/Core/MatFile.h"
+#include "ofxCvMin/Core/Instrumentation.h"
+#include "ofxCvMin/Core/FrameAllocator.h"
+#include "ofxCvMin/Core/ThreadingConfig.h"